@@ -1,6 +1,7 @@
 #include "mec_eigenharp.h"
 
 #include "mec_log.h"
+#include "../mec_latency.h"
 #include "../mec_surfacemapper.h"
 #include "../mec_voice.h"
 
@@ -24,6 +25,7 @@ public:
                         ? 0 : 1000000ULL /
                               p.getInt("throttle",
                                        0)) {
+        voices_.setStealPolicy(Voices::stealPolicy(p.getString("steal policy", "oldest")));
         if (valid_) {
             LOG_0("EigenharpHandler enabling for mecapi");
         }
@@ -63,6 +65,8 @@ public:
 
     virtual void key(const char *dev, unsigned long long t, unsigned course, unsigned key, bool a, unsigned p, int r,
                      int y) {
+        // called back directly, rather than via a queue, so latency is recorded here
+        uint64_t ts = Latency::stamp();
         Voices::Voice *voice = voices_.voiceId(key);
         float mx = bipolar(r);
         float my = bipolar(y);
@@ -86,8 +90,9 @@ public:
                 if (!voice && stealVoices_) {
                     LOG_2("voice steal required for " << key);
                     // no available voices, steal?
-                    Voices::Voice *stolen = voices_.oldestActiveVoice();
+                    Voices::Voice *stolen = voices_.stealVoice();
                     callback_.touchOff(stolen->i_, stolen->note_, stolen->x_, stolen->y_, 0.0f);
+                    Latency::recordDirect(ts);
                     stolenKeys_.insert((unsigned) stolen->id_);
                     voices_.stopVoice(stolen);
                     voice = voices_.startVoice(key);
@@ -101,6 +106,7 @@ public:
                     if (voice->state_ == Voices::Voice::ACTIVE) {
                         LOG_2("start voice for " << key << " ch " << voice->i_);
                         callback_.touchOn(voice->i_, mn, mx, my, voice->v_); //v_ = calculated velocity
+                        Latency::recordDirect(ts);
                         voice->t_ = t;
                     }
                     // dont send to callbacks until we have the minimum pressures for velocity
@@ -108,6 +114,7 @@ public:
                     if (throttle_ == 0 || (t - voice->t_) >= throttle_) {
                         LOG_2("continue voice for " << key << " ch " << voice->i_);
                         callback_.touchContinue(voice->i_, mn, mx, my, mz);
+                        Latency::recordDirect(ts);
                         voice->t_ = t;
                     }
                 }
@@ -124,6 +131,7 @@ public:
             if (voice) {
                 LOG_2("stop voice for " << key << " ch " << voice->i_);
                 callback_.touchOff(voice->i_, mn, mx, my, mz);
+                Latency::recordDirect(ts);
                 voices_.stopVoice(voice);
             }
             stolenKeys_.erase(key);
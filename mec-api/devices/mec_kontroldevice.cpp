@@ -174,6 +174,11 @@ bool KontrolDevice::isActive() {
     return active_;
 }
 
+bool KontrolDevice::setNotifier(Notifier *) {
+    // processing is done on the processor thread, nothing to signal
+    return true;
+}
+
 }
 
 
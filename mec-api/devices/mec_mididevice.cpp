@@ -1,6 +1,7 @@
 #include "mec_mididevice.h"
 
 #include "mec_log.h"
+#include "../mec_latency.h"
 #include "../mec_voice.h"
 
 namespace mec {
@@ -34,6 +35,8 @@ bool MidiDevice::init(void *arg) {
     }
     active_ = false;
 
+    queue_.resize(static_cast<unsigned>(prefs.getInt("queue size", MsgQueue::DEFAULT_SIZE)));
+
     bool found = false;
 
     std::string input_device = prefs.getString("input device");
@@ -140,6 +143,9 @@ void MidiDevice::deinit() {
     LOG_0("MidiDevice::deinit");
     if (midiInDevice_) midiInDevice_->cancelCallback();
     midiInDevice_.reset();
+    if (queue_.dropped() > 0) {
+        LOG_0("MidiDevice::deinit - queue dropped " << queue_.dropped() << " high water " << queue_.highWaterMark());
+    }
     active_ = false;
 }
 
@@ -147,6 +153,11 @@ bool MidiDevice::isActive() {
     return active_;
 }
 
+bool MidiDevice::setNotifier(Notifier *n) {
+    queue_.setNotifier(n);
+    return true;
+}
+
 bool MidiDevice::midiCallback(double, std::vector<unsigned char> *message) {
     int status = 0, data1 = 0, data2 = 0; //data3 = 0;
     unsigned int n = message->size();
@@ -162,6 +173,7 @@ bool MidiDevice::midiCallback(double, std::vector<unsigned char> *message) {
     int type = status & 0xF0;
     VoiceData &touch = touches_[ch];
     MecMsg msg;
+    Latency::stamp(msg);
     switch (type) {
         case 0x90: {
             // note on (+note off if vel =0)
@@ -338,14 +350,9 @@ bool MidiDevice::midiCallback(double, std::vector<unsigned char> *message) {
 
 bool MidiDevice::send(const MidiMsg &m) {
     if (midiOutDevice_ == nullptr || !isOutputOpen()) return false;
-    std::vector<unsigned char> msg;
-
-    for (int i = 0; i < m.size; i++) {
-        msg.push_back(m.data[i]);
-    }
 
     try {
-        midiOutDevice_->sendMessage(&msg);
+        midiOutDevice_->sendMessage(m.data, m.size);
     } catch (RtMidiError &error) {
         LOG_0("MidiDevice output write error:" << error.what());
         return false;
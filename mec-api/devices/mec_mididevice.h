@@ -21,6 +21,7 @@ public:
     virtual bool process();
     virtual void deinit();
     virtual bool isActive();
+    virtual bool setNotifier(Notifier *);
 
     virtual bool midiCallback(double deltatime, std::vector<unsigned char> *message);
 
@@ -4,39 +4,81 @@
 #include <osc/OscOutboundPacketStream.h>
 #include <osc/OscReceivedElements.h>
 #include <osc/OscPacketListener.h>
+#include <ip/TimerListener.h>
 #include <ip/UdpSocket.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 
 #include "mec_log.h"
+#include "../mec_latency.h"
 #include "../mec_voice.h"
 
-////////////////////////////////////////////////
-// TODO
-////////////////////////////////////////////////
-
 namespace mec {
 
-class OscT3DHandler : public osc::OscPacketListener {
+static uint64_t nowMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// parses /t3d/tchN, returning the touch id N, or -1 if not a touch address (no allocation)
+static int touchAddress(const char *addr) {
+    static const char A_TOUCH[] = "/t3d/tch";
+    static const unsigned A_TOUCH_LEN = sizeof(A_TOUCH) - 1;
+    if (std::strncmp(addr, A_TOUCH, A_TOUCH_LEN) != 0) return -1;
+    const char *p = addr + A_TOUCH_LEN;
+    if (*p == 0) return -1;
+    int id = 0;
+    for (; *p; p++) {
+        if (*p < '0' || *p > '9' || id > 100000) return -1;
+        id = id * 10 + (*p - '0');
+    }
+    return id;
+}
+
+// runs on the socket thread, packets and the timeout timer are both called from the multiplexer
+class OscT3DHandler : public osc::OscPacketListener, public TimerListener {
 public:
+    static const unsigned MAX_FRAME_MSGS = 64;
+
     OscT3DHandler(Preferences &p, MsgQueue &q)
         : prefs_(p),
           queue_(q),
           valid_(true),
-          socket_(nullptr) {
+          voices_(static_cast<unsigned>(p.getInt("voices", 15)),
+                  static_cast<unsigned>(p.getInt("velocity count", 5))),
+          stealVoices_(p.getBool("steal voices", false)),
+          timeout_(static_cast<unsigned>(p.getInt("touch timeout", 250))),
+          frameSize_(0),
+          frameStamp_(0),
+          frames_(0),
+          touches_(0),
+          timedOut_(0) {
+        voices_.setStealPolicy(Voices::stealPolicy(p.getString("steal policy", "oldest")));
         if (valid_) {
             LOG_0("OscT3DHandler enabling for mecapi");
         }
-        for (int i = 0; i < sizeof(activeTouches_); i++) {
-            activeTouches_[i] = false;
-        }
-        stealVoices_ = false;
     }
 
     bool isValid() { return valid_; }
 
-    void setSocket(UdpListeningReceiveSocket *pS) {
-        socket_ = pS;
+    // 0 = no timeout
+    unsigned timeout() { return timeout_; }
+
+    unsigned long frames() { return frames_; }
+    unsigned long touches() { return touches_; }
+    unsigned long timedOut() { return timedOut_; }
+
+    // messages in a packet are queued together, when the packet is done, or at the next /t3d/frm
+    virtual void ProcessPacket(const char *data, int size, const IpEndpointName &remoteEndpoint) {
+        try {
+            osc::OscPacketListener::ProcessPacket(data, size, remoteEndpoint);
+        } catch (osc::Exception &e) {
+            LOG_0("error while parsing packet: " << e.what());
+        }
+        flushFrame();
     }
 
     virtual void ProcessMessage(const osc::ReceivedMessage &m,
@@ -46,23 +88,19 @@ public:
         try {
             // example of parsing single messages. osc::OsckPacketListener
             // handles the bundle traversal.
-            static const std::string A_COMMAND = "/t3d/command";
-            static const std::string A_TOUCH = "/t3d/tch";
-            static const std::string A_FRM = "/t3d/frm";
-
-
+            const char *addr = m.AddressPattern();
             osc::ReceivedMessageArgumentStream args = m.ArgumentStream();
-            std::string addr = m.AddressPattern();
-            if (addr.length() > 8 && addr.find(A_TOUCH) == 0) {
-                std::string touch = addr.substr(8);
-                unsigned tId = static_cast<unsigned>(std::stoi(touch));
+            int tId = touchAddress(addr);
+            if (tId >= 0) {
                 float x = 0.0f, y = 0.0f, z = 0.0f, note = 0.0f;
                 args >> x >> y >> z >> note >> osc::EndMessage;
-                queue_touch(tId, note, x, (y * 2.0f) - 1.0f, z);
-            } else if (addr == A_FRM) {
-                osc::int32 d1, d2;
-                args >> d1 >> d2 >> osc::EndMessage;
-            } else if (addr == A_COMMAND) {
+                touches_++;
+                queue_touch(static_cast<unsigned>(tId), note, x, (y * 2.0f) - 1.0f, z);
+            } else if (std::strcmp(addr, "/t3d/frm") == 0) {
+                // new frame
+                flushFrame();
+                frames_++;
+            } else if (std::strcmp(addr, "/t3d/command") == 0) {
                 const char *cmd;
                 args >> cmd >> osc::EndMessage;
 
@@ -72,7 +110,7 @@ public:
                     MecMsg msg;
                     msg.type_ = MecMsg::MEC_CONTROL;
                     msg.data_.mec_control_.cmd_ = MecMsg::SHUTDOWN;
-                    queue_.addToQueue(msg);
+                    addToFrame(msg);
                 }
             }
         } catch (osc::Exception &e) {
@@ -82,7 +120,30 @@ public:
         }
     }
 
+    // touches not updated within the timeout are turned off, as if the sender had sent z = 0
+    virtual void TimerExpired() {
+        if (timeout_ == 0) return;
+        uint64_t now = nowMs();
+        Voices::Voice *voice = voices_.oldestActiveVoice();
+        while (voice != nullptr) {
+            Voices::Voice *next = voice->next_;
+            if (now - voice->t_ > timeout_) {
+                if (voice->state_ == Voices::Voice::ACTIVE) {
+                    MecMsg msg;
+                    touchMsg(msg, MecMsg::TOUCH_OFF, voice->i_, voice->note_, voice->x_, voice->y_, 0.0f, Latency::stamp());
+                    addToFrame(msg);
+                }
+                // else pending, touch on not sent yet
+                voices_.stopVoice(voice);
+                timedOut_++;
+            }
+            voice = next;
+        }
+        flushFrame();
+    }
+
     virtual void queue_touch(unsigned tId, float mn, float mx, float my, float mz) {
+        uint64_t t = frameStamp();
         Voices::Voice *voice = voices_.voiceId(tId);
         if (mz > 0.0) {
             if (!voice) {
@@ -91,15 +152,12 @@ public:
 
                 if (!voice && stealVoices_) {
                     // no available voices, steal?
-                    Voices::Voice *stolen = voices_.oldestActiveVoice();
-                    MecMsg msg;
-                    msg.data_.touch_.touchId_ = stolen->i_;
-                    msg.data_.touch_.note_ = stolen->note_;
-                    msg.data_.touch_.x_ = stolen->x_;
-                    msg.data_.touch_.y_ = stolen->y_;
-                    msg.data_.touch_.z_ = 0.0f;
-                    msg.type_ = MecMsg::TOUCH_OFF;
-                    queue_.addToQueue(msg);
+                    Voices::Voice *stolen = voices_.stealVoice();
+                    if (stolen->state_ == Voices::Voice::ACTIVE) {
+                        MecMsg msg;
+                        touchMsg(msg, MecMsg::TOUCH_OFF, stolen->i_, stolen->note_, stolen->x_, stolen->y_, 0.0f, t);
+                        addToFrame(msg);
+                    }
                     voices_.stopVoice(stolen);
                     voice = voices_.startVoice(tId);
                 }
@@ -111,30 +169,20 @@ public:
                     voices_.addPressure(voice, mz);
                     if (voice->state_ == Voices::Voice::ACTIVE) {
                         MecMsg msg;
-                        msg.data_.touch_.touchId_ = voice->i_;
-                        msg.data_.touch_.note_ = mn;
-                        msg.data_.touch_.x_ = mx;
-                        msg.data_.touch_.y_ = my;
-                        msg.data_.touch_.z_ = voice->v_;
-                        msg.type_ = MecMsg::TOUCH_ON;
-                        queue_.addToQueue(msg);
+                        touchMsg(msg, MecMsg::TOUCH_ON, voice->i_, mn, mx, my, voice->v_, t);
+                        addToFrame(msg);
                     }
                     // dont send to callbacks until we have the minimum pressures for velocity
                 } else {
                     MecMsg msg;
-                    msg.data_.touch_.touchId_ = voice->i_;
-                    msg.data_.touch_.note_ = mn;
-                    msg.data_.touch_.x_ = mx;
-                    msg.data_.touch_.y_ = my;
-                    msg.data_.touch_.z_ = mz;
-                    msg.type_ = MecMsg::TOUCH_CONTINUE;
-                    queue_.addToQueue(msg);
+                    touchMsg(msg, MecMsg::TOUCH_CONTINUE, voice->i_, mn, mx, my, mz, t);
+                    addToFrame(msg);
                 }
                 voice->note_ = mn;
                 voice->x_ = mx;
                 voice->y_ = my;
                 voice->z_ = mz;
-                voice->t_ = 0;
+                voice->t_ = nowMs();
             }
             // else no voice available
 
@@ -142,14 +190,11 @@ public:
 
             if (voice) {
                 // LOG_1("stop voice for " << tId << " ch " << voice->i_);
-                MecMsg msg;
-                msg.data_.touch_.touchId_ = voice->i_;
-                msg.data_.touch_.note_ = mn;
-                msg.data_.touch_.x_ = mx;
-                msg.data_.touch_.y_ = my;
-                msg.data_.touch_.z_ = mz;
-                msg.type_ = MecMsg::TOUCH_OFF;
-                queue_.addToQueue(msg);
+                if (voice->state_ == Voices::Voice::ACTIVE) {
+                    MecMsg msg;
+                    touchMsg(msg, MecMsg::TOUCH_OFF, voice->i_, mn, mx, my, mz, t);
+                    addToFrame(msg);
+                }
                 voices_.stopVoice(voice);
             }
         }
@@ -160,14 +205,47 @@ private:
 
     float note(float n) { return n; }
 
+    static void touchMsg(MecMsg &msg, MecMsg::type t, int id, float n, float x, float y, float z, uint64_t ts) {
+        msg.type_ = t;
+        msg.data_.touch_.touchId_ = id;
+        msg.data_.touch_.note_ = n;
+        msg.data_.touch_.x_ = x;
+        msg.data_.touch_.y_ = y;
+        msg.data_.touch_.z_ = z;
+        msg.t_ = ts;
+    }
+
+    // touches in a frame share a latency stamp, from the first message
+    uint64_t frameStamp() {
+        if (frameSize_ == 0) frameStamp_ = Latency::stamp();
+        return frameStamp_;
+    }
+
+    void addToFrame(const MecMsg &msg) {
+        if (frameSize_ == MAX_FRAME_MSGS) flushFrame();
+        frame_[frameSize_++] = msg;
+    }
+
+    void flushFrame() {
+        if (frameSize_ == 0) return;
+        queue_.addFrameToQueue(frame_, frameSize_);
+        frameSize_ = 0;
+    }
+
     Preferences prefs_;
     MsgQueue &queue_;
     bool valid_;
-    bool activeTouches_[16];
-    UdpListeningReceiveSocket *socket_;
-    bool stealVoices_;
     Voices voices_;
+    bool stealVoices_;
+    unsigned timeout_; // ms
+
+    MecMsg frame_[MAX_FRAME_MSGS];
+    unsigned frameSize_;
+    uint64_t frameStamp_;
 
+    std::atomic<unsigned long> frames_;
+    std::atomic<unsigned long> touches_;
+    std::atomic<unsigned long> timedOut_;
 };
 
 
@@ -187,7 +265,7 @@ void OscT3DListen(OscT3D *self) {
 
 void OscT3D::listenProc() {
     LOG_1("T3D socket listening on : " << port_);
-    socket_->Run();
+    mux_->Run();
 }
 
 bool OscT3D::init(void *arg) {
@@ -197,28 +275,34 @@ bool OscT3D::init(void *arg) {
         deinit();
     }
     active_ = false;
-    OscT3DHandler *pCb = new OscT3DHandler(prefs, queue_);
+    queue_.resize(static_cast<unsigned>(prefs.getInt("queue size", MsgQueue::DEFAULT_SIZE)));
+    handler_.reset(new OscT3DHandler(prefs, queue_));
 
     port_ = (unsigned) prefs.getInt("port", 9000);
 
-    if (pCb->isValid()) {
-        active_ = true;
-    } else {
-        delete pCb;
+    if (!handler_->isValid()) {
+        handler_.reset();
+        return false;
     }
 
     LOG_1("T3D socket on port : " << port_);
 
-    socket_.reset(
-        new UdpListeningReceiveSocket(
-            IpEndpointName(IpEndpointName::ANY_ADDRESS, port_),
-            pCb)
-    );
-
-    pCb->setSocket(socket_.get());
+    try {
+        socket_.reset(new UdpReceiveSocket(IpEndpointName(IpEndpointName::ANY_ADDRESS, port_)));
+    } catch (const std::runtime_error &e) {
+        LOG_0("OscT3D::init - unable to listen on port " << port_ << " : " << e.what());
+        handler_.reset();
+        return false;
+    }
+    mux_.reset(new SocketReceiveMultiplexer());
+    mux_->AttachSocketListener(socket_.get(), handler_.get());
+    if (handler_->timeout() > 0) {
+        // check a few times per timeout, so touches are turned off within 1.25 x timeout
+        mux_->AttachPeriodicTimerListener(std::max(1, (int) handler_->timeout() / 4), handler_.get());
+    }
 
     listenThread_ = std::thread(OscT3DListen, this);
-
+    active_ = true;
 
     return active_;
 }
@@ -230,9 +314,18 @@ bool OscT3D::process() {
 void OscT3D::deinit() {
     LOG_0("OscT3D::deinit");
     if (active_) {
-        socket_->AsynchronousBreak();
+        mux_->AsynchronousBreak();
         listenThread_.join();
+        mux_->DetachSocketListener(socket_.get(), handler_.get());
+        if (handler_->timeout() > 0) mux_->DetachPeriodicTimerListener(handler_.get());
+        mux_.reset();
         socket_.reset();
+        if (queue_.dropped() > 0) {
+            LOG_0("OscT3D::deinit - queue dropped " << queue_.dropped() << " high water " << queue_.highWaterMark());
+        }
+        if (handler_->timedOut() > 0) {
+            LOG_0("OscT3D::deinit - touches timed out " << handler_->timedOut());
+        }
         LOG_0("OscT3D::deinit done");
     }
     active_ = false;
@@ -242,6 +335,22 @@ bool OscT3D::isActive() {
     return active_;
 }
 
+bool OscT3D::setNotifier(Notifier *n) {
+    queue_.setNotifier(n);
+    return true;
+}
 
+unsigned long OscT3D::framesReceived() {
+    return handler_ ? handler_->frames() : 0;
 }
 
+unsigned long OscT3D::touchesReceived() {
+    return handler_ ? handler_->touches() : 0;
+}
+
+unsigned long OscT3D::touchesTimedOut() {
+    return handler_ ? handler_->timedOut() : 0;
+}
+
+
+}
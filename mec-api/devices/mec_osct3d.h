@@ -9,10 +9,15 @@
 #include <memory>
 #include <thread>
 
-class UdpListeningReceiveSocket;
+class UdpReceiveSocket;
+class SocketReceiveMultiplexer;
 
 namespace mec {
 
+class OscT3DHandler;
+
+// T3D over OSC input, touches (/t3d/tchN) following a /t3d/frm are queued together, as a frame
+// touches which stop arriving for 'touch timeout' ms, without a z = 0 off, are turned off
 class OscT3D : public Device {
 
 public:
@@ -22,14 +27,22 @@ public:
     virtual bool process();
     virtual void deinit();
     virtual bool isActive();
+    virtual bool setNotifier(Notifier *);
 
     void listenProc();
 
+    // stats, since init
+    unsigned long framesReceived();
+    unsigned long touchesReceived();
+    unsigned long touchesTimedOut();
+
 private:
     ICallback &callback_;
     bool active_;
     MsgQueue queue_;
-    std::unique_ptr<UdpListeningReceiveSocket> socket_;
+    std::unique_ptr<OscT3DHandler> handler_;
+    std::unique_ptr<UdpReceiveSocket> socket_;
+    std::unique_ptr<SocketReceiveMultiplexer> mux_;
     std::thread listenThread_;
 
     unsigned int port_;
@@ -37,4 +50,4 @@ private:
 
 }
 
-#endif // MecOscT3D_H
\ No newline at end of file
+#endif // MecOscT3D_H
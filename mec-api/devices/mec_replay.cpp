@@ -0,0 +1,182 @@
+#include "mec_replay.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "mec_log.h"
+#include "../mec_latency.h"
+#include "../mec_notifier.h"
+
+namespace mec {
+
+// gap left between the end of a capture and the start of the next loop
+static const unsigned LOOP_GAP_US = 1000;
+// longest sleep of the replay thread, so deinit is not held up by gaps in a recording
+static const unsigned MAX_SLEEP_MS = 100;
+
+ReplayDevice::ReplayDevice(ICallback &cb) :
+    callback_(cb),
+    active_(false),
+    realtime_(true),
+    loop_(false),
+    shutdown_(false),
+    notifier_(nullptr),
+    next_(0),
+    finished_(false),
+    running_(false),
+    framesPlayed_(0) {
+}
+
+ReplayDevice::~ReplayDevice() {
+    deinit();
+}
+
+void ReplayDeviceProc(ReplayDevice *self) {
+    self->replayProc();
+}
+
+bool ReplayDevice::init(void *arg) {
+    Preferences prefs(arg);
+
+    if (active_) {
+        deinit();
+    }
+    active_ = false;
+
+    if (prefs.exists("file")) {
+        std::string file = prefs.getString("file");
+        if (!capture_.load(file)) {
+            LOG_0("ReplayDevice::init - unable to load capture " << file);
+            return false;
+        }
+        LOG_1("ReplayDevice::init - loaded " << file);
+    } else if (prefs.exists("synthetic")) {
+        std::string name = prefs.getString("synthetic");
+        unsigned seconds = static_cast<unsigned>(prefs.getInt("seconds", 10));
+        unsigned rate = static_cast<unsigned>(prefs.getInt("rate", 1000));
+        unsigned voices = static_cast<unsigned>(prefs.getInt("voices", 0));
+        if (rate == 0 || !Capture::synthetic(capture_, name, seconds, rate, voices)) {
+            LOG_0("ReplayDevice::init - unknown synthetic capture " << name);
+            return false;
+        }
+    }
+
+    if (capture_.frameCount() == 0) {
+        LOG_0("ReplayDevice::init - nothing to replay");
+        return false;
+    }
+
+    realtime_ = prefs.getBool("realtime", true);
+    loop_ = prefs.getBool("loop", false);
+    shutdown_ = prefs.getBool("shutdown", false);
+
+    // a frame must fit in the queue, else it will be (partly) dropped when replayed at maximum speed
+    unsigned qsize = static_cast<unsigned>(prefs.getInt("queue size", MsgQueue::DEFAULT_SIZE));
+    queue_.resize(std::max(qsize, capture_.maxFrameSize() + 1));
+
+    LOG_1("ReplayDevice::init - frames " << capture_.frameCount()
+                                         << " msgs " << capture_.msgCount()
+                                         << " duration " << capture_.duration() / 1000 << "ms"
+                                         << (realtime_ ? " realtime" : " max speed"));
+
+    next_ = 0;
+    framesPlayed_ = 0;
+    finished_ = false;
+    active_ = true;
+
+    if (realtime_) {
+        running_ = true;
+        replayThread_ = std::thread(ReplayDeviceProc, this);
+    }
+    return active_;
+}
+
+void ReplayDevice::replayProc() {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    while (running_) {
+        for (unsigned i = 0; i < capture_.frameCount() && running_; i++) {
+            Clock::time_point due = start + std::chrono::microseconds(capture_.frameTime(i));
+            for (Clock::time_point now = Clock::now(); now < due && running_; now = Clock::now()) {
+                std::this_thread::sleep_until(std::min(due, now + std::chrono::milliseconds(MAX_SLEEP_MS)));
+            }
+            if (running_) queueFrame(i);
+        }
+        if (!loop_) break;
+        start += std::chrono::microseconds(capture_.duration() + LOOP_GAP_US);
+    }
+    if (running_) {
+        finished_ = true;
+        queueShutdown();
+    }
+}
+
+bool ReplayDevice::queueFrame(unsigned i) {
+    MsgSpan frame = capture_.frame(i);
+    bool ok = true;
+    uint64_t t = Latency::stamp();
+    for (const MecMsg &m : frame) {
+        MecMsg msg = m;
+        msg.t_ = t;
+        ok = queue_.addToQueue(msg) && ok;
+    }
+    framesPlayed_++;
+    return ok;
+}
+
+void ReplayDevice::queueShutdown() {
+    if (!shutdown_) return;
+    LOG_1("ReplayDevice - replay complete, requesting shutdown");
+    MecMsg msg;
+    msg.type_ = MecMsg::MEC_CONTROL;
+    msg.data_.mec_control_.cmd_ = MecMsg::SHUTDOWN;
+    queue_.addToQueue(msg);
+}
+
+bool ReplayDevice::process() {
+    if (!active_) return false;
+
+    if (!realtime_ && !finished_) {
+        queueFrame(next_++);
+        if (next_ >= capture_.frameCount()) {
+            if (loop_) {
+                next_ = 0;
+            } else {
+                finished_ = true;
+                queueShutdown();
+            }
+        }
+        // keep MecApi::waitForWork from waiting, until the capture is done
+        if (!finished_ && notifier_ != nullptr) notifier_->notify();
+    }
+    return queue_.process(callback_);
+}
+
+void ReplayDevice::deinit() {
+    if (active_) {
+        LOG_1("ReplayDevice::deinit - frames played " << framesPlayed_);
+        running_ = false;
+        if (replayThread_.joinable()) {
+            replayThread_.join();
+        }
+        if (queue_.dropped() > 0) {
+            LOG_0("ReplayDevice::deinit - queue dropped " << queue_.dropped() << " high water " << queue_.highWaterMark());
+        }
+    }
+    active_ = false;
+}
+
+bool ReplayDevice::isActive() {
+    return active_;
+}
+
+bool ReplayDevice::setNotifier(Notifier *n) {
+    queue_.setNotifier(n);
+    notifier_ = n;
+    if (!realtime_ && notifier_ != nullptr && active_ && !finished_) {
+        notifier_->notify();
+    }
+    return true;
+}
+
+}
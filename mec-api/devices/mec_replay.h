@@ -0,0 +1,63 @@
+#ifndef MecReplay_H
+#define MecReplay_H
+
+#include "../mec_api.h"
+#include "../mec_capture.h"
+#include "../mec_device.h"
+#include "../mec_msg_queue.h"
+
+#include <atomic>
+#include <thread>
+
+namespace mec {
+
+// plays a capture back as a device, so the rest of the chain (MecApi, processors, outputs) can be run without hardware
+// - realtime : a replay thread queues each frame at its recorded time, as a device thread would
+// - otherwise : as fast as possible, one frame per process(), the notifier is signalled while frames remain
+// prefs
+//  "file" : capture to play, or
+//  "synthetic" : "chords" | "glissandi" | "stress", with "seconds", "rate" and "voices"
+//  "realtime" (true), "loop" (false), "shutdown" (false) requests shutdown once played, "queue size"
+class ReplayDevice : public Device {
+
+public:
+    ReplayDevice(ICallback &);
+    virtual ~ReplayDevice();
+    virtual bool init(void *);
+    virtual bool process();
+    virtual void deinit();
+    virtual bool isActive();
+    virtual bool setNotifier(Notifier *);
+
+    // replay a capture directly, rather than from prefs, call before init
+    void setCapture(const Capture &c) { capture_ = c; }
+    const Capture &capture() const { return capture_; }
+
+    bool finished() const { return finished_; }
+    unsigned long framesPlayed() const { return framesPlayed_; }
+    unsigned long dropped() { return queue_.dropped(); }
+
+    void replayProc();
+
+private:
+    bool queueFrame(unsigned i);
+    void queueShutdown();
+
+    ICallback &callback_;
+    bool active_;
+    bool realtime_;
+    bool loop_;
+    bool shutdown_;
+    Capture capture_;
+    MsgQueue queue_;
+    Notifier *notifier_;
+    unsigned next_;
+    std::atomic<bool> finished_;
+    std::atomic<bool> running_;
+    std::atomic<unsigned long> framesPlayed_;
+    std::thread replayThread_;
+};
+
+}
+
+#endif // MecReplay_H
@@ -1,10 +1,14 @@
 #include "mec_soundplane.h"
 
 #include <SoundplaneModel.h>
+#include <ReplaySoundplaneDriver.h>
 #include <MLAppState.h>
 
 
+#include <bitset>
+
 #include "mec_log.h"
+#include "../mec_latency.h"
 #include "../mec_voice.h"
 
 
@@ -15,14 +19,23 @@ namespace mec {
 // TODO
 // 1. voices not needed? as soundplane already does touch alloction, just need to detemine on and off
 ////////////////////////////////////////////////
+// messages between startFrame and endFrame are queued together, bracketed by FRAME_START/FRAME_END,
+// so consumers see whole sensor frames, frames with no touches or controls are not queued
 class SoundplaneHandler : public SoundplaneMECCallback {
 public:
+    // start marker, an on (or off) per touch, plus offs for stolen voices, and controls
+    static const unsigned MAX_FRAME_MSGS = 2 + (kSoundplaneMaxTouches * 2) + 30;
+
     SoundplaneHandler(Preferences &p, MsgQueue &q)
             : prefs_(p),
               queue_(q),
               valid_(true),
               voices_(static_cast<unsigned>(p.getInt("voices", 15))),
-              stealVoices_(p.getBool("steal voices", true)) {
+              stealVoices_(p.getBool("steal voices", true)),
+              inFrame_(false),
+              frameId_(0),
+              frameSize_(0) {
+        voices_.setStealPolicy(Voices::stealPolicy(p.getString("steal policy", "oldest")));
         if (valid_) {
             LOG_0("SoundplaneHandler enabling for mecapi");
         }
@@ -35,6 +48,20 @@ public:
         LOG_1(" r: " << rows << " c: " << cols);
     }
 
+    virtual void startFrame(const char *dev, unsigned long long t) {
+        if (inFrame_) endFrame(dev, t);
+        inFrame_ = true;
+        frameId_++;
+        frameSize_ = 0;
+        addFrameMarker(MecMsg::FRAME_START);
+    }
+
+    virtual void endFrame(const char *dev, unsigned long long t) {
+        if (!inFrame_) return;
+        inFrame_ = false;
+        flushFrame();
+    }
+
     virtual void touch(const char *dev, unsigned long long t, bool a, int itouch, float n, float x, float y, float z) {
         static const unsigned int NOTE_CH_OFFSET = 1;
 
@@ -47,6 +74,7 @@ public:
         float mz = clamp(z, 0.0f, 1.0f);
 
         MecMsg msg;
+        Latency::stamp(msg);
         msg.type_ = MecMsg::TOUCH_OFF;
         msg.data_.touch_.touchId_ = -1;
         msg.data_.touch_.note_ = mn;
@@ -60,7 +88,7 @@ public:
             // LOG_1(" x: " << x      << " y: "   << y    << " z: "   << z);
             // LOG_1(" mx: " << mx    << " my: "  << my   << " mz: "  << mz);
             if (!voice) {
-                if (stolenTouches_.find(touch) != stolenTouches_.end()) {
+                if (isStolen(touch)) {
                     // this key has been stolen, must be released to reactivate it
                     return;
                 }
@@ -70,7 +98,7 @@ public:
 
                 if (!voice && stealVoices_) {
                     // no available voices, steal?
-                    Voices::Voice *stolen = voices_.oldestActiveVoice();
+                    Voices::Voice *stolen = voices_.stealVoice();
 
                     MecMsg stolenMsg;
                     stolenMsg.type_ = MecMsg::TOUCH_OFF;
@@ -79,8 +107,9 @@ public:
                     stolenMsg.data_.touch_.x_ = stolen->x_;
                     stolenMsg.data_.touch_.y_ = stolen->y_;
                     stolenMsg.data_.touch_.z_ = 0.0f;
-                    stolenTouches_.insert((unsigned) stolen->id_);
-                    queue_.addToQueue(stolenMsg);
+                    stolenMsg.t_ = msg.t_;
+                    setStolen((unsigned) stolen->id_, true);
+                    addToFrame(stolenMsg);
                     voices_.stopVoice(stolen);
 
                     voice = voices_.startVoice(touch);
@@ -89,7 +118,7 @@ public:
                 if (voice) {
                     msg.type_ = MecMsg::TOUCH_ON;
                     msg.data_.touch_.touchId_ = voice->i_;
-                    queue_.addToQueue(msg);
+                    addToFrame(msg);
                     voice->note_ = mn;
                     voice->x_ = mx;
                     voice->y_ = my;
@@ -99,7 +128,7 @@ public:
             } else {
                 msg.type_ = MecMsg::TOUCH_CONTINUE;
                 msg.data_.touch_.touchId_ = voice->i_;
-                queue_.addToQueue(msg);
+                addToFrame(msg);
                 voice->note_ = mn;
                 voice->x_ = mx;
                 voice->y_ = my;
@@ -113,19 +142,20 @@ public:
                 msg.type_ = MecMsg::TOUCH_OFF;
                 msg.data_.touch_.touchId_ = voice->i_;
                 msg.data_.touch_.z_ = 0.0;
-                queue_.addToQueue(msg);
+                addToFrame(msg);
                 voices_.stopVoice(voice);
             }
-            stolenTouches_.erase(touch);
+            setStolen(touch, false);
         }
     }
 
     virtual void control(const char *dev, unsigned long long t, int id, float val) {
         MecMsg msg;
+        Latency::stamp(msg);
         msg.type_ = MecMsg::CONTROL;
         msg.data_.control_.controlId_ = id;
         msg.data_.control_.value_ = clamp(val, -1.0f, 1.0f);
-        queue_.addToQueue(msg);
+        addToFrame(msg);
     }
 
 private:
@@ -133,12 +163,53 @@ private:
 
     float note(float n) { return n; }
 
+    bool isStolen(unsigned touch) { return touch < stolenTouches_.size() && stolenTouches_.test(touch); }
+
+    void setStolen(unsigned touch, bool stolen) {
+        if (touch < stolenTouches_.size()) stolenTouches_.set(touch, stolen);
+    }
+
+    void addFrameMarker(MecMsg::type type) {
+        MecMsg &msg = frame_[frameSize_++];
+        msg.type_ = type;
+        msg.data_.frame_.frameId_ = frameId_;
+        msg.t_ = 0;
+    }
+
+    // outside of a frame (e.g. no frame markers from the model), queued immediately as before
+    void addToFrame(MecMsg &msg) {
+        if (!inFrame_) {
+            queue_.addToQueue(msg);
+            return;
+        }
+        if (frameSize_ == MAX_FRAME_MSGS - 1) {
+            // full, queue this part, and continue the frame in another
+            flushFrame();
+            addFrameMarker(MecMsg::FRAME_START);
+        }
+        frame_[frameSize_++] = msg;
+    }
+
+    void flushFrame() {
+        // just the start marker, nothing to send
+        if (frameSize_ > 1) {
+            addFrameMarker(MecMsg::FRAME_END);
+            queue_.addFrameToQueue(frame_, frameSize_);
+        }
+        frameSize_ = 0;
+    }
+
     Preferences prefs_;
     MsgQueue &queue_;
     Voices voices_;
     bool valid_;
     bool stealVoices_;
-    std::set<unsigned> stolenTouches_;
+    std::bitset<kSoundplaneMaxTouches> stolenTouches_;
+
+    bool inFrame_;
+    unsigned frameId_;
+    MecMsg frame_[MAX_FRAME_MSGS];
+    unsigned frameSize_;
 };
 
 
@@ -169,17 +240,49 @@ bool Soundplane::init(void *arg) {
     model_->setPropertyImmediate("midi_active", 0.0f);
     model_->setPropertyImmediate("osc_active", 0.0f);
     model_->setPropertyImmediate("mec_active", 1.0f);
-    model_->setPropertyImmediate("data_freq_mec", 500.0f);
+    // continues are sent every (1000 / data rate) sensor frames, if they moved more than the change threshold
+    model_->setPropertyImmediate("data_freq_mec", static_cast<float>(prefs.getDouble("data rate", 500.0)));
+    model_->mecOutput().setChangeThreshold(static_cast<float>(prefs.getDouble("change threshold", 0.0)));
+    // viewer only signals, not needed headless
+    model_->setPropertyImmediate("debug_view", prefs.getBool("debug view", false) ? 1.0f : 0.0f);
+
+    queue_.resize(static_cast<unsigned>(prefs.getInt("queue size", MsgQueue::DEFAULT_SIZE)));
 
     SoundplaneHandler *pCb = new SoundplaneHandler(prefs, queue_);
     if (pCb->isValid()) {
         model_->mecOutput().connect(pCb);
-        LOG_0("Soundplane::init - model init");
-        model_->initialize();
-        active_ = true;
+
+        // raw frames, for replay without the device, see ReplaySoundplaneDriver
+        if (prefs.exists("record frames")) {
+            std::string file = prefs.getString("record frames");
+            if (model_->recordFrames(file)) {
+                LOG_0("Soundplane::init - recording frames to " << file);
+            }
+        }
+
+        if (prefs.exists("replay frames")) {
+            std::string file = prefs.getString("replay frames");
+            std::shared_ptr<SoundplaneFrameReader> frames = std::make_shared<SoundplaneFrameReader>();
+            if (frames->load(file)) {
+                float rate = static_cast<float>(prefs.getDouble("replay rate", kSoundplaneSampleRate));
+                LOG_0("Soundplane::init - model init, replaying " << frames->getFrameCount() << " frames from " << file);
+                active_ = model_->initializeReplay(frames, rate, prefs.getBool("replay loop", false)) != nullptr;
+            } else {
+                LOG_0("Soundplane::init - unable to load frames " << file);
+            }
+        } else {
+            LOG_0("Soundplane::init - model init");
+            model_->initialize();
+            active_ = true;
+        }
+    }
+
+    if (active_) {
         LOG_0("Soundplane::init - complete");
     } else {
         LOG_0("Soundplane::init - delete callback");
+        model_->mecOutput().connect(nullptr);
+        model_.reset();
         delete pCb;
     }
 
@@ -193,8 +296,13 @@ bool Soundplane::process() {
 void Soundplane::deinit() {
     LOG_0("Soundplane::deinit");
     if (!model_) return;
+    LOG_0("Soundplane::deinit - updates sent " << model_->mecOutput().getUpdatesSent()
+                                              << " suppressed " << model_->mecOutput().getUpdatesSuppressed());
     LOG_0("Soundplane::reset model");
     model_.reset();
+    if (queue_.dropped() > 0) {
+        LOG_0("Soundplane::deinit - queue dropped " << queue_.dropped() << " high water " << queue_.highWaterMark());
+    }
     active_ = false;
 }
 
@@ -202,6 +310,11 @@ bool Soundplane::isActive() {
     return active_;
 }
 
+bool Soundplane::setNotifier(Notifier *n) {
+    queue_.setNotifier(n);
+    return true;
+}
+
 
 }
 
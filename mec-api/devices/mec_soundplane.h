@@ -23,6 +23,7 @@ public:
     virtual bool process();
     virtual void deinit();
     virtual bool isActive();
+    virtual bool setNotifier(Notifier *);
 
 private:
     ICallback &callback_;
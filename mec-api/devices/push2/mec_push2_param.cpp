@@ -3,16 +3,6 @@
 #include <mec_log.h>
 
 namespace mec {
-std::string centreText(const std::string t) {
-    unsigned len = t.length();
-    if (len > 24) return t;
-    const std::string pad = "                         ";
-    unsigned padlen = (24 - len) / 2;
-    std::string ret = pad.substr(0, padlen) + t + pad.substr(0, padlen);
-    // LOG_0("pad " << t << " l " << len << " pl " << padlen << "[" << ret << "]");
-    return ret;
-}
-
 static const unsigned VSCALE = 3;
 static const unsigned HSCALE = 1;
 
@@ -50,7 +40,7 @@ void P2_ParamMode::processCC(unsigned cc, unsigned v) {
             auto pRack = model_->getRack(parent_.currentRack());
             auto pModule = model_->getModule(pRack, parent_.currentModule());
             auto pPage = model_->getPage(pModule, parent_.currentPage());
-            auto pParams = model_->getParams(pModule, pPage);
+            const auto &pParams = model_->getParams(pModule, pPage);
 
             if (idx >= pParams.size()) return;
 
@@ -87,9 +77,9 @@ void P2_ParamMode::drawParam(unsigned pos, const Kontrol::Parameter &param) {
     // #define MONO_CLR RGB565(255,60,0)
     uint16_t clr = page_clrs[pageIdx_];
 
-    push2Api_->drawCell8(1, pos, centreText(param.displayName()).c_str(), VSCALE, HSCALE, clr);
-    push2Api_->drawCell8(2, pos, centreText(param.displayValue()).c_str(), VSCALE, HSCALE, clr);
-    push2Api_->drawCell8(3, pos, centreText(param.displayUnit()).c_str(), VSCALE, HSCALE, clr);
+    push2Api_->drawCentredCell8(1, pos, param.displayName().c_str(), VSCALE, HSCALE, clr);
+    push2Api_->drawCentredCell8(2, pos, param.displayValue().c_str(), VSCALE, HSCALE, clr);
+    push2Api_->drawCentredCell8(3, pos, param.displayUnit().c_str(), VSCALE, HSCALE, clr);
 }
 
 void P2_ParamMode::displayPage() {
@@ -99,16 +89,16 @@ void P2_ParamMode::displayPage() {
     for (unsigned int i = P2_TRACK_SELECT_CC_START; i < P2_TRACK_SELECT_CC_END; i++) { parent_.sendCC(0, i, 0); }
 
     auto pRack = model_->getRack(parent_.currentRack());
-    auto pModules = model_->getModules(pRack);
+    const auto &pModules = model_->getModules(pRack);
     auto pModule = model_->getModule(pRack, parent_.currentModule());
     auto pPage = model_->getPage(pModule, parent_.currentPage());
-    auto pPages = model_->getPages(pModule);
-    auto pParams = model_->getParams(pModule, pPage);
+    const auto &pPages = model_->getPages(pModule);
+    const auto &pParams = model_->getParams(pModule, pPage);
 
     // draw pages
     unsigned int i = 0;
     for (auto cpage : pPages) {
-        push2Api_->drawCell8(0, i, centreText(cpage->displayName()).c_str(), VSCALE, HSCALE, page_clrs[i]);
+        push2Api_->drawCentredCell8(0, i, cpage->displayName().c_str(), VSCALE, HSCALE, page_clrs[i]);
         parent_.sendCC(0, P2_DEV_SELECT_CC_START + i, i == pageIdx_ ? 122 : 124);
 
         if (i == pageIdx_) {
@@ -128,7 +118,7 @@ void P2_ParamMode::displayPage() {
     // draw modules
     i = 0;
     for (auto mod : pModules) {
-        push2Api_->drawCell8(5, i, centreText(mod->displayName()).c_str(), VSCALE, HSCALE, page_clrs[i]);
+        push2Api_->drawCentredCell8(5, i, mod->displayName().c_str(), VSCALE, HSCALE, page_clrs[i]);
         parent_.sendCC(0, P2_TRACK_SELECT_CC_START + i, i == moduleIdx_ ? 122 : 124);
         i++;
         if (i == 8) break;
@@ -138,7 +128,7 @@ void P2_ParamMode::displayPage() {
 
 void P2_ParamMode::setCurrentModule(int moduleIdx) {
     auto pRack = model_->getRack(parent_.currentRack());
-    auto pModules = model_->getModules(pRack);
+    const auto &pModules = model_->getModules(pRack);
 //    auto pModule = model_->getModule(pRack, parent_.currentModule());
 ////    auto pPage = model_->getPage(pModule, parent_.currentPage());
 //    auto pPages = model_->getPages(pModule);
@@ -163,7 +153,7 @@ void P2_ParamMode::setCurrentPage(int pageIdx) {
     auto pRack = model_->getRack(parent_.currentRack());
     auto pModule = model_->getModule(pRack, parent_.currentModule());
 //    auto pPage = model_->getPage(pModule, parent_.currentPage());
-    auto pPages = model_->getPages(pModule);
+    const auto &pPages = model_->getPages(pModule);
 //    auto pParams = model_->getParams(pModule, pPage);
 
     if(pPages.size()==0) {
@@ -194,7 +184,7 @@ void P2_ParamMode::module(Kontrol::ChangeSource src, const Kontrol::Rack &rack,
     } else {
         // adjust moduleidx
         auto prack = model_->getRack(parent_.currentRack());
-        auto modules = model_->getModules(prack);
+        const auto &modules = model_->getModules(prack);
         unsigned int i = 0;
         for (auto mod : modules) {
             if (mod->id() == parent_.currentModule()) {
@@ -225,7 +215,7 @@ void P2_ParamMode::page(Kontrol::ChangeSource src, const Kontrol::Rack &rack, co
     if (parent_.currentPage().length() == 0) {
         auto pRack = model_->getRack(parent_.currentRack());
         auto pModule = model_->getModule(pRack, parent_.currentModule());
-        auto pPages = model_->getPages(pModule);
+        const auto &pPages = model_->getPages(pModule);
         if (pPages.size() > 0) {
             setCurrentPage(0);
         }
@@ -247,7 +237,7 @@ void P2_ParamMode::param(Kontrol::ChangeSource src, const Kontrol::Rack &rack, c
     auto pModule = model_->getModule(pRack, parent_.currentModule());
     auto pPage = model_->getPage(pModule, parent_.currentPage());
 //    auto pPages = model_->getPages(pModule);
-    auto pParams = model_->getParams(pModule, pPage);
+    const auto &pParams = model_->getParams(pModule, pPage);
 
     unsigned i = 0;
     for (auto p: pParams) {
@@ -269,7 +259,7 @@ void P2_ParamMode::changed(Kontrol::ChangeSource src, const Kontrol::Rack &rack,
     auto pModule = model_->getModule(pRack, parent_.currentModule());
     auto pPage = model_->getPage(pModule, parent_.currentPage());
 //    auto pPages = model_->getPages(pModule);
-    auto pParams = model_->getParams(pModule, pPage);
+    const auto &pParams = model_->getParams(pModule, pPage);
 
     unsigned i = 0;
     for (auto p: pParams) {
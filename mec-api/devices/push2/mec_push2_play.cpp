@@ -1,6 +1,7 @@
 #include "mec_push2_play.h"
 
 #include <mec_log.h>
+#include "../../mec_latency.h"
 
 #define PAD_NOTE_ON_CLR (int8_t) 127
 #define PAD_NOTE_OFF_CLR (int8_t) 0
@@ -126,6 +127,7 @@ void P2_PlayMode::processNoteOn(unsigned n, unsigned v) {
         int c = padn % 8;
 
         MecMsg msg;
+        Latency::stamp(msg);
         msg.type_ = MecMsg::TOUCH_ON;
         msg.data_.touch_.touchId_ = 1;
         msg.data_.touch_.note_ = determinePadNote(r,c);
@@ -146,6 +148,7 @@ void P2_PlayMode::processNoteOff(unsigned n, unsigned v) {
         int c = padn % 8;
 
         MecMsg msg;
+        Latency::stamp(msg);
         msg.type_ = MecMsg::TOUCH_OFF;
         msg.data_.touch_.touchId_ = 1;
         msg.data_.touch_.note_ = determinePadNote(r,c);
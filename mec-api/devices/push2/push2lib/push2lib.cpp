@@ -2,6 +2,7 @@
 #include "push2lib.h"
 #include "push1font.h"
 
+#include <libusb.h>
 #include <stdarg.h>
 #include <memory.h>
 
@@ -20,13 +21,9 @@ static uint16_t VID = 0x2982, PID = 0x1967;
 // #define RGB565(r,g,b) ((((((int16_t) r & 0x001F) << 5) | ((int16_t) g & 0x003F) ) << 6 ) | ((int16_t) b & 0x001f)) // do as RGB , idea was too then reverse, didnt seem right
 
 
-#define F_HEIGHT    8
-#define F_WIDTH     5
-
 // push 1
 #define MONOCHROME true
 
-#define HDR_PKT_SZ 0x10
 static uint8_t headerPkt[HDR_PKT_SZ] =
         {0xef, 0xcd, 0xab, 0x89, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};// rev engineered
 // { 0xFF, 0xCC, 0xAA, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,0x00, 0x00, 0x00, 0x00 }; //ableton
@@ -51,26 +48,251 @@ static int perr(char const *format, ...) {
 #define ERR_EXIT(errcode) do { perr("   %s\n", libusb_strerror((enum libusb_error)errcode)); return -1; } while (0)
 #define CALL_CHECK(fcall) do { r=fcall; if (r < 0) ERR_EXIT(r); } while (0);
 
-Push2::Push2() : headerPkt_(headerPkt), handle_(NULL) {
+#define TRANSFER_TIMEOUT_MS 1000
+
+// asynchronous bulk transfers, a header and a data transfer per slot
+// completions are handled in poll(), so everything happens on the thread calling render()
+class LibusbTransport : public Push2Transport {
+public:
+    LibusbTransport() : handle_(NULL), inited_(false), claimed_(false) {
+        for (unsigned i = 0; i < N_SLOTS; i++) {
+            slots_[i].hdr_ = NULL;
+            slots_[i].data_ = NULL;
+            slots_[i].pending_ = 0;
+        }
+    }
+
+    virtual ~LibusbTransport() {
+        close();
+    }
+
+    int open() override;
+    void close() override;
+    int submit(unsigned slot, const uint8_t *hdr, unsigned hdrSize, const uint8_t *data, unsigned dataSize) override;
+
+    bool busy(unsigned slot) override {
+        return slots_[slot].pending_ > 0;
+    }
+
+    void poll() override {
+        struct timeval tv = {0, 0};
+        libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+    }
+
+private:
+    struct Slot {
+        libusb_transfer *hdr_;
+        libusb_transfer *data_;
+        unsigned pending_;
+    };
+
+    static void LIBUSB_CALL completed(libusb_transfer *transfer);
+
+    Slot slots_[N_SLOTS];
+    libusb_device_handle *handle_;
+    bool inited_;
+    bool claimed_;
+    int iface_ = 0;
+    int endpointOut_ = 1;
+};
+
+int LibusbTransport::open() {
+    const struct libusb_version *version;
+    version = libusb_get_version();
+    std::cout << "Using libusb " << version->major << "." << version->minor << "." << version->micro << "."
+              << version->nano << std::endl;
+    int r = libusb_init(NULL);
+    if (r < 0) ERR_EXIT(r);
+    inited_ = true;
+    libusb_set_debug(NULL, LIBUSB_LOG_LEVEL_INFO);
+    static uint16_t vid = VID, pid = PID;
+
+    std::cout << "Open Push2 :" << std::hex << vid << ":" << pid << std::dec << std::endl;
+
+    handle_ = libusb_open_device_with_vid_pid(NULL, vid, pid);
+
+    if (handle_ == NULL) {
+        perr("  Failed.\n");
+        return -1;
+    }
+
+    CALL_CHECK(libusb_claim_interface(handle_, iface_));
+    claimed_ = true;
+
+    for (unsigned i = 0; i < N_SLOTS; i++) {
+        slots_[i].hdr_ = libusb_alloc_transfer(0);
+        slots_[i].data_ = libusb_alloc_transfer(0);
+        if (slots_[i].hdr_ == NULL || slots_[i].data_ == NULL) ERR_EXIT(LIBUSB_ERROR_NO_MEM);
+    }
+
+    return r;
+}
+
+void LibusbTransport::close() {
+    // transfers must complete (or be cancelled) before they are freed
+    for (unsigned i = 0; i < N_SLOTS; i++) {
+        if (slots_[i].pending_ > 0) {
+            libusb_cancel_transfer(slots_[i].hdr_);
+            libusb_cancel_transfer(slots_[i].data_);
+        }
+    }
+    for (unsigned i = 0; i < N_SLOTS; i++) {
+        for (int retry = 0; slots_[i].pending_ > 0 && retry < 10; retry++) {
+            struct timeval tv = {0, 100000};
+            libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+        }
+        if (slots_[i].hdr_ != NULL) libusb_free_transfer(slots_[i].hdr_);
+        if (slots_[i].data_ != NULL) libusb_free_transfer(slots_[i].data_);
+        slots_[i].hdr_ = NULL;
+        slots_[i].data_ = NULL;
+        slots_[i].pending_ = 0;
+    }
+
+    if (handle_ != NULL) {
+        if (claimed_) libusb_release_interface(handle_, iface_);
+        libusb_close(handle_);
+        handle_ = NULL;
+        claimed_ = false;
+    }
+    if (inited_) {
+        libusb_exit(NULL);
+        inited_ = false;
+    }
+}
+
+int LibusbTransport::submit(unsigned slot, const uint8_t *hdr, unsigned hdrSize, const uint8_t *data, unsigned dataSize) {
+    if (handle_ == NULL || slot >= N_SLOTS || slots_[slot].pending_ > 0) return -1;
+    Slot &s = slots_[slot];
+
+    // both on the same endpoint, so the header is sent before the data
+    libusb_fill_bulk_transfer(s.hdr_, handle_, endpointOut_, const_cast<uint8_t *>(hdr), hdrSize,
+                              completed, &s.pending_, TRANSFER_TIMEOUT_MS);
+    libusb_fill_bulk_transfer(s.data_, handle_, endpointOut_, const_cast<uint8_t *>(data), dataSize,
+                              completed, &s.pending_, TRANSFER_TIMEOUT_MS);
+
+    // both counted up front, a failed submit takes back what will never complete
+    int r = 0;
+    s.pending_ = 2;
+    r = libusb_submit_transfer(s.hdr_);
+    if (r < 0) {
+        s.pending_ = 0; // nothing in flight, no completion will free the slot
+        ERR_EXIT(r);
+    }
+    r = libusb_submit_transfer(s.data_);
+    if (r < 0) {
+        s.pending_--; // header still in flight
+        ERR_EXIT(r);
+    }
+    return 0;
+}
+
+void LIBUSB_CALL LibusbTransport::completed(libusb_transfer *transfer) {
+    if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+        perr("transfer failed %d\n", transfer->status);
+    } else if (transfer->actual_length != transfer->length) {
+        perr("packet short %d\n", transfer->actual_length);
+    }
+    unsigned *pending = static_cast<unsigned *>(transfer->user_data);
+    if (*pending > 0) (*pending)--;
+}
+
+
+Push2::Push2() : Push2(std::unique_ptr<Push2Transport>(new LibusbTransport())) {
     ;
 }
 
+Push2::Push2(std::unique_ptr<Push2Transport> transport)
+        : headerPkt_(headerPkt),
+          anyDirty_(false),
+          lastSlot_(0),
+          transport_(std::move(transport)),
+          open_(false) {
+    memset(dataPkt_, 0, DATA_PKT_SZ);
+    for (unsigned i = 0; i < Push2Transport::N_SLOTS; i++) {
+        frames_[i].reset(new uint8_t[DATA_PKT_SZ]);
+        memset(frames_[i].get(), 0, DATA_PKT_SZ);
+    }
+    memset(lineDirty_, 0, sizeof(lineDirty_));
+    memset(sentDirty_, 0, sizeof(sentDirty_));
+    resetStats();
+}
+
 Push2::~Push2() {
     ;
 }
 
+void Push2::resetStats() {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
 
 void Push2::clearDisplay() {
     memset(dataPkt_, 0, DATA_PKT_SZ);
+    for (unsigned line = 0; line < HEIGHT; line++) markLine(line);
 }
 
 void Push2::clearRow(unsigned row, unsigned vscale) {
-    for (int line = 0; line < F_HEIGHT; line++) {
-        for (int vs = 0; vs < vscale; vs++) {
-            int bl = (((((row * F_HEIGHT) + line)) * vscale) + vs) * (LINE / 2);
-            memset(&(dataPkt_[bl]), 0, LINE);
+    clearRect(0, row * textHeight(vscale), WIDTH, textHeight(vscale));
+}
+
+void Push2::clearRect(int x, int y, unsigned w, unsigned h) {
+    int x0 = x < 0 ? 0 : x;
+    int x1 = x + (int) w > (int) WIDTH ? (int) WIDTH : x + (int) w;
+    int y0 = y < 0 ? 0 : y;
+    int y1 = y + (int) h > (int) HEIGHT ? (int) HEIGHT : y + (int) h;
+    if (x0 >= x1) return;
+    for (int py = y0; py < y1; py++) {
+        memset(&(dataPkt_[py * (LINE / 2) + x0]), 0, (x1 - x0) * sizeof(uint16_t));
+        markLine(py);
+    }
+}
+
+
+// glyph atlas, built once from the font image
+// one RGB565 pixel per font pixel, in monochrome mode lit pixels are white (0xffff),
+// so a glyph row is coloured by masking it with the text colour
+static const unsigned N_GLYPHS = (GIMP_IMAGE_WIDTH / Push2::GLYPH_WIDTH) * (GIMP_IMAGE_HEIGHT / Push2::GLYPH_HEIGHT);
+
+class GlyphAtlas {
+public:
+    GlyphAtlas() {
+        const unsigned glyphsPerRow = GIMP_IMAGE_WIDTH / Push2::GLYPH_WIDTH;
+        for (unsigned ch = 0; ch < N_GLYPHS; ch++) {
+            unsigned prow = ch / glyphsPerRow;
+            unsigned pchar = ch % glyphsPerRow;
+            for (unsigned line = 0; line < Push2::GLYPH_HEIGHT; line++) {
+                unsigned pline = ((prow * Push2::GLYPH_HEIGHT) + line) * (GIMP_IMAGE_WIDTH * GIMP_IMAGE_BYTES_PER_PIXEL);
+                for (unsigned pix = 0; pix < Push2::GLYPH_WIDTH; pix++) {
+                    unsigned poffset = pline + (((pchar * Push2::GLYPH_WIDTH) + pix) * GIMP_IMAGE_BYTES_PER_PIXEL);
+                    unsigned red = GIMP_IMAGE_PIXEL_DATA[poffset];
+                    uint16_t clr = 0;
+                    if (MONOCHROME) {
+                        if (red) clr = 0xffff;
+                    } else {
+                        unsigned green = GIMP_IMAGE_PIXEL_DATA[poffset + 1];
+                        unsigned blue = GIMP_IMAGE_PIXEL_DATA[poffset + 2];
+                        clr = RGB565(red, blue, green);
+                    }
+                    glyphs_[ch][line][pix] = clr;
+                }
+            }
         }
     }
+
+    // characters outside the font are drawn as spaces
+    const uint16_t *row(char ch, unsigned line) const {
+        unsigned c = (unsigned char) ch;
+        if (c >= N_GLYPHS) c = ' ';
+        return glyphs_[c][line];
+    }
+
+private:
+    uint16_t glyphs_[N_GLYPHS][Push2::GLYPH_HEIGHT][Push2::GLYPH_WIDTH];
+};
+
+static const GlyphAtlas &glyphAtlas() {
+    static GlyphAtlas atlas;
+    return atlas;
 }
 
 
@@ -88,49 +310,67 @@ void Push2::drawText(unsigned row, unsigned col,
                      unsigned vscale, unsigned hscale,
                      uint16_t colour,
                      bool invert) {
-    unsigned CH_COLS = (WIDTH / F_WIDTH) / hscale;
-    unsigned CH_ROWS = ((HEIGHT / F_HEIGHT) / vscale);
-    if (row > CH_ROWS) return;
-
-    unsigned len = col + ln < CH_COLS ? ln : CH_COLS - col;
-    for (int i = 0; i < len; i++) {
-        int c = col + i;
-        int ch = str[i];
-        for (int line = 0; line < F_HEIGHT; line++) {
-            int prow = ch / (GIMP_IMAGE_WIDTH / F_WIDTH);
-            int pchar = ch % (GIMP_IMAGE_WIDTH / F_WIDTH);
-            int pline = ((prow * F_HEIGHT) + line) * (GIMP_IMAGE_WIDTH * GIMP_IMAGE_BYTES_PER_PIXEL);
-
-            for (int vs = 0; vs < vscale; vs++) {
-                int bl = (((((row * F_HEIGHT) + line)) * vscale) + vs) * (LINE / 2);
-                for (int pix = 0; pix < F_WIDTH; pix++) {
-                    int poffset = (pline) + (((pchar * F_WIDTH) + pix) * GIMP_IMAGE_BYTES_PER_PIXEL);
-
-                    uint16_t clr = 0;
-                    unsigned red = GIMP_IMAGE_PIXEL_DATA[poffset];
-                    if (MONOCHROME) {
-                        if (red) {
-                            clr = colour;
-                        }
-
-                    } else {
-                        unsigned green = GIMP_IMAGE_PIXEL_DATA[poffset + 1];
-                        unsigned blue = GIMP_IMAGE_PIXEL_DATA[poffset + 2];
-                        clr = RGB565(red, blue, green);
-                    }
-
+    drawTextAt(col * GLYPH_WIDTH * hscale, row * textHeight(vscale), str, ln, vscale, hscale, colour, invert);
+}
 
-                    for (int hs = 0; hs < hscale; hs++) {
-                        int bpos = bl + ((((c * F_WIDTH) + pix) * hscale) + hs);
-                        // dataPkt_[bpos] = ( (clr & 0x00FF) << 8 ) | ( (clr & 0xFF00) >> 8);
-                        if (bpos < (DATA_PKT_SZ / 2)) {
-                            if(invert) clr = ~ clr;
-                            dataPkt_[bpos] = clr;
-                        }
+// each glyph line is written once, as a span across the visible characters,
+// then copied to the remaining (vscale) display lines
+void Push2::drawTextAt(int x, int y,
+                       const char *str, unsigned ln,
+                       unsigned vscale, unsigned hscale,
+                       uint16_t colour,
+                       bool invert) {
+    if (ln == 0 || vscale == 0 || hscale == 0) return;
+    const GlyphAtlas &atlas = glyphAtlas();
+    const int gw = GLYPH_WIDTH * hscale;
+
+    // horizontal clip, in pixels and characters
+    int x0 = x < 0 ? 0 : x;
+    int x1 = x + (int) ln * gw;
+    if (x1 > (int) WIDTH) x1 = WIDTH;
+    if (x0 >= x1) return;
+    unsigned first = (x0 - x) / gw;
+    unsigned last = (x1 - 1 - x) / gw;
+
+    const uint16_t mask = MONOCHROME ? colour : 0xffff;
+    const uint16_t flip = invert ? 0xffff : 0;
+
+    for (unsigned line = 0; line < GLYPH_HEIGHT; line++) {
+        int py = y + (int) (line * vscale);
+        if (py >= (int) HEIGHT) break;
+        if (py + (int) vscale <= 0) continue;
+        int span = py < 0 ? 0 : py;
+
+        uint16_t *dst = &(dataPkt_[span * (LINE / 2)]);
+        for (unsigned i = first; i <= last; i++) {
+            const uint16_t *g = atlas.row(str[i], line);
+            int cx = x + (int) i * gw;
+            if (cx >= x0 && cx + gw <= x1) {
+                uint16_t *d = dst + cx;
+                if (hscale == 1) {
+                    for (unsigned pix = 0; pix < GLYPH_WIDTH; pix++) d[pix] = (g[pix] & mask) ^ flip;
+                } else {
+                    for (unsigned pix = 0; pix < GLYPH_WIDTH; pix++) {
+                        uint16_t clr = (g[pix] & mask) ^ flip;
+                        for (unsigned hs = 0; hs < hscale; hs++) *d++ = clr;
                     }
                 }
+            } else {
+                // partially visible
+                for (int px = 0; px < gw; px++) {
+                    int bx = cx + px;
+                    if (bx >= x0 && bx < x1) dst[bx] = (g[px / hscale] & mask) ^ flip;
+                }
             }
         }
+        markLine(span);
+
+        int end = py + (int) vscale;
+        if (end > (int) HEIGHT) end = HEIGHT;
+        for (int vs = span + 1; vs < end; vs++) {
+            memcpy(&(dataPkt_[vs * (LINE / 2) + x0]), dst + x0, (x1 - x0) * sizeof(uint16_t));
+            markLine(vs);
+        }
     }
 }
 
@@ -150,7 +390,7 @@ void Push2::p1_drawCell4(unsigned row, unsigned cell, const char *str) {
 }
 
 void Push2::drawInvertedCell8(unsigned row, unsigned cell, const char *str, unsigned vscale, unsigned hscale, uint16_t clr) {
-    unsigned CH_COLS = (WIDTH / F_WIDTH) / hscale;
+    unsigned CH_COLS = fitChars(WIDTH, hscale);
     // static const unsigned CELL_OFFSET_8[8] = { 0, 24, 48, 72, 96, 120, 144, 168 };
     if (cell < 8) {
         drawText(row, (CH_COLS / 8) * cell, str, vscale, hscale, clr,true);
@@ -158,13 +398,26 @@ void Push2::drawInvertedCell8(unsigned row, unsigned cell, const char *str, unsi
 }
 
 void Push2::drawCell8(unsigned row, unsigned cell, const char *str, unsigned vscale, unsigned hscale, uint16_t clr) {
-    unsigned CH_COLS = (WIDTH / F_WIDTH) / hscale;
+    unsigned CH_COLS = fitChars(WIDTH, hscale);
     // static const unsigned CELL_OFFSET_8[8] = { 0, 24, 48, 72, 96, 120, 144, 168 };
     if (cell < 8) {
         drawText(row, (CH_COLS / 8) * cell, str, vscale, hscale, clr,false);
     }
 }
 
+void Push2::drawCentredCell8(unsigned row, unsigned cell, const char *str, unsigned vscale, unsigned hscale, uint16_t clr) {
+    if (cell >= 8) return;
+    unsigned cellChars = fitChars(WIDTH, hscale) / 8;
+    unsigned cellWidth = textWidth(cellChars, hscale);
+    int x = cell * cellWidth;
+    int y = row * textHeight(vscale);
+    unsigned len = (unsigned) strlen(str);
+    clearRect(x, y, cellWidth, textHeight(vscale));
+    // character aligned, longer text overflows to the right
+    if (len < cellChars) x += textWidth((cellChars - len) / 2, hscale);
+    drawTextAt(x, y, str, len, vscale, hscale, clr, false);
+}
+
 
 
 // void Push2::abletonShape() {
@@ -174,47 +427,80 @@ void Push2::drawCell8(unsigned row, unsigned cell, const char *str, unsigned vsc
 
 
 int Push2::render() {
-    if (handle_ == NULL) return -1;
-    int tfrsize = 0;
-    int r = 0;
-    CALL_CHECK(libusb_bulk_transfer(handle_, endpointOut_, headerPkt_, HDR_PKT_SZ, &tfrsize, 1000));
-    if (tfrsize != HDR_PKT_SZ) { printf("header packet short %d", tfrsize); }
-    CALL_CHECK(libusb_bulk_transfer(handle_, endpointOut_, (unsigned char *) dataPkt_, DATA_PKT_SZ, &tfrsize, 1000));
-    if (tfrsize != DATA_PKT_SZ) { printf("data packet short %d", tfrsize); }
-
-    return 0;
-}
-
-
-int Push2::init() {
-    const struct libusb_version *version;
-    version = libusb_get_version();
-    std::cout << "Using libusb " << version->major << "." << version->minor << "." << version->micro << "."
-              << version->nano << std::endl;
-    int r = libusb_init(NULL);
-    libusb_set_debug(NULL, LIBUSB_LOG_LEVEL_INFO);
-    static uint16_t vid = VID, pid = PID;
+    if (!open_) return -1;
+    transport_->poll();
+
+    auto now = std::chrono::steady_clock::now();
+    bool keepAlive = (now - lastSend_) >= std::chrono::milliseconds(KEEP_ALIVE_MS);
+
+    const uint8_t *draw = (const uint8_t *) dataPkt_;
+    if (anyDirty_) {
+        // lines redrawn with the same content (e.g. clear and redraw) are not changes
+        const uint8_t *last = frames_[lastSlot_].get();
+        anyDirty_ = false;
+        for (unsigned line = 0; line < HEIGHT; line++) {
+            if (lineDirty_[line]) {
+                unsigned offset = line * LINE;
+                if (memcmp(draw + offset, last + offset, LINE) == 0) {
+                    lineDirty_[line] = false;
+                } else {
+                    anyDirty_ = true;
+                }
+            }
+        }
+    }
 
-    std::cout << "Open Push2 :" << std::hex << vid << ":" << pid << std::dec << std::endl;
+    if (!anyDirty_ && !keepAlive) {
+        stats_.skipped_++;
+        return 0;
+    }
 
-    handle_ = libusb_open_device_with_vid_pid(NULL, vid, pid);
+    unsigned slot = (lastSlot_ + 1) % Push2Transport::N_SLOTS;
+    if (transport_->busy(slot)) {
+        // still sending, changes stay dirty until a later render
+        stats_.stalled_++;
+        return 0;
+    }
 
-    if (handle_ == NULL) {
-        perr("  Failed.\n");
-        return -1;
+    uint8_t *frame = frames_[slot].get();
+    for (unsigned line = 0; line < HEIGHT; line++) {
+        if (lineDirty_[line] || sentDirty_[line]) {
+            unsigned offset = line * LINE;
+            memcpy(frame + offset, draw + offset, LINE);
+            stats_.linesCopied_++;
+        }
+        sentDirty_[line] = lineDirty_[line];
+        lineDirty_[line] = false;
+    }
+    anyDirty_ = false;
+
+    int r = transport_->submit(slot, headerPkt_, HDR_PKT_SZ, frame, DATA_PKT_SZ);
+    if (r < 0) {
+        // not sent, so resend everything once the transport recovers
+        for (unsigned line = 0; line < HEIGHT; line++) sentDirty_[line] = lineDirty_[line] = true;
+        anyDirty_ = true;
+        return r;
     }
 
-    CALL_CHECK(libusb_claim_interface(handle_, iface_));
+    lastSlot_ = slot;
+    lastSend_ = now;
+    stats_.frames_++;
+    stats_.bytesSubmitted_ += HDR_PKT_SZ + DATA_PKT_SZ;
+    return 0;
+}
+
 
+int Push2::init() {
+    int r = transport_->open();
+    open_ = (r >= 0);
+    // first render sends the whole display
+    lastSend_ = std::chrono::steady_clock::time_point();
     return r;
 }
 
 int Push2::deinit() {
-    if (handle_ != NULL) {
-        if (iface_ != 0) libusb_release_interface(handle_, iface_);
-        libusb_close(handle_);
-    }
-    libusb_exit(NULL);
+    transport_->close();
+    open_ = false;
     return 0;
 }
 
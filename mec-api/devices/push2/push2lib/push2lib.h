@@ -2,7 +2,9 @@
 #define PUSH2LIB_H
 
 #include <stdint.h>
-#include <libusb.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
 
 namespace Push2API {
 
@@ -15,17 +17,62 @@ namespace Push2API {
 
 #define RGB565(r, g, b)   (uint16_t) ((((((uint16_t) b & 0x0078)>> 3)   << 5) | (((uint16_t) g & 0x00FC) >> 2 ) << 6 ) | (((uint16_t) r & 0x00f8) >> 3))   //use top bits of colour input
 
+#define HDR_PKT_SZ 0x10
+
+// display frames are sent through a transport, libusb by default, or a stub for testing
+// submit() and poll() must not block, a slot is busy until its transfers have completed
+class Push2Transport {
+public:
+    static const unsigned N_SLOTS = 2;
+
+    virtual ~Push2Transport() { ; }
+    virtual int open() = 0;
+    virtual void close() = 0;
+    // queue header and data for sending, both must remain valid until the slot is no longer busy
+    // on failure, returns < 0 and leaves the slot free
+    virtual int submit(unsigned slot, const uint8_t *hdr, unsigned hdrSize, const uint8_t *data, unsigned dataSize) = 0;
+    virtual bool busy(unsigned slot) = 0;
+    // handle any completed transfers
+    virtual void poll() = 0;
+};
+
+struct RenderStats {
+    unsigned long frames_;          // frames submitted
+    unsigned long skipped_;         // renders with nothing changed
+    unsigned long stalled_;         // renders with changes, but no free slot
+    unsigned long linesCopied_;     // lines copied into send buffers
+    unsigned long bytesSubmitted_;
+};
+
 class Push2 {
 public:
     Push2();
+    explicit Push2(std::unique_ptr<Push2Transport> transport);
     virtual ~Push2();
     int init();
+    // sends the display, if it has changed since the last frame (or the keep alive is due)
+    // does not block, the frame is double buffered, so drawing can continue while it is sent
     int render();
     int deinit();
 
+    const RenderStats &stats() const { return stats_; }
+    const uint16_t *frameBuffer() const { return dataPkt_; }
+    void resetStats();
+
 
     void clearDisplay();
     void clearRow(unsigned row, unsigned vscale);
+    // clipped to the display
+    void clearRect(int x, int y, unsigned w, unsigned h);
+
+    // text metrics in pixels, the font is fixed width
+    static const unsigned GLYPH_WIDTH = 5;
+    static const unsigned GLYPH_HEIGHT = 8;
+    static unsigned textWidth(unsigned len, unsigned hscale) { return len * GLYPH_WIDTH * hscale; }
+    static unsigned textWidth(const char *str, unsigned hscale) { return textWidth((unsigned) strlen(str), hscale); }
+    static unsigned textHeight(unsigned vscale) { return GLYPH_HEIGHT * vscale; }
+    // characters which fit in width pixels
+    static unsigned fitChars(unsigned width, unsigned hscale) { return width / (GLYPH_WIDTH * hscale); }
 
     static const unsigned P1_VSCALE = 5;
     static const unsigned P1_HSCALE = 2;
@@ -35,20 +82,47 @@ public:
                   uint16_t clr, bool invert);
     void drawText(unsigned row, unsigned col, const char *str, unsigned vscale, unsigned hscale, uint16_t clr,bool invert);
 
+    // draw text at a pixel position, clipped to the display
+    void drawTextAt(int x, int y,
+                    const char *str, unsigned ln,
+                    unsigned vscale, unsigned hscale,
+                    uint16_t clr, bool invert);
+
     void drawCell8(unsigned row, unsigned cell, const char *str, unsigned vscale, unsigned hscale, uint16_t clr);
+    // clears the cell, then draws the text centred in it
+    void drawCentredCell8(unsigned row, unsigned cell, const char *str, unsigned vscale, unsigned hscale, uint16_t clr);
     void drawInvertedCell8(unsigned row, unsigned cell, const char *str, unsigned vscale, unsigned hscale, uint16_t clr);
 
     void p1_drawCell8(unsigned row, unsigned cell, const char *str);
     void p1_drawCell4(unsigned row, unsigned cell, const char *str);
 
 
+    // the display blanks if it does not receive a frame for 2 seconds
+    static const unsigned KEEP_ALIVE_MS = 1000;
+
 private:
-    uint8_t *headerPkt_;
-    uint16_t dataPkt_[DATA_PKT_SZ / 2];
+    void markLine(unsigned line) {
+        if (line < HEIGHT) {
+            lineDirty_[line] = true;
+            anyDirty_ = true;
+        }
+    }
 
-    libusb_device_handle *handle_;
-    int iface_ = 0;
-    int endpointOut_ = 1;
+    uint8_t *headerPkt_;
+    uint16_t dataPkt_[DATA_PKT_SZ / 2];   // drawn into
+
+    // send buffers, one per transport slot
+    // a slot is refilled with lines changed since it was last sent, i.e. dirty now, or sent in the previous frame
+    std::unique_ptr<uint8_t[]> frames_[Push2Transport::N_SLOTS];
+    bool lineDirty_[HEIGHT];
+    bool sentDirty_[HEIGHT];
+    bool anyDirty_;
+    unsigned lastSlot_;
+    std::chrono::steady_clock::time_point lastSend_;
+
+    std::unique_ptr<Push2Transport> transport_;
+    bool open_;
+    RenderStats stats_;
 };
 
 }
@@ -0,0 +1,255 @@
+#include "push2lib.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// headless checks of Push2 rendering, against a stub transport
+// the stub completes transfers after a fixed latency, and keeps a copy of what the display received
+// the benchmark counts bytes submitted and time spent in render() for typical display updates
+
+typedef std::chrono::steady_clock Clock;
+
+static const unsigned BENCH_FRAMES = 200;
+// roughly a full frame over usb 2.0 bulk
+static const unsigned USB_FRAME_US = 8000;
+// render loop period, faster than mec::Push2 polls, but long enough for a transfer to complete
+static const unsigned FRAME_PERIOD_US = 10000;
+
+class StubTransport : public Push2API::Push2Transport {
+public:
+    StubTransport(unsigned latencyUs) : latency_(latencyUs), failures_(0), submitted_(0), bytes_(0) {
+        for (unsigned i = 0; i < N_SLOTS; i++) {
+            busy_[i] = false;
+            data_[i] = nullptr;
+            size_[i] = 0;
+        }
+    }
+
+    int open() override { return 0; }
+
+    void close() override { flush(); }
+
+    int submit(unsigned slot, const uint8_t *hdr, unsigned hdrSize, const uint8_t *data, unsigned dataSize) override {
+        assert(slot < N_SLOTS);
+        assert(!busy_[slot]);
+        assert(hdrSize == HDR_PKT_SZ && dataSize == DATA_PKT_SZ);
+        if (failures_ > 0) {
+            // as a failed usb submit, nothing in flight
+            failures_--;
+            return -1;
+        }
+        busy_[slot] = true;
+        due_[slot] = Clock::now() + std::chrono::microseconds(latency_);
+        data_[slot] = data;
+        size_[slot] = dataSize;
+        submitted_++;
+        bytes_ += hdrSize + dataSize;
+        return 0;
+    }
+
+    bool busy(unsigned slot) override { return busy_[slot]; }
+
+    void poll() override {
+        auto now = Clock::now();
+        // complete in submission order
+        for (;;) {
+            int next = -1;
+            for (unsigned i = 0; i < N_SLOTS; i++) {
+                if (busy_[i] && due_[i] <= now && (next < 0 || due_[i] < due_[next])) next = i;
+            }
+            if (next < 0) break;
+            display_.assign(data_[next], data_[next] + size_[next]);
+            busy_[next] = false;
+        }
+    }
+
+    void flush() {
+        for (unsigned i = 0; i < N_SLOTS; i++) due_[i] = Clock::now();
+        poll();
+    }
+
+    unsigned latency_;
+    unsigned failures_;     // fail this many submits
+    unsigned long submitted_;
+    unsigned long bytes_;
+    std::vector<uint8_t> display_;
+
+private:
+    bool busy_[N_SLOTS];
+    Clock::time_point due_[N_SLOTS];
+    const uint8_t *data_[N_SLOTS];
+    unsigned size_[N_SLOTS];
+};
+
+static const unsigned VSCALE = 3;
+static const unsigned HSCALE = 1;
+
+void drawPage(Push2API::Push2 &push2, unsigned value) {
+    char buf[16];
+    push2.clearDisplay();
+    for (unsigned i = 0; i < 8; i++) {
+        push2.drawCell8(0, i, "  Page", VSCALE, HSCALE, RGB565(0xff, 0xff, 0xff));
+        push2.drawCell8(1, i, "  Param", VSCALE, HSCALE, MONO_CLR);
+        snprintf(buf, sizeof(buf), "  %u.%02u", value + i, (value * 7) % 100);
+        push2.drawCell8(2, i, buf, VSCALE, HSCALE, MONO_CLR);
+        push2.drawCell8(3, i, "  Hz", VSCALE, HSCALE, MONO_CLR);
+    }
+}
+
+void checks() {
+    StubTransport *stub = new StubTransport(0);
+    Push2API::Push2 push2{std::unique_ptr<Push2API::Push2Transport>(stub)};
+
+    assert(push2.render() < 0); // not open
+    assert(push2.init() == 0);
+
+    // first render sends the (blank) display
+    assert(push2.render() == 0);
+    assert(stub->submitted_ == 1);
+    assert(stub->bytes_ == HDR_PKT_SZ + DATA_PKT_SZ);
+
+    // nothing changed
+    assert(push2.render() == 0);
+    assert(stub->submitted_ == 1);
+    assert(push2.stats().skipped_ == 1);
+
+    // only changed lines are copied
+    push2.resetStats();
+    push2.drawText(0, 0, "hello", 1, 1, MONO_CLR, false);
+    assert(push2.render() == 0);
+    assert(stub->submitted_ == 2);
+    assert(push2.stats().linesCopied_ > 0 && push2.stats().linesCopied_ <= 8);
+
+    // redrawing identical content is not a change
+    push2.clearDisplay();
+    push2.drawText(0, 0, "hello", 1, 1, MONO_CLR, false);
+    assert(push2.render() == 0);
+    assert(stub->submitted_ == 2);
+
+    // display content matches a single render of the same drawing
+    drawPage(push2, 1);
+    push2.render();
+    drawPage(push2, 2);
+    push2.drawText(9, 0, "bottom", 2, 2, MONO_CLR, false);
+    push2.render();
+    stub->flush();
+
+    StubTransport *refStub = new StubTransport(0);
+    Push2API::Push2 ref{std::unique_ptr<Push2API::Push2Transport>(refStub)};
+    ref.init();
+    drawPage(ref, 2);
+    ref.drawText(9, 0, "bottom", 2, 2, MONO_CLR, false);
+    ref.render();
+    refStub->flush();
+    assert(stub->display_ == refStub->display_);
+
+    // slow transport, render does not wait, changes are sent once a slot is free
+    stub->latency_ = 100000;
+    push2.resetStats();
+    drawPage(push2, 3);
+    assert(push2.render() == 0);
+    drawPage(push2, 4);
+    assert(push2.render() == 0);
+    drawPage(push2, 5);
+    assert(push2.render() == 0);
+    assert(push2.stats().frames_ == 2);
+    assert(push2.stats().stalled_ == 1);
+    stub->flush();
+    assert(push2.render() == 0);
+    assert(push2.stats().frames_ == 3);
+    stub->flush();
+    ref.clearDisplay();
+    drawPage(ref, 5);
+    ref.render();
+    refStub->flush();
+    assert(stub->display_ == refStub->display_);
+
+    // failed submit, the slot is not left busy, and the whole display is resent on the next render
+    stub->latency_ = 0;
+    push2.resetStats();
+    stub->failures_ = 1;
+    drawPage(push2, 6);
+    assert(push2.render() < 0);
+    assert(push2.stats().frames_ == 0);
+    assert(push2.render() == 0);
+    assert(push2.stats().frames_ == 1);
+    assert(push2.stats().stalled_ == 0);
+    stub->flush();
+    assert(push2.render() == 0);
+    stub->flush();
+    ref.clearDisplay();
+    drawPage(ref, 6);
+    ref.render();
+    refStub->flush();
+    assert(stub->display_ == refStub->display_);
+
+    ref.deinit();
+    push2.deinit();
+}
+
+template<typename Draw>
+void benchmark(const char *name, Draw draw) {
+    StubTransport *stub = new StubTransport(USB_FRAME_US);
+    Push2API::Push2 push2{std::unique_ptr<Push2API::Push2Transport>(stub)};
+    push2.init();
+    push2.render();
+    stub->flush();
+    push2.resetStats();
+    unsigned long bytes = stub->bytes_;
+
+    double drawUs = 0.0, renderUs = 0.0, maxRenderUs = 0.0;
+    auto next = Clock::now();
+    for (unsigned f = 0; f < BENCH_FRAMES; f++) {
+        next += std::chrono::microseconds(FRAME_PERIOD_US);
+        std::this_thread::sleep_until(next);
+        auto start = Clock::now();
+        draw(push2, f);
+        auto drawn = Clock::now();
+        push2.render();
+        auto end = Clock::now();
+        drawUs += std::chrono::duration<double, std::micro>(drawn - start).count();
+        double r = std::chrono::duration<double, std::micro>(end - drawn).count();
+        renderUs += r;
+        if (r > maxRenderUs) maxRenderUs = r;
+    }
+    push2.deinit();
+
+    const Push2API::RenderStats &stats = push2.stats();
+    std::cout << name
+              << " draw " << drawUs / BENCH_FRAMES << "us/frame"
+              << " render " << renderUs / BENCH_FRAMES << "us/frame"
+              << " (max " << maxRenderUs << "us)"
+              << " sent " << stats.frames_
+              << " skipped " << stats.skipped_
+              << " stalled " << stats.stalled_
+              << " lines copied " << stats.linesCopied_
+              << " bytes " << (stub->bytes_ - bytes) / BENCH_FRAMES << "/frame"
+              << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::cout << "p2rendertest started" << std::endl;
+
+    checks();
+
+    // previously every render was a blocking transfer of header and full frame,
+    // i.e. HDR_PKT_SZ + DATA_PKT_SZ bytes and ~USB_FRAME_US per frame, whatever changed
+    std::cout << "full frame " << HDR_PKT_SZ + DATA_PKT_SZ << " bytes, transfer " << USB_FRAME_US << "us" << std::endl;
+
+    benchmark("idle", [](Push2API::Push2 &, unsigned) { ; });
+    benchmark("param value", [](Push2API::Push2 &p, unsigned f) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "  %u", f);
+        p.drawCell8(2, f % 8, buf, VSCALE, HSCALE, MONO_CLR);
+    });
+    benchmark("page redraw, same", [](Push2API::Push2 &p, unsigned) { drawPage(p, 1); });
+    benchmark("page redraw, changed", [](Push2API::Push2 &p, unsigned f) { drawPage(p, f); });
+
+    std::cout << "p2rendertest completed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include "push2lib.h"
+#include "push1font.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// checks the glyph atlas text drawing against the previous per pixel implementation,
+// and benchmarks a full parameter page redraw
+
+typedef std::chrono::steady_clock Clock;
+
+static const unsigned BENCH_PAGES = 2000;
+static const unsigned VSCALE = 3;
+static const unsigned HSCALE = 1;
+
+// previous implementation, pixel by pixel from the font image
+class Reference {
+public:
+    Reference() : buf_(DATA_PKT_SZ / 2, 0) { ; }
+
+    void clear() { std::fill(buf_.begin(), buf_.end(), 0); }
+
+    void drawText(unsigned row, unsigned col, const char *str, unsigned ln,
+                  unsigned vscale, unsigned hscale, uint16_t colour, bool invert) {
+        const unsigned F_WIDTH = Push2API::Push2::GLYPH_WIDTH, F_HEIGHT = Push2API::Push2::GLYPH_HEIGHT;
+        unsigned CH_COLS = (WIDTH / F_WIDTH) / hscale;
+        unsigned CH_ROWS = ((HEIGHT / F_HEIGHT) / vscale);
+        if (row > CH_ROWS) return;
+
+        unsigned len = col + ln < CH_COLS ? ln : CH_COLS - col;
+        for (unsigned i = 0; i < len; i++) {
+            int c = col + i;
+            int ch = str[i];
+            for (unsigned line = 0; line < F_HEIGHT; line++) {
+                int prow = ch / (GIMP_IMAGE_WIDTH / F_WIDTH);
+                int pchar = ch % (GIMP_IMAGE_WIDTH / F_WIDTH);
+                int pline = ((prow * F_HEIGHT) + line) * (GIMP_IMAGE_WIDTH * GIMP_IMAGE_BYTES_PER_PIXEL);
+                for (unsigned vs = 0; vs < vscale; vs++) {
+                    int bl = (((((row * F_HEIGHT) + line)) * vscale) + vs) * (LINE / 2);
+                    for (unsigned pix = 0; pix < F_WIDTH; pix++) {
+                        int poffset = (pline) + (((pchar * F_WIDTH) + pix) * GIMP_IMAGE_BYTES_PER_PIXEL);
+                        uint16_t clr = 0;
+                        if (GIMP_IMAGE_PIXEL_DATA[poffset]) clr = colour;
+                        for (unsigned hs = 0; hs < hscale; hs++) {
+                            int bpos = bl + ((((c * F_WIDTH) + pix) * hscale) + hs);
+                            if (bpos < (DATA_PKT_SZ / 2)) {
+                                if (invert) clr = ~clr;
+                                buf_[bpos] = clr;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<uint16_t> buf_;
+};
+
+// as the parameter page used to centre text, by padding with spaces
+std::string centreText(const std::string t) {
+    unsigned len = t.length();
+    if (len > 24) return t;
+    const std::string pad = "                         ";
+    unsigned padlen = (24 - len) / 2;
+    return pad.substr(0, padlen) + t + pad.substr(0, padlen);
+}
+
+bool same(const Push2API::Push2 &push2, const Reference &ref) {
+    return memcmp(push2.frameBuffer(), ref.buf_.data(), DATA_PKT_SZ) == 0;
+}
+
+void check(unsigned row, unsigned col, const char *str, unsigned vscale, unsigned hscale, bool invert) {
+    Push2API::Push2 *push2 = new Push2API::Push2(nullptr);
+    Reference ref;
+    push2->drawText(row, col, str, (unsigned) strlen(str), vscale, hscale, MONO_CLR, invert);
+    ref.drawText(row, col, str, (unsigned) strlen(str), vscale, hscale, MONO_CLR, invert);
+    if (!same(*push2, ref)) {
+        std::cout << "mismatch row " << row << " col " << col << " [" << str << "]"
+                  << " vscale " << vscale << " hscale " << hscale << " invert " << invert << std::endl;
+        assert(false);
+    }
+    delete push2;
+}
+
+void checks() {
+    const char *text = "The quick brown fox, 0123456789 !?#%";
+    for (unsigned vscale = 1; vscale <= 5; vscale++) {
+        for (unsigned hscale = 1; hscale <= 4; hscale++) {
+            unsigned rows = (HEIGHT / Push2API::Push2::GLYPH_HEIGHT) / vscale;
+            unsigned cols = Push2API::Push2::fitChars(WIDTH, hscale);
+            check(0, 0, text, vscale, hscale, false);
+            check(rows, 3, text, vscale, hscale, false);        // clipped at the bottom
+            check(1, cols - 10, text, vscale, hscale, false);   // clipped on the right
+        }
+        // the previous implementation toggled inversion per horizontal pixel, so only hscale 1 matches
+        check(2, 5, text, vscale, 1, true);
+    }
+
+    // pixel positions, clipped on all sides
+    Push2API::Push2 *push2 = new Push2API::Push2(nullptr);
+    push2->drawTextAt(-7, -3, "clipped", 7, 2, 2, MONO_CLR, false);
+    push2->drawTextAt(WIDTH - 12, HEIGHT - 5, "clipped", 7, 1, 1, MONO_CLR, false);
+    push2->drawTextAt(WIDTH, 0, "offscreen", 9, 1, 1, MONO_CLR, false);
+    push2->drawTextAt(0, HEIGHT, "offscreen", 9, 1, 1, MONO_CLR, false);
+    const uint16_t *fb = push2->frameBuffer();
+    for (unsigned line = 0; line < HEIGHT; line++) {
+        for (unsigned px = WIDTH; px < LINE / 2; px++) assert(fb[line * (LINE / 2) + px] == 0);
+    }
+
+    // measurement
+    assert(Push2API::Push2::textWidth("abc", 2) == 30);
+    assert(Push2API::Push2::textHeight(3) == 24);
+    assert(Push2API::Push2::fitChars(WIDTH, 1) / 8 == 24);
+
+    // centred cells, as the parameter page previously padded them
+    Reference ref;
+    push2->clearDisplay();
+    push2->drawCentredCell8(2, 3, "Cutoff", VSCALE, HSCALE, MONO_CLR);
+    push2->drawCentredCell8(3, 7, "a very long parameter name!", VSCALE, HSCALE, MONO_CLR);
+    std::string c = centreText("Cutoff");
+    ref.drawText(2, 24 * 3, c.c_str(), c.length(), VSCALE, HSCALE, MONO_CLR, false);
+    c = centreText("a very long parameter name!");
+    ref.drawText(3, 24 * 7, c.c_str(), c.length(), VSCALE, HSCALE, MONO_CLR, false);
+    assert(same(*push2, ref));
+    delete push2;
+}
+
+struct PageText {
+    std::string pages_[8];
+    std::string names_[8];
+    std::string values_[8];
+    std::string units_[8];
+    std::string modules_[8];
+};
+
+void benchmark() {
+    PageText page;
+    char buf[32];
+    for (unsigned i = 0; i < 8; i++) {
+        snprintf(buf, sizeof(buf), "Page %u", i);
+        page.pages_[i] = buf;
+        snprintf(buf, sizeof(buf), "Parameter %u", i);
+        page.names_[i] = buf;
+        snprintf(buf, sizeof(buf), "%u.%03u", i * 100, i * 7);
+        page.values_[i] = buf;
+        page.units_[i] = i % 2 ? "Hz" : "dB";
+        snprintf(buf, sizeof(buf), "Module %u", i);
+        page.modules_[i] = buf;
+    }
+
+    // previous, centreText strings and per pixel drawing
+    Reference ref;
+    auto start = Clock::now();
+    for (unsigned n = 0; n < BENCH_PAGES; n++) {
+        ref.clear();
+        for (unsigned i = 0; i < 8; i++) {
+            std::string t = centreText(page.pages_[i]);
+            ref.drawText(0, i * 24, t.c_str(), t.length(), VSCALE, HSCALE, MONO_CLR, false);
+            t = centreText(page.names_[i]);
+            ref.drawText(1, i * 24, t.c_str(), t.length(), VSCALE, HSCALE, MONO_CLR, false);
+            t = centreText(page.values_[i]);
+            ref.drawText(2, i * 24, t.c_str(), t.length(), VSCALE, HSCALE, MONO_CLR, false);
+            t = centreText(page.units_[i]);
+            ref.drawText(3, i * 24, t.c_str(), t.length(), VSCALE, HSCALE, MONO_CLR, false);
+            t = centreText(page.modules_[i]);
+            ref.drawText(5, i * 24, t.c_str(), t.length(), VSCALE, HSCALE, MONO_CLR, false);
+        }
+    }
+    double refUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / BENCH_PAGES;
+
+    Push2API::Push2 *push2 = new Push2API::Push2(nullptr);
+    start = Clock::now();
+    for (unsigned n = 0; n < BENCH_PAGES; n++) {
+        push2->clearDisplay();
+        for (unsigned i = 0; i < 8; i++) {
+            push2->drawCentredCell8(0, i, page.pages_[i].c_str(), VSCALE, HSCALE, MONO_CLR);
+            push2->drawCentredCell8(1, i, page.names_[i].c_str(), VSCALE, HSCALE, MONO_CLR);
+            push2->drawCentredCell8(2, i, page.values_[i].c_str(), VSCALE, HSCALE, MONO_CLR);
+            push2->drawCentredCell8(3, i, page.units_[i].c_str(), VSCALE, HSCALE, MONO_CLR);
+            push2->drawCentredCell8(5, i, page.modules_[i].c_str(), VSCALE, HSCALE, MONO_CLR);
+        }
+    }
+    double atlasUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / BENCH_PAGES;
+    delete push2;
+
+    std::cout << "parameter page redraw (40 cells)"
+              << " per pixel " << refUs << "us"
+              << " glyph atlas " << atlasUs << "us" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::cout << "p2texttest started" << std::endl;
+
+    checks();
+    benchmark();
+
+    std::cout << "p2texttest completed" << std::endl;
+    return 0;
+}
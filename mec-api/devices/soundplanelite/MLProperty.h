@@ -9,6 +9,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 #include "MLSignal.h"
 #include "MLSymbol.h"
 #include "MLDebug.h"
@@ -94,6 +95,7 @@ public:
 	void setProperty(MLSymbol p, T v)
 	{
 		mProperties[p].setValue(v);
+		updateBindings(p);
 		broadcastProperty(p, false);
 	}
 
@@ -102,6 +104,7 @@ public:
 	void setPropertyImmediate(MLSymbol p, T v)
 	{
 		mProperties[p].setValue(v);
+		updateBindings(p);
 		broadcastProperty(p, true);
 	}
 	
@@ -111,11 +114,21 @@ public:
 	void setPropertyImmediateExcludingListener(MLSymbol p, T v, MLPropertyListener* pL)
 	{
 		mProperties[p].setValue(v);
+		updateBindings(p);
 		broadcastPropertyExcludingListener(p, true, pL);
 	}
 	
     void broadcastAllProperties();
     
+	// bind a float property to a plain variable, which is written whenever the property is set.
+	// lets time critical code (e.g. per frame processing) read parameters without
+	// symbol construction or map lookups. the variable is set to the current value on binding,
+	// and must outlive the binding, or be unbound first.
+	void bindProperty(MLSymbol p, float* pVar);
+	void bindProperty(MLSymbol p, int* pVar);
+	void bindProperty(MLSymbol p, bool* pVar);
+	void unbindProperty(MLSymbol p);
+	
 	static const MLProperty nullProperty;
 
 protected:
@@ -126,6 +139,26 @@ private:
 	std::map<MLSymbol, MLProperty> mProperties;
 	std::list<MLPropertyListener*> mpListeners;
 	
+	// a plain variable bound to a float property
+	class PropertyBinding
+	{
+	public:
+		enum Type
+		{
+			kFloat,
+			kInt,
+			kBool
+		};
+		PropertyBinding(Type t, void* pVar) : mType(t), mpVar(pVar) {}
+		
+		Type mType;
+		void* mpVar;
+	};
+	std::map<MLSymbol, std::vector<PropertyBinding> > mBindings;
+	
+	void addBinding(MLSymbol p, const PropertyBinding& b);
+	void updateBindings(MLSymbol p);
+	static void writeBinding(const PropertyBinding& b, float v);
 	void broadcastProperty(MLSymbol p, bool immediate);
 	void broadcastPropertyExcludingListener(MLSymbol p, bool immediate, MLPropertyListener* pListenerToExclude);
 };
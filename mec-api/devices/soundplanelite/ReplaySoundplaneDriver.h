@@ -0,0 +1,69 @@
+// Driver for Soundplane Model A that replays recorded frames, rather than
+// talking to a device (see SoundplaneFrameFile.h).
+//
+// Behaves as a device that connects and syncs immediately, so the listener
+// (normally SoundplaneModel) calibrates, filters and tracks the replayed frames
+// exactly as it would live ones.
+
+#ifndef __REPLAY_SOUNDPLANE_DRIVER__
+#define __REPLAY_SOUNDPLANE_DRIVER__
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "SoundplaneDriver.h"
+#include "SoundplaneFrameFile.h"
+
+class ReplaySoundplaneDriver : public SoundplaneDriver
+{
+public:
+	/**
+	 * rate is in frames per second, 0 replays as fast as the listener can
+	 * take them. When loop is set, replay restarts from the first frame
+	 * (without a new device sync, so no recalibration).
+	 */
+	ReplaySoundplaneDriver(SoundplaneDriverListener* listener,
+		std::shared_ptr<const SoundplaneFrameReader> frames,
+		float rate = kSoundplaneSampleRate, bool loop = false);
+	~ReplaySoundplaneDriver();
+
+	/**
+	 * Starts the replay thread.
+	 */
+	void init();
+
+	virtual MLSoundplaneState getDeviceState() const override;
+	virtual uint16_t getFirmwareVersion() const override;
+	virtual std::string getSerialNumberString() const override;
+
+	virtual const unsigned char *getCarriers() const override;
+	virtual void setCarriers(const Carriers& carriers) override;
+	virtual void enableCarriers(unsigned long mask) override;
+
+	bool isFinished() const { return mFinished.load(std::memory_order_acquire); }
+	unsigned long getFramesSent() const { return mFramesSent.load(std::memory_order_relaxed); }
+
+	/**
+	 * Blocks until all frames are replayed (or timeout), returns isFinished()
+	 */
+	bool waitUntilFinished(int timeoutMs);
+
+private:
+	void processThread();
+	void setDeviceState(MLSoundplaneState newState);
+
+	SoundplaneDriverListener* const mListener;
+	const std::shared_ptr<const SoundplaneFrameReader> mFrames;
+	const float mRate;
+	const bool mLoop;
+
+	std::atomic<MLSoundplaneState> mState;
+	std::atomic<bool> mQuitting;
+	std::atomic<bool> mFinished;
+	std::atomic<unsigned long> mFramesSent;
+	Carriers mCurrentCarriers;
+	std::thread mProcessThread;
+};
+
+#endif // __REPLAY_SOUNDPLANE_DRIVER__
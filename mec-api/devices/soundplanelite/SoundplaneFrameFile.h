@@ -0,0 +1,81 @@
+// Raw Soundplane frame files, for recording a device and replaying it later
+// (see ReplaySoundplaneDriver).
+//
+// Frames are stored as delivered to SoundplaneDriverListener::receivedFrame,
+// i.e. before calibration, filtering and touch tracking.
+//
+// file layout, native byte order (little endian on all supported platforms):
+//   header: magic (u32), version (u16), reserved (u16), frame length in floats (u32)
+//   frames: frame length floats each, until end of file
+
+#ifndef __SOUNDPLANE_FRAME_FILE__
+#define __SOUNDPLANE_FRAME_FILE__
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "SoundplaneModelA.h"
+
+const uint32_t kSoundplaneFrameFileMagic = 0x52465053; // "SPFR"
+const uint16_t kSoundplaneFrameFileVersion = 1;
+const int kSoundplaneFrameFileHeaderSize = 12;
+
+/**
+ * Appends frames to a file. write() is called on the driver's processing
+ * thread, so it only copies into the stream's buffer, which is written out
+ * in large blocks.
+ */
+class SoundplaneFrameRecorder
+{
+public:
+	SoundplaneFrameRecorder();
+	~SoundplaneFrameRecorder();
+
+	bool open(const std::string& file, int frameLength = kSoundplaneOutputFrameLength);
+	void close();
+	bool isOpen() const { return mStream.is_open(); }
+
+	/**
+	 * Frames of a different length to that given to open() are dropped.
+	 */
+	void write(const float* data, int size);
+
+	int getFramesWritten() const { return mFramesWritten; }
+	int getFramesDropped() const { return mFramesDropped; }
+
+private:
+	std::ofstream mStream;
+	std::vector<char> mStreamBuffer;
+	int mFrameLength;
+	int mFramesWritten;
+	int mFramesDropped;
+};
+
+/**
+ * A frame file loaded into memory, so replay does no file access.
+ */
+class SoundplaneFrameReader
+{
+public:
+	SoundplaneFrameReader() : mFrameLength(0) {}
+
+	bool load(const std::string& file);
+	bool save(const std::string& file) const;
+
+	void setFrameLength(int frameLength) { mFrameLength = frameLength; mFrames.clear(); }
+	void addFrame(const float* data);
+
+	int getFrameLength() const { return mFrameLength; }
+	int getFrameCount() const { return mFrameLength ? static_cast<int>(mFrames.size() / mFrameLength) : 0; }
+	const float* getFrame(int i) const { return mFrames.data() + static_cast<size_t>(i) * mFrameLength; }
+
+	static bool isFrameFile(const std::string& file);
+
+private:
+	int mFrameLength;
+	std::vector<float> mFrames;
+};
+
+#endif // __SOUNDPLANE_FRAME_FILE__
@@ -16,6 +16,10 @@ class SoundplaneMECCallback {
 public:
 	virtual ~SoundplaneMECCallback() {};
     virtual void device(const char* dev, int rows, int cols) = 0;
+    // t is the sensor frame count (kSoundplaneSampleRate)
+    // bracket the touches and controls of each sensor frame
+    virtual void startFrame(const char* dev, unsigned long long t) = 0;
+    virtual void endFrame(const char* dev, unsigned long long t) = 0;
     virtual void touch(const char* dev, unsigned long long t, bool a, int touch, float note, float x, float y, float z) = 0;
     virtual void control(const char* dev, unsigned long long t, int id, float val) = 0;
 };
@@ -41,6 +45,18 @@ public:
 	void notify(int connected);
 	void doInfrequentTasks();
 
+    // continues and controllers are sent every n sensor frames (set by setDataFreq), ons and offs always
+    void setDecimation(int n);
+    int getDecimation() const;
+    // on a sending frame, a touch or controller is only sent if a value moved more than this since last sent
+    // 0 = suppress exact repeats only, < 0 = send every time
+    void setChangeThreshold(float v);
+
+    // continues and controllers, sent or suppressed (decimated or unchanged), safe to read from any thread
+    unsigned long getUpdatesSent() const;
+    unsigned long getUpdatesSuppressed() const;
+    void resetCounters();
+
 private:	
 	SoundplaneMECOutput_Impl *impl_;
 };
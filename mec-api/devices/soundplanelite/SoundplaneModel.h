@@ -14,9 +14,12 @@
 #include "SoundplaneModelA.h"
 #include "SoundplaneDriver.h"
 #include "SoundplaneDataListener.h"
+#include "SoundplaneFrameFile.h"
 #include "TouchTracker.h"
 #include "MLSymbol.h"
 #include "MLParameter.h"
+
+class ReplaySoundplaneDriver;
 #include "cJSON.h"
 #include "Zone.h"
 
@@ -50,6 +53,21 @@ public:
 
 
 	void initialize();
+
+	/**
+	 * As initialize(), but frames come from a recording rather than the
+	 * device, see ReplaySoundplaneDriver. The returned driver is owned by
+	 * the model, null if the frames are not kSoundplaneOutputFrameLength.
+	 */
+	ReplaySoundplaneDriver* initializeReplay(std::shared_ptr<const SoundplaneFrameReader> frames,
+		float rate = kSoundplaneSampleRate, bool loop = false);
+
+	/**
+	 * Records raw frames, as received from the driver, until the model is
+	 * destroyed. Call before initialize().
+	 */
+	bool recordFrames(const std::string& file);
+	int getFramesRecorded() const { return mpRecorder ? mpRecorder->getFramesWritten() : 0; }
 	void clearTouchData();
 	void sendTouchDataToZones();
     void sendMessageToListeners();
@@ -153,12 +171,23 @@ private:
 	std::unique_ptr<SoundplaneDriver> mpDriver;
 	int mSerialNumber;
 
+	// the destructor stops the driver first, so the recording is complete
+	std::unique_ptr<SoundplaneFrameRecorder> mpRecorder;
+
     SoundplaneDataMessage mMessage;
+    // message types, looked up once rather than every frame
+    MLSymbol mStartFrameType;
+    MLSymbol mEndFrameType;
+    MLSymbol mMatrixType;
 
 	MLSignal mSurface;
 	MLSignal mCalibrateData;
 
+	// bound to properties, so sendTouchDataToZones() does no property lookups
 	int	mMaxTouches;
+	float mZScale;
+	float mZCurve;
+	float mHysteresis;
 	MLSignal mTouchFrame;
 	MLSignal mTouchHistory;
 
@@ -205,6 +234,7 @@ private:
 	TouchTracker mTracker;
 
 	int mHistoryCtr;
+	bool mDebugView;	// keep viewer only data (touch history, tracker signals)
 
 	bool mCarrierMaskDirty;
 	bool mNeedsCarriersSet;
@@ -235,9 +235,15 @@ public:
 	void setForceCurve(float f) { mForceCurve = f; }
 	void setZScale(float f) { mZScale = f; }
 	
+	// debug view: keep copies of intermediate signals for a viewer (see getTestSignal() etc.)
+	// off by default, so headless use does not pay for the copies each frame
+	void setDebugView(bool b) { mDebugView = b; }
+	bool getDebugView() const { return mDebugView; }
+	
 	// process input and get touches. creates one frame of touch data in buffer.
 	void process(int);
 	
+	// only updated while debug view is on
 	const MLSignal& getTestSignal() { return mTestSignal; } 
 	const MLSignal& getCalibratedSignal() { return mCalibratedSignal; } 
 	const MLSignal& getCookedSignal() { return mCookedSignal; } 
@@ -344,6 +350,7 @@ private:
 	int mPrevTouchForRotate;
 	bool mRotate;
 	bool mDoNormalize;
+	bool mDebugView;
 	
 	std::vector<Vec3> mPeaks;
 	std::vector<Touch> mTouches;
@@ -299,6 +299,68 @@ void MLPropertySet::broadcastAllProperties()
 	}
 }
 
+void MLPropertySet::bindProperty(MLSymbol p, float* pVar)
+{
+	addBinding(p, PropertyBinding(PropertyBinding::kFloat, pVar));
+}
+
+void MLPropertySet::bindProperty(MLSymbol p, int* pVar)
+{
+	addBinding(p, PropertyBinding(PropertyBinding::kInt, pVar));
+}
+
+void MLPropertySet::bindProperty(MLSymbol p, bool* pVar)
+{
+	addBinding(p, PropertyBinding(PropertyBinding::kBool, pVar));
+}
+
+void MLPropertySet::unbindProperty(MLSymbol p)
+{
+	mBindings.erase(p);
+}
+
+void MLPropertySet::addBinding(MLSymbol p, const PropertyBinding& b)
+{
+	mBindings[p].push_back(b);
+	std::map<MLSymbol, MLProperty>::const_iterator it = mProperties.find(p);
+	if((it != mProperties.end()) && (it->second.getType() == MLProperty::kFloatProperty))
+	{
+		writeBinding(b, it->second.getFloatValue());
+	}
+}
+
+// called only when a property is set, so the bound variables can be read without lookups
+void MLPropertySet::updateBindings(MLSymbol p)
+{
+	if(mBindings.empty()) return;
+	std::map<MLSymbol, std::vector<PropertyBinding> >::const_iterator it = mBindings.find(p);
+	if(it == mBindings.end()) return;
+	
+	const MLProperty& prop = mProperties[p];
+	if(prop.getType() != MLProperty::kFloatProperty) return;
+	float v = prop.getFloatValue();
+	for(const PropertyBinding& b : it->second)
+	{
+		writeBinding(b, v);
+	}
+}
+
+void MLPropertySet::writeBinding(const PropertyBinding& b, float v)
+{
+	switch(b.mType)
+	{
+		case PropertyBinding::kFloat:
+			*static_cast<float*>(b.mpVar) = v;
+			break;
+		case PropertyBinding::kInt:
+			*static_cast<int*>(b.mpVar) = static_cast<int>(v);
+			break;
+		case PropertyBinding::kBool:
+			*static_cast<bool*>(b.mpVar) = (v != 0.f);
+			break;
+	}
+}
+
 #pragma mark MLPropertyListener
 
 void MLPropertyListener::updateChangedProperties()
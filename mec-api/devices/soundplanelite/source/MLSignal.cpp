@@ -8,6 +8,203 @@
 
 #include "MLSignal.h"
 
+// ----------------------------------------------------------------
+#pragma mark SIMD kernels
+//
+// element-wise kernels for the arithmetic ops and convolve3x3r. 
+// vector width is selected at build time: AVX2 (8) if the compiler targets it, 
+// else SSE2 or NEON (4), else scalar. kernels evaluate in the same order as 
+// the scalar code, so results match it exactly (NEON flushes denormals).
+
+#if defined(ML_USE_SSE) && defined(__AVX2__)
+
+#include <immintrin.h>
+typedef __m256 MLSigVec;
+const int kMLSigVecSize = 8;
+static force_inline MLSigVec vecLoad(const float* p) { return _mm256_loadu_ps(p); }
+static force_inline void vecStore(float* p, MLSigVec v) { _mm256_storeu_ps(p, v); }
+static force_inline MLSigVec vecSet1(float f) { return _mm256_set1_ps(f); }
+static force_inline MLSigVec vecAdd(MLSigVec a, MLSigVec b) { return _mm256_add_ps(a, b); }
+static force_inline MLSigVec vecSub(MLSigVec a, MLSigVec b) { return _mm256_sub_ps(a, b); }
+static force_inline MLSigVec vecMul(MLSigVec a, MLSigVec b) { return _mm256_mul_ps(a, b); }
+static force_inline MLSigVec vecMin(MLSigVec a, MLSigVec b) { return _mm256_min_ps(a, b); }
+static force_inline MLSigVec vecMax(MLSigVec a, MLSigVec b) { return _mm256_max_ps(a, b); }
+
+#elif defined(ML_USE_SSE)
+
+#include <emmintrin.h>
+typedef __m128 MLSigVec;
+const int kMLSigVecSize = 4;
+static force_inline MLSigVec vecLoad(const float* p) { return _mm_loadu_ps(p); }
+static force_inline void vecStore(float* p, MLSigVec v) { _mm_storeu_ps(p, v); }
+static force_inline MLSigVec vecSet1(float f) { return _mm_set1_ps(f); }
+static force_inline MLSigVec vecAdd(MLSigVec a, MLSigVec b) { return _mm_add_ps(a, b); }
+static force_inline MLSigVec vecSub(MLSigVec a, MLSigVec b) { return _mm_sub_ps(a, b); }
+static force_inline MLSigVec vecMul(MLSigVec a, MLSigVec b) { return _mm_mul_ps(a, b); }
+static force_inline MLSigVec vecMin(MLSigVec a, MLSigVec b) { return _mm_min_ps(a, b); }
+static force_inline MLSigVec vecMax(MLSigVec a, MLSigVec b) { return _mm_max_ps(a, b); }
+
+#elif defined(ML_USE_NEON)
+
+#include <arm_neon.h>
+typedef float32x4_t MLSigVec;
+const int kMLSigVecSize = 4;
+static force_inline MLSigVec vecLoad(const float* p) { return vld1q_f32(p); }
+static force_inline void vecStore(float* p, MLSigVec v) { vst1q_f32(p, v); }
+static force_inline MLSigVec vecSet1(float f) { return vdupq_n_f32(f); }
+static force_inline MLSigVec vecAdd(MLSigVec a, MLSigVec b) { return vaddq_f32(a, b); }
+static force_inline MLSigVec vecSub(MLSigVec a, MLSigVec b) { return vsubq_f32(a, b); }
+static force_inline MLSigVec vecMul(MLSigVec a, MLSigVec b) { return vmulq_f32(a, b); }
+static force_inline MLSigVec vecMin(MLSigVec a, MLSigVec b) { return vminq_f32(a, b); }
+static force_inline MLSigVec vecMax(MLSigVec a, MLSigVec b) { return vmaxq_f32(a, b); }
+
+#else
+
+typedef float MLSigVec;
+const int kMLSigVecSize = 1;
+static force_inline MLSigVec vecLoad(const float* p) { return *p; }
+static force_inline void vecStore(float* p, MLSigVec v) { *p = v; }
+static force_inline MLSigVec vecSet1(float f) { return f; }
+static force_inline MLSigVec vecAdd(MLSigVec a, MLSigVec b) { return a + b; }
+static force_inline MLSigVec vecSub(MLSigVec a, MLSigVec b) { return a - b; }
+static force_inline MLSigVec vecMul(MLSigVec a, MLSigVec b) { return a * b; }
+static force_inline MLSigVec vecMin(MLSigVec a, MLSigVec b) { return min(a, b); }
+static force_inline MLSigVec vecMax(MLSigVec a, MLSigVec b) { return max(a, b); }
+
+#endif
+
+// ops, with a vector and matching scalar form for the remainder
+struct MLSigOpAdd
+{
+	static force_inline MLSigVec v(MLSigVec a, MLSigVec b) { return vecAdd(a, b); }
+	static force_inline float s(float a, float b) { return a + b; }
+};
+struct MLSigOpSub
+{
+	static force_inline MLSigVec v(MLSigVec a, MLSigVec b) { return vecSub(a, b); }
+	static force_inline float s(float a, float b) { return a - b; }
+};
+struct MLSigOpMul
+{
+	static force_inline MLSigVec v(MLSigVec a, MLSigVec b) { return vecMul(a, b); }
+	static force_inline float s(float a, float b) { return a * b; }
+};
+struct MLSigOpMin
+{
+	static force_inline MLSigVec v(MLSigVec a, MLSigVec b) { return vecMin(a, b); }
+	static force_inline float s(float a, float b) { return min(a, b); }
+};
+struct MLSigOpMax
+{
+	static force_inline MLSigVec v(MLSigVec a, MLSigVec b) { return vecMax(a, b); }
+	static force_inline float s(float a, float b) { return max(a, b); }
+};
+
+// pa[i] = op(pa[i], pb[i])
+template <class Op>
+static inline void sigApply(float* pa, const float* pb, int n)
+{
+	int i = 0;
+	for(; i + kMLSigVecSize <= n; i += kMLSigVecSize)
+	{
+		vecStore(pa + i, Op::v(vecLoad(pa + i), vecLoad(pb + i)));
+	}
+	for(; i < n; ++i)
+	{
+		pa[i] = Op::s(pa[i], pb[i]);
+	}
+}
+
+// pa[i] = op(pa[i], k)
+template <class Op>
+static inline void sigApply(float* pa, const float k, int n)
+{
+	const MLSigVec vk = vecSet1(k);
+	int i = 0;
+	for(; i + kMLSigVecSize <= n; i += kMLSigVecSize)
+	{
+		vecStore(pa + i, Op::v(vecLoad(pa + i), vk));
+	}
+	for(; i < n; ++i)
+	{
+		pa[i] = Op::s(pa[i], k);
+	}
+}
+
+// pa[i] = op(k, pb[i])
+template <class Op>
+static inline void sigApply(float* pa, const float k, const float* pb, int n)
+{
+	const MLSigVec vk = vecSet1(k);
+	int i = 0;
+	for(; i + kMLSigVecSize <= n; i += kMLSigVecSize)
+	{
+		vecStore(pa + i, Op::v(vk, vecLoad(pb + i)));
+	}
+	for(; i < n; ++i)
+	{
+		pa[i] = Op::s(k, pb[i]);
+	}
+}
+
+// inner cells [i0, i1) of one output row of convolve3x3r, rows above / below are optional.
+template <bool kAbove, bool kBelow>
+static inline void convolve3x3rSpan(float* prOut, const float* pr1, const float* pr2, const float* pr3, 
+	int i0, int i1, const MLSample kc, const MLSample ke, const MLSample kk)
+{
+	const MLSigVec vkc = vecSet1(kc);
+	const MLSigVec vke = vecSet1(ke);
+	const MLSigVec vkk = vecSet1(kk);
+	int i = i0;
+	for(; i + kMLSigVecSize <= i1; i += kMLSigVecSize)
+	{
+		MLSigVec e = vecLoad(pr2 + i - 1);
+		if(kAbove) e = vecAdd(e, vecLoad(pr1 + i));
+		e = vecAdd(e, vecLoad(pr2 + i + 1));
+		if(kBelow) e = vecAdd(e, vecLoad(pr3 + i));
+
+		MLSigVec c;
+		if(kAbove && kBelow)
+		{
+			c = vecAdd(vecAdd(vecAdd(vecLoad(pr1 + i - 1), vecLoad(pr1 + i + 1)), vecLoad(pr3 + i - 1)), vecLoad(pr3 + i + 1));
+		}
+		else if(kAbove)
+		{
+			c = vecAdd(vecLoad(pr1 + i - 1), vecLoad(pr1 + i + 1));
+		}
+		else
+		{
+			c = vecAdd(vecLoad(pr3 + i - 1), vecLoad(pr3 + i + 1));
+		}
+
+		MLSigVec f = vecMul(vke, e);
+		f = vecAdd(f, vecMul(vkk, c));
+		f = vecAdd(f, vecMul(vkc, vecLoad(pr2 + i)));
+		vecStore(prOut + i, f);
+	}
+	for(; i < i1; ++i)
+	{
+		float f;
+		if(kAbove && kBelow)
+		{
+			f = ke * (pr2[i-1] + pr1[i] + pr2[i+1] + pr3[i]);
+			f += kk * (pr1[i-1] + pr1[i+1] + pr3[i-1] + pr3[i+1]);
+		}
+		else if(kAbove)
+		{
+			f = ke * (pr2[i-1] + pr1[i] + pr2[i+1]);
+			f += kk * (pr1[i-1] + pr1[i+1]);
+		}
+		else
+		{
+			f = ke * (pr2[i-1] + pr2[i+1] + pr3[i]);
+			f += kk * (pr3[i-1] + pr3[i+1]);
+		}
+		f += kc * pr2[i];
+		prOut[i] = f;
+	}
+}
+
 const MLSample kMLSignalEndSamples[4] = 
 {
 	(MLSample)0x01234567, (MLSample)0x89abcdef, (MLSample)0xfedcba98, (MLSample)0x76543210 
@@ -373,22 +570,14 @@ void MLSignal::sigClamp(const MLSignal& a, const MLSignal& b)
 void MLSignal::sigMin(const MLSignal& b)
 {
 	int n = min(mSize, b.getSize());
-	for(int i = 0; i < n; ++i)
-	{
-		MLSample f = mDataAligned[i];
-		mDataAligned[i] = min(f, b.mDataAligned[i]);
-	}
+	sigApply<MLSigOpMin>(mDataAligned, b.mDataAligned, n);
 	setConstant(false);
 }
 
 void MLSignal::sigMax(const MLSignal& b)
 {
 	int n = min(mSize, b.getSize());
-	for(int i = 0; i < n; ++i)
-	{
-		MLSample f = mDataAligned[i];
-		mDataAligned[i] = max(f, b.mDataAligned[i]);
-	}
+	sigApply<MLSigOpMax>(mDataAligned, b.mDataAligned, n);
 	setConstant(false);
 }
 
@@ -504,7 +693,6 @@ const MLSample MLSignal::operator() (const float i, const float j) const
 }*/
 
 
-// TODO SSE
 void MLSignal::add(const MLSignal& b)
 {
 	const bool ka = isConstant();
@@ -519,31 +707,21 @@ void MLSignal::add(const MLSignal& b)
 		if (ka && !kb)
 		{
 			MLSample fa = mDataAligned[0];
-			for(int i = 0; i < n; ++i)
-			{
-				mDataAligned[i] = fa + b[i];
-			}
+			sigApply<MLSigOpAdd>(mDataAligned, fa, b.mDataAligned, n);
 		}
 		else if (!ka && kb)
 		{
 			MLSample fb = b[0];
-			for(int i = 0; i < n; ++i)
-			{
-				mDataAligned[i] += fb;
-			}
+			sigApply<MLSigOpAdd>(mDataAligned, fb, n);
 		}
 		else
 		{
-			for(int i = 0; i < n; ++i)
-			{
-				mDataAligned[i] += b.mDataAligned[i];
-			}
+			sigApply<MLSigOpAdd>(mDataAligned, b.mDataAligned, n);
 		}
 		setConstant(false);
 	}
 }
 
-// TODO SSE
 void MLSignal::subtract(const MLSignal& b)
 {
 	const bool ka = isConstant();
@@ -558,32 +736,22 @@ void MLSignal::subtract(const MLSignal& b)
 		if (ka && !kb)
 		{
 			MLSample fa = mDataAligned[0];
-			for(int i = 0; i < n; ++i)
-			{
-				mDataAligned[i] = fa - b[i];
-			}
+			sigApply<MLSigOpSub>(mDataAligned, fa, b.mDataAligned, n);
 		}
 		else if (!ka && kb)
 		{
 			MLSample fb = b[0];
-			for(int i = 0; i < n; ++i)
-			{
-				mDataAligned[i] -= fb;
-			}
+			sigApply<MLSigOpSub>(mDataAligned, fb, n);
 		}
 		else
 		{
-			for(int i = 0; i < n; ++i)
-			{
-				mDataAligned[i] -= b.mDataAligned[i];
-			}
+			sigApply<MLSigOpSub>(mDataAligned, b.mDataAligned, n);
 		}
 		setConstant(false);
 	}
 }
 
 
-// TODO SSE
 void MLSignal::multiply(const MLSignal& b)
 {
 	const bool ka = isConstant();
@@ -598,25 +766,16 @@ void MLSignal::multiply(const MLSignal& b)
 		if (ka && !kb)
 		{
 			MLSample fa = mDataAligned[0];
-			for(int i = 0; i < n; ++i)
-			{
-				mDataAligned[i] = fa * b[i];
-			}
+			sigApply<MLSigOpMul>(mDataAligned, fa, b.mDataAligned, n);
 		}
 		else if (!ka && kb)
 		{
 			MLSample fb = b[0];
-			for(int i = 0; i < n; ++i)
-			{
-				mDataAligned[i] *= fb;
-			}
+			sigApply<MLSigOpMul>(mDataAligned, fb, n);
 		}
 		else
 		{
-			for(int i = 0; i < n; ++i)
-			{
-				mDataAligned[i] *= b.mDataAligned[i];
-			}
+			sigApply<MLSigOpMul>(mDataAligned, b.mDataAligned, n);
 		}
 		setConstant(false);
 	}
@@ -681,26 +840,17 @@ void MLSignal::fill(const MLSample f)
 
 void MLSignal::scale(const MLSample k)
 {
-	for(int i=0; i<mSize; ++i)
-	{
-		mDataAligned[i] *= k;
-	}
+	sigApply<MLSigOpMul>(mDataAligned, k, mSize);
 }
 
 void MLSignal::add(const MLSample k)
 {
-	for(int i=0; i<mSize; ++i)
-	{
-		mDataAligned[i] += k;
-	}
+	sigApply<MLSigOpAdd>(mDataAligned, k, mSize);
 }
 
 void MLSignal::subtract(const MLSample k)
 {
-	for(int i=0; i<mSize; ++i)
-	{
-		mDataAligned[i] -= k;
-	}
+	sigApply<MLSigOpSub>(mDataAligned, k, mSize);
 }
 
 void MLSignal::subtractFrom(const MLSample k)
@@ -721,24 +871,14 @@ void MLSignal::sigClamp(const MLSample min, const MLSample max)
 	}
 }
 
-// TODO SSE
 void MLSignal::sigMin(const MLSample m)
 {
-	for(int i=0; i<mSize; ++i)
-	{
-		float f = mDataAligned[i];
-		mDataAligned[i] = min(f, (float)m);
-	}
+	sigApply<MLSigOpMin>(mDataAligned, (float)m, mSize);
 }
 
-// TODO SSE
 void MLSignal::sigMax(const MLSample m)	
 {
-	for(int i=0; i<mSize; ++i)
-	{
-		float f = mDataAligned[i];
-		mDataAligned[i] = max(f, (float)m);
-	}
+	sigApply<MLSigOpMax>(mDataAligned, (float)m, mSize);
 }
 
 // convolve a 1D signal with a 3-point impulse response.
@@ -811,13 +951,8 @@ void MLSignal::convolve3x3r(const MLSample kc, const MLSample ke, const MLSample
 			prOut[i] = f;		
 		}
 			
-		for(i = 1; i < width - 1; i++) // top side
-		{
-			f = ke * (pr2[i-1] + pr2[i+1] + pr3[i]);
-			f += kk * (pr3[i-1] + pr3[i+1]);
-			f += kc * pr2[i];
-			prOut[i] = f;
-		}
+		// top side
+		convolve3x3rSpan<false, true>(prOut, 0, pr2, pr3, 1, width - 1, kc, ke, kk);
 		
 		i = width - 1; // top right corner
 		{
@@ -843,13 +978,8 @@ void MLSignal::convolve3x3r(const MLSample kc, const MLSample ke, const MLSample
 			prOut[i] = f;		
 		}
 			
-		for(i = 1; i < width - 1; i++) // center
-		{
-			f = ke * (pr2[i-1] + pr1[i] + pr2[i+1] + pr3[i]);
-			f += kk * (pr1[i-1] + pr1[i+1] + pr3[i-1] + pr3[i+1]);
-			f += kc * pr2[i];
-			prOut[i] = f;
-		}
+		// center
+		convolve3x3rSpan<true, true>(prOut, pr1, pr2, pr3, 1, width - 1, kc, ke, kk);
 		
 		i = width - 1; // right side
 		{
@@ -874,13 +1004,8 @@ void MLSignal::convolve3x3r(const MLSample kc, const MLSample ke, const MLSample
 			prOut[i] = f;		
 		}
 			
-		for(i = 1; i < width - 1; i++) // bottom side
-		{
-			f = ke * (pr2[i-1] + pr1[i] + pr2[i+1]);
-			f += kk * (pr1[i-1] + pr1[i+1]);
-			f += kc * pr2[i];
-			prOut[i] = f;
-		}
+		// bottom side
+		convolve3x3rSpan<true, false>(prOut, pr1, pr2, 0, 1, width - 1, kc, ke, kk);
 		
 		i = width - 1; // bottom right corner
 		{
@@ -0,0 +1,114 @@
+// ReplaySoundplaneDriver.cpp
+//
+// Plays recorded frames to a SoundplaneDriverListener, in place of a device.
+
+#include "ReplaySoundplaneDriver.h"
+
+#include <chrono>
+
+ReplaySoundplaneDriver::ReplaySoundplaneDriver(SoundplaneDriverListener* listener,
+	std::shared_ptr<const SoundplaneFrameReader> frames, float rate, bool loop) :
+	mListener(listener),
+	mFrames(frames),
+	mRate(rate),
+	mLoop(loop),
+	mState(kNoDevice),
+	mQuitting(false),
+	mFinished(false),
+	mFramesSent(0)
+{
+	mCurrentCarriers.fill(0);
+}
+
+ReplaySoundplaneDriver::~ReplaySoundplaneDriver()
+{
+	mQuitting.store(true, std::memory_order_release);
+	if (mProcessThread.joinable())
+	{
+		mProcessThread.join();
+	}
+	setDeviceState(kDeviceIsTerminating);
+}
+
+void ReplaySoundplaneDriver::init()
+{
+	mProcessThread = std::thread(&ReplaySoundplaneDriver::processThread, this);
+}
+
+MLSoundplaneState ReplaySoundplaneDriver::getDeviceState() const
+{
+	return mState.load(std::memory_order_acquire);
+}
+
+uint16_t ReplaySoundplaneDriver::getFirmwareVersion() const
+{
+	return 0;
+}
+
+std::string ReplaySoundplaneDriver::getSerialNumberString() const
+{
+	return "replay";
+}
+
+const unsigned char *ReplaySoundplaneDriver::getCarriers() const
+{
+	return mCurrentCarriers.data();
+}
+
+void ReplaySoundplaneDriver::setCarriers(const Carriers& carriers)
+{
+	// the recording was made with whatever carriers the device had
+	mCurrentCarriers = carriers;
+}
+
+void ReplaySoundplaneDriver::enableCarriers(unsigned long mask)
+{
+}
+
+bool ReplaySoundplaneDriver::waitUntilFinished(int timeoutMs)
+{
+	auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	while (!isFinished() && std::chrono::steady_clock::now() < end)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return isFinished();
+}
+
+void ReplaySoundplaneDriver::setDeviceState(MLSoundplaneState newState)
+{
+	mState.store(newState, std::memory_order_release);
+	if (mListener) mListener->deviceStateChanged(*this, newState);
+}
+
+void ReplaySoundplaneDriver::processThread()
+{
+	typedef std::chrono::steady_clock Clock;
+
+	setDeviceState(kDeviceConnected);
+	setDeviceState(kDeviceHasIsochSync);
+
+	const int frameCount = mFrames ? mFrames->getFrameCount() : 0;
+	const int frameLength = mFrames ? mFrames->getFrameLength() : 0;
+	const bool paced = mRate > 0.f;
+	const auto period = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(paced ? 1.0 / mRate : 0.0));
+
+	Clock::time_point next = Clock::now();
+	do
+	{
+		for (int i = 0; i < frameCount && !mQuitting.load(std::memory_order_acquire); ++i)
+		{
+			if (paced)
+			{
+				next += period;
+				std::this_thread::sleep_until(next);
+			}
+			if (mListener) mListener->receivedFrame(*this, mFrames->getFrame(i), frameLength);
+			mFramesSent.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	while (mLoop && frameCount > 0 && !mQuitting.load(std::memory_order_acquire));
+
+	mFinished.store(true, std::memory_order_release);
+}
@@ -0,0 +1,152 @@
+// SoundplaneFrameFile.cpp
+//
+// Recording and loading of raw Soundplane frames.
+
+#include "SoundplaneFrameFile.h"
+
+#include <cstring>
+
+namespace
+{
+	// a second of frames, so the recorder writes out about once a second
+	const size_t kRecorderBufferSize = kSoundplaneOutputFrameLength * sizeof(float) * 1000;
+
+	void writeHeader(std::ostream& os, int frameLength)
+	{
+		uint32_t magic = kSoundplaneFrameFileMagic;
+		uint16_t version = kSoundplaneFrameFileVersion;
+		uint16_t reserved = 0;
+		uint32_t length = static_cast<uint32_t>(frameLength);
+		os.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+		os.write(reinterpret_cast<const char*>(&version), sizeof(version));
+		os.write(reinterpret_cast<const char*>(&reserved), sizeof(reserved));
+		os.write(reinterpret_cast<const char*>(&length), sizeof(length));
+	}
+
+	// returns frame length, or 0 if not a valid header
+	int readHeader(std::istream& is)
+	{
+		uint32_t magic = 0, length = 0;
+		uint16_t version = 0, reserved = 0;
+		is.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		is.read(reinterpret_cast<char*>(&version), sizeof(version));
+		is.read(reinterpret_cast<char*>(&reserved), sizeof(reserved));
+		is.read(reinterpret_cast<char*>(&length), sizeof(length));
+		if (!is || magic != kSoundplaneFrameFileMagic || version != kSoundplaneFrameFileVersion)
+		{
+			return 0;
+		}
+		// a frame is the surface, as the model receives it, anything else would overrun it on replay
+		if (length != kSoundplaneOutputFrameLength)
+		{
+			return 0;
+		}
+		return static_cast<int>(length);
+	}
+}
+
+// ----------------------------------------------------------------
+#pragma mark SoundplaneFrameRecorder
+
+SoundplaneFrameRecorder::SoundplaneFrameRecorder() :
+	mFrameLength(0),
+	mFramesWritten(0),
+	mFramesDropped(0)
+{
+}
+
+SoundplaneFrameRecorder::~SoundplaneFrameRecorder()
+{
+	close();
+}
+
+bool SoundplaneFrameRecorder::open(const std::string& file, int frameLength)
+{
+	close();
+	mStreamBuffer.resize(kRecorderBufferSize);
+	mStream.rdbuf()->pubsetbuf(mStreamBuffer.data(), mStreamBuffer.size());
+	mStream.open(file.c_str(), std::ios::binary | std::ios::trunc);
+	if (!mStream.is_open())
+	{
+		return false;
+	}
+	mFrameLength = frameLength;
+	mFramesWritten = 0;
+	mFramesDropped = 0;
+	writeHeader(mStream, mFrameLength);
+	return mStream.good();
+}
+
+void SoundplaneFrameRecorder::close()
+{
+	if (mStream.is_open())
+	{
+		mStream.close();
+	}
+	mStream.clear();
+}
+
+void SoundplaneFrameRecorder::write(const float* data, int size)
+{
+	if (!mStream.is_open()) return;
+	if (size != mFrameLength || !mStream.good())
+	{
+		mFramesDropped++;
+		return;
+	}
+	mStream.write(reinterpret_cast<const char*>(data), size * sizeof(float));
+	mFramesWritten++;
+}
+
+// ----------------------------------------------------------------
+#pragma mark SoundplaneFrameReader
+
+bool SoundplaneFrameReader::load(const std::string& file)
+{
+	mFrames.clear();
+	std::ifstream is(file.c_str(), std::ios::binary);
+	if (!is.is_open()) return false;
+
+	int frameLength = readHeader(is);
+	if (!frameLength) return false;
+	mFrameLength = frameLength;
+
+	is.seekg(0, std::ios::end);
+	std::streamoff end = is.tellg();
+	is.seekg(kSoundplaneFrameFileHeaderSize, std::ios::beg);
+
+	// a partial frame at the end (e.g. recording interrupted) is ignored
+	size_t frameBytes = mFrameLength * sizeof(float);
+	size_t frames = static_cast<size_t>(end - kSoundplaneFrameFileHeaderSize) / frameBytes;
+	mFrames.resize(frames * mFrameLength);
+	if (frames > 0)
+	{
+		is.read(reinterpret_cast<char*>(mFrames.data()), frames * frameBytes);
+	}
+	if (!is)
+	{
+		mFrames.clear();
+		return false;
+	}
+	return true;
+}
+
+bool SoundplaneFrameReader::save(const std::string& file) const
+{
+	std::ofstream os(file.c_str(), std::ios::binary | std::ios::trunc);
+	if (!os.is_open() || !mFrameLength) return false;
+	writeHeader(os, mFrameLength);
+	os.write(reinterpret_cast<const char*>(mFrames.data()), mFrames.size() * sizeof(float));
+	return os.good();
+}
+
+void SoundplaneFrameReader::addFrame(const float* data)
+{
+	mFrames.insert(mFrames.end(), data, data + mFrameLength);
+}
+
+bool SoundplaneFrameReader::isFrameFile(const std::string& file)
+{
+	std::ifstream is(file.c_str(), std::ios::binary);
+	return is.is_open() && readHeader(is) != 0;
+}
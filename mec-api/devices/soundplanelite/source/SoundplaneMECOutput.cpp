@@ -6,16 +6,62 @@
 #include "SoundplaneMECOutput.h"
 #include "SoundplaneModelA.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace
+{
+
+// message types, resolved from the message symbols once per message
+enum MECMessageType
+{
+    kMECStartFrame,
+    kMECEndFrame,
+    kMECTouchOn,
+    kMECTouchContinue,
+    kMECTouchOff,
+    kMECControllerX,
+    kMECControllerY,
+    kMECControllerXY,
+    kMECControllerXYZ,
+    kMECControllerZ,
+    kMECControllerToggle,
+    kMECOther
+};
+
+const int kMaxControllers = 64;
+
+}
+
 class SoundplaneMECOutput_Impl
 {
 public:
     SoundplaneMECOutput_Impl() :     
         callback_(NULL)
-        ,mCurrFrameStartTime(0)
-        ,mLastFrameStartTime(0)
-        ,mTimeToSendNewFrame(false)
         ,mDataFreq(500.0f)
+        ,mDecimation(2)
+        ,mChangeThreshold(0.0f)
+        ,mFrame(0)
+        ,mTimeToSendNewFrame(false)
+        ,mUpdatesSent(0)
+        ,mUpdatesSuppressed(0)
+        ,startFrameSym("start_frame")
+        ,endFrameSym("end_frame")
+        ,touchSym("touch")
+        ,onSym("on")
+        ,continueSym("continue")
+        ,offSym("off")
+        ,controllerSym("controller")
+        ,xSym("x")
+        ,ySym("y")
+        ,xySym("xy")
+        ,xyzSym("xyz")
+        ,zSym("z")
+        ,toggleSym("toggle")
     {
+        for(int i = 0; i < kSoundplaneMaxTouches; ++i) mLastTouch[i] = LastSent();
+        for(int i = 0; i < kMaxControllers; ++i) mLastController[i] = LastSent();
     }
     void connect(SoundplaneMECCallback* cb);
     void deviceInit();
@@ -27,13 +73,51 @@ public:
     void setMaxTouches(int v);
     void notify(int connected);      
     void doInfrequentTasks();
+
+    void setDecimation(int n);
+    int getDecimation() const { return mDecimation; }
+    void setChangeThreshold(float v) { mChangeThreshold = v; }
+    unsigned long getUpdatesSent() const { return mUpdatesSent.load(std::memory_order_relaxed); }
+    unsigned long getUpdatesSuppressed() const { return mUpdatesSuppressed.load(std::memory_order_relaxed); }
+    void resetCounters();
 private:
+    struct LastSent
+    {
+        LastSent() : valid(false), a(0), b(0), c(0), d(0) {}
+        bool valid;
+        float a, b, c, d;
+    };
+
+    MECMessageType messageType(const SoundplaneDataMessage* msg) const;
+    bool changed(LastSent& last, float a, float b, float c, float d);
+    void sent() { mUpdatesSent.fetch_add(1, std::memory_order_relaxed); }
+    void suppressed() { mUpdatesSuppressed.fetch_add(1, std::memory_order_relaxed); }
+
     SoundplaneMECCallback *callback_;
     std::string mSerialNumber;
     float    mDataFreq;
-    uint64_t mCurrFrameStartTime;
-    uint64_t mLastFrameStartTime;
+    int      mDecimation;
+    float    mChangeThreshold;
+    uint64_t mFrame;
     bool     mTimeToSendNewFrame;
+    LastSent mLastTouch[kSoundplaneMaxTouches];
+    LastSent mLastController[kMaxControllers];
+    std::atomic<unsigned long> mUpdatesSent;
+    std::atomic<unsigned long> mUpdatesSuppressed;
+
+    const MLSymbol startFrameSym;
+    const MLSymbol endFrameSym;
+    const MLSymbol touchSym;
+    const MLSymbol onSym;
+    const MLSymbol continueSym;
+    const MLSymbol offSym;
+    const MLSymbol controllerSym;
+    const MLSymbol xSym;
+    const MLSymbol ySym;
+    const MLSymbol xySym;
+    const MLSymbol xyzSym;
+    const MLSymbol zSym;
+    const MLSymbol toggleSym;
 };
 
 
@@ -60,6 +144,12 @@ void SoundplaneMECOutput::setDataFreq(float v) { impl_->setDataFreq(v);}
 void SoundplaneMECOutput::setMaxTouches(int v) {impl_->setMaxTouches(v);}
 void SoundplaneMECOutput::notify(int connected) {impl_->notify(connected);}
 void SoundplaneMECOutput::doInfrequentTasks() {impl_->doInfrequentTasks();}
+void SoundplaneMECOutput::setDecimation(int n) { impl_->setDecimation(n);}
+int SoundplaneMECOutput::getDecimation() const { return impl_->getDecimation();}
+void SoundplaneMECOutput::setChangeThreshold(float v) { impl_->setChangeThreshold(v);}
+unsigned long SoundplaneMECOutput::getUpdatesSent() const { return impl_->getUpdatesSent();}
+unsigned long SoundplaneMECOutput::getUpdatesSuppressed() const { return impl_->getUpdatesSuppressed();}
+void SoundplaneMECOutput::resetCounters() { impl_->resetCounters();}
 
 void SoundplaneMECOutput_Impl::setSerialNumber(int s) 
 {
@@ -70,6 +160,21 @@ void SoundplaneMECOutput_Impl::setSerialNumber(int s)
 void SoundplaneMECOutput_Impl::setDataFreq(float v)
 {
     mDataFreq = v;
+    if (v > 0.0f)
+    {
+        setDecimation((int) std::lround(kSoundplaneSampleRate / v));
+    }
+}
+
+void SoundplaneMECOutput_Impl::setDecimation(int n)
+{
+    mDecimation = n < 1 ? 1 : n;
+}
+
+void SoundplaneMECOutput_Impl::resetCounters()
+{
+    mUpdatesSent = 0;
+    mUpdatesSuppressed = 0;
 }
 
 
@@ -101,116 +206,144 @@ void SoundplaneMECOutput_Impl::setMaxTouches(int v)
 }
 
 
-//TODO review this!!!
-#include <sys/time.h>
-unsigned long getMilliseconds2()
+MECMessageType SoundplaneMECOutput_Impl::messageType(const SoundplaneDataMessage* msg) const
 {
-    timeval time;
-    gettimeofday(&time, NULL);
-    unsigned long msec = (time.tv_sec * 1000) + (time.tv_usec / 1000);
-    return msec;
+    const MLSymbol type = msg->mType;
+    const MLSymbol subtype = msg->mSubtype;
+    if (type == touchSym)
+    {
+        if (subtype == continueSym) return kMECTouchContinue;
+        if (subtype == onSym) return kMECTouchOn;
+        if (subtype == offSym) return kMECTouchOff;
+    }
+    else if (type == controllerSym)
+    {
+        if (subtype == xSym) return kMECControllerX;
+        if (subtype == ySym) return kMECControllerY;
+        if (subtype == xySym) return kMECControllerXY;
+        if (subtype == xyzSym) return kMECControllerXYZ;
+        if (subtype == zSym) return kMECControllerZ;
+        if (subtype == toggleSym) return kMECControllerToggle;
+    }
+    else if (type == startFrameSym) return kMECStartFrame;
+    else if (type == endFrameSym) return kMECEndFrame;
+    return kMECOther;
 }
 
-void SoundplaneMECOutput_Impl::processSoundplaneMessage(const SoundplaneDataMessage* msg)
+bool SoundplaneMECOutput_Impl::changed(LastSent& last, float a, float b, float c, float d)
 {
-    static const MLSymbol startFrameSym("start_frame");
-    static const MLSymbol touchSym("touch");
-    static const MLSymbol onSym("on");
-    static const MLSymbol continueSym("continue");
-    static const MLSymbol offSym("off");
-    static const MLSymbol controllerSym("controller");
-    static const MLSymbol xSym("x");
-    static const MLSymbol ySym("y");
-    static const MLSymbol xySym("xy");
-    static const MLSymbol xyzSym("xyz");
-    static const MLSymbol zSym("z");
-    static const MLSymbol toggleSym("toggle");
-    static const MLSymbol endFrameSym("end_frame");
-    static const MLSymbol matrixSym("matrix");
-    static const MLSymbol nullSym;
+    if (last.valid && mChangeThreshold >= 0.0f)
+    {
+        float delta = std::max(std::max(std::fabs(a - last.a), std::fabs(b - last.b)),
+                               std::max(std::fabs(c - last.c), std::fabs(d - last.d)));
+        if (mChangeThreshold > 0.0f ? delta <= mChangeThreshold : delta == 0.0f) return false;
+    }
+    last.valid = true;
+    last.a = a;
+    last.b = b;
+    last.c = c;
+    last.d = d;
+    return true;
+}
 
+void SoundplaneMECOutput_Impl::processSoundplaneMessage(const SoundplaneDataMessage* msg)
+{
     if (!callback_) return;
 
-    MLSymbol type = msg->mType;
-    MLSymbol subtype = msg->mSubtype;
-
-    int voiceIdx, offset;
-    float x, y, z, dz, note, vibrato;
-
-    // virtual void device(const char* dev, DeviceType dt, int rows, int cols) {};
+    const MECMessageType type = messageType(msg);
+    const char* dev = mSerialNumber.c_str();
 
-    mCurrFrameStartTime = getMilliseconds2();
-    if(type == startFrameSym) {
-        const unsigned long dataPeriodMillisecs = 1000 / mDataFreq;
-        mCurrFrameStartTime = getMilliseconds2();
-        if (mCurrFrameStartTime > mLastFrameStartTime + dataPeriodMillisecs) 
-        {
-            mTimeToSendNewFrame = true;
-            mLastFrameStartTime = mCurrFrameStartTime;
-        } 
-        else 
+    switch (type)
+    {
+        case kMECStartFrame:
         {
-            mTimeToSendNewFrame = false;
+            // sensor frames arrive at kSoundplaneSampleRate, so decimating the frame count gives the data rate
+            mFrame++;
+            mTimeToSendNewFrame = (mFrame % mDecimation) == 0;
+            callback_->startFrame(dev, mFrame);
+            break;
         }
-
-    }
-    else if (type == touchSym)
-    {
-        // get incoming touch data from message
-        voiceIdx = msg->mData[0];
-        x = msg->mData[1];
-        y = msg->mData[2];
-        z = msg->mData[3];
-        dz = msg->mData[4];
-        note = msg->mData[5];
-        vibrato = msg->mData[6];
-        offset = msg->mOffset;
-
-        float fNote =  note + vibrato;
-
-        if (subtype == onSym)
+        case kMECEndFrame:
         {
-            callback_-> touch(mSerialNumber.c_str(), mCurrFrameStartTime, true, voiceIdx, fNote, x, y, z);
+            callback_->endFrame(dev, mFrame);
+            break;
         }
-        if (subtype == continueSym)
+        case kMECTouchOn:
+        case kMECTouchContinue:
+        case kMECTouchOff:
         {
-            if(mTimeToSendNewFrame) 
+            // get incoming touch data from message
+            int voiceIdx = msg->mData[0];
+            float x = msg->mData[1];
+            float y = msg->mData[2];
+            float z = msg->mData[3];
+            float note = msg->mData[5];
+            float vibrato = msg->mData[6];
+            float fNote =  note + vibrato;
+            LastSent dummy;
+            LastSent& last = (voiceIdx >= 0 && voiceIdx < kSoundplaneMaxTouches) ? mLastTouch[voiceIdx] : dummy;
+
+            if (type == kMECTouchOn)
             {
-                callback_-> touch(mSerialNumber.c_str(), mCurrFrameStartTime, true, voiceIdx, fNote, x, y, z);
+                last.valid = false;
+                changed(last, x, y, z, fNote);
+                callback_->touch(dev, mFrame, true, voiceIdx, fNote, x, y, z);
             }
+            else if (type == kMECTouchContinue)
+            {
+                if (mTimeToSendNewFrame && changed(last, x, y, z, fNote))
+                {
+                    sent();
+                    callback_->touch(dev, mFrame, true, voiceIdx, fNote, x, y, z);
+                }
+                else
+                {
+                    suppressed();
+                }
+            }
+            else
+            {
+                last.valid = false;
+                callback_->touch(dev, mFrame, false, voiceIdx, fNote, x, y, z);
+            }
+            break;
         }
-        if (subtype == offSym)
-        {
-            callback_-> touch(mSerialNumber.c_str(), mCurrFrameStartTime, false, voiceIdx, fNote, x, y, z);
-        }
-    }
-    else if (type == controllerSym) {
-        int zoneID = msg->mData[0];
-        if (subtype == xSym)
-        {
-            callback_->control(mSerialNumber.c_str(), mCurrFrameStartTime, zoneID, x);
-        }
-        else if (subtype == ySym)
-        {
-            callback_->control(mSerialNumber.c_str(), mCurrFrameStartTime, zoneID, y);
-        }
-        else if (subtype == zSym)
-        {
-//               callback_->global(mSerialNumber.c_str(),mCurrFrameStartTime, zoneID, z);
-        }
-        else if (subtype == xyzSym)
-        {
-            callback_->control(mSerialNumber.c_str(), mCurrFrameStartTime, zoneID, x);
-//               callback_->control(mSerialNumber.c_str(),mCurrFrameStartTime, zoneID, y);
-//               callback_->control(mSerialNumber.c_str(),mCurrFrameStartTime, zoneID, z);
-        }
-        else if (subtype == toggleSym)
-        {
-            callback_->control(mSerialNumber.c_str(), mCurrFrameStartTime, zoneID, x > 0.5 ? 1 : 0);
-        }
-        else if(type == endFrameSym) 
+        case kMECControllerX:
+        case kMECControllerY:
+        case kMECControllerXY:
+        case kMECControllerXYZ:
+        case kMECControllerToggle:
         {
-            //nop
+            int zoneID = msg->mData[0];
+            float x = msg->mData[5];
+            float y = msg->mData[6];
+            float z = msg->mData[7];
+            LastSent dummy;
+            LastSent& last = (zoneID >= 0 && zoneID < kMaxControllers) ? mLastController[zoneID] : dummy;
+            if (!mTimeToSendNewFrame || !changed(last, x, y, z, 0.0f))
+            {
+                suppressed();
+                break;
+            }
+            sent();
+            switch (type)
+            {
+                case kMECControllerY:
+                    callback_->control(dev, mFrame, zoneID, y);
+                    break;
+                case kMECControllerToggle:
+                    callback_->control(dev, mFrame, zoneID, x > 0.5 ? 1 : 0);
+                    break;
+                default:
+                    // x, xy, xyz, only x is sent
+                    callback_->control(dev, mFrame, zoneID, x);
+                    break;
+            }
+            break;
         }
+        case kMECControllerZ:
+        case kMECOther:
+        default:
+            break;
     }
-}
\ No newline at end of file
+}
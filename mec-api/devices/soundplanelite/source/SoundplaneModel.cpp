@@ -9,6 +9,7 @@
 #include "pa_memorybarrier.h"
 
 #include "InertSoundplaneDriver.h"
+#include "ReplaySoundplaneDriver.h"
 
 #include <string>
 #include <fstream>
@@ -58,7 +59,14 @@ SoundplaneModel::SoundplaneModel() :
 	mZoneMap(kSoundplaneAKeyWidth, kSoundplaneAKeyHeight),
 	mOutputEnabled(false),
 	mLastInfrequentTaskTime(0),
+	mStartFrameType("start_frame"),
+	mEndFrameType("end_frame"),
+	mMatrixType("matrix"),
 	mSurface(kSoundplaneWidth, kSoundplaneHeight),
+	mMaxTouches(0),
+	mZScale(1.f),
+	mZCurve(0.f),
+	mHysteresis(0.f),
 
 	//mRawSignal(kSoundplaneWidth, kSoundplaneHeight),
 	//mCalibratedSignal(kSoundplaneWidth, kSoundplaneHeight),
@@ -83,6 +91,7 @@ SoundplaneModel::SoundplaneModel() :
 	mTracker(kSoundplaneWidth, kSoundplaneHeight),
 
 	mHistoryCtr(0),
+	mDebugView(false),
 
 	mCarrierMaskDirty(false),
 	mNeedsCarriersSet(true),
@@ -121,6 +130,11 @@ SoundplaneModel::SoundplaneModel() :
 
     clearZones();
 
+	bindProperty("max_touches", &mMaxTouches);
+	bindProperty("z_scale", &mZScale);
+	bindProperty("z_curve", &mZCurve);
+	bindProperty("hysteresis", &mHysteresis);
+
 	setAllPropertiesToDefaults();
 
 	mTracker.setListener(this);
@@ -247,6 +261,12 @@ void SoundplaneModel::doPropertyChangeAction(MLSymbol p, const MLProperty & newV
 				bool b = v;
 				mTracker.setRotate(b);
 			}
+			else if (p == "debug_view")
+			{
+				bool b = v;
+				mDebugView = b;
+				mTracker.setDebugView(b);
+			}
 			else if (p == "glissando")
 			{
 				sendParametersToZones();
@@ -391,6 +411,46 @@ void SoundplaneModel::initialize()
 	mTouchHistory.setDims(kTouchWidth, kSoundplaneMaxTouches, kSoundplaneHistorySize);
 }
 
+ReplaySoundplaneDriver* SoundplaneModel::initializeReplay(std::shared_ptr<const SoundplaneFrameReader> frames,
+	float rate, bool loop)
+{
+	// frames are copied straight into the surface
+	if (!frames || frames->getFrameLength() != kSoundplaneOutputFrameLength)
+	{
+		MLConsole() << "SoundplaneModel: replay frames are not of the surface size\n";
+		return nullptr;
+	}
+
+    addListener(&mOSCOutput);
+    addListener(&mMECOutput);
+
+	if (!mCalibrateData.setDims(kSoundplaneWidth, kSoundplaneHeight, kSoundplaneCalibrateSize))
+	{
+		MLConsole() << "SoundplaneModel: out of memory!\n";
+	}
+
+	mTouchFrame.setDims(kTouchWidth, kSoundplaneMaxTouches);
+	mTouchHistory.setDims(kTouchWidth, kSoundplaneMaxTouches, kSoundplaneHistorySize);
+
+	// everything is set up before the first frame arrives
+	ReplaySoundplaneDriver* driver = new ReplaySoundplaneDriver(this, frames, rate, loop);
+	mpDriver.reset(driver);
+	driver->init();
+	return driver;
+}
+
+bool SoundplaneModel::recordFrames(const std::string& file)
+{
+	std::unique_ptr<SoundplaneFrameRecorder> recorder(new SoundplaneFrameRecorder());
+	if (!recorder->open(file))
+	{
+		MLConsole() << "SoundplaneModel: unable to record to " << file << "\n";
+		return false;
+	}
+	mpRecorder = std::move(recorder);
+	return true;
+}
+
 int SoundplaneModel::getDeviceState(void)
 {
 	return mpDriver->getDeviceState();
@@ -429,6 +489,11 @@ void SoundplaneModel::deviceStateChanged(SoundplaneDriver& driver, MLSoundplaneS
 
 void SoundplaneModel::receivedFrame(SoundplaneDriver& driver, const float* data, int size)
 {
+	if (mpRecorder)
+	{
+		mpRecorder->write(data, size);
+	}
+
     // do once every so many frames
 	if(mLastInfrequentTaskTime > 1000)
 	{
@@ -509,9 +574,13 @@ void SoundplaneModel::receivedFrame(SoundplaneDriver& driver, const float* data,
 
  		sendTouchDataToZones();
 
-		mHistoryCtr++;
-		if (mHistoryCtr >= kSoundplaneHistorySize) mHistoryCtr = 0;
-		mTouchHistory.setFrame(mHistoryCtr, mTouchFrame);
+		// touch history is only used by viewers
+		if(mDebugView)
+		{
+			mHistoryCtr++;
+			if (mHistoryCtr >= kSoundplaneHistorySize) mHistoryCtr = 0;
+			mTouchHistory.setFrame(mHistoryCtr, mTouchFrame);
+		}
 	}
 }
 
@@ -775,7 +844,7 @@ Vec2 SoundplaneModel::xyToKeyGrid(Vec2 xy)
 
 void SoundplaneModel::clearTouchData()
 {
-	const int maxTouches = getFloatProperty("max_touches");
+	const int maxTouches = mMaxTouches;
 	for(int i=0; i<maxTouches; ++i)
 	{
 		mTouchFrame(xColumn, i) = 0;
@@ -819,10 +888,10 @@ void SoundplaneModel::sendTouchDataToZones()
 	float x, y, z, dz;
 	int age;
 
-	const float zscale = getFloatProperty("z_scale");
-	const float zcurve = getFloatProperty("z_curve");
-	const int maxTouches = getFloatProperty("max_touches");
-	const float hysteresis = getFloatProperty("hysteresis");
+	const float zscale = mZScale;
+	const float zcurve = mZCurve;
+	const int maxTouches = mMaxTouches;
+	const float hysteresis = mHysteresis;
 
 	MLRange yRange(0.05, 0.8);
 	yRange.convertTo(MLRange(0., 1.));
@@ -881,7 +950,7 @@ void SoundplaneModel::sendTouchDataToZones()
 	}
 
     // tell listeners we are starting this frame.
-    mMessage.mType = MLSymbol("start_frame");
+    mMessage.mType = mStartFrameType;
 	sendMessageToListeners();
 
     // process note offs for each zone
@@ -906,7 +975,7 @@ void SoundplaneModel::sendTouchDataToZones()
     // send optional calibrated matrix
     if(mSendMatrixData)
     {
-        mMessage.mType = MLSymbol("matrix");
+        mMessage.mType = mMatrixType;
         for(int j = 0; j < kSoundplaneHeight; ++j)
         {
             for(int i = 0; i < kSoundplaneWidth; ++i)
@@ -919,7 +988,7 @@ void SoundplaneModel::sendTouchDataToZones()
 #endif
 
     // tell listeners we are done with this frame.
-    mMessage.mType = MLSymbol("end_frame");
+    mMessage.mType = mEndFrameType;
 	sendMessageToListeners();
 }
 
@@ -52,7 +52,8 @@ TouchTracker::TouchTracker(int w, int h) :
 	mBackgroundFilterFreq(0.125f),
 	mPrevTouchForRotate(0),
 	mRotate(false),
-	mDoNormalize(true)
+	mDoNormalize(true),
+	mDebugView(false)
 {
 	mTouches.resize(kTrackerMaxTouches);	
 	mTouchesToSort.resize(kTrackerMaxTouches);	
@@ -1173,10 +1174,12 @@ void TouchTracker::process(int)
 		}
 
 		// get signals for viewer
-		// TODO optimize: we only have to copy these each time a view is needed
-		mCalibratedSignal.copy(mInputMinusBackground);
-		mCookedSignal.copy(mSumOfTouches);		
-		mTestSignal.copy(mResidual);		
+		if(mDebugView)
+		{
+			mCalibratedSignal.copy(mInputMinusBackground);
+			mCookedSignal.copy(mSumOfTouches);		
+			mTestSignal.copy(mResidual);		
+		}
 		
 		// get subpixel xyz peak from residual
 		addPeakToKeyState(mResidual);
@@ -0,0 +1,587 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cassert>
+#include <ctime>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "InertSoundplaneDriver.h"
+#include "ReplaySoundplaneDriver.h"
+#include "SoundplaneFrameFile.h"
+#include "SoundplaneModel.h"
+#include "SoundplaneMECOutput.h"
+#include "MLProperty.h"
+
+// checks property bindings and frame files, and benchmarks SoundplaneModel::receivedFrame
+// and the whole chain (calibration, filters, tracker, zones) replayed by ReplaySoundplaneDriver
+// and the MEC output, replaying a zone message stream at different decimations and change thresholds
+// frames and messages are synthesised, so no device is needed
+
+namespace {
+
+const int kFrames = 10000;
+const int kRuns = 5;
+
+// a single note row zone covering the surface
+const char* kZoneJSON =
+    "{ \"zone\": { \"name\": \"all\", \"type\": \"note_row\", \"rect\": [0, 0, 30, 5],"
+    " \"note\": 40, \"offset\": 5 } }";
+
+void checkBindings()
+{
+    MLPropertySet props;
+    props.setProperty("a", 0.5f);
+
+    float f = 0.f;
+    int n = 0;
+    bool b = false;
+
+    // bound variables take the current value, then follow every set
+    props.bindProperty("a", &f);
+    assert(f == 0.5f);
+    props.bindProperty("b", &n);
+    props.bindProperty("b", &b);
+    assert(n == 0 && !b);
+
+    props.setProperty("a", 0.25f);
+    assert(f == 0.25f);
+    props.setPropertyImmediate("b", 4.f);
+    assert(n == 4 && b);
+    props.setPropertyImmediateExcludingListener("b", 0.f, nullptr);
+    assert(n == 0 && !b);
+
+    // non float values leave bound variables alone
+    props.setProperty("a", std::string("text"));
+    assert(f == 0.25f);
+
+    props.unbindProperty("a");
+    props.setProperty("a", 1.f);
+    assert(f == 0.25f);
+}
+
+void makeFrames(std::vector<MLSignal>& frames, int count)
+{
+    const int kTouches = 4;
+    frames.resize(count);
+    for(int f = 0; f < count; ++f)
+    {
+        MLSignal& sig = frames[f];
+        sig.setDims(kSoundplaneWidth, kSoundplaneHeight);
+        for(int j = 0; j < kSoundplaneHeight; ++j)
+        {
+            for(int i = 0; i < kSoundplaneWidth; ++i)
+            {
+                sig(i, j) = 0.0005f * (float)((i * 7 + j * 13 + f * 3) % 11);
+            }
+        }
+        for(int t = 0; t < kTouches; ++t)
+        {
+            int phase = (f + t * 125) % 500;
+            if(phase >= 400) continue;
+            float z = 0.1f * std::sin(3.14159f * (float)phase / 400.f);
+            float cx = 4.f + t * 14.f + 6.f * std::sin((float)f * 0.002f + t);
+            float cy = 1.5f + (float)(t % 3) * 2.f;
+            for(int j = 0; j < kSoundplaneHeight; ++j)
+            {
+                for(int i = 0; i < kSoundplaneWidth; ++i)
+                {
+                    float dx = (float)i - cx, dy = (float)j - cy;
+                    sig(i, j) += z * std::exp(-(dx * dx + dy * dy) * 0.5f);
+                }
+            }
+        }
+    }
+}
+
+// returns mean time per frame in microseconds
+double replayFrames(SoundplaneModel& model, SoundplaneDriver& driver, const std::vector<MLSignal>& frames)
+{
+    const int size = kSoundplaneWidth * kSoundplaneHeight;
+    auto start = std::chrono::steady_clock::now();
+    for(const MLSignal& frame : frames)
+    {
+        model.receivedFrame(driver, frame.getConstBuffer(), size);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / frames.size();
+}
+
+// per frame parameter reads, as sendTouchDataToZones() did them, and as it does now
+volatile float gSink;
+
+double lookupReads(MLPropertySet& props, int count)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < count; ++i)
+    {
+        float v = props.getFloatProperty("z_scale");
+        v += props.getFloatProperty("z_curve");
+        v += props.getFloatProperty("max_touches");
+        v += props.getFloatProperty("hysteresis");
+        MLSymbol start("start_frame");
+        MLSymbol end("end_frame");
+        gSink = v + (start == end);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / count;
+}
+
+double boundReads(MLPropertySet& props, int count)
+{
+    float zScale, zCurve, hysteresis;
+    int maxTouches;
+    props.bindProperty("z_scale", &zScale);
+    props.bindProperty("z_curve", &zCurve);
+    props.bindProperty("max_touches", &maxTouches);
+    props.bindProperty("hysteresis", &hysteresis);
+    MLSymbol startType("start_frame");
+    MLSymbol endType("end_frame");
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < count; ++i)
+    {
+        volatile float* pZScale = &zScale;
+        float v = *pZScale + zCurve + maxTouches + hysteresis;
+        gSink = v + (startType == endType);
+    }
+    auto end = std::chrono::steady_clock::now();
+    props.unbindProperty("z_scale");
+    props.unbindProperty("z_curve");
+    props.unbindProperty("max_touches");
+    props.unbindProperty("hysteresis");
+    return std::chrono::duration<double, std::micro>(end - start).count() / count;
+}
+
+void checkFrameFiles(const std::vector<MLSignal>& frames)
+{
+    const int length = kSoundplaneWidth * kSoundplaneHeight;
+    const char* file = "modeltest_frames.spfr";
+
+    SoundplaneFrameReader out;
+    out.setFrameLength(length);
+    for(int f = 0; f < 100; ++f)
+    {
+        out.addFrame(frames[f].getConstBuffer());
+    }
+    assert(out.save(file));
+    assert(SoundplaneFrameReader::isFrameFile(file));
+
+    SoundplaneFrameReader in;
+    assert(in.load(file));
+    assert(in.getFrameLength() == length);
+    assert(in.getFrameCount() == 100);
+    for(int f = 0; f < 100; ++f)
+    {
+        assert(memcmp(in.getFrame(f), frames[f].getConstBuffer(), length * sizeof(float)) == 0);
+    }
+
+    // recorder, frames of the wrong size are dropped, a partial last frame is ignored on load
+    {
+        SoundplaneFrameRecorder recorder;
+        assert(recorder.open(file));
+        recorder.write(frames[0].getConstBuffer(), length);
+        recorder.write(frames[1].getConstBuffer(), length - 1);
+        recorder.write(frames[2].getConstBuffer(), length);
+        assert(recorder.getFramesWritten() == 2);
+        assert(recorder.getFramesDropped() == 1);
+    }
+    {
+        FILE* fp = fopen(file, "ab");
+        fwrite(frames[3].getConstBuffer(), sizeof(float), length / 2, fp);
+        fclose(fp);
+    }
+    assert(in.load(file));
+    assert(in.getFrameCount() == 2);
+    assert(memcmp(in.getFrame(1), frames[2].getConstBuffer(), length * sizeof(float)) == 0);
+
+    // not a frame file
+    {
+        FILE* fp = fopen(file, "wb");
+        fputs("not frames", fp);
+        fclose(fp);
+    }
+    assert(!SoundplaneFrameReader::isFrameFile(file));
+    assert(!in.load(file));
+
+    // frames of another length, e.g. a foreign or corrupt file, would overrun the surface on replay
+    {
+        std::vector<float> big(length * 2, 0.5f);
+        SoundplaneFrameRecorder recorder;
+        assert(recorder.open(file, length * 2));
+        recorder.write(big.data(), length * 2);
+        assert(recorder.getFramesWritten() == 1);
+    }
+    assert(!in.load(file));
+    {
+        std::vector<float> big(length * 2, 0.5f);
+        auto wrong = std::make_shared<SoundplaneFrameReader>();
+        wrong->setFrameLength(length * 2);
+        wrong->addFrame(big.data());
+        SoundplaneModel model;
+        assert(model.initializeReplay(wrong, 0.f) == nullptr);
+    }
+    remove(file);
+}
+
+void setupModel(SoundplaneModel& model)
+{
+    model.setPropertyImmediate("zone_JSON", std::string(kZoneJSON));
+    model.setPropertyImmediate("max_touches", 8);
+    model.setPropertyImmediate("z_scale", 0.7f);
+}
+
+// the whole chain, as a device would drive it, returns mean time per frame in microseconds
+// optionally records what the model received
+double replayModel(std::shared_ptr<const SoundplaneFrameReader> frames, const char* recordFile)
+{
+    SoundplaneModel model;
+    setupModel(model);
+    if (recordFile)
+    {
+        bool recording = model.recordFrames(recordFile);
+        assert(recording);
+    }
+    auto start = std::chrono::steady_clock::now();
+    ReplaySoundplaneDriver* driver = model.initializeReplay(frames, 0.f);
+    bool finished = driver->waitUntilFinished(600000);
+    assert(finished);
+    auto end = std::chrono::steady_clock::now();
+    assert(driver->getFramesSent() == (unsigned long) frames->getFrameCount());
+    assert(model.getDeviceState() == kDeviceHasIsochSync);
+    if (recordFile) assert(model.getFramesRecorded() == frames->getFrameCount());
+    return std::chrono::duration<double, std::micro>(end - start).count() / frames->getFrameCount();
+}
+
+// counts what SoundplaneMECOutput sends, as the mec-api soundplane device would receive it
+class CountingMECCallback : public SoundplaneMECCallback
+{
+public:
+    CountingMECCallback(int decimation) : mDecimation(decimation) {}
+
+    void device(const char* dev, int rows, int cols) override {}
+    void startFrame(const char* dev, unsigned long long t) override
+    {
+        assert(!mInFrame);
+        mInFrame = true;
+        mFrames++;
+    }
+    void endFrame(const char* dev, unsigned long long t) override
+    {
+        assert(mInFrame);
+        mInFrame = false;
+    }
+    void touch(const char* dev, unsigned long long t, bool a, int touch, float note, float x, float y, float z) override
+    {
+        assert(mInFrame);
+        if(!a) mOffs++;
+        else if(touch >= 0 && touch < kSoundplaneMaxTouches && !mActive[touch]) mOns++;
+        else
+        {
+            // continues only on every n'th sensor frame
+            assert(t % mDecimation == 0);
+            mContinues++;
+        }
+        if(touch >= 0 && touch < kSoundplaneMaxTouches) mActive[touch] = a;
+    }
+    void control(const char* dev, unsigned long long t, int id, float val) override
+    {
+        assert(t % mDecimation == 0);
+        mControls++;
+    }
+
+    unsigned long messages() const { return mOns + mContinues + mOffs + mControls; }
+
+    int mDecimation;
+    bool mInFrame = false;
+    bool mActive[kSoundplaneMaxTouches] = {};
+    unsigned long mFrames = 0, mOns = 0, mContinues = 0, mOffs = 0, mControls = 0;
+};
+
+// a zone's message stream, recorded compactly, replayed through a SoundplaneDataMessage
+struct RecordedMessage
+{
+    MLSymbol type;
+    MLSymbol subtype;
+    float data[8];
+};
+
+// 8 touches, each held for 300 frames then lifted for 100, half moving, half held still after the attack
+// plus a controller zone that only changes occasionally
+void makeMessages(std::vector<RecordedMessage>& msgs, int frames)
+{
+    const int kTouches = 8;
+    msgs.clear();
+    auto add = [&msgs](const char* type, const char* subtype, float a, float b, float c, float d, float e, float f, float g, float h)
+    {
+        RecordedMessage m;
+        m.type = MLSymbol(type);
+        m.subtype = MLSymbol(subtype);
+        m.data[0] = a; m.data[1] = b; m.data[2] = c; m.data[3] = d;
+        m.data[4] = e; m.data[5] = f; m.data[6] = g; m.data[7] = h;
+        msgs.push_back(m);
+    };
+    bool down[kTouches] = { false };
+    for(int f = 0; f < frames; ++f)
+    {
+        add("start_frame", "", 0, 0, 0, 0, 0, 0, 0, 0);
+        for(int t = 0; t < kTouches; ++t)
+        {
+            // staggered starts, every touch on is lifted before the end of the stream
+            int phase = (f + 400 - t * 50) % 400;
+            if(f == frames - 1 && down[t]) phase = 300;
+            if(phase == 0) down[t] = true;
+            if(!down[t]) continue;
+            if(phase == 300) down[t] = false;
+            bool moving = (t & 1) != 0;
+            int age = moving ? phase : std::min(phase, 20);
+            float x = 0.1f + 0.1f * t + (moving ? 0.05f * std::sin(age * 0.01f) : 0.f);
+            float y = 0.5f + (moving ? 0.2f * std::cos(age * 0.013f) : 0.f);
+            float z = 0.5f * std::min(age, 20) / 20.f;
+            const char* subtype = phase == 0 ? "on" : (phase == 300 ? "off" : "continue");
+            add("touch", subtype, (float) t, x, y, z, 0.f, 40.f + t * 5, 0.f, 0.f);
+        }
+        add("controller", "x", 0, 0, 1, 2, 3, (float) ((f / 100) % 10) / 10.f, 0, 0);
+        add("end_frame", "", 0, 0, 0, 0, 0, 0, 0, 0);
+    }
+}
+
+unsigned long legacyMilliseconds()
+{
+    timeval time;
+    gettimeofday(&time, NULL);
+    return (time.tv_sec * 1000) + (time.tv_usec / 1000);
+}
+
+// as SoundplaneMECOutput previously throttled: symbol compares, and gettimeofday on every message
+class LegacyMECOutput
+{
+public:
+    LegacyMECOutput(SoundplaneMECCallback* cb, float dataFreq) : mCallback(cb), mDataFreq(dataFreq) {}
+
+    void process(const SoundplaneDataMessage* msg)
+    {
+        static const MLSymbol startFrameSym("start_frame");
+        static const MLSymbol touchSym("touch");
+        static const MLSymbol onSym("on");
+        static const MLSymbol continueSym("continue");
+        static const MLSymbol offSym("off");
+        static const MLSymbol controllerSym("controller");
+        static const MLSymbol xSym("x");
+        static const MLSymbol endFrameSym("end_frame");
+
+        MLSymbol type = msg->mType;
+        MLSymbol subtype = msg->mSubtype;
+        mCurrFrameStartTime = legacyMilliseconds();
+        if(type == startFrameSym)
+        {
+            const unsigned long dataPeriodMillisecs = 1000 / mDataFreq;
+            mCurrFrameStartTime = legacyMilliseconds();
+            mTimeToSendNewFrame = mCurrFrameStartTime > mLastFrameStartTime + dataPeriodMillisecs;
+            if(mTimeToSendNewFrame) mLastFrameStartTime = mCurrFrameStartTime;
+            mCallback->startFrame("", 0);
+        }
+        else if(type == touchSym)
+        {
+            float fNote = msg->mData[5] + msg->mData[6];
+            if(subtype == onSym || (subtype == continueSym && mTimeToSendNewFrame))
+            {
+                mCallback->touch("", 0, true, msg->mData[0], fNote, msg->mData[1], msg->mData[2], msg->mData[3]);
+            }
+            if(subtype == offSym)
+            {
+                mCallback->touch("", 0, false, msg->mData[0], fNote, msg->mData[1], msg->mData[2], msg->mData[3]);
+            }
+        }
+        else if(type == controllerSym)
+        {
+            if(subtype == xSym) mCallback->control("", 0, msg->mData[0], msg->mData[5]);
+        }
+        else if(type == endFrameSym)
+        {
+            mCallback->endFrame("", 0);
+        }
+    }
+
+private:
+    SoundplaneMECCallback* mCallback;
+    float mDataFreq;
+    unsigned long mCurrFrameStartTime = 0;
+    unsigned long mLastFrameStartTime = 0;
+    bool mTimeToSendNewFrame = false;
+};
+
+// replays the message stream, as fast as possible, returns process cpu time per sensor frame in microseconds
+template<typename Output>
+double replayMessages(Output& output, const std::vector<RecordedMessage>& msgs, int frames, int runs)
+{
+    SoundplaneDataMessage msg;
+    std::clock_t start = std::clock();
+    for(int r = 0; r < runs; ++r)
+    {
+        for(const RecordedMessage& m : msgs)
+        {
+            msg.mType = m.type;
+            msg.mSubtype = m.subtype;
+            memcpy(msg.mData, m.data, sizeof(msg.mData));
+            output.process(&msg);
+        }
+    }
+    std::clock_t end = std::clock();
+    return (double)(end - start) * 1000000. / CLOCKS_PER_SEC / (frames * runs);
+}
+
+struct MECOutputAdapter
+{
+    SoundplaneMECOutput output;
+    void process(const SoundplaneDataMessage* msg) { output.processSoundplaneMessage(msg); }
+};
+
+void benchmarkMEC()
+{
+    const int kMECFrames = 4000;
+    const int kMECRuns = 25;
+    std::vector<RecordedMessage> msgs;
+    makeMessages(msgs, kMECFrames);
+
+    {
+        CountingMECCallback out(1);
+        LegacyMECOutput legacy(&out, 500.f);
+        double cpu = replayMessages(legacy, msgs, kMECFrames, kMECRuns);
+        std::cout << "mec output, previous (gettimeofday, 500Hz) cpu " << cpu << "us/frame"
+                  << " messages " << out.messages() << " (" << (double) out.messages() / (kMECFrames * kMECRuns) << "/frame)"
+                  << " continue " << out.mContinues << " control " << out.mControls << std::endl;
+    }
+
+    struct Setting { int decimation; float threshold; };
+    const Setting settings[] = { {1, -1.f}, {1, 0.f}, {2, 0.f}, {2, 0.001f}, {4, 0.001f} };
+    unsigned long ons = 0;
+    for(const Setting& setting : settings)
+    {
+        CountingMECCallback out(setting.decimation);
+        MECOutputAdapter adapter;
+        adapter.output.setActive(true);
+        adapter.output.setDataFreq(kSoundplaneSampleRate / setting.decimation);
+        assert(adapter.output.getDecimation() == setting.decimation);
+        adapter.output.setChangeThreshold(setting.threshold);
+        adapter.output.connect(&out);
+        double cpu = replayMessages(adapter, msgs, kMECFrames, kMECRuns);
+        unsigned long sent = adapter.output.getUpdatesSent();
+        unsigned long suppressed = adapter.output.getUpdatesSuppressed();
+        std::cout << "mec output, decimation " << setting.decimation << " threshold " << setting.threshold
+                  << " cpu " << cpu << "us/frame"
+                  << " messages " << out.messages() << " (" << (double) out.messages() / (kMECFrames * kMECRuns) << "/frame)"
+                  << " continue " << out.mContinues << " control " << out.mControls
+                  << " sent " << sent << " suppressed " << suppressed << std::endl;
+
+        // every touch is turned on and off, whatever is suppressed between
+        assert(out.mFrames == (unsigned long) kMECFrames * kMECRuns);
+        assert(out.mOns > 0);
+        assert(out.mOns == out.mOffs);
+        if(ons == 0) ons = out.mOns;
+        assert(out.mOns == ons);
+        assert(sent == out.mContinues + out.mControls);
+        if(setting.threshold < 0.f && setting.decimation == 1) assert(suppressed == 0);
+        else assert(suppressed > 0);
+
+        // deterministic, whatever the replay speed
+        adapter.output.resetCounters();
+        assert(adapter.output.getUpdatesSent() == 0);
+        CountingMECCallback again(setting.decimation);
+        adapter.output.connect(&again);
+        replayMessages(adapter, msgs, kMECFrames, 1);
+        assert(again.messages() * kMECRuns == out.messages());
+        adapter.output.connect(nullptr);
+    }
+}
+
+} // namespace
+
+int main(int argc, const char * argv[])
+{
+    std::cout << "modeltest started" << std::endl;
+
+    checkBindings();
+
+    // without a device attached, the model's own driver just waits, frames are fed directly
+    SoundplaneModel model;
+    model.initialize();
+    InertSoundplaneDriver driver;
+    setupModel(model);
+
+    // model parameters read by the frame path follow property changes
+    model.setPropertyImmediate("hysteresis", 0.25f);
+    assert(model.getFloatProperty("hysteresis") == 0.25f);
+
+    std::vector<MLSignal> frames;
+    makeFrames(frames, kFrames);
+
+    // warm up. the model's infrequent tasks set carriers (disabling output) and try to calibrate,
+    // which does nothing without a device, so output is enabled again afterwards
+    replayFrames(model, driver, frames);
+    double best = 0.;
+    for(int r = 0; r < kRuns; ++r)
+    {
+        model.enableOutput(true);
+        double t = replayFrames(model, driver, frames);
+        if(r == 0 || t < best) best = t;
+    }
+    std::cout << "receivedFrame frames " << kFrames << " " << best << "us/frame" << std::endl;
+
+    checkFrameFiles(frames);
+
+    // replayed from file, including device sync and calibration
+    auto recording = std::make_shared<SoundplaneFrameReader>();
+    recording->setFrameLength(kSoundplaneWidth * kSoundplaneHeight);
+    for(const MLSignal& frame : frames)
+    {
+        recording->addFrame(frame.getConstBuffer());
+    }
+    const char* recordFile = "modeltest_record.spfr";
+    replayModel(recording, recordFile);
+    SoundplaneFrameReader recorded;
+    bool loaded = recorded.load(recordFile);
+    assert(loaded);
+    assert(recorded.getFrameCount() == kFrames);
+    assert(memcmp(recorded.getFrame(0), recording->getFrame(0),
+        sizeof(float) * kFrames * recording->getFrameLength()) == 0);
+    remove(recordFile);
+
+    double replay = 0.;
+    for(int r = 0; r < kRuns; ++r)
+    {
+        double t = replayModel(recording, nullptr);
+        if(r == 0 || t < replay) replay = t;
+    }
+    std::cout << "replay, full chain, frames " << kFrames << " " << replay << "us/frame"
+              << " (" << (int) (1000000. / replay) << " frames/s)" << std::endl;
+
+    benchmarkMEC();
+
+    // same parameter set size as the model, so lookups cost the same
+    MLPropertySet params;
+    for(int i = 0; i < 64; ++i)
+    {
+        params.setProperty(MLSymbol("param").withFinalNumber(i), (float)i);
+    }
+    params.setProperty("z_scale", 0.7f);
+    params.setProperty("z_curve", 0.25f);
+    params.setProperty("max_touches", 8);
+    params.setProperty("hysteresis", 0.5f);
+
+    double lookup = 0., bound = 0.;
+    for(int r = 0; r < kRuns; ++r)
+    {
+        double t = lookupReads(params, kFrames * 10);
+        if(r == 0 || t < lookup) lookup = t;
+        t = boundReads(params, kFrames * 10);
+        if(r == 0 || t < bound) bound = t;
+    }
+    std::cout << "per frame parameter reads, lookup " << lookup << "us bound " << bound << "us" << std::endl;
+
+    std::cout << "modeltest completed" << std::endl;
+    return 0;
+}
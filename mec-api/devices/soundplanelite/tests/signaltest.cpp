@@ -0,0 +1,260 @@
+// checks MLSignal kernels (SIMD where built with ML_USE_SSE / ML_USE_NEON) against
+// plain scalar loops, then times each kernel on a Soundplane sized (64x8) signal
+
+#include <iostream>
+#include <chrono>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+
+#include "MLSignal.h"
+
+namespace {
+
+const int kWidth = 64;
+const int kHeight = 8;
+const int kIterations = 100000;
+
+// kernels sum in the same order as the scalar code, but -ffast-math may reassociate 
+// either side, and NEON flushes denormals, so allow rounding error relative to the inputs (~1)
+bool close(float a, float b)
+{
+	return std::fabs(a - b) <= 1e-6f * max(1.f, std::fabs(b));
+}
+
+void randomize(MLSignal& s)
+{
+	for(int j = 0; j < s.getHeight(); ++j)
+	{
+		for(int i = 0; i < s.getWidth(); ++i)
+		{
+			s(i, j) = ((float)std::rand() / (float)RAND_MAX) * 2.f - 1.f;
+		}
+	}
+}
+
+void checkSame(const MLSignal& a, const MLSignal& b, const char* name)
+{
+	for(int j = 0; j < a.getHeight(); ++j)
+	{
+		for(int i = 0; i < a.getWidth(); ++i)
+		{
+			if(!close(a(i, j), b(i, j)))
+			{
+				std::cout << name << " mismatch at " << i << "," << j << " : " << a(i, j) << " != " << b(i, j) << std::endl;
+				assert(false);
+			}
+		}
+	}
+}
+
+// reference, scalar versions of the kernels
+// not inlined, so they are timed on the same terms as the MLSignal methods
+#define REF_KERNEL __attribute__((noinline))
+
+// MLSignal::convolve3x3r before vectorization
+REF_KERNEL void refConvolve3x3r(MLSignal& sig, const MLSample kc, const MLSample ke, const MLSample kk)
+{
+	int i, j;
+    float f;
+    float * pr1, * pr2, * pr3; // input row ptrs
+    float * prOut; 	
+	
+	static MLSignal copy(kWidth, kHeight); // as getCopy(), reuses a buffer
+	copy.copy(sig);
+	MLSample* pIn = copy.getBuffer();
+	MLSample* pOut = sig.getBuffer();
+	int width = sig.getWidth();
+	int height = sig.getHeight();
+	
+	j = 0;	// top row
+	{
+		// row ptrs
+		pr2 = (pIn + sig.row(j));
+		pr3 = (pIn + sig.row(j + 1));
+		prOut = (pOut + sig.row(j));
+		
+		i = 0; // top left corner
+		{
+			f = ke * (pr2[i+1] + pr3[i]);
+			f += kk * (pr3[i+1]);
+			f += kc * pr2[i];
+			prOut[i] = f;		
+		}
+			
+		for(i = 1; i < width - 1; i++) // top side
+		{
+			f = ke * (pr2[i-1] + pr2[i+1] + pr3[i]);
+			f += kk * (pr3[i-1] + pr3[i+1]);
+			f += kc * pr2[i];
+			prOut[i] = f;
+		}
+		
+		i = width - 1; // top right corner
+		{
+			f = ke * (pr2[i-1] + pr3[i]);
+			f += kk * (pr3[i-1]);
+			f += kc * pr2[i];
+			prOut[i] = f;		
+		}
+	}
+	for(j = 1; j < height - 1; j++) // center rows
+	{
+		// row ptrs
+		pr1 = (pIn + sig.row(j - 1));
+		pr2 = (pIn + sig.row(j));
+		pr3 = (pIn + sig.row(j + 1));
+		prOut = (pOut + sig.row(j));
+		
+		i = 0; // left side
+		{
+			f = ke * (pr1[i] + pr2[i+1] + pr3[i]);
+			f += kk * (pr1[i+1] + pr3[i+1]);
+			f += kc * pr2[i];
+			prOut[i] = f;		
+		}
+			
+		for(i = 1; i < width - 1; i++) // center
+		{
+			f = ke * (pr2[i-1] + pr1[i] + pr2[i+1] + pr3[i]);
+			f += kk * (pr1[i-1] + pr1[i+1] + pr3[i-1] + pr3[i+1]);
+			f += kc * pr2[i];
+			prOut[i] = f;
+		}
+		
+		i = width - 1; // right side
+		{
+			f = ke * (pr2[i-1] + pr1[i] + pr3[i]);
+			f += kk * (pr1[i-1] + pr3[i-1]);
+			f += kc * pr2[i];
+			prOut[i] = f;		
+		}
+	}
+	j = height - 1;	// bottom row
+	{
+		// row ptrs
+		pr1 = (pIn + sig.row(j - 1));
+		pr2 = (pIn + sig.row(j));
+		prOut = (pOut + sig.row(j));
+		
+		i = 0; // bottom left corner
+		{
+			f = ke * (pr1[i] + pr2[i+1]);
+			f += kk * (pr1[i+1]);
+			f += kc * pr2[i];
+			prOut[i] = f;		
+		}
+			
+		for(i = 1; i < width - 1; i++) // bottom side
+		{
+			f = ke * (pr2[i-1] + pr1[i] + pr2[i+1]);
+			f += kk * (pr1[i-1] + pr1[i+1]);
+			f += kc * pr2[i];
+			prOut[i] = f;
+		}
+		
+		i = width - 1; // bottom right corner
+		{
+			f = ke * (pr2[i-1] + pr1[i]);
+			f += kk * (pr1[i-1]);
+			f += kc * pr2[i];
+			prOut[i] = f;		
+		}
+	}
+}
+
+
+// element-wise ops as the original loops, over the whole buffer
+#define REF_LOOP(expr) \
+	float* pa = a.getBuffer(); \
+	for(int i = 0; i < a.getSize(); ++i) { expr; }
+
+REF_KERNEL void refAdd(MLSignal& a, const MLSignal& b) { const float* pb = b.getConstBuffer(); REF_LOOP(pa[i] += pb[i]) }
+REF_KERNEL void refSubtract(MLSignal& a, const MLSignal& b) { const float* pb = b.getConstBuffer(); REF_LOOP(pa[i] -= pb[i]) }
+REF_KERNEL void refMultiply(MLSignal& a, const MLSignal& b) { const float* pb = b.getConstBuffer(); REF_LOOP(pa[i] *= pb[i]) }
+REF_KERNEL void refScale(MLSignal& a, const MLSample k) { REF_LOOP(pa[i] *= k) }
+REF_KERNEL void refAdd(MLSignal& a, const MLSample k) { REF_LOOP(pa[i] += k) }
+REF_KERNEL void refSigMax(MLSignal& a, const MLSample k) { REF_LOOP(pa[i] = max(pa[i], k)) }
+REF_KERNEL void refSigMax(MLSignal& a, const MLSignal& b) { const float* pb = b.getConstBuffer(); REF_LOOP(pa[i] = max(pa[i], pb[i])) }
+REF_KERNEL void refSigMin(MLSignal& a, const MLSample k) { REF_LOOP(pa[i] = min(pa[i], k)) }
+
+// best of several runs, the first also warms caches
+template <class Fn>
+double timeIt(MLSignal& sig, Fn fn)
+{
+	const int kRuns = 5;
+	double best = 0.;
+	for(int r = 0; r < kRuns; ++r)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for(int n = 0; n < kIterations / kRuns; ++n)
+		{
+			fn(sig);
+		}
+		auto end = std::chrono::steady_clock::now();
+		double t = std::chrono::duration<double, std::nano>(end - start).count() / (kIterations / kRuns);
+		if(r == 0 || t < best) best = t;
+	}
+	return best;
+}
+
+template <class RefFn, class SigFn>
+void compare(const char* name, RefFn ref, SigFn fn)
+{
+	MLSignal a(kWidth, kHeight), b(kWidth, kHeight);
+	randomize(a);
+	b = a;
+	ref(a);
+	fn(b);
+	checkSame(a, b, name);
+
+	// keep values bounded over many iterations
+	randomize(a);
+	b = a;
+	double tRef = timeIt(a, ref);
+	double tSig = timeIt(b, fn);
+	std::cout << std::setw(14) << name << " scalar " << std::setw(8) << tRef << "ns"
+		<< "  MLSignal " << std::setw(8) << tSig << "ns"
+		<< "  x" << (tRef / tSig) << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::cout << "test started" << std::endl;
+
+	MLSignal other(kWidth, kHeight);
+	randomize(other);
+
+	const MLSample kc = 4., ke = 2., kk = 1.;
+	const MLSample kNorm = 1.f / 16.f;
+
+	compare("convolve3x3r",
+		[&](MLSignal& s) { refConvolve3x3r(s, kc * kNorm, ke * kNorm, kk * kNorm); },
+		[&](MLSignal& s) { s.convolve3x3r(kc * kNorm, ke * kNorm, kk * kNorm); });
+	compare("add",
+		[&](MLSignal& s) { refAdd(s, other); refSubtract(s, other); },
+		[&](MLSignal& s) { s.add(other); s.subtract(other); });
+	compare("multiply",
+		[&](MLSignal& s) { refMultiply(s, other); },
+		[&](MLSignal& s) { s.multiply(other); });
+	compare("scale",
+		[&](MLSignal& s) { refScale(s, 0.999f); },
+		[&](MLSignal& s) { s.scale(0.999f); });
+	compare("add k",
+		[&](MLSignal& s) { refAdd(s, 0.001f); refAdd(s, -0.001f); },
+		[&](MLSignal& s) { s.add(0.001f); s.add(-0.001f); });
+	compare("sigMax k",
+		[&](MLSignal& s) { refSigMax(s, 0.f); },
+		[&](MLSignal& s) { s.sigMax(0.f); });
+	compare("sigMax",
+		[&](MLSignal& s) { refSigMax(s, other); },
+		[&](MLSignal& s) { s.sigMax(other); });
+	compare("sigMin k",
+		[&](MLSignal& s) { refSigMin(s, 0.5f); },
+		[&](MLSignal& s) { s.sigMin(0.5f); });
+
+	std::cout << "test completed" << std::endl;
+	return 0;
+}
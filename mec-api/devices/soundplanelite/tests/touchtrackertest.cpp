@@ -5,9 +5,14 @@
 #include <signal.h>
 
 #include <iomanip>
+#include <memory>
 #include <string.h>
+#include <cmath>
+#include <vector>
 
 #include <SoundplaneDriver.h>
+#include "ReplaySoundplaneDriver.h"
+#include "SoundplaneFrameFile.h"
 #include "SoundplaneModelA.h"
 #include "MLSignal.h"
 #include "TouchTracker.h"
@@ -18,7 +23,8 @@ const int kMaxTouch = 8;
 class TouchTrackerTest : public SoundplaneDriverListener
 {
 public:
-    TouchTrackerTest() : 
+    TouchTrackerTest(bool verbose = true) :
+        mVerbose(verbose),
         mTracker(kSoundplaneWidth,kSoundplaneHeight),
         mSurface(kSoundplaneWidth, kSoundplaneHeight),
         mCalibration(kSoundplaneWidth, kSoundplaneHeight),
@@ -64,9 +70,11 @@ public:
             memcpy(mCalibration.getBuffer(), data, sizeof(float) * size);
             mHasCalibration = true;
             mTracker.setCalibration(mCalibration);
-            std::cout << "calibration\n";
-            mCalibration.dumpASCII(std::cout);
-            std::cout << "============\n";
+            if (mVerbose) {
+                std::cout << "calibration\n";
+                mCalibration.dumpASCII(std::cout);
+                std::cout << "============\n";
+            }
 
 //            mTracker.setDefaultNormalizeMap(); // ?
         }
@@ -81,7 +89,7 @@ public:
             mTracker.setOutputSignal(&mTouchFrame);
             mTracker.process(1);
 
-            if (mFrameCounter == 0) {
+            if (mFrameCounter == 0 && mVerbose) {
                 mTest.scale(100.f);
                 mTest.flipVertical();
 
@@ -97,6 +105,7 @@ public:
     }
 
 private:
+    bool mVerbose;
     int mFrameCounter = 0;
     bool mHasCalibration = false;
     MLSignal mTest;
@@ -106,6 +115,164 @@ private:
     TouchTracker mTracker;
 };
 
+// throughput mode: replays frames through the tracker without a device
+// frames are synthesised: a few touches moving across the surface, with some noise
+void makeFrames(std::vector<MLSignal>& frames, int count)
+{
+    const int kTouches = 4;
+    frames.resize(count);
+    for(int f = 0; f < count; ++f)
+    {
+        MLSignal& sig = frames[f];
+        sig.setDims(kSoundplaneWidth, kSoundplaneHeight);
+        for(int j = 0; j < kSoundplaneHeight; ++j)
+        {
+            for(int i = 0; i < kSoundplaneWidth; ++i)
+            {
+                sig(i, j) = 0.0005f * (float)((i * 7 + j * 13 + f * 3) % 11);
+            }
+        }
+        for(int t = 0; t < kTouches; ++t)
+        {
+            // each touch presses for 400 frames, then lifts for 100
+            int phase = (f + t * 125) % 500;
+            if(phase >= 400) continue;
+            float z = 0.1f * std::sin(3.14159f * (float)phase / 400.f);
+            float cx = 4.f + t * 14.f + 6.f * std::sin((float)f * 0.002f + t);
+            float cy = 1.5f + (float)(t % 3) * 2.f;
+            for(int j = 0; j < kSoundplaneHeight; ++j)
+            {
+                for(int i = 0; i < kSoundplaneWidth; ++i)
+                {
+                    float dx = (float)i - cx, dy = (float)j - cy;
+                    sig(i, j) += z * std::exp(-(dx * dx + dy * dy) * 0.5f);
+                }
+            }
+        }
+    }
+}
+
+// returns mean time per frame in microseconds
+double replayFrames(const std::vector<MLSignal>& frames, bool debugView)
+{
+    TouchTracker tracker(kSoundplaneWidth, kSoundplaneHeight);
+    tracker.setSampleRate(kSoundplaneSampleRate);
+    tracker.setMaxTouches(kMaxTouch);
+    tracker.setLopass(100);
+    tracker.setThresh(0.005000);
+    tracker.setZScale(0.700000);
+    tracker.setForceCurve(0.250000);
+    tracker.setTemplateThresh(0.279104);
+    tracker.setBackgroundFilter(0.050000);
+    tracker.setQuantize(1);
+    tracker.setRotate(0);
+    tracker.setDebugView(debugView);
+
+    MLSignal in(kSoundplaneWidth, kSoundplaneHeight);
+    MLSignal touchFrame;
+    touchFrame.setDims(kTouchWidth, kSoundplaneMaxTouches);
+    tracker.setInputSignal(&in);
+    tracker.setOutputSignal(&touchFrame);
+
+    auto start = std::chrono::steady_clock::now();
+    for(const MLSignal& frame : frames)
+    {
+        in.copy(frame);
+        tracker.process(1);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / frames.size();
+}
+
+// frames from a recording, the first frame is taken as calibration (as TouchTrackerTest does)
+bool loadFrames(std::vector<MLSignal>& frames, const std::string& file)
+{
+    SoundplaneFrameReader reader;
+    if (!reader.load(file) || reader.getFrameLength() != kSoundplaneWidth * kSoundplaneHeight || reader.getFrameCount() < 2)
+    {
+        std::cerr << "unable to load frames from " << file << std::endl;
+        return false;
+    }
+    MLSignal calibration(kSoundplaneWidth, kSoundplaneHeight);
+    memcpy(calibration.getBuffer(), reader.getFrame(0), sizeof(float) * reader.getFrameLength());
+    frames.resize(reader.getFrameCount() - 1);
+    for(int f = 1; f < reader.getFrameCount(); ++f)
+    {
+        MLSignal& sig = frames[f - 1];
+        sig.setDims(kSoundplaneWidth, kSoundplaneHeight);
+        memcpy(sig.getBuffer(), reader.getFrame(f), sizeof(float) * reader.getFrameLength());
+        sig.subtract(calibration);
+    }
+    return true;
+}
+
+// frame count, or a recorded frame file
+int throughput(const char* source)
+{
+    std::vector<MLSignal> frames;
+    int count = source ? atoi(source) : 10000;
+    if (count <= 0)
+    {
+        if (!loadFrames(frames, source)) return -1;
+        count = static_cast<int>(frames.size());
+    }
+    else
+    {
+        makeFrames(frames, count);
+    }
+
+    // warm up, then alternate so both settings see the same conditions, best of several runs
+    replayFrames(frames, false);
+    double off = 0., on = 0.;
+    const int kRuns = 5;
+    for(int r = 0; r < kRuns; ++r)
+    {
+        double t = replayFrames(frames, false);
+        if(r == 0 || t < off) off = t;
+        t = replayFrames(frames, true);
+        if(r == 0 || t < on) on = t;
+    }
+    std::cout << "frames " << count
+              << " debug view off " << off << "us/frame (" << (int) (1000000. / off) << " frames/s)"
+              << " on " << on << "us/frame (" << (int) (1000000. / on) << " frames/s)" << std::endl;
+    return 0;
+}
+
+// records raw frames from the device, until interrupted or for the given time
+class RecordListener : public TouchTrackerTest
+{
+public:
+    RecordListener(SoundplaneFrameRecorder& recorder) : mRecorder(recorder) {}
+
+    virtual void receivedFrame(SoundplaneDriver& driver, const float* data, int size) override {
+        mRecorder.write(data, size);
+        TouchTrackerTest::receivedFrame(driver, data, size);
+    }
+
+private:
+    SoundplaneFrameRecorder& mRecorder;
+};
+
+// synthetic frames to a file, so replay can be tried without ever having a device
+int writeSynthetic(const char* file, int count)
+{
+    std::vector<MLSignal> frames;
+    makeFrames(frames, count);
+    SoundplaneFrameReader writer;
+    writer.setFrameLength(kSoundplaneWidth * kSoundplaneHeight);
+    for(const MLSignal& frame : frames)
+    {
+        writer.addFrame(frame.getConstBuffer());
+    }
+    if (!writer.save(file))
+    {
+        std::cerr << "unable to write " << file << std::endl;
+        return -1;
+    }
+    std::cout << "wrote " << count << " frames to " << file << std::endl;
+    return 0;
+}
+
 } // namespace
 
 static volatile int keepRunning = 1;
@@ -118,20 +285,69 @@ void intHandler(int dummy) {
     keepRunning = 0;
 }
         
+// usage
+//  touchtrackertest                              : live, from the device
+//  touchtrackertest --throughput [count | file]  : tracker only, synthetic or recorded frames, as fast as possible
+//  touchtrackertest --record file [seconds]      : record raw frames from the device
+//  touchtrackertest --replay file [rate]         : as live, but from a recording, rate 0 is as fast as possible
+//  touchtrackertest --synthetic file [count]     : write synthetic frames, for --replay
 int main(int argc, const char * argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--throughput") == 0) {
+        return throughput(argc > 2 ? argv[2] : nullptr);
+    }
+    if (argc > 2 && strcmp(argv[1], "--synthetic") == 0) {
+        return writeSynthetic(argv[2], argc > 3 ? atoi(argv[3]) : 10000);
+    }
+
     signal(SIGINT, intHandler);
 
-    TouchTrackerTest listener;
+    if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+        auto frames = std::make_shared<SoundplaneFrameReader>();
+        if (!frames->load(argv[2])) {
+            std::cerr << "unable to load frames from " << argv[2] << std::endl;
+            return -1;
+        }
+        float rate = argc > 3 ? (float) atof(argv[3]) : kSoundplaneSampleRate;
+        TouchTrackerTest listener(rate > 0.f);
+        auto start = std::chrono::steady_clock::now();
+        {
+            ReplaySoundplaneDriver driver(&listener, frames, rate);
+            driver.init();
+            while(keepRunning && !driver.waitUntilFinished(100)) {
+                ;
+            }
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "replayed " << frames->getFrameCount() << " frames in " << secs << "s"
+                  << " (" << (int) (frames->getFrameCount() / secs) << " frames/s)" << std::endl;
+        return 0;
+    }
+
+    SoundplaneFrameRecorder recorder;
+    int seconds = 0;
+    if (argc > 2 && strcmp(argv[1], "--record") == 0) {
+        if (!recorder.open(argv[2])) {
+            std::cerr << "unable to record to " << argv[2] << std::endl;
+            return -1;
+        }
+        seconds = argc > 3 ? atoi(argv[3]) : 0;
+    }
+
+    RecordListener listener(recorder);
     auto driver = SoundplaneDriver::create(&listener);
 
     std::cout << "TouchTrackerTest\n";
     std::cout << "Initial device state: " << driver->getDeviceState() << std::endl;
 
-    while(keepRunning) {
+    for(int t = 0; keepRunning && (seconds == 0 || t < seconds); ++t) {
         sleep(1);
     }
     delete driver.release();
 
+    if (recorder.isOpen()) {
+        std::cout << "recorded " << recorder.getFramesWritten() << " frames" << std::endl;
+        recorder.close();
+    }
 
     return 0;
 }
@@ -3,7 +3,15 @@
 
 #include "mec_prefs.h"
 #include "mec_device.h"
+#include "mec_device_factory.h"
+#include "mec_device_thread.h"
+#include "mec_latency.h"
 #include "mec_log.h"
+#include "mec_notifier.h"
+
+#include <algorithm>
+#include <cctype>
+#include <set>
 
 #ifndef WIN32
 #include "devices/mec_eigenharp.h"
@@ -14,6 +22,7 @@
 #include "devices/mec_mididevice.h"
 #include "devices/mec_osct3d.h"
 #include "devices/mec_kontroldevice.h"
+#include "devices/mec_replay.h"
 
 namespace mec {
 
@@ -27,6 +36,14 @@ public:
     void init();
     void process();  // periodically call to process messages
 
+    bool waitForWork(unsigned timeoutMs);
+    void wakeup();
+
+    bool attachDevice(const std::string &name);
+    bool detachDevice(const std::string &name);
+    unsigned rescanDevices();
+    std::vector<std::string> devices();
+
     void subscribe(ICallback *);
     void unsubscribe(ICallback *);
 
@@ -44,6 +61,7 @@ public:
     virtual void touchOff(int touchId, float note, float x, float y, float z);
     virtual void control(int ctrlId, float v);
     virtual void mec_control(int cmd, void *other);
+    virtual void touchFrame(const MsgSpan &msgs);
 
     virtual void touchOn(const Touch &);
     virtual void touchContinue(const Touch &);
@@ -54,14 +72,42 @@ public:
     virtual void touchOff(const MusicalTouch &);
 
 private:
+    // a started device, a named instance of a device type (see DeviceRegistry)
+    struct DeviceInstance {
+        std::string name_;
+        std::string type_;
+        std::shared_ptr<Device> device_;
+        std::unique_ptr<DeviceThread> thread_; // null if processed by the thread calling process()
+        bool polled_;                          // processed by process(), but does not signal the notifier
+    };
+
+    static void registerDevices();
     void initDevices();
-
-    std::vector<std::shared_ptr<Device>> devices_;
+    std::string deviceType(const std::string &name);
+    std::vector<std::string> deviceKeys();
+    bool isThreaded(const std::string &name);
+    ICallback &deviceCallback(const std::string &name);
+    std::vector<DeviceInstance>::iterator findDevice(const std::string &name);
+    void stopDevice(DeviceInstance &);
+    void updatePolling();
+    void logLatency();
+
+    std::vector<DeviceInstance> devices_;
+    std::set<std::string> detached_; // detached by the application, so not restarted by a rescan
+    std::unique_ptr<MergeCallback> merge_; // output stage for device threads
     std::unique_ptr<Preferences> fileprefs_; // top level prefs on file
     std::unique_ptr<Preferences> prefs_;     // api prefs
     std::vector<ICallback *> callbacks_;
     std::vector<ISurfaceCallback *> surfaces_;
     std::vector<IMusicalCallback *> musicalsurfaces_;
+
+    Notifier notifier_;
+    bool pollRequired_;     // at least one device needs process() to be called periodically
+    unsigned pollInterval_; // ms
+    uint64_t latencyLogInterval_; // ns, 0 = no log
+    uint64_t latencyLogNext_;
+    std::chrono::milliseconds rescanInterval_; // 0 = no periodic rescan
+    std::chrono::steady_clock::time_point rescanNext_;
 };
 
 
@@ -90,6 +136,30 @@ void MecApi::process() {
     impl_->process();
 }
 
+bool MecApi::waitForWork(unsigned timeoutMs) {
+    return impl_->waitForWork(timeoutMs);
+}
+
+void MecApi::wakeup() {
+    impl_->wakeup();
+}
+
+bool MecApi::attachDevice(const std::string &name) {
+    return impl_->attachDevice(name);
+}
+
+bool MecApi::detachDevice(const std::string &name) {
+    return impl_->detachDevice(name);
+}
+
+unsigned MecApi::rescanDevices() {
+    return impl_->rescanDevices();
+}
+
+std::vector<std::string> MecApi::devices() {
+    return impl_->devices();
+}
+
 void MecApi::subscribe(ICallback *p) {
     impl_->subscribe(p);
 
@@ -120,21 +190,30 @@ void MecApi::unsubscribe(IMusicalCallback *p) {
 
 /////////////////////////////////////////////////////////
 //MecApi_Impl
-MecApi_Impl::MecApi_Impl(void *prefs) {
+MecApi_Impl::MecApi_Impl(void *prefs) :
+    pollRequired_(false), pollInterval_(5), latencyLogInterval_(0), latencyLogNext_(0), rescanInterval_(0) {
+    registerDevices();
     fileprefs_.reset(new Preferences(prefs));
     prefs_.reset(new Preferences(fileprefs_->getSubTree("mec")));
 }
 
-MecApi_Impl::MecApi_Impl(const std::string &configFile) {
+MecApi_Impl::MecApi_Impl(const std::string &configFile) :
+    pollRequired_(false), pollInterval_(5), latencyLogInterval_(0), latencyLogNext_(0), rescanInterval_(0) {
+    registerDevices();
     fileprefs_.reset(new Preferences(configFile));
     prefs_.reset(new Preferences(fileprefs_->getSubTree("mec")));
 }
 
 MecApi_Impl::~MecApi_Impl() {
     LOG_1("MecApi_Impl::~MecApi_Impl");
-    for (std::vector<std::shared_ptr<Device>>::iterator it = devices_.begin(); it != devices_.end(); ++it) {
-        LOG_1("device deinit ");
-        (*it)->deinit();
+    for (std::vector<DeviceInstance>::iterator it = devices_.begin(); it != devices_.end(); ++it) {
+        if (it->thread_) it->thread_->stop();
+        it->device_->setNotifier(nullptr);
+    }
+    if (merge_) merge_->queue().setNotifier(nullptr);
+    for (std::vector<DeviceInstance>::iterator it = devices_.begin(); it != devices_.end(); ++it) {
+        LOG_1("device deinit " << it->name_);
+        stopDevice(*it);
     }
     devices_.clear();
     LOG_1("devices cleared");
@@ -144,15 +223,73 @@ MecApi_Impl::~MecApi_Impl() {
 
 void MecApi_Impl::init() {
     LOG_1("MecApi_Impl::init");
+
+    if (prefs_ != nullptr) {
+        pollInterval_ = static_cast<unsigned>(prefs_->getInt("poll interval", 5));
+
+        // see DeviceThread, devices run on their own threads, unless their preferences have "thread" : false
+        if (prefs_->getBool("device threads", false)) {
+            unsigned size = static_cast<unsigned>(prefs_->getInt("merge queue size", MergeCallback::DEFAULT_SIZE));
+            merge_.reset(new MergeCallback(size));
+            merge_->queue().setNotifier(&notifier_);
+        }
+
+        // see mec_latency.h, if not configured, leave as is, so an application can enable it
+        if (prefs_->exists("latency stats")) {
+            Latency::enable(prefs_->getBool("latency stats", false));
+            Latency::reset();
+        }
+        latencyLogInterval_ = static_cast<uint64_t>(prefs_->getInt("latency log interval", 10000)) * 1000000ULL;
+        if (Latency::enabled()) {
+            LOG_1("MecApi_Impl::init - latency stats enabled, log interval " << latencyLogInterval_ / 1000000 << "ms");
+        }
+
+        // restart devices which have been (re)connected, and remove those which have gone inactive
+        rescanInterval_ = std::chrono::milliseconds(prefs_->getInt("rescan interval", 0));
+        rescanNext_ = std::chrono::steady_clock::now() + rescanInterval_;
+    }
+
     initDevices();
+    if (pollRequired_) {
+        LOG_1("MecApi_Impl::init - device requires polling, poll interval " << pollInterval_ << "ms");
+    }
 }
 
 void MecApi_Impl::process() {
-    for (std::vector<std::shared_ptr<Device>>::iterator it = devices_.begin(); it != devices_.end(); ++it) {
-        (*it)->process();
+    for (std::vector<DeviceInstance>::iterator it = devices_.begin(); it != devices_.end(); ++it) {
+        if (!it->thread_) it->device_->process();
+    }
+    if (merge_) merge_->queue().process(*this);
+    if (latencyLogInterval_ > 0 && Latency::enabled()) logLatency();
+    if (rescanInterval_.count() > 0 && std::chrono::steady_clock::now() >= rescanNext_) {
+        rescanDevices();
+        rescanNext_ = std::chrono::steady_clock::now() + rescanInterval_;
+    }
+}
+
+void MecApi_Impl::logLatency() {
+    uint64_t now = Latency::now();
+    if (latencyLogNext_ == 0) {
+        latencyLogNext_ = now + latencyLogInterval_;
+    } else if (now >= latencyLogNext_) {
+        // nothing to report when idle
+        if (Latency::histogram(Latency::TOTAL).count() > 0) {
+            LOG_0(Latency::report());
+            Latency::reset();
+        }
+        latencyLogNext_ = now + latencyLogInterval_;
     }
 }
 
+bool MecApi_Impl::waitForWork(unsigned timeoutMs) {
+    unsigned t = pollRequired_ ? std::min(timeoutMs, pollInterval_) : timeoutMs;
+    return notifier_.wait(std::chrono::milliseconds(t));
+}
+
+void MecApi_Impl::wakeup() {
+    notifier_.notify();
+}
+
 void MecApi_Impl::subscribe(ICallback *p) {
     callbacks_.push_back(p);
 }
@@ -223,6 +360,13 @@ void MecApi_Impl::mec_control(int cmd, void *other) {
     }
 }
 
+void MecApi_Impl::touchFrame(const MsgSpan &msgs) {
+    // pass the whole frame on, rather than fanning out each message
+    for (std::vector<ICallback *>::iterator it = callbacks_.begin(); it != callbacks_.end(); ++it) {
+        (*it)->touchFrame(msgs);
+    }
+}
+
 
 void MecApi_Impl::touchOn(const Touch &t) {
     for (std::vector<ISurfaceCallback *>::iterator it = surfaces_.begin(); it != surfaces_.end(); ++it) {
@@ -267,113 +411,219 @@ void MecApi_Impl::touchOff(const MusicalTouch &t) {
 
 
 
-void MecApi_Impl::initDevices() {
-    if (fileprefs_ == nullptr || prefs_ == nullptr) {
-        LOG_1("MecApi_Impl :: invalid preferences file");
-        return;
+#ifndef WIN32
+// push2 is also a kontrol model listener, for the lifetime of the device
+class Push2Factory : public DeviceFactory {
+public:
+    std::shared_ptr<Device> create(const std::string &name, ICallback &cb) override {
+        std::shared_ptr<Push2> device = std::make_shared<Push2>(cb);
+        Kontrol::KontrolModel::model()->addCallback(name, device);
+        return device;
     }
 
+    void destroy(const std::string &name, std::shared_ptr<Device>) override {
+        Kontrol::KontrolModel::model()->removeCallback(name);
+    }
+};
+#endif
+
+// built in types start in this order, whatever the order of their keys, as before the registry
+static const char *const DEVICE_START_ORDER[] = {
+        "eigenharp", "soundplane", "push2", "midi", "osct3d", "replay", "kontrol"
+};
+
+// built in device types, types already registered (e.g. by the application) are left in place
+void MecApi_Impl::registerDevices() {
+    std::vector<std::pair<std::string, std::shared_ptr<DeviceFactory>>> factories = {
 #ifndef WIN32
-    if (prefs_->exists("eigenharp")) {
-        LOG_1("eigenharp initialise ");
-        std::shared_ptr<Device> device = std::make_shared<Eigenharp>(*this);
-        if (device->init(prefs_->getSubTree("eigenharp"))) {
-            if (device->isActive()) {
-                devices_.push_back(device);
-            } else {
-                LOG_1("eigenharp init inactive ");
-                device->deinit();
-            }
-        } else {
-            LOG_1("eigenharp init failed ");
-            device->deinit();
-        }
+            {"eigenharp",  std::make_shared<SimpleDeviceFactory<Eigenharp>>()},
+            {"soundplane", std::make_shared<SimpleDeviceFactory<Soundplane>>()},
+            {"push2",      std::make_shared<Push2Factory>()},
+#endif
+            {"midi",       std::make_shared<SimpleDeviceFactory<MidiDevice>>()},
+            {"osct3d",     std::make_shared<SimpleDeviceFactory<OscT3D>>()},
+            {"replay",     std::make_shared<SimpleDeviceFactory<ReplayDevice>>()},
+            {"kontrol",    std::make_shared<SimpleDeviceFactory<KontrolDevice>>()}
+    };
+    for (auto &f : factories) {
+        if (!DeviceRegistry::isRegistered(f.first)) DeviceRegistry::registerFactory(f.first, f.second);
     }
+}
 
-    if (prefs_->exists("soundplane")) {
-        LOG_1("soundplane initialise");
-        std::shared_ptr<Device> device = std::make_shared<Soundplane>(*this);
-        if (device->init(prefs_->getSubTree("soundplane"))) {
-            if (device->isActive()) {
-                devices_.push_back(device);
-                LOG_1("soundplane init active ");
-            } else {
-                LOG_1("soundplane init inactive ");
-                device->deinit();
-            }
-        } else {
-            LOG_1("soundplane init failed ");
-            device->deinit();
-        }
+// a device instance is a preferences key, of type given by its "type",
+// or if no type is given, the key itself in lower case (e.g. "soundplane", or "Kontrol" as kontrol),
+// as preference lookups ignore case
+// other keys (e.g. "mec") are not devices, and a leading '_' disables a device (e.g. "_soundplane")
+std::string MecApi_Impl::deviceType(const std::string &name) {
+    if (name.empty() || name[0] == '_') return "";
+    Preferences p(prefs_->getSubTree(name));
+    std::string key = name;
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    std::string type = p.getString("type", key);
+    if (!DeviceRegistry::isRegistered(type)) {
+        if (p.exists("type")) LOG_0("MecApi_Impl :: unknown device type " << type << " for " << name);
+        return "";
     }
+    return type;
+}
+
+// device keys in start order, built in types first (see DEVICE_START_ORDER), then others in key order
+std::vector<std::string> MecApi_Impl::deviceKeys() {
+    static const size_t nOrder = sizeof(DEVICE_START_ORDER) / sizeof(DEVICE_START_ORDER[0]);
+    std::vector<std::pair<size_t, std::string>> ranked;
+    std::vector<std::string> keys = prefs_->getKeys();
+    for (std::vector<std::string>::iterator it = keys.begin(); it != keys.end(); ++it) {
+        std::string type = deviceType(*it);
+        if (type.empty()) continue;
+        size_t rank = std::find(DEVICE_START_ORDER, DEVICE_START_ORDER + nOrder, type) - DEVICE_START_ORDER;
+        ranked.push_back(std::make_pair(rank, *it));
+    }
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](const std::pair<size_t, std::string> &a, const std::pair<size_t, std::string> &b) {
+                         return a.first < b.first;
+                     });
+    std::vector<std::string> names;
+    for (auto &r : ranked) names.push_back(r.second);
+    return names;
+}
 
-    if (prefs_->exists("push2")) {
-        LOG_1("push2 initialise ");
-        std::shared_ptr<Push2> device = std::make_shared<Push2>(*this);
-        Kontrol::KontrolModel::model()->addCallback("push2", device);
-        if (device->init(prefs_->getSubTree("push2"))) {
-            if (device->isActive()) {
-                devices_.push_back(device);
-            } else {
-                LOG_1("push2 init inactive ");
-                device->deinit();
-            }
-        } else {
-            LOG_1("push2 init failed ");
-            device->deinit();
-        }
+bool MecApi_Impl::isThreaded(const std::string &name) {
+    if (merge_ == nullptr) return false;
+    Preferences p(prefs_->getSubTree(name));
+    return p.getBool("thread", true);
+}
+
+ICallback &MecApi_Impl::deviceCallback(const std::string &name) {
+    if (isThreaded(name)) return *merge_;
+    return *this;
+}
+
+std::vector<MecApi_Impl::DeviceInstance>::iterator MecApi_Impl::findDevice(const std::string &name) {
+    return std::find_if(devices_.begin(), devices_.end(),
+                        [&name](const DeviceInstance &d) { return d.name_ == name; });
+}
+
+void MecApi_Impl::stopDevice(DeviceInstance &d) {
+    if (d.thread_) {
+        d.thread_->stop();
+        d.thread_.reset();
     }
-#endif
+    d.device_->setNotifier(nullptr);
+    d.device_->deinit();
+    std::shared_ptr<DeviceFactory> factory = DeviceRegistry::factory(d.type_);
+    if (factory) factory->destroy(d.name_, d.device_);
+}
 
-    if (prefs_->exists("midi")) {
-        LOG_1("midi initialise ");
-        std::shared_ptr<Device> device = std::make_shared<MidiDevice>(*this);
-        if (device->init(prefs_->getSubTree("midi"))) {
-            if (device->isActive()) {
-                devices_.push_back(device);
-            } else {
-                LOG_1("midi init inactive ");
-                device->deinit();
-            }
-        } else {
-            LOG_1("midi init failed ");
-            device->deinit();
-        }
+void MecApi_Impl::updatePolling() {
+    pollRequired_ = false;
+    for (std::vector<DeviceInstance>::iterator it = devices_.begin(); it != devices_.end(); ++it) {
+        if (it->polled_) pollRequired_ = true;
     }
+}
 
+void MecApi_Impl::initDevices() {
+    if (fileprefs_ == nullptr || prefs_ == nullptr) {
+        LOG_1("MecApi_Impl :: invalid preferences file");
+        return;
+    }
 
-    if (prefs_->exists("osct3d")) {
-        LOG_1("osct3d initialise ");
-        std::shared_ptr<Device> device = std::make_shared<OscT3D>(*this);
-        if (device->init(prefs_->getSubTree("osct3d"))) {
-            if (device->isActive()) {
-                devices_.push_back(device);
-            } else {
-                LOG_1("osct3d init inactive ");
-                device->deinit();
-            }
-        } else {
-            LOG_1("osct3d init failed ");
-            device->deinit();
-        }
+    std::vector<std::string> keys = deviceKeys();
+    for (std::vector<std::string>::iterator it = keys.begin(); it != keys.end(); ++it) {
+        attachDevice(*it);
     }
+}
 
-    if (prefs_->exists("kontrol")) {
-        LOG_1("KontrolDevice initialise ");
-        std::shared_ptr<Device> device = std::make_shared<KontrolDevice>(*this);
-        if (device->init(prefs_->getSubTree("Kontrol"))) {
-            if (device->isActive()) {
-                devices_.push_back(device);
-            } else {
-                LOG_1("KontrolDevice init inactive ");
-                device->deinit();
-            }
+bool MecApi_Impl::attachDevice(const std::string &name) {
+    if (prefs_ == nullptr) return false;
+    if (findDevice(name) != devices_.end()) return true;
+    detached_.erase(name);
+
+    std::string type = deviceType(name);
+    std::shared_ptr<DeviceFactory> factory = DeviceRegistry::factory(type);
+    if (type.empty() || factory == nullptr) {
+        LOG_0("MecApi_Impl :: no device type for " << name);
+        return false;
+    }
+
+    LOG_1(name << " initialise (" << type << ")");
+    std::shared_ptr<Device> device = factory->create(name, deviceCallback(name));
+    if (device == nullptr) {
+        LOG_1(name << " create failed ");
+        return false;
+    }
+    if (!device->init(prefs_->getSubTree(name))) {
+        LOG_1(name << " init failed ");
+        device->deinit();
+        factory->destroy(name, device);
+        return false;
+    }
+    if (!device->isActive()) {
+        LOG_1(name << " init inactive ");
+        device->deinit();
+        factory->destroy(name, device);
+        return false;
+    }
+    LOG_1(name << " init active ");
+
+    DeviceInstance d;
+    d.name_ = name;
+    d.type_ = type;
+    d.device_ = device;
+    d.polled_ = false;
+    if (isThreaded(name)) {
+        Preferences p(prefs_->getSubTree(name));
+        LOG_1("MecApi_Impl - starting device thread " << name);
+        d.thread_.reset(new DeviceThread(name, device, pollInterval_));
+        d.thread_->start(p.getInt("thread priority", 0), p.getInt("thread cpu", -1));
+    } else {
+        d.polled_ = !device->setNotifier(&notifier_);
+    }
+    devices_.push_back(std::move(d));
+    updatePolling();
+    return true;
+}
+
+bool MecApi_Impl::detachDevice(const std::string &name) {
+    std::vector<DeviceInstance>::iterator it = findDevice(name);
+    if (it == devices_.end()) return false;
+    LOG_1(name << " detach ");
+    stopDevice(*it);
+    devices_.erase(it);
+    detached_.insert(name);
+    updatePolling();
+    return true;
+}
+
+unsigned MecApi_Impl::rescanDevices() {
+    if (prefs_ == nullptr) return 0;
+
+    // remove devices which have gone inactive (e.g. unplugged), so they can be restarted
+    for (std::vector<DeviceInstance>::iterator it = devices_.begin(); it != devices_.end();) {
+        if (!it->device_->isActive()) {
+            LOG_1(it->name_ << " inactive, removing ");
+            stopDevice(*it);
+            it = devices_.erase(it);
         } else {
-            LOG_1("KontrolDevice init failed ");
-            device->deinit();
+            ++it;
         }
     }
+    updatePolling();
 
+    unsigned attached = 0;
+    std::vector<std::string> keys = deviceKeys();
+    for (std::vector<std::string>::iterator it = keys.begin(); it != keys.end(); ++it) {
+        if (findDevice(*it) != devices_.end() || detached_.count(*it) > 0) continue;
+        if (attachDevice(*it)) attached++;
+    }
+    return attached;
+}
+
+std::vector<std::string> MecApi_Impl::devices() {
+    std::vector<std::string> names;
+    for (std::vector<DeviceInstance>::iterator it = devices_.begin(); it != devices_.end(); ++it) {
+        names.push_back(it->name_);
+    }
+    return names;
 }
 
 }
@@ -2,7 +2,9 @@
 #define MEC_API_H
 
 #include <string>
+#include <vector>
 
+#include "mec_msg_queue.h"
 
 namespace mec {
 
@@ -20,6 +22,15 @@ public:
     virtual void touchOff(int touchId, float note, float x, float y, float z) = 0;
     virtual void control(int ctrlId, float v) = 0;
     virtual void mec_control(int cmd, void* other) = 0;
+
+    // all messages drained from a device in one go (typically a sensor frame)
+    // default calls the individual methods above for each message, override to process as a batch
+    virtual void touchFrame(const MsgSpan& msgs);
+
+    // sensor frame boundaries (FRAME_START/FRAME_END), a span may hold several frames, or none
+    // e.g. to coalesce updates per voice per frame, by default ignored
+    virtual void frameStart(unsigned frameId) {};
+    virtual void frameEnd(unsigned frameId) {};
 };
 
 class Callback : public ICallback {
@@ -38,7 +49,10 @@ public:
 
 
 
-typedef std::string SurfaceID;
+// surfaces are named in configuration, but resolved to small integers (see SurfaceManager)
+// so touches can be routed by array lookup
+typedef unsigned SurfaceID;
+static const SurfaceID INVALID_SURFACE = ~0U;
 
 
 // represents a single touch on a surface
@@ -51,8 +65,9 @@ typedef std::string SurfaceID;
 // touches originate from a device, and then are passed thru surfaces to allow there coordinates to be translated.
 // a simple exampe is a device surfaces may be 'split' into 2 halfs, a 'split surface' will take the device touches and translate into touches for that
 // split... to the application these touches will be the same as if they came from different devices
+// kept compact (28 bytes, 32 as MusicalTouch), so a touch fits in a cache line
 struct Touch {
-    Touch() {
+    Touch() : id_(-1), surface_(INVALID_SURFACE), x_(0.0f), y_(0.0f), z_(0.0f), r_(0.0f), c_(0.0f) {
         ;
     }
     Touch(int id, SurfaceID surface, float x, float y, float z, float r, float c) :
@@ -85,7 +100,7 @@ public:
 
 // a musical touch, is a touch that has been converted into a pitched note using a scaler
 struct MusicalTouch : public Touch {
-    MusicalTouch() {
+    MusicalTouch() : note_(0.0f) {
         ;
     }
 
@@ -115,6 +130,21 @@ public:
     void init();
     void process();  // periodically call to process messages
 
+    // alternative to polling, wait until a device has messages for process(), or timeout
+    // returns true if woken by a device (or wakeup), devices that have to be polled limit the wait to 'poll interval'
+    bool waitForWork(unsigned timeoutMs);
+    void wakeup();
+
+    // devices are named instances, keys in the preferences (see DeviceRegistry for the types)
+    // call from the thread calling process()
+    // attach: start a device from its preferences, detach: stop it, and leave it stopped until attached
+    // rescan: remove devices that have gone inactive (e.g. unplugged), and start those configured but not running,
+    // returns the number started. also done every 'rescan interval' ms by process(), if set
+    bool attachDevice(const std::string& name);
+    bool detachDevice(const std::string& name);
+    unsigned rescanDevices();
+    std::vector<std::string> devices(); // names of running devices
+
     void subscribe(ICallback*);
     void unsubscribe(ICallback*);
 
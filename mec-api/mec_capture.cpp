@@ -0,0 +1,481 @@
+#include "mec_capture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "mec_log.h"
+
+namespace mec {
+
+static const unsigned HEADER_SIZE = 16;
+static const unsigned FRAME_HEADER_SIZE = 6;
+
+//////////////////////////////////////////
+// little endian encoding, independent of host byte order and struct layout
+static void putU8(std::vector<uint8_t> &buf, uint8_t v) {
+    buf.push_back(v);
+}
+
+static void putU16(std::vector<uint8_t> &buf, uint16_t v) {
+    buf.push_back(static_cast<uint8_t>(v));
+    buf.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+static void putU32(std::vector<uint8_t> &buf, uint32_t v) {
+    buf.push_back(static_cast<uint8_t>(v));
+    buf.push_back(static_cast<uint8_t>(v >> 8));
+    buf.push_back(static_cast<uint8_t>(v >> 16));
+    buf.push_back(static_cast<uint8_t>(v >> 24));
+}
+
+static void putF32(std::vector<uint8_t> &buf, float f) {
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    putU32(buf, v);
+}
+
+// bounds checked reader, any read past the end marks the reader as failed
+class Reader {
+public:
+    Reader(const uint8_t *data, size_t size) : data_(data), size_(size), pos_(0), failed_(false) { ; }
+
+    uint8_t u8() {
+        if (!check(1)) return 0;
+        return data_[pos_++];
+    }
+
+    uint16_t u16() {
+        if (!check(2)) return 0;
+        uint16_t v = static_cast<uint16_t>(data_[pos_] | (data_[pos_ + 1] << 8));
+        pos_ += 2;
+        return v;
+    }
+
+    uint32_t u32() {
+        if (!check(4)) return 0;
+        uint32_t v = static_cast<uint32_t>(data_[pos_])
+                     | (static_cast<uint32_t>(data_[pos_ + 1]) << 8)
+                     | (static_cast<uint32_t>(data_[pos_ + 2]) << 16)
+                     | (static_cast<uint32_t>(data_[pos_ + 3]) << 24);
+        pos_ += 4;
+        return v;
+    }
+
+    float f32() {
+        uint32_t v = u32();
+        float f;
+        memcpy(&f, &v, sizeof(f));
+        return f;
+    }
+
+    bool failed() const { return failed_; }
+    bool atEnd() const { return pos_ == size_; }
+
+private:
+    bool check(size_t n) {
+        if (failed_ || size_ - pos_ < n) {
+            failed_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    const uint8_t *data_;
+    size_t size_;
+    size_t pos_;
+    bool failed_;
+};
+
+
+//////////////////////////////////////////
+// Capture
+void Capture::clear() {
+    frames_.clear();
+    msgs_.clear();
+}
+
+void Capture::reserve(unsigned frames, unsigned msgs) {
+    frames_.reserve(frames);
+    msgs_.reserve(msgs);
+}
+
+void Capture::addFrame(uint64_t timeUs, const MsgSpan &msgs) {
+    // frame markers are not stored, a capture frame is already the messages delivered together
+    // very large frames are split, so each fits the file format
+    Frame f;
+    f.time_ = frames_.empty() ? timeUs : std::max(timeUs, frames_.back().time_);
+    f.first_ = static_cast<unsigned>(msgs_.size());
+    f.count_ = 0;
+    for (const MecMsg &m : msgs) {
+        if (m.type_ == MecMsg::FRAME_START || m.type_ == MecMsg::FRAME_END) continue;
+        if (f.count_ == MAX_FRAME_MSGS) {
+            frames_.push_back(f);
+            f.first_ = static_cast<unsigned>(msgs_.size());
+            f.count_ = 0;
+        }
+        msgs_.push_back(m);
+        f.count_++;
+    }
+    if (f.count_ > 0) frames_.push_back(f);
+}
+
+void Capture::addFrame(uint64_t timeUs, const MecMsg &msg) {
+    addFrame(timeUs, MsgSpan(&msg, 1));
+}
+
+unsigned Capture::maxFrameSize() const {
+    unsigned sz = 0;
+    for (const Frame &f : frames_) {
+        sz = std::max(sz, f.count_);
+    }
+    return sz;
+}
+
+bool Capture::write(std::ostream &os) const {
+    std::vector<uint8_t> buf;
+    buf.reserve(HEADER_SIZE + frames_.size() * FRAME_HEADER_SIZE + msgs_.size() * 21);
+
+    putU32(buf, MAGIC);
+    putU16(buf, VERSION);
+    putU16(buf, 0);
+    putU32(buf, static_cast<uint32_t>(frames_.size()));
+    putU32(buf, static_cast<uint32_t>(msgs_.size()));
+
+    uint64_t last = 0;
+    for (const Frame &f : frames_) {
+        uint64_t delta = f.time_ - last;
+        if (delta > 0xffffffff) {
+            LOG_0("Capture::write - gap between frames too large, " << delta << "us");
+            return false;
+        }
+        last = f.time_;
+        putU32(buf, static_cast<uint32_t>(delta));
+        putU16(buf, static_cast<uint16_t>(f.count_));
+        for (unsigned i = f.first_; i < f.first_ + f.count_; i++) {
+            const MecMsg &m = msgs_[i];
+            putU8(buf, static_cast<uint8_t>(m.type_));
+            switch (m.type_) {
+                case MecMsg::TOUCH_ON:
+                case MecMsg::TOUCH_CONTINUE:
+                case MecMsg::TOUCH_OFF:
+                    putU32(buf, static_cast<uint32_t>(m.data_.touch_.touchId_));
+                    putF32(buf, m.data_.touch_.note_);
+                    putF32(buf, m.data_.touch_.x_);
+                    putF32(buf, m.data_.touch_.y_);
+                    putF32(buf, m.data_.touch_.z_);
+                    break;
+                case MecMsg::CONTROL:
+                    putU32(buf, static_cast<uint32_t>(m.data_.control_.controlId_));
+                    putF32(buf, m.data_.control_.value_);
+                    break;
+                case MecMsg::MEC_CONTROL:
+                    putU32(buf, 0);
+                    putU8(buf, static_cast<uint8_t>(m.data_.mec_control_.cmd_));
+                    break;
+                case MecMsg::FRAME_START:
+                case MecMsg::FRAME_END:
+                    // never stored, see addFrame
+                    break;
+            }
+        }
+    }
+
+    os.write(reinterpret_cast<const char *>(buf.data()), buf.size());
+    return os.good();
+}
+
+bool Capture::read(std::istream &is) {
+    clear();
+    std::vector<uint8_t> buf((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    Reader r(buf.data(), buf.size());
+
+    uint32_t magic = r.u32();
+    uint16_t version = r.u16();
+    r.u16();
+    uint32_t nFrames = r.u32();
+    uint32_t nMsgs = r.u32();
+    if (r.failed() || magic != MAGIC) {
+        LOG_0("Capture::read - not a capture");
+        return false;
+    }
+    if (version != VERSION) {
+        LOG_0("Capture::read - unsupported version " << version);
+        return false;
+    }
+    // counts are only a hint until the records are read, so don't trust them for large allocations
+    if (static_cast<uint64_t>(nFrames) * FRAME_HEADER_SIZE > buf.size()
+        || static_cast<uint64_t>(nMsgs) * 6 > buf.size()) {
+        LOG_0("Capture::read - truncated");
+        return false;
+    }
+    reserve(nFrames, nMsgs);
+
+    uint64_t time = 0;
+    for (uint32_t fi = 0; fi < nFrames && !r.failed(); fi++) {
+        time += r.u32();
+        unsigned count = r.u16();
+        Frame f;
+        f.time_ = time;
+        f.first_ = static_cast<unsigned>(msgs_.size());
+        f.count_ = count;
+        for (unsigned i = 0; i < count && !r.failed(); i++) {
+            MecMsg m;
+            uint8_t type = r.u8();
+            int32_t id = static_cast<int32_t>(r.u32());
+            switch (type) {
+                case MecMsg::TOUCH_ON:
+                case MecMsg::TOUCH_CONTINUE:
+                case MecMsg::TOUCH_OFF:
+                    m.type_ = static_cast<MecMsg::type>(type);
+                    m.data_.touch_.touchId_ = id;
+                    m.data_.touch_.note_ = r.f32();
+                    m.data_.touch_.x_ = r.f32();
+                    m.data_.touch_.y_ = r.f32();
+                    m.data_.touch_.z_ = r.f32();
+                    break;
+                case MecMsg::CONTROL:
+                    m.type_ = MecMsg::CONTROL;
+                    m.data_.control_.controlId_ = id;
+                    m.data_.control_.value_ = r.f32();
+                    break;
+                case MecMsg::MEC_CONTROL:
+                    m.type_ = MecMsg::MEC_CONTROL;
+                    m.data_.mec_control_.cmd_ = static_cast<MecMsg::mec_cmd>(r.u8());
+                    break;
+                default:
+                    LOG_0("Capture::read - invalid message type " << (unsigned) type);
+                    clear();
+                    return false;
+            }
+            msgs_.push_back(m);
+        }
+        frames_.push_back(f);
+    }
+
+    if (r.failed() || !r.atEnd() || msgs_.size() != nMsgs) {
+        LOG_0("Capture::read - corrupt or truncated");
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool Capture::save(const std::string &file) const {
+    std::ofstream os(file.c_str(), std::ios::binary | std::ios::trunc);
+    if (!os.is_open()) {
+        LOG_0("Capture::save - unable to open " << file);
+        return false;
+    }
+    return write(os);
+}
+
+bool Capture::load(const std::string &file) {
+    std::ifstream is(file.c_str(), std::ios::binary);
+    if (!is.is_open()) {
+        LOG_0("Capture::load - unable to open " << file);
+        return false;
+    }
+    return read(is);
+}
+
+bool Capture::isCapture(const std::string &file) {
+    std::ifstream is(file.c_str(), std::ios::binary);
+    uint8_t hdr[4];
+    if (!is.read(reinterpret_cast<char *>(hdr), sizeof(hdr))) return false;
+    Reader r(hdr, sizeof(hdr));
+    return r.u32() == MAGIC;
+}
+
+
+//////////////////////////////////////////
+// synthetic captures
+static MecMsg touchMsg(MecMsg::type type, int id, float note, float x, float y, float z) {
+    MecMsg m;
+    m.type_ = type;
+    m.data_.touch_.touchId_ = id;
+    m.data_.touch_.note_ = note;
+    m.data_.touch_.x_ = x;
+    m.data_.touch_.y_ = y;
+    m.data_.touch_.z_ = z;
+    return m;
+}
+
+static const float PI = 3.14159265f;
+
+void Capture::chords(Capture &c, unsigned seconds, unsigned rate, unsigned voices) {
+    // each chord is held for 0.5s, then 0.1s with nothing down
+    static const int roots[] = {48, 53, 55, 50, 57, 52, 55, 48};
+    static const int intervals[] = {0, 4, 7, 12, 16, 19, 24, 28, 31, 36, 40, 43, 48, 52, 55, 60};
+    const unsigned held = rate / 2, gap = rate / 10, period = held + gap;
+    const unsigned total = seconds * rate;
+    const uint64_t frameUs = 1000000 / rate;
+    voices = std::min(voices, 16u);
+
+    c.clear();
+    c.reserve(total, total * voices);
+    std::vector<MecMsg> frame;
+    for (unsigned f = 0; f < total; f++) {
+        unsigned chord = f / period, pos = f % period;
+        float root = static_cast<float>(roots[chord % (sizeof(roots) / sizeof(roots[0]))]);
+        frame.clear();
+        for (unsigned v = 0; v < voices && pos <= held; v++) {
+            float note = root + intervals[v];
+            float y = 0.2f * std::sin(2.0f * PI * (pos + v * 17) / rate);
+            float z = 0.5f + 0.2f * std::sin(2.0f * PI * 3.0f * pos / rate + v);
+            if (pos == 0) {
+                frame.push_back(touchMsg(MecMsg::TOUCH_ON, v, note, 0.0f, y, 0.8f));
+            } else if (pos == held) {
+                frame.push_back(touchMsg(MecMsg::TOUCH_OFF, v, note, 0.0f, y, 0.0f));
+            } else {
+                frame.push_back(touchMsg(MecMsg::TOUCH_CONTINUE, v, note, 0.0f, y, z));
+            }
+        }
+        c.addFrame(f * frameUs, MsgSpan(frame.data(), static_cast<unsigned>(frame.size())));
+    }
+}
+
+void Capture::glissandi(Capture &c, unsigned seconds, unsigned rate, unsigned voices) {
+    // each touch slides up 24 semitones and back over 2s, touches staggered by 0.5s,
+    // lifting for 0.1s between slides
+    const unsigned slide = rate * 2, gap = rate / 10, period = slide + gap;
+    const unsigned total = seconds * rate;
+    const uint64_t frameUs = 1000000 / rate;
+    voices = std::min(voices, 16u);
+
+    c.clear();
+    c.reserve(total, total * voices);
+    std::vector<MecMsg> frame;
+    for (unsigned f = 0; f < total; f++) {
+        frame.clear();
+        for (unsigned v = 0; v < voices; v++) {
+            unsigned offset = v * rate / 2;
+            if (f < offset) continue;
+            unsigned pos = (f - offset) % period;
+            if (pos > slide) continue;
+            float phase = static_cast<float>(pos) / slide;
+            float note = 40.0f + v * 5.0f + 24.0f * (phase < 0.5f ? phase * 2.0f : (1.0f - phase) * 2.0f);
+            float x = note - std::floor(note + 0.5f);
+            float z = 0.6f + 0.1f * std::sin(2.0f * PI * phase * 4.0f);
+            if (pos == 0) {
+                frame.push_back(touchMsg(MecMsg::TOUCH_ON, v, note, x, 0.0f, 0.7f));
+            } else if (pos == slide) {
+                frame.push_back(touchMsg(MecMsg::TOUCH_OFF, v, note, x, 0.0f, 0.0f));
+            } else {
+                frame.push_back(touchMsg(MecMsg::TOUCH_CONTINUE, v, note, x, 0.0f, z));
+            }
+        }
+        c.addFrame(f * frameUs, MsgSpan(frame.data(), static_cast<unsigned>(frame.size())));
+    }
+}
+
+void Capture::stress(Capture &c, unsigned seconds, unsigned rate, unsigned voices) {
+    // every voice sends every frame, x/y/z never settle, each voice retriggers every 250ms (staggered)
+    const unsigned retrigger = rate / 4;
+    const unsigned total = seconds * rate;
+    const uint64_t frameUs = 1000000 / rate;
+    voices = std::min(voices, 16u);
+
+    c.clear();
+    c.reserve(total, total * voices);
+    std::vector<MecMsg> frame;
+    for (unsigned f = 0; f < total; f++) {
+        frame.clear();
+        for (unsigned v = 0; v < voices; v++) {
+            unsigned pos = (f + v * 7) % retrigger;
+            float note = 36.0f + v * 3.0f + 0.5f * std::sin(2.0f * PI * f * (v + 1) / rate);
+            float x = note - std::floor(note + 0.5f);
+            float y = std::sin(2.0f * PI * f * 3.0f / rate + v);
+            float z = 0.5f + 0.45f * std::sin(2.0f * PI * f * 5.0f / rate + v * 0.3f);
+            if (pos == 0 && f > 0) {
+                frame.push_back(touchMsg(MecMsg::TOUCH_OFF, v, note, x, y, 0.0f));
+            } else if (f == 0 || (pos == 1 && f > 1)) {
+                frame.push_back(touchMsg(MecMsg::TOUCH_ON, v, note, x, y, z));
+            } else if (pos > 1) {
+                frame.push_back(touchMsg(MecMsg::TOUCH_CONTINUE, v, note, x, y, z));
+            }
+        }
+        c.addFrame(f * frameUs, MsgSpan(frame.data(), static_cast<unsigned>(frame.size())));
+    }
+}
+
+bool Capture::synthetic(Capture &c, const std::string &name, unsigned seconds, unsigned rate, unsigned voices) {
+    if (name == "chords") {
+        chords(c, seconds, rate, voices ? voices : 4);
+    } else if (name == "glissandi") {
+        glissandi(c, seconds, rate, voices ? voices : 2);
+    } else if (name == "stress") {
+        stress(c, seconds, rate, voices ? voices : 16);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+//////////////////////////////////////////
+// CaptureRecorder
+CaptureRecorder::CaptureRecorder() : started_(false) {
+    frame_.reserve(64);
+}
+
+void CaptureRecorder::reset() {
+    capture_.clear();
+    started_ = false;
+}
+
+uint64_t CaptureRecorder::now() {
+    Clock::time_point t = Clock::now();
+    if (!started_) {
+        start_ = t;
+        started_ = true;
+    }
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(t - start_).count());
+}
+
+void CaptureRecorder::addTouch(MecMsg::type type, int touchId, float note, float x, float y, float z) {
+    MecMsg m = touchMsg(type, touchId, note, x, y, z);
+    capture_.addFrame(now(), m);
+}
+
+void CaptureRecorder::touchOn(int touchId, float note, float x, float y, float z) {
+    addTouch(MecMsg::TOUCH_ON, touchId, note, x, y, z);
+}
+
+void CaptureRecorder::touchContinue(int touchId, float note, float x, float y, float z) {
+    addTouch(MecMsg::TOUCH_CONTINUE, touchId, note, x, y, z);
+}
+
+void CaptureRecorder::touchOff(int touchId, float note, float x, float y, float z) {
+    addTouch(MecMsg::TOUCH_OFF, touchId, note, x, y, z);
+}
+
+void CaptureRecorder::control(int ctrlId, float v) {
+    MecMsg m;
+    m.type_ = MecMsg::CONTROL;
+    m.data_.control_.controlId_ = ctrlId;
+    m.data_.control_.value_ = v;
+    capture_.addFrame(now(), m);
+}
+
+void CaptureRecorder::mec_control(int, void *) {
+    // not recorded
+    ;
+}
+
+void CaptureRecorder::touchFrame(const MsgSpan &msgs) {
+    frame_.clear();
+    for (const MecMsg &m : msgs) {
+        // frame markers are not recorded, a capture frame is what was delivered in one touchFrame
+        if (m.type_ == MecMsg::TOUCH_ON || m.type_ == MecMsg::TOUCH_CONTINUE || m.type_ == MecMsg::TOUCH_OFF
+            || m.type_ == MecMsg::CONTROL) {
+            frame_.push_back(m);
+        }
+    }
+    if (frame_.empty()) return;
+    capture_.addFrame(now(), MsgSpan(frame_.data(), static_cast<unsigned>(frame_.size())));
+}
+
+}
@@ -0,0 +1,108 @@
+#ifndef MEC_CAPTURE_H
+#define MEC_CAPTURE_H
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "mec_api.h"
+#include "mec_msg_queue.h"
+
+namespace mec {
+
+// a recorded (or synthesised) MEC message stream, as frames of messages with a timestamp
+// frames are kept as they were delivered to ICallback::touchFrame, so replay reproduces the batching
+//
+// file format, little endian
+//  header : magic (u32) , version (u16), reserved (u16), frame count (u32), message count (u32)
+//  frame  : time delta from previous frame in us (u32), message count (u16)
+//  message: type (u8), id (i32), then by type
+//           touch       : note, x, y, z (f32)
+//           control     : value (f32)
+//           mec_control : cmd (u8)
+class Capture {
+public:
+    static const uint32_t MAGIC = 0x4343454d; // "MECC"
+    static const uint16_t VERSION = 1;
+    static const unsigned MAX_FRAME_MSGS = 0xffff;
+
+    struct Frame {
+        uint64_t time_;     // us from start of capture
+        unsigned first_;    // index of first message
+        unsigned count_;
+    };
+
+    Capture() { ; }
+
+    void clear();
+    void reserve(unsigned frames, unsigned msgs);
+
+    // frames must be added in time order, empty frames are ignored
+    void addFrame(uint64_t timeUs, const MsgSpan &msgs);
+    void addFrame(uint64_t timeUs, const MecMsg &msg);
+
+    unsigned frameCount() const { return static_cast<unsigned>(frames_.size()); }
+    unsigned long msgCount() const { return msgs_.size(); }
+    uint64_t frameTime(unsigned i) const { return frames_[i].time_; }
+    MsgSpan frame(unsigned i) const { return MsgSpan(msgs_.data() + frames_[i].first_, frames_[i].count_); }
+    uint64_t duration() const { return frames_.empty() ? 0 : frames_.back().time_; }
+    unsigned maxFrameSize() const;
+
+    bool save(const std::string &file) const;
+    bool load(const std::string &file);
+    bool write(std::ostream &) const;
+    bool read(std::istream &);
+    static bool isCapture(const std::string &file);
+
+    // synthetic captures, for benchmarks and tests without hardware
+    // all run at the given frame rate, with touches on/continue/off as a surface would send them
+
+    // chord sequence, 'voices' notes on together, held with a little pressure variation, then released
+    static void chords(Capture &, unsigned seconds, unsigned rate = 1000, unsigned voices = 4);
+    // overlapping glissandi, each touch slides 2 octaves up then back
+    static void glissandi(Capture &, unsigned seconds, unsigned rate = 1000, unsigned voices = 2);
+    // every touch active every frame, with continuously changing x/y/z, and staggered retriggers
+    static void stress(Capture &, unsigned seconds, unsigned rate = 1000, unsigned voices = 16);
+    // by name, chords, glissandi or stress, returns false if unknown, voices 0 is the default for each
+    static bool synthetic(Capture &, const std::string &name, unsigned seconds, unsigned rate = 1000, unsigned voices = 0);
+
+private:
+    std::vector<Frame> frames_;
+    std::vector<MecMsg> msgs_;
+};
+
+
+// records everything delivered to it, attach with MecApi::subscribe
+// timestamps are taken on arrival (i.e. in MecApi::process), relative to the first message
+// mec control messages (e.g. shutdown) are not recorded
+class CaptureRecorder : public ICallback {
+public:
+    CaptureRecorder();
+
+    void touchOn(int touchId, float note, float x, float y, float z) override;
+    void touchContinue(int touchId, float note, float x, float y, float z) override;
+    void touchOff(int touchId, float note, float x, float y, float z) override;
+    void control(int ctrlId, float v) override;
+    void mec_control(int cmd, void *other) override;
+    void touchFrame(const MsgSpan &msgs) override;
+
+    Capture &capture() { return capture_; }
+    bool save(const std::string &file) const { return capture_.save(file); }
+    void reset();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    uint64_t now();
+    void addTouch(MecMsg::type type, int touchId, float note, float x, float y, float z);
+
+    Capture capture_;
+    bool started_;
+    Clock::time_point start_;
+    std::vector<MecMsg> frame_;   // touches and controls of the current frame
+};
+
+}
+
+#endif // MEC_CAPTURE_H
@@ -5,6 +5,8 @@
 
 namespace mec {
 
+class Notifier;
+
 class Device {
 public:
     virtual ~Device() {};
@@ -12,6 +14,10 @@ public:
     virtual bool process() = 0 ;
     virtual void deinit() = 0;
     virtual bool isActive() = 0;
+
+    // devices which receive data on their own thread, signal the notifier when messages are waiting for process()
+    // return false, if the device has to be polled (i.e. process() does the work)
+    virtual bool setNotifier(Notifier*) { return false; }
 };
 
 }
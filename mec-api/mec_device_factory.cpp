@@ -0,0 +1,47 @@
+#include "mec_device_factory.h"
+
+#include <map>
+#include <mutex>
+
+namespace mec {
+
+// function statics, so factories can be registered during static initialisation
+static std::mutex &registryMutex() {
+    static std::mutex mtx;
+    return mtx;
+}
+
+static std::map<std::string, std::shared_ptr<DeviceFactory>> &registry() {
+    static std::map<std::string, std::shared_ptr<DeviceFactory>> factories;
+    return factories;
+}
+
+void DeviceRegistry::registerFactory(const std::string &type, std::shared_ptr<DeviceFactory> factory) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry()[type] = factory;
+}
+
+bool DeviceRegistry::unregisterFactory(const std::string &type) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    return registry().erase(type) > 0;
+}
+
+bool DeviceRegistry::isRegistered(const std::string &type) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    return registry().find(type) != registry().end();
+}
+
+std::shared_ptr<DeviceFactory> DeviceRegistry::factory(const std::string &type) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto it = registry().find(type);
+    return it != registry().end() ? it->second : nullptr;
+}
+
+std::vector<std::string> DeviceRegistry::types() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    std::vector<std::string> t;
+    for (auto &f : registry()) t.push_back(f.first);
+    return t;
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef MEC_DEVICE_FACTORY_H
+#define MEC_DEVICE_FACTORY_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mec_api.h"
+#include "mec_device.h"
+
+namespace mec {
+
+// creates devices of one type, for MecApi to start named instances of it
+// the name is the instance's key in the preferences, which are passed to Device::init as usual
+class DeviceFactory {
+public:
+    virtual ~DeviceFactory() { ; }
+    virtual std::shared_ptr<Device> create(const std::string &name, ICallback &cb) = 0;
+
+    // called once the device is deinit'd, e.g. to remove registrations made by create
+    virtual void destroy(const std::string &name, std::shared_ptr<Device> device) { ; }
+};
+
+// the common case, a device type constructed from its callback
+template<typename T>
+class SimpleDeviceFactory : public DeviceFactory {
+public:
+    std::shared_ptr<Device> create(const std::string &name, ICallback &cb) override {
+        return std::make_shared<T>(cb);
+    }
+};
+
+// device factories by type name (e.g. "soundplane"), MecApi registers the built in types,
+// applications and tests may add (or replace) types, before MecApi::init
+// thread safe, though typically only used during init, attach and rescan
+class DeviceRegistry {
+public:
+    static void registerFactory(const std::string &type, std::shared_ptr<DeviceFactory> factory);
+    static bool unregisterFactory(const std::string &type);
+    static bool isRegistered(const std::string &type);
+    static std::shared_ptr<DeviceFactory> factory(const std::string &type); // null if not registered
+    static std::vector<std::string> types();
+};
+
+}
+
+#endif //MEC_DEVICE_FACTORY_H
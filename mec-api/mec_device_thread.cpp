@@ -0,0 +1,189 @@
+#include "mec_device_thread.h"
+
+#include "mec_latency.h"
+#include "mec_log.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#endif
+
+namespace mec {
+
+// longest wait of a device thread with a notifier, so stop() is not held up
+static const unsigned MAX_WAIT_MS = 100;
+
+/////////////////////////////////////////////////////////
+// current thread scheduling
+static bool setRealtimePriority(int priority, std::string &error) {
+#ifdef _WIN32
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+        error = "SetThreadPriority failed";
+        return false;
+    }
+    return true;
+#else
+    sched_param param;
+    param.sched_priority = std::max(sched_get_priority_min(SCHED_FIFO),
+                                    std::min(priority, sched_get_priority_max(SCHED_FIFO)));
+    int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (rc != 0) {
+        error = strerror(rc);
+        return false;
+    }
+    return true;
+#endif
+}
+
+static bool setAffinity(int cpu, std::string &error) {
+#if defined(_WIN32)
+    if (!SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu)) {
+        error = "SetThreadAffinityMask failed";
+        return false;
+    }
+    return true;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) {
+        error = strerror(rc);
+        return false;
+    }
+    return true;
+#else
+    // e.g. macOS, only has affinity hints (thread_policy_set), which do not pin to a cpu
+    error = "not supported on this platform";
+    return false;
+#endif
+}
+
+
+/////////////////////////////////////////////////////////
+// MergeCallback
+void MergeCallback::touch(MecMsg::type type, int touchId, float note, float x, float y, float z) {
+    MecMsg msg;
+    Latency::stamp(msg);
+    msg.type_ = type;
+    msg.data_.touch_.touchId_ = touchId;
+    msg.data_.touch_.note_ = note;
+    msg.data_.touch_.x_ = x;
+    msg.data_.touch_.y_ = y;
+    msg.data_.touch_.z_ = z;
+    queue_.addToQueue(msg);
+}
+
+void MergeCallback::touchOn(int touchId, float note, float x, float y, float z) {
+    touch(MecMsg::TOUCH_ON, touchId, note, x, y, z);
+}
+
+void MergeCallback::touchContinue(int touchId, float note, float x, float y, float z) {
+    touch(MecMsg::TOUCH_CONTINUE, touchId, note, x, y, z);
+}
+
+void MergeCallback::touchOff(int touchId, float note, float x, float y, float z) {
+    touch(MecMsg::TOUCH_OFF, touchId, note, x, y, z);
+}
+
+void MergeCallback::control(int ctrlId, float v) {
+    MecMsg msg;
+    Latency::stamp(msg);
+    msg.type_ = MecMsg::CONTROL;
+    msg.data_.control_.controlId_ = ctrlId;
+    msg.data_.control_.value_ = v;
+    queue_.addToQueue(msg);
+}
+
+void MergeCallback::mec_control(int cmd, void *other) {
+    if (cmd == ICallback::SHUTDOWN) {
+        MecMsg msg;
+        msg.type_ = MecMsg::MEC_CONTROL;
+        msg.data_.mec_control_.cmd_ = MecMsg::SHUTDOWN;
+        queue_.addToQueue(msg);
+    }
+}
+
+void MergeCallback::touchFrame(const MsgSpan &msgs) {
+    // keeps the device stamps, so latency is measured from the device handler
+    // and the span whole, so frames (and their markers) are not interleaved with other devices
+    if (msgs.size() <= queue_.capacity()) {
+        queue_.addFrameToQueue(msgs.begin(), msgs.size());
+        return;
+    }
+    for (const MecMsg &m : msgs) {
+        MecMsg msg = m;
+        queue_.addToQueue(msg);
+    }
+}
+
+
+/////////////////////////////////////////////////////////
+// DeviceThread
+DeviceThread::DeviceThread(const std::string &name, std::shared_ptr<Device> device, unsigned pollInterval) :
+    name_(name),
+    device_(device),
+    pollInterval_(pollInterval),
+    waitInterval_(pollInterval),
+    priority_(0),
+    cpu_(-1),
+    running_(false),
+    processCount_(0) {
+}
+
+DeviceThread::~DeviceThread() {
+    stop();
+}
+
+bool DeviceThread::start(int priority, int cpu) {
+    if (running_) return false;
+    priority_ = priority;
+    cpu_ = cpu;
+    waitInterval_ = device_->setNotifier(&notifier_) ? MAX_WAIT_MS : pollInterval_;
+    running_ = true;
+    thread_ = std::thread(&DeviceThread::run, this);
+    return true;
+}
+
+void DeviceThread::stop() {
+    if (!thread_.joinable()) return;
+    running_ = false;
+    notifier_.notify();
+    thread_.join();
+    device_->setNotifier(nullptr);
+}
+
+void DeviceThread::run() {
+    std::string error;
+    if (priority_ > 0) {
+        if (setRealtimePriority(priority_, error)) {
+            LOG_1("DeviceThread " << name_ << " - realtime priority " << priority_);
+        } else {
+            LOG_0("DeviceThread " << name_ << " - unable to set realtime priority " << priority_ << " : " << error);
+        }
+    }
+    if (cpu_ >= 0) {
+        if (setAffinity(cpu_, error)) {
+            LOG_1("DeviceThread " << name_ << " - cpu " << cpu_);
+        } else {
+            LOG_0("DeviceThread " << name_ << " - unable to set cpu " << cpu_ << " : " << error);
+        }
+    }
+
+    // messages are recorded when delivered from the merged queue, not as they are forwarded to it
+    Latency::setForwarding(true);
+
+    while (running_) {
+        device_->process();
+        processCount_++;
+        notifier_.wait(std::chrono::milliseconds(waitInterval_));
+    }
+}
+
+}
@@ -0,0 +1,82 @@
+#ifndef MEC_DEVICE_THREAD_H
+#define MEC_DEVICE_THREAD_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "mec_api.h"
+#include "mec_device.h"
+#include "mec_msg_queue.h"
+#include "mec_notifier.h"
+
+namespace mec {
+
+// merged output stage, for devices processed on their own threads (see DeviceThread)
+// devices call back on their own thread, so rather than calling the outputs, messages are queued
+// and delivered on the thread calling MecApi::process, so outputs are only ever called from one thread
+// frames are queued whole, though messages of devices queuing at the same time may interleave
+class MergeCallback : public ICallback {
+public:
+    static const unsigned DEFAULT_SIZE = 1024;
+
+    MergeCallback(unsigned size = DEFAULT_SIZE) : queue_(size) { ; }
+
+    MsgQueue &queue() { return queue_; }
+
+    // messages from direct calls (rather than frames) are stamped here, see Latency
+    void touchOn(int touchId, float note, float x, float y, float z) override;
+    void touchContinue(int touchId, float note, float x, float y, float z) override;
+    void touchOff(int touchId, float note, float x, float y, float z) override;
+    void control(int ctrlId, float v) override;
+    void mec_control(int cmd, void *other) override;
+    void touchFrame(const MsgSpan &msgs) override;
+
+private:
+    void touch(MecMsg::type type, int touchId, float note, float x, float y, float z);
+
+    MsgQueue queue_;
+};
+
+
+// calls Device::process on a dedicated thread, rather than the thread calling MecApi::process,
+// so a slow device (e.g. push2 display rendering) cannot delay the others
+// devices which signal a notifier are processed when they have messages, others every poll interval
+//
+// optionally with realtime (SCHED_FIFO) priority and pinned to a cpu, from device preferences
+//   "thread priority" : 1-99, SCHED_FIFO priority, 0 = normal scheduling (default)
+//   "thread cpu" : cpu number for affinity, -1 = any (default)
+// these typically need privileges (e.g. CAP_SYS_NICE, or rtprio in limits.conf), if refused the
+// thread runs with normal scheduling, and the failure is logged
+class DeviceThread {
+public:
+    DeviceThread(const std::string &name, std::shared_ptr<Device> device, unsigned pollInterval);
+    ~DeviceThread();
+
+    bool start(int priority = 0, int cpu = -1);
+    void stop();  // waits for the current process() to complete
+
+    const std::string &name() const { return name_; }
+    std::shared_ptr<Device> device() const { return device_; }
+    bool isRunning() const { return running_; }
+    unsigned long processCount() const { return processCount_; }
+
+private:
+    void run();
+
+    std::string name_;
+    std::shared_ptr<Device> device_;
+    unsigned pollInterval_;  // ms
+    unsigned waitInterval_;  // ms
+    int priority_;
+    int cpu_;
+    Notifier notifier_;
+    std::atomic<bool> running_;
+    std::atomic<unsigned long> processCount_;
+    std::thread thread_;
+};
+
+}
+
+#endif //MEC_DEVICE_THREAD_H
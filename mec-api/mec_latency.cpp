@@ -0,0 +1,106 @@
+#include "mec_latency.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace mec {
+
+static unsigned msb(uint64_t v) {
+#if defined(__GNUC__)
+    return 63 - static_cast<unsigned>(__builtin_clzll(v));
+#else
+    unsigned n = 0;
+    while (v >>= 1) n++;
+    return n;
+#endif
+}
+
+/////////////////////////////////////////////////////////
+// LatencyHistogram
+unsigned LatencyHistogram::bucket(uint64_t v) {
+    if (v < 2 * SUB_BUCKETS) return static_cast<unsigned>(v);
+    unsigned shift = msb(v) - SUB_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<unsigned>((v >> shift) - SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::bucketHigh(unsigned b) {
+    if (b < 2 * SUB_BUCKETS) return b;
+    unsigned shift = b / SUB_BUCKETS - 1;
+    uint64_t mantissa = (b % SUB_BUCKETS) + SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n ? sum_.load(std::memory_order_relaxed) / n : 0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    // use the bucket total, rather than count_, so a concurrent record() cannot leave us short
+    uint64_t total = 0;
+    for (unsigned b = 0; b < BUCKETS; b++) total += counts_[b].load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+
+    uint64_t target = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total) + 0.5);
+    if (target < 1) target = 1;
+    if (target > total) target = total;
+
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < BUCKETS; b++) {
+        seen += counts_[b].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            uint64_t high = bucketHigh(b);
+            uint64_t mx = max();
+            return high < mx || mx == 0 ? high : mx;
+        }
+    }
+    return max();
+}
+
+void LatencyHistogram::reset() {
+    for (unsigned b = 0; b < BUCKETS; b++) counts_[b].store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+
+/////////////////////////////////////////////////////////
+// Latency
+std::atomic<bool> Latency::enabled_(false);
+thread_local bool Latency::forwarding_ = false;
+LatencyHistogram Latency::histograms_[Latency::NUM_STAGES];
+
+const char *Latency::stageName(Stage s) {
+    switch (s) {
+        case QUEUE:
+            return "queue";
+        case DISPATCH:
+            return "dispatch";
+        case TOTAL:
+            return "total";
+        default:
+            return "unknown";
+    }
+}
+
+void Latency::reset() {
+    for (unsigned s = 0; s < NUM_STAGES; s++) histograms_[s].reset();
+}
+
+std::string Latency::report() {
+    std::ostringstream os;
+    os << "latency (us)" << std::fixed << std::setprecision(1);
+    for (unsigned s = 0; s < NUM_STAGES; s++) {
+        const LatencyHistogram &h = histograms_[s];
+        os << " " << stageName(static_cast<Stage>(s))
+           << " [n " << h.count()
+           << " p50 " << h.percentile(50.0) / 1000.0
+           << " p99 " << h.percentile(99.0) / 1000.0
+           << " p99.9 " << h.percentile(99.9) / 1000.0
+           << " max " << h.max() / 1000.0 << "]";
+    }
+    return os.str();
+}
+
+}
@@ -0,0 +1,126 @@
+#ifndef MEC_LATENCY_H
+#define MEC_LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "mec_msg_queue.h"
+
+namespace mec {
+
+// log-linear (HDR style) histogram of durations in ns
+// values are bucketed by power of 2, each power split into SUB_BUCKETS linear buckets,
+// so any recorded value is reported within 1/SUB_BUCKETS (~3%) of its true value
+// record() is lock-free (relaxed atomic increments), queries may run on any thread concurrently,
+// though a query during recording may see a count slightly ahead of the buckets
+class LatencyHistogram {
+public:
+    static const unsigned SUB_BITS = 5;
+    static const unsigned SUB_BUCKETS = 1 << SUB_BITS;
+    static const unsigned MAX_BITS = 36;  // ~68s, larger values are clamped
+    static const unsigned BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+    static const uint64_t MAX_VALUE = (1ULL << MAX_BITS) - 1;
+
+    LatencyHistogram() { reset(); }
+
+    void record(uint64_t ns) {
+        if (ns > MAX_VALUE) ns = MAX_VALUE;
+        counts_[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t mx = max_.load(std::memory_order_relaxed);
+        while (ns > mx && !max_.compare_exchange_weak(mx, ns, std::memory_order_relaxed));
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t mean() const;
+    uint64_t percentile(double p) const; // p in 0..100, upper bound of the bucket, 0 if empty
+    void reset();
+
+    static unsigned bucket(uint64_t v);
+    static uint64_t bucketHigh(unsigned b); // highest value in bucket b
+
+private:
+    std::atomic<uint64_t> counts_[BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+
+// end to end latency, from a device handler to the return of the output callbacks
+// device handlers stamp each MecMsg as it is created, MsgQueue::process records each stage as the
+// messages are delivered to MecApi, and so on to its subscribers (e.g. MIDI/OSC outputs)
+// stages
+//  QUEUE    : stamp -> drained from the device queue, by the thread calling MecApi::process
+//  DISPATCH : drained -> all callbacks returned (one sample per frame, i.e. per ICallback::touchFrame)
+//  TOTAL    : stamp -> all callbacks returned (one sample per message)
+// devices that call back directly (eigenharp), record their handler to callback time as DISPATCH and TOTAL
+//
+// disabled by default, when disabled stamping is a relaxed atomic load, and messages carry a 0 stamp
+// enable in config with mec: { "latency stats" : true, "latency log interval" : 10000 (ms, 0 = no log) }
+// when logging, each log line covers the interval since the last, histograms are reset after logging
+class Latency {
+public:
+    enum Stage {
+        QUEUE,
+        DISPATCH,
+        TOTAL,
+        NUM_STAGES
+    };
+
+    static void enable(bool e) { enabled_.store(e, std::memory_order_relaxed); }
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // current time if enabled, else 0 (i.e. not stamped)
+    static uint64_t stamp() { return enabled() ? now() : 0; }
+    static void stamp(MecMsg &msg) { msg.t_ = stamp(); }
+
+    // set on threads which forward drained messages to another queue, rather than to the outputs
+    // (see DeviceThread), so messages are only recorded where they are finally delivered
+    static void setForwarding(bool f) { forwarding_ = f; }
+    static bool recording() { return enabled() && !forwarding_; }
+
+    static void record(Stage s, uint64_t ns) { histograms_[s].record(ns); }
+
+    // record each stamped message against time t
+    static void record(Stage s, const MecMsg *msgs, unsigned n, uint64_t t) {
+        LatencyHistogram &h = histograms_[s];
+        for (unsigned i = 0; i < n; i++) {
+            uint64_t ts = msgs[i].t_;
+            if (ts != 0 && ts <= t) h.record(t - ts);
+        }
+    }
+
+    // for devices that call back directly, start is from stamp()
+    static void recordDirect(uint64_t start) {
+        if (start == 0 || forwarding_) return;
+        uint64_t d = now() - start;
+        histograms_[DISPATCH].record(d);
+        histograms_[TOTAL].record(d);
+    }
+
+    static const LatencyHistogram &histogram(Stage s) { return histograms_[s]; }
+    static const char *stageName(Stage s);
+    static void reset();
+
+    // single line summary, count, p50/p99/p99.9/max in us, per stage
+    static std::string report();
+
+private:
+    static std::atomic<bool> enabled_;
+    static thread_local bool forwarding_;
+    static LatencyHistogram histograms_[NUM_STAGES];
+};
+
+}
+
+#endif //MEC_LATENCY_H
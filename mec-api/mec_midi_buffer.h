@@ -0,0 +1,120 @@
+#ifndef MEC_MIDI_BUFFER_H
+#define MEC_MIDI_BUFFER_H
+
+#include <cstring>
+
+namespace mec {
+
+// fixed size buffer of complete midi messages, e.g. all generated during one process cycle
+// no allocation, messages are stored back to back, each with its status byte
+// when full, further messages are dropped (and counted), so flush before that
+class MidiBuffer {
+public:
+    static const unsigned CAPACITY = 1024; // bytes, ~340 three byte messages
+
+    MidiBuffer() : size_(0), count_(0), dropped_(0) { ; }
+
+    // length of a message, from its status byte, 0 for sysex/undefined (not supported)
+    static unsigned msgLength(unsigned char status) {
+        if (status < 0x80) return 0;
+        if (status < 0xF0) return (status & 0xE0) == 0xC0 ? 2 : 3; // program change, channel pressure
+        switch (status) {
+            case 0xF1 :
+            case 0xF3 :
+                return 2;
+            case 0xF2 :
+                return 3;
+            case 0xF0 :
+            case 0xF4 :
+            case 0xF5 :
+            case 0xF7 :
+            case 0xF9 :
+            case 0xFD :
+                return 0;
+            default:
+                return 1;
+        }
+    }
+
+    bool add(unsigned char status, unsigned char d1 = 0, unsigned char d2 = 0) {
+        unsigned len = msgLength(status);
+        if (len == 0 || size_ + len > CAPACITY) {
+            dropped_++;
+            return false;
+        }
+        data_[size_] = status;
+        if (len > 1) data_[size_ + 1] = (unsigned char) (d1 & 0x7F);
+        if (len > 2) data_[size_ + 2] = (unsigned char) (d2 & 0x7F);
+        size_ += len;
+        count_++;
+        return true;
+    }
+
+    // room for a message with this status (an unsupported status is left to add, to count as dropped)
+    bool fits(unsigned char status) const { return size_ + msgLength(status) <= CAPACITY; }
+
+    bool add(const unsigned char *msg, unsigned size) {
+        if (size == 0 || msgLength(msg[0]) != size) {
+            dropped_++;
+            return false;
+        }
+        return add(msg[0], size > 1 ? msg[1] : 0, size > 2 ? msg[2] : 0);
+    }
+
+    // calls f(const unsigned char *msg, unsigned size) for each message, in order
+    template<typename F>
+    void forEach(F f) const {
+        unsigned pos = 0;
+        while (pos < size_) {
+            unsigned len = msgLength(data_[pos]);
+            f(data_ + pos, len);
+            pos += len;
+        }
+    }
+
+    // whole buffer as a byte stream, with running status, for transports taking a raw stream
+    // (most RtMidi apis parse one complete message per call, so use forEach for those)
+    // channel status is omitted if it repeats, system common messages cancel running status,
+    // realtime messages are transparent. returns bytes written, 0 if out is too small
+    unsigned encode(unsigned char *out, unsigned max) const {
+        unsigned pos = 0, n = 0;
+        unsigned char running = 0;
+        while (pos < size_) {
+            unsigned char status = data_[pos];
+            unsigned len = msgLength(status);
+            unsigned skip = (status < 0xF0 && status == running) ? 1 : 0;
+            if (n + len - skip > max) return 0;
+            memcpy(out + n, data_ + pos + skip, len - skip);
+            n += len - skip;
+            if (status < 0xF0) running = status;
+            else if (status < 0xF8) running = 0;
+            pos += len;
+        }
+        return n;
+    }
+
+    void clear() {
+        size_ = 0;
+        count_ = 0;
+    }
+
+    bool empty() const { return count_ == 0; }
+
+    const unsigned char *data() const { return data_; }
+
+    unsigned size() const { return size_; }   // bytes, without running status
+
+    unsigned count() const { return count_; } // messages
+
+    unsigned long dropped() const { return dropped_; }
+
+private:
+    unsigned char data_[CAPACITY];
+    unsigned size_;
+    unsigned count_;
+    unsigned long dropped_;
+};
+
+}
+
+#endif //MEC_MIDI_BUFFER_H
@@ -1,37 +1,73 @@
 #include "mec_msg_queue.h"
 
 #include "mec_api.h"
+#include "mec_latency.h"
 #include "mec_log.h"
+#include "mec_notifier.h"
 
-namespace mec {
+#include <atomic>
 
-const int RING_BUFFER_SIZE = 30;
+namespace mec {
 
+static const unsigned CACHE_LINE_SIZE = 64;
 
+// bounded MPSC queue, based on Dmitry Vyukov's bounded MPMC queue
+// each cell carries a sequence number, which tells producers/consumer if the cell is free or filled
+// - producers claim a slot with a CAS on writePos_, then publish the cell with a release store of seq
+// - the (single) consumer acquires seq, copies the message, then hands the cell back to producers
 class MsgQueue_impl {
 public:
-    MsgQueue_impl();
+    MsgQueue_impl(unsigned size);
     ~MsgQueue_impl();
 
     bool addToQueue(MecMsg &);
+    bool addFrameToQueue(const MecMsg *msgs, unsigned n);
     bool nextMsg(MecMsg &);
+    unsigned drain(MecMsg *msgs, unsigned max);
+    MecMsg *batch() { return batch_.get(); }
     bool isEmpty();
     bool isFull();
     int available();
     int pending();
 
+    void resize(unsigned size);
+    unsigned capacity();
+    void setNotifier(Notifier *);
+    unsigned highWaterMark();
+    unsigned long dropped();
+    void resetStats();
+
 private:
-    MecMsg queue_[RING_BUFFER_SIZE];
-    // unsigned readPtr_;
-    // unsigned writePtr_;
-    volatile unsigned readPtr_;
-    volatile unsigned writePtr_;
+    struct Cell {
+        std::atomic<unsigned> seq_;
+        MecMsg msg_;
+    };
+
+    void updateHighWaterMark(unsigned n);
+
+    std::unique_ptr<Cell[]> queue_;
+    std::unique_ptr<MecMsg[]> batch_; // consumer side buffer for process()
+    unsigned size_;
+    unsigned mask_;
+
+    // keep producer and consumer positions on separate cache lines
+    char pad0_[CACHE_LINE_SIZE];
+    std::atomic<unsigned> writePos_;
+    char pad1_[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned>)];
+    std::atomic<unsigned> readPos_;
+    char pad2_[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned>)];
+
+    std::atomic<unsigned> highWaterMark_;
+    std::atomic<unsigned long> dropped_;
+    std::atomic<bool> overflow_;
+
+    std::atomic<Notifier *> notifier_;
 };
 
 
 /////////// Public Interface
-MsgQueue::MsgQueue() {
-    impl_.reset(new MsgQueue_impl());
+MsgQueue::MsgQueue(unsigned size) {
+    impl_.reset(new MsgQueue_impl(size));
 }
 
 MsgQueue::~MsgQueue() {
@@ -41,10 +77,18 @@ bool MsgQueue::addToQueue(MecMsg &msg) {
     return impl_->addToQueue(msg);
 }
 
+bool MsgQueue::addFrameToQueue(const MecMsg *msgs, unsigned n) {
+    return impl_->addFrameToQueue(msgs, n);
+}
+
 bool MsgQueue::nextMsg(MecMsg &msg) {
     return impl_->nextMsg(msg);
 }
 
+unsigned MsgQueue::drain(MecMsg *msgs, unsigned max) {
+    return impl_->drain(msgs, max);
+}
+
 bool MsgQueue::isEmpty() {
     return impl_->isEmpty();
 }
@@ -61,39 +105,173 @@ int MsgQueue::pending() {
     return impl_->pending();
 }
 
+void MsgQueue::resize(unsigned size) {
+    impl_->resize(size);
+}
+
+unsigned MsgQueue::capacity() {
+    return impl_->capacity();
+}
+
+void MsgQueue::setNotifier(Notifier *n) {
+    impl_->setNotifier(n);
+}
+
+unsigned MsgQueue::highWaterMark() {
+    return impl_->highWaterMark();
+}
+
+unsigned long MsgQueue::dropped() {
+    return impl_->dropped();
+}
+
+void MsgQueue::resetStats() {
+    impl_->resetStats();
+}
+
 
 /////////// Implementation
-MsgQueue_impl::MsgQueue_impl() {
-    writePtr_ = readPtr_ = 0;
+MsgQueue_impl::MsgQueue_impl(unsigned size) : size_(0), mask_(0), notifier_(nullptr) {
+    resize(size);
 }
 
 MsgQueue_impl::~MsgQueue_impl() {
 
 }
 
+void MsgQueue_impl::resize(unsigned size) {
+    unsigned sz = 2;
+    while (sz < size) sz <<= 1;
+
+    queue_.reset(new Cell[sz]);
+    batch_.reset(new MecMsg[sz]);
+    size_ = sz;
+    mask_ = sz - 1;
+    for (unsigned i = 0; i < size_; i++) {
+        queue_[i].seq_.store(i, std::memory_order_relaxed);
+    }
+    writePos_.store(0, std::memory_order_relaxed);
+    readPos_.store(0, std::memory_order_relaxed);
+    resetStats();
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
 bool MsgQueue_impl::addToQueue(MecMsg &msg) {
-    unsigned next = (writePtr_ + 1) % RING_BUFFER_SIZE;
+    Cell *cell;
+    unsigned pos = writePos_.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &queue_[pos & mask_];
+        unsigned seq = cell->seq_.load(std::memory_order_acquire);
+        int diff = static_cast<int>(seq - pos);
+        if (diff == 0) {
+            // cell free, try to claim it
+            if (writePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // cell still holds an unread message, so queue is full
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            if (!overflow_.exchange(true, std::memory_order_relaxed)) {
+                LOG_0("MsgQueue_impl : ring buffer overflow, dropping messages (size " << size_ << ")");
+            }
+            return false;
+        } else {
+            // another producer claimed this cell
+            pos = writePos_.load(std::memory_order_relaxed);
+        }
+    }
 
-    if (next == readPtr_) {
-        LOG_0("MsgQueue_impl : ring buffer overflow");
-        return false;
+    cell->msg_ = msg;
+    cell->seq_.store(pos + 1, std::memory_order_release);
+
+    updateHighWaterMark(pos + 1 - readPos_.load(std::memory_order_relaxed));
+
+    Notifier *notifier = notifier_.load(std::memory_order_acquire);
+    if (notifier) notifier->notify();
+    return true;
+}
+
+bool MsgQueue_impl::addFrameToQueue(const MecMsg *msgs, unsigned n) {
+    if (n == 0) return true;
+    Cell *first;
+    Cell *last;
+    unsigned pos = writePos_.load(std::memory_order_relaxed);
+    for (;;) {
+        // the consumer frees cells in order, so if the last cell of the frame is free, so are those before it
+        first = &queue_[pos & mask_];
+        last = &queue_[(pos + n - 1) & mask_];
+        int diffFirst = static_cast<int>(first->seq_.load(std::memory_order_acquire) - pos);
+        int diffLast = static_cast<int>(last->seq_.load(std::memory_order_acquire) - (pos + n - 1));
+        if (n <= size_ && diffFirst == 0 && diffLast == 0) {
+            // cells free, try to claim them all
+            if (writePos_.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) break;
+        } else if (n > size_ || diffFirst < 0 || diffLast < 0) {
+            // not enough room for the frame
+            dropped_.fetch_add(n, std::memory_order_relaxed);
+            if (!overflow_.exchange(true, std::memory_order_relaxed)) {
+                LOG_0("MsgQueue_impl : ring buffer overflow, dropping frame (size " << size_ << ")");
+            }
+            return false;
+        } else {
+            // another producer claimed a cell
+            pos = writePos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    // publish in reverse, the consumer stops at the first cell not yet published, so cannot take part of the frame
+    for (unsigned i = n; i-- > 0;) {
+        Cell &cell = queue_[(pos + i) & mask_];
+        cell.msg_ = msgs[i];
+        cell.seq_.store(pos + i + 1, std::memory_order_release);
     }
-    queue_[writePtr_] = msg;
-    writePtr_ = next;
+
+    updateHighWaterMark(pos + n - readPos_.load(std::memory_order_relaxed));
+
+    Notifier *notifier = notifier_.load(std::memory_order_acquire);
+    if (notifier) notifier->notify();
     return true;
 }
 
 bool MsgQueue_impl::nextMsg(MecMsg &msg) {
-    if (readPtr_ != writePtr_) {
-        msg = queue_[readPtr_];
-        readPtr_ = (readPtr_ + 1) % RING_BUFFER_SIZE;
-        return true;
+    // single consumer, so no need to CAS on readPos_
+    unsigned pos = readPos_.load(std::memory_order_relaxed);
+    Cell &cell = queue_[pos & mask_];
+    unsigned seq = cell.seq_.load(std::memory_order_acquire);
+    if (seq != pos + 1) {
+        // consumer has caught up, so next overflow is reported again
+        if (overflow_.load(std::memory_order_relaxed)) overflow_.store(false, std::memory_order_relaxed);
+        return false;
     }
-    return false;
+
+    msg = cell.msg_;
+    cell.seq_.store(pos + size_, std::memory_order_release);
+    readPos_.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+unsigned MsgQueue_impl::drain(MecMsg *msgs, unsigned max) {
+    // as nextMsg, but only publish the read position once for the batch
+    unsigned start = readPos_.load(std::memory_order_relaxed);
+    unsigned n = 0;
+    for (; n < max; n++) {
+        unsigned pos = start + n;
+        Cell &cell = queue_[pos & mask_];
+        unsigned seq = cell.seq_.load(std::memory_order_acquire);
+        if (seq != pos + 1) break;
+
+        msgs[n] = cell.msg_;
+        cell.seq_.store(pos + size_, std::memory_order_release);
+    }
+
+    if (n > 0) {
+        readPos_.store(start + n, std::memory_order_release);
+    } else {
+        // consumer has caught up, so next overflow is reported again
+        if (overflow_.load(std::memory_order_relaxed)) overflow_.store(false, std::memory_order_relaxed);
+    }
+    return n;
 }
 
 bool MsgQueue_impl::isEmpty() {
-    return readPtr_ == writePtr_;
+    return pending() == 0;
 }
 
 bool MsgQueue_impl::isFull() {
@@ -101,24 +279,69 @@ bool MsgQueue_impl::isFull() {
 }
 
 int MsgQueue_impl::available() {
-    return RING_BUFFER_SIZE - pending();
-
+    return size_ - pending();
 }
 
 int MsgQueue_impl::pending() {
-    if (writePtr_ >= readPtr_) {
-        return writePtr_ - readPtr_;
-    }
+    unsigned r = readPos_.load(std::memory_order_acquire);
+    unsigned w = writePos_.load(std::memory_order_acquire);
+    unsigned n = w - r;
+    // positions are read independently, so clamp if a producer/consumer moved in between
+    return static_cast<int>(n > size_ ? size_ : n);
+}
+
+unsigned MsgQueue_impl::capacity() {
+    return size_;
+}
+
+void MsgQueue_impl::setNotifier(Notifier *n) {
+    notifier_.store(n, std::memory_order_release);
+}
 
-    return writePtr_ + RING_BUFFER_SIZE - readPtr_;
+void MsgQueue_impl::updateHighWaterMark(unsigned n) {
+    if (n > size_) n = size_;
+    unsigned hwm = highWaterMark_.load(std::memory_order_relaxed);
+    while (n > hwm && !highWaterMark_.compare_exchange_weak(hwm, n, std::memory_order_relaxed));
+}
+
+unsigned MsgQueue_impl::highWaterMark() {
+    return highWaterMark_.load(std::memory_order_relaxed);
+}
+
+unsigned long MsgQueue_impl::dropped() {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+void MsgQueue_impl::resetStats() {
+    highWaterMark_.store(0, std::memory_order_relaxed);
+    dropped_.store(0, std::memory_order_relaxed);
+    overflow_.store(false, std::memory_order_relaxed);
 }
 
 bool MsgQueue::process(ICallback &c) {
-    MecMsg msg;
-    while (nextMsg(msg)) {
+    MecMsg *batch = impl_->batch();
+    unsigned n;
+    while ((n = drain(batch, capacity())) > 0) {
+        if (Latency::recording()) {
+            uint64_t t0 = Latency::now();
+            Latency::record(Latency::QUEUE, batch, n, t0);
+            c.touchFrame(MsgSpan(batch, n));
+            uint64_t t1 = Latency::now();
+            Latency::record(Latency::DISPATCH, t1 - t0);
+            Latency::record(Latency::TOTAL, batch, n, t1);
+        } else {
+            c.touchFrame(MsgSpan(batch, n));
+        }
+    }
+    return true;
+}
+
+/////////// ICallback default batch handling
+void ICallback::touchFrame(const MsgSpan &msgs) {
+    for (const MecMsg &msg : msgs) {
         switch (msg.type_) {
             case MecMsg::TOUCH_ON:
-                c.touchOn(
+                touchOn(
                         msg.data_.touch_.touchId_,
                         msg.data_.touch_.note_,
                         msg.data_.touch_.x_,
@@ -126,7 +349,7 @@ bool MsgQueue::process(ICallback &c) {
                         msg.data_.touch_.z_);
                 break;
             case MecMsg::TOUCH_CONTINUE:
-                c.touchContinue(
+                touchContinue(
                         msg.data_.touch_.touchId_,
                         msg.data_.touch_.note_,
                         msg.data_.touch_.x_,
@@ -134,7 +357,7 @@ bool MsgQueue::process(ICallback &c) {
                         msg.data_.touch_.z_);
                 break;
             case MecMsg::TOUCH_OFF:
-                c.touchOff(
+                touchOff(
                         msg.data_.touch_.touchId_,
                         msg.data_.touch_.note_,
                         msg.data_.touch_.x_,
@@ -142,7 +365,7 @@ bool MsgQueue::process(ICallback &c) {
                         msg.data_.touch_.z_);
                 break;
             case MecMsg::CONTROL :
-                c.control(
+                control(
                         msg.data_.control_.controlId_,
                         msg.data_.control_.value_);
                 break;
@@ -150,14 +373,20 @@ bool MsgQueue::process(ICallback &c) {
             case MecMsg::MEC_CONTROL :
                 if (msg.data_.mec_control_.cmd_ == MecMsg::SHUTDOWN) {
                     LOG_1("posting shutdown request");
-                    c.mec_control(ICallback::SHUTDOWN, nullptr);
+                    mec_control(ICallback::SHUTDOWN, nullptr);
                 }
+                break;
+            case MecMsg::FRAME_START :
+                frameStart(msg.data_.frame_.frameId_);
+                break;
+            case MecMsg::FRAME_END :
+                frameEnd(msg.data_.frame_.frameId_);
+                break;
             default:
-                LOG_0("MsgQueue::process unhandled message type");
+                LOG_0("ICallback::touchFrame unhandled message type");
         }
     }
-    return true;
 }
 
 
-}
\ No newline at end of file
+}
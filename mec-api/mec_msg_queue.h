@@ -1,11 +1,13 @@
 #ifndef MECMSGQUEUE_H
 #define MECMSGQUEUE_H
 
+#include <cstdint>
 #include <memory>
 
 namespace mec {
 
 class ICallback;
+class Notifier;
 
 struct MecMsg {
     enum type {
@@ -13,7 +15,9 @@ struct MecMsg {
         TOUCH_CONTINUE,
         TOUCH_OFF,
         CONTROL,
-        MEC_CONTROL
+        MEC_CONTROL,
+        FRAME_START,    // markers around the touches of one sensor frame, from devices which know their frames
+        FRAME_END
     } type_;
 
     enum mec_cmd {
@@ -33,22 +37,63 @@ struct MecMsg {
         struct {
             mec_cmd cmd_;
         } mec_control_;
+        struct {
+            unsigned frameId_;
+        } frame_;
     } data_;
+
+    // when the device handler created the message, in ns (see Latency), 0 if not stamped
+    uint64_t t_ = 0;
+};
+
+// contiguous run of messages, as drained from a device queue, e.g. all touches of a sensor frame
+struct MsgSpan {
+    MsgSpan(const MecMsg *data, unsigned size) : data_(data), size_(size) { ; }
+
+    const MecMsg *begin() const { return data_; }
+    const MecMsg *end() const { return data_ + size_; }
+    const MecMsg &operator[](unsigned i) const { return data_[i]; }
+    unsigned size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const MecMsg *data_;
+    unsigned size_;
 };
 
 class MsgQueue_impl;
 
+// bounded lock-free queue, between device threads (producers) and the thread calling MecApi::process (consumer)
+// - any number of producers may call addToQueue concurrently, only one thread may consume (nextMsg/process)
+// - capacity is rounded up to a power of 2
+// - when full, new messages are dropped (and counted), existing messages are never overwritten
 class MsgQueue {
 public:
-    MsgQueue();
+    static const unsigned DEFAULT_SIZE = 128;
+
+    MsgQueue(unsigned size = DEFAULT_SIZE);
     ~MsgQueue();
     bool addToQueue(MecMsg&);
+    // all or nothing, the consumer sees the frame whole (e.g. in one touchFrame), the notifier is signalled once
+    bool addFrameToQueue(const MecMsg *msgs, unsigned n);
     bool nextMsg(MecMsg&);
+    unsigned drain(MecMsg *msgs, unsigned max); // consumer, take up to max pending messages, returns count
     bool isEmpty();
     bool isFull();
     int  available();
     int  pending();
-    bool process(ICallback&);
+    bool process(ICallback&);   // drains pending messages, delivers as ICallback::touchFrame
+
+    // resize discards any pending messages, only use when no producer/consumer is active (e.g. in Device::init)
+    void resize(unsigned size);
+    unsigned capacity();
+
+    // signalled after each message is added, so the consumer can wait rather than poll
+    void setNotifier(Notifier*);
+
+    // overflow telemetry, safe to call from any thread
+    unsigned highWaterMark();
+    unsigned long dropped();
+    void resetStats();
 
 private:
     std::unique_ptr<MsgQueue_impl> impl_;
@@ -0,0 +1,47 @@
+#ifndef MEC_NOTIFIER_H
+#define MEC_NOTIFIER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace mec {
+
+// wakes the thread calling MecApi::process, when a device has new messages
+// notify() may be called from any thread, and is cheap once signalled (a single atomic exchange)
+// only the first notify() after a wait() returns takes the lock, so this only costs a syscall
+// when the consumer goes from 'no work' to 'work available'
+class Notifier {
+public:
+    Notifier() : signalled_(false) { ; }
+
+    void notify() {
+        if (!signalled_.exchange(true)) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            cond_.notify_one();
+        }
+    }
+
+    // wait until notified or timeout, returns true if notified
+    // clears the signal, so any notify() during subsequent processing will wake the next wait()
+    bool wait(std::chrono::milliseconds timeout) {
+        if (!signalled_.exchange(false)) {
+            std::unique_lock<std::mutex> lock(mtx_);
+            if (!cond_.wait_for(lock, timeout, [this] { return signalled_.load(); })) {
+                return false;
+            }
+            signalled_.exchange(false);
+        }
+        return true;
+    }
+
+private:
+    std::atomic<bool> signalled_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+};
+
+}
+
+#endif //MEC_NOTIFIER_H
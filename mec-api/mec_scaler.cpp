@@ -1,5 +1,18 @@
 #include "mec_scaler.h"
 
+#include "mec_log.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define MEC_SCALER_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define MEC_SCALER_NEON
+#include <arm_neon.h>
+#endif
+
 namespace mec {
 
 
@@ -46,8 +59,9 @@ const ScaleArray &Scales::getScale(const std::string &name) {
 Scaler::Scaler() :
         scale_(Scales::getScale("chromatic")),
         tonic_(0.0f),
-        rowOffset_(0.0f), columnOffset_(0.0f) {
-    ;
+        rowOffset_(0.0f), columnOffset_(0.0f),
+        pitchMode_(P_CONTINUOUS) {
+    compile();
 }
 
 Scaler::~Scaler() {
@@ -61,31 +75,166 @@ bool Scaler::load(const Preferences &prefs) {
     tonic_ = (float) prefs.getDouble("tonic", 0.0f);
     rowOffset_ = (float) prefs.getDouble("row offset", 0.0f);
     columnOffset_ = (float) prefs.getDouble("column offset", 0.0f);
+    pitchMode_ = prefs.getString("pitch mode", "continuous") == "quantized" ? P_QUANTIZED : P_CONTINUOUS;
+    compile();
 
     return true;
 }
 
-MusicalTouch Scaler::map(const Touch &t) const {
+void Scaler::compile() {
     // see notes above, important 12 note scale has 13 entries!
-    // think , row = string , column = fret
-    int ix = (int) t.c_;
-    int sz = (int) scale_.size() - 1;
-    int n = ix % sz;
+    unsigned sz = scale_.size();
+    if (sz > MAX_SCALE_SIZE + 1) {
+        LOG_0("Scaler: scale too large, truncated to " << MAX_SCALE_SIZE << " notes");
+        sz = MAX_SCALE_SIZE + 1;
+    }
 
-    float fx = t.c_ - ix;
+    if (sz < 2) {
+        // no (valid) scale, treat as chromatic
+        degrees_ = 1;
+        octave_ = 1.0f;
+        notes_[0] = 0.0f;
+        intervals_[0] = 1.0f;
+    } else {
+        degrees_ = sz - 1;
+        octave_ = scale_[degrees_];
+        for (unsigned i = 0; i < degrees_; i++) {
+            notes_[i] = scale_[i];
+            intervals_[i] = scale_[i + 1] - scale_[i];
+        }
+    }
+    invDegrees_ = 1.0f / (float) degrees_;
+}
 
-    float sn0 = scale_[n];
-    float sn1 = scale_[n + 1];
+MusicalTouch Scaler::map(const Touch &t) const {
+    // think , row = string , column = fret
+    float c = pitchMode_ == P_QUANTIZED ? std::floor(t.c_ + 0.5f) : t.c_;
+    float fix = std::floor(c);
+    float fx = c - fix;
 
-    float sn = sn0 + ((sn1 - sn0) * fx);
+    // octave, offset by half a degree to avoid rounding errors on degree boundaries
+    float oct = std::floor((fix + 0.5f) * invDegrees_);
+    int n = (int) (fix - (oct * degrees_));
+    if (n < 0) n = 0;
+    else if (n >= (int) degrees_) n = degrees_ - 1;
 
-    float note = ((ix / sz) * scale_[sz]) + sn;
+    float note = (oct * octave_) + (notes_[n] + (intervals_[n] * fx));
 
     note = columnOffset_ + (t.r_ * rowOffset_) + tonic_ + note;
 
     return MusicalTouch(t, note);
 }
 
+#if defined(MEC_SCALER_SSE)
+
+static inline __m128 floor_ps(__m128 x) {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+}
+
+#elif defined(MEC_SCALER_NEON)
+
+static inline float32x4_t floor_ps(float32x4_t x) {
+    float32x4_t t = vcvtq_f32_s32(vcvtq_s32_f32(x));
+    uint32x4_t gt = vcgtq_f32(t, x);
+    return vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(gt, vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))));
+}
+
+#endif
+
+void Scaler::mapBatch(const float *r, const float *c, float *note, unsigned n) const {
+    // same steps as map(), 4 touches at a time, only the table lookup is scalar
+    unsigned i = 0;
+    float maxDegree = (float) (degrees_ - 1);
+    int idx[4];
+    float sn[4], si[4];
+
+#if defined(MEC_SCALER_SSE)
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 inv = _mm_set1_ps(invDegrees_);
+    const __m128 deg = _mm_set1_ps((float) degrees_);
+    const __m128 octave = _mm_set1_ps(octave_);
+    const __m128 maxD = _mm_set1_ps(maxDegree);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 rowO = _mm_set1_ps(rowOffset_);
+    const __m128 colO = _mm_set1_ps(columnOffset_);
+    const __m128 tonic = _mm_set1_ps(tonic_);
+    for (; i + 4 <= n; i += 4) {
+        __m128 vc = _mm_loadu_ps(c + i);
+        if (pitchMode_ == P_QUANTIZED) vc = floor_ps(_mm_add_ps(vc, half));
+        __m128 fix = floor_ps(vc);
+        __m128 fx = _mm_sub_ps(vc, fix);
+        __m128 oct = floor_ps(_mm_mul_ps(_mm_add_ps(fix, half), inv));
+        __m128 deg_n = _mm_min_ps(_mm_max_ps(_mm_sub_ps(fix, _mm_mul_ps(oct, deg)), zero), maxD);
+        _mm_storeu_si128((__m128i *) idx, _mm_cvttps_epi32(deg_n));
+        for (unsigned j = 0; j < 4; j++) {
+            sn[j] = notes_[idx[j]];
+            si[j] = intervals_[idx[j]];
+        }
+        __m128 vn = _mm_add_ps(_mm_mul_ps(oct, octave),
+                               _mm_add_ps(_mm_loadu_ps(sn), _mm_mul_ps(_mm_loadu_ps(si), fx)));
+        __m128 base = _mm_add_ps(_mm_add_ps(colO, _mm_mul_ps(_mm_loadu_ps(r + i), rowO)), tonic);
+        _mm_storeu_ps(note + i, _mm_add_ps(base, vn));
+    }
+#elif defined(MEC_SCALER_NEON)
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const float32x4_t inv = vdupq_n_f32(invDegrees_);
+    const float32x4_t deg = vdupq_n_f32((float) degrees_);
+    const float32x4_t octave = vdupq_n_f32(octave_);
+    const float32x4_t maxD = vdupq_n_f32(maxDegree);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t rowO = vdupq_n_f32(rowOffset_);
+    const float32x4_t colO = vdupq_n_f32(columnOffset_);
+    const float32x4_t tonic = vdupq_n_f32(tonic_);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t vc = vld1q_f32(c + i);
+        if (pitchMode_ == P_QUANTIZED) vc = floor_ps(vaddq_f32(vc, half));
+        float32x4_t fix = floor_ps(vc);
+        float32x4_t fx = vsubq_f32(vc, fix);
+        float32x4_t oct = floor_ps(vmulq_f32(vaddq_f32(fix, half), inv));
+        float32x4_t deg_n = vminq_f32(vmaxq_f32(vsubq_f32(fix, vmulq_f32(oct, deg)), zero), maxD);
+        vst1q_s32(idx, vcvtq_s32_f32(deg_n));
+        for (unsigned j = 0; j < 4; j++) {
+            sn[j] = notes_[idx[j]];
+            si[j] = intervals_[idx[j]];
+        }
+        float32x4_t vn = vaddq_f32(vmulq_f32(oct, octave),
+                                   vaddq_f32(vld1q_f32(sn), vmulq_f32(vld1q_f32(si), fx)));
+        float32x4_t base = vaddq_f32(vaddq_f32(colO, vmulq_f32(vld1q_f32(r + i), rowO)), tonic);
+        vst1q_f32(note + i, vaddq_f32(base, vn));
+    }
+#else
+    (void) maxDegree;
+    (void) idx;
+    (void) sn;
+    (void) si;
+#endif
+
+    // remainder (or everything, without simd)
+    Touch t;
+    for (; i < n; i++) {
+        t.r_ = r[i];
+        t.c_ = c[i];
+        note[i] = map(t).note_;
+    }
+}
+
+void Scaler::mapBatch(const Touch *in, MusicalTouch *out, unsigned n) const {
+    static const unsigned CHUNK = 16;
+    float r[CHUNK], c[CHUNK], note[CHUNK];
+    for (unsigned i = 0; i < n; i += CHUNK) {
+        unsigned sz = std::min(CHUNK, n - i);
+        for (unsigned j = 0; j < sz; j++) {
+            r[j] = in[i + j].r_;
+            c[j] = in[i + j].c_;
+        }
+        mapBatch(r, c, note, sz);
+        for (unsigned j = 0; j < sz; j++) {
+            out[i + j] = MusicalTouch(in[i + j], note[j]);
+        }
+    }
+}
+
 float Scaler::getTonic() const {
     return tonic_;
 }
@@ -102,6 +251,10 @@ const ScaleArray &Scaler::getScale() const {
     return scale_;
 }
 
+Scaler::PitchMode Scaler::getPitchMode() const {
+    return pitchMode_;
+}
+
 void Scaler::setTonic(float f) {
     tonic_ = f;
 }
@@ -116,13 +269,19 @@ void Scaler::setColumnOffset(float f) {
     columnOffset_ = f;
 }
 
+void Scaler::setPitchMode(PitchMode m) {
+    pitchMode_ = m;
+}
+
 
 void Scaler::setScale(const ScaleArray &scale) {
     scale_ = scale;
+    compile();
 }
 
 void Scaler::setScale(const std::string &name) {
     scale_ = Scales::getScale(name);
+    compile();
 }
 
 
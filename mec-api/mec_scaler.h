@@ -26,6 +26,10 @@
 // a 12 note scales has 13 entries, we need this for the last interval, and also octave size.
 // we dont care what the last number is, it just has to be same tone as 0.0, but an octave higher
 // we use linear interp beween notes in scale
+//
+// when a scale is selected, it is compiled into fixed tables (note and interval to next note, per degree)
+// so mapping is a table lookup, and a frame of touches can be mapped in one pass with mapBatch (SSE/NEON where available)
+// pitch mode, continuous : interpolates between degrees, quantized : snaps to nearest degree
 
 
 
@@ -50,30 +54,52 @@ private:
 
 class Scaler {
 public:
+    static const unsigned MAX_SCALE_SIZE = 64;
+
+    enum PitchMode {
+        P_CONTINUOUS,
+        P_QUANTIZED
+    };
+
     Scaler();
     virtual ~Scaler();
     bool load(const Preferences &prefs);
 
     virtual MusicalTouch map(const Touch &t) const;
 
+    // map n touches at once, row/column in, note out (note may be same array as r or c)
+    void mapBatch(const float *r, const float *c, float *note, unsigned n) const;
+    void mapBatch(const Touch *in, MusicalTouch *out, unsigned n) const;
+
     float getTonic() const;
     float getRowOffset() const;
     float getColumnOffset() const;
     const ScaleArray &getScale() const;
+    PitchMode getPitchMode() const;
 
     void setTonic(float);
     void setRowOffset(float);
     void setColumnOffset(float);
+    void setPitchMode(PitchMode);
 
     void setScale(const ScaleArray &scale);
     void setScale(const std::string &name);
 
 private:
+    void compile();
+
+    ScaleArray scale_;
     float tonic_;
     float rowOffset_;
     float columnOffset_;
-
-    ScaleArray scale_;
+    PitchMode pitchMode_;
+
+    // compiled from scale_
+    unsigned degrees_;  // notes per octave (scale size - 1)
+    float invDegrees_;
+    float octave_;
+    float notes_[MAX_SCALE_SIZE];
+    float intervals_[MAX_SCALE_SIZE]; // to next degree
 };
 
 }
@@ -31,34 +31,90 @@ bool SurfaceManager::init(const Preferences &prefs) {
     for (std::string k : keys) {
         Preferences p(prefs.getSubTree(k));
         if (p.valid()) {
+            SurfaceID id = surfaceId(k);
             std::shared_ptr<Surface> pS;
             std::string type = p.getString("type", "");
             if (type.size() == 0) { // plain
-                pS.reset(new Surface(k));
+                pS.reset(new Surface(id));
             } else if (type == "join") {
-                pS.reset(new JoinedSurface(k));
+                pS.reset(new JoinedSurface(id));
             } else if (type == "split") {
-                pS.reset(new SplitSurface(k));
+                pS.reset(new SplitSurface(id));
             } else {
                 pS.reset();
                 LOG_0("SurfaceManager: surface def missing type");
             }
             if (pS) {
-                if (pS->load(p)) {
-                    surfaces_[k] = pS;
+                if (pS->load(p, *this)) {
+                    surfaces_[id] = pS;
                 } else {
                     pS.reset();
                 }
             }
         }
     }
-    return true;
+    return compile();
+}
+
+SurfaceID SurfaceManager::surfaceId(const std::string &name) {
+    auto it = ids_.find(name);
+    if (it != ids_.end()) return it->second;
+
+    SurfaceID id = static_cast<SurfaceID>(names_.size());
+    ids_[name] = id;
+    names_.push_back(name);
+    surfaces_.resize(names_.size());
+    routes_.resize(names_.size(), nullptr);
+    return id;
+}
+
+const std::string &SurfaceManager::surfaceName(SurfaceID id) const {
+    static const std::string unknown;
+    if (id >= names_.size()) return unknown;
+    return names_[id];
 }
 
 std::shared_ptr<Surface> SurfaceManager::getSurface(SurfaceID id) {
+    if (id >= surfaces_.size()) return nullptr;
     return surfaces_[id];
 }
 
+std::shared_ptr<Surface> SurfaceManager::getSurface(const std::string &name) {
+    auto it = ids_.find(name);
+    if (it == ids_.end()) return nullptr;
+    return surfaces_[it->second];
+}
+
+bool SurfaceManager::compile() {
+    // names may have been registered by surfaces during load
+    routes_.assign(names_.size(), nullptr);
+    for (auto pS : surfaces_) {
+        if (!pS) continue;
+        for (SurfaceID src : pS->sources()) {
+            if (src >= routes_.size()) continue;
+            if (routes_[src] != nullptr) {
+                LOG_0("SurfaceManager: surface " << surfaceName(src) << " already consumed, ignoring "
+                                                 << surfaceName(pS->getId()));
+                continue;
+            }
+            routes_[src] = pS.get();
+        }
+    }
+    return true;
+}
+
+Touch SurfaceManager::route(const Touch &t) const {
+    Touch out = t;
+    // depth guards against cycles in configuration
+    for (unsigned d = 0; d < MAX_ROUTE_DEPTH; d++) {
+        if (out.surface_ >= routes_.size()) break;
+        const Surface *pS = routes_[out.surface_];
+        if (pS == nullptr) break;
+        out = pS->map(out);
+    }
+    return out;
+}
+
 ////////////////////////////// Surface ////////////////////////////////////////
 
 
@@ -71,7 +127,7 @@ Surface::~Surface() {
     ;
 }
 
-bool Surface::load(const Preferences &prefs) {
+bool Surface::load(const Preferences &prefs, SurfaceManager &) {
     return prefs.valid();
 }
 
@@ -79,10 +135,22 @@ Touch Surface::map(const Touch &t) const {
     return t;
 }
 
+std::vector<SurfaceID> Surface::sources() const {
+    return std::vector<SurfaceID>();
+}
+
 SurfaceID Surface::getId() {
     return surfaceId_;
 }
 
+float Touch::*Surface::axis(const std::string &axis) {
+    if (axis == "y") return &Touch::y_;
+    else if (axis == "z") return &Touch::z_;
+    else if (axis == "r") return &Touch::r_;
+    else if (axis == "c") return &Touch::c_;
+    return &Touch::x_;
+}
+
 
 //const float UNDEFINED_SPLIT = -1.0f;
 //const float MIN_SPLIT = 0.0f;
@@ -92,7 +160,10 @@ SurfaceID Surface::getId() {
 
 
 SplitSurface::SplitSurface(SurfaceID surfaceId) :
-        Surface(surfaceId) {
+        Surface(surfaceId),
+        axis_(&Touch::x_),
+        source_(surfaceId),
+        splitPoint_(0.5f) {
     ;
 }
 
@@ -100,7 +171,7 @@ SplitSurface::~SplitSurface() {
     ;
 }
 
-bool SplitSurface::load(const Preferences &prefs) {
+bool SplitSurface::load(const Preferences &prefs, SurfaceManager &mgr) {
 
     if (!prefs.valid()) return false;
 
@@ -108,70 +179,34 @@ bool SplitSurface::load(const Preferences &prefs) {
 
     Preferences::Array array(prefs.getArray("surfaces"));
     for (unsigned i = 0; i < array.getSize(); i++) {
-        SurfaceID n = array.getString(i);
+        std::string n = array.getString(i);
         if (n.size() > 0) {
-            surfaces_.push_back(n);
+            surfaces_.push_back(mgr.surfaceId(n));
         }
     }
 
-    std::string axis = prefs.getString("axis", "");
-    if (axis.size() > 0) {
-        if (axis == "x") axis_ = C_X;
-        else if (axis == "y") axis_ = C_Y;
-        else if (axis == "z") axis_ = C_Z;
-        else if (axis == "r") axis_ = C_R;
-        else if (axis == "c") axis_ = C_C;
-        else axis_ = C_X;
-    } else {
-        axis_ = C_X;
-    }
+    // by default split touches on this surface, alternatively split another surface
+    std::string source = prefs.getString("source", "");
+    if (source.size() > 0) source_ = mgr.surfaceId(source);
 
+    axis_ = axis(prefs.getString("axis", "x"));
 
     return surfaces_.size() > 0;
 }
 
+std::vector<SurfaceID> SplitSurface::sources() const {
+    return std::vector<SurfaceID>(1, source_);
+}
+
 Touch SplitSurface::map(const Touch &t) const {
     // TODO
     // relationship between X-C , Y - R
     // touch id, needs to be voiced on surface
     Touch out = t;
-    unsigned n = 0;
-
-    switch (axis_) {
-        case C_X: {
-            n = static_cast<unsigned>(t.x_ / splitPoint_);
-            n = std::min<unsigned>(n, surfaces_.size() - 1);
-            out.x_ = t.x_ - (splitPoint_ * n);
-            break;
-        }
-        case C_Y: {
-            n = static_cast<unsigned>(static_cast<int>(t.y_ / splitPoint_));
-            n = std::min<unsigned>(n, surfaces_.size() - 1);
-            out.y_ = t.y_ - (splitPoint_ * n);
-            break;
-        }
-        case C_Z: {
-            n = static_cast<unsigned>(t.z_ / splitPoint_);
-            n = std::min<unsigned>(n, surfaces_.size() - 1);
-            out.z_ = t.z_ - (splitPoint_ * n);
-            break;
-        }
-        case C_R: {
-            n = static_cast<unsigned>(t.r_ / splitPoint_);
-            n = std::min<unsigned>(n, surfaces_.size() - 1);
-            out.r_ = t.r_ - (splitPoint_ * n);
-            break;
-        }
-        case C_C: {
-            n = static_cast<unsigned>(t.c_ / splitPoint_);
-            n = std::min<unsigned>(n, surfaces_.size() - 1);
-            out.c_ = t.c_ - (splitPoint_ * n);
-            break;
-        }
-        default:
-            LOG_0("SplitSurface : invalid axis");
-            break;
-    }
+    float v = t.*axis_;
+    unsigned n = v > 0.0f ? static_cast<unsigned>(v / splitPoint_) : 0;
+    n = std::min<unsigned>(n, surfaces_.size() - 1);
+    out.*axis_ = v - (splitPoint_ * n);
     out.surface_ = surfaces_[n];
     return out;
 }
@@ -181,7 +216,9 @@ Touch SplitSurface::map(const Touch &t) const {
 
 
 JoinedSurface::JoinedSurface(SurfaceID surfaceId) :
-        Surface(surfaceId) {
+        Surface(surfaceId),
+        axis_(&Touch::x_),
+        surfaceSize_(1.0f) {
     ;
 }
 
@@ -189,7 +226,7 @@ JoinedSurface::~JoinedSurface() {
     ;
 }
 
-bool JoinedSurface::load(const Preferences &prefs) {
+bool JoinedSurface::load(const Preferences &prefs, SurfaceManager &mgr) {
     if (!prefs.valid()) return false;
 
     // temp, this will come from the source surface
@@ -197,70 +234,37 @@ bool JoinedSurface::load(const Preferences &prefs) {
 
     Preferences::Array array(prefs.getArray("surfaces"));
     for (unsigned i = 0; i < array.getSize(); i++) {
-        SurfaceID n = array.getString(i);
+        std::string n = array.getString(i);
         if (n.size() > 0) {
-            surfaces_.push_back(n);
+            SurfaceID id = mgr.surfaceId(n);
+            if (id >= index_.size()) index_.resize(id + 1, -1);
+            index_[id] = static_cast<int>(surfaces_.size());
+            surfaces_.push_back(id);
         }
     }
 
-    std::string axis = prefs.getString("axis", "");
-    if (axis.size() > 0) {
-        if (axis == "x") axis_ = C_X;
-        else if (axis == "y") axis_ = C_Y;
-        else if (axis == "z") axis_ = C_Z;
-        else if (axis == "r") axis_ = C_R;
-        else if (axis == "c") axis_ = C_C;
-        else axis_ = C_X;
-    } else {
-        axis_ = C_X;
-    }
-
+    axis_ = axis(prefs.getString("axis", "x"));
 
     return surfaces_.size() > 0;
 }
 
+std::vector<SurfaceID> JoinedSurface::sources() const {
+    return surfaces_;
+}
+
 Touch JoinedSurface::map(const Touch &t) const {
     // TODO
     // use source surface for dimension,
     // relationship between X-C , Y - R
     // touch id, needs to be voiced on surface
     Touch out = t;
-    int idx = 0;
-    for (SurfaceID n : surfaces_) {
-        if (t.surface_ == n) {
-            switch (axis_) {
-                case C_X: {
-                    out.x_ = t.x_ + (surfaceSize_ * idx);
-                    break;
-                }
-                case C_Y: {
-                    out.y_ = t.y_ + (surfaceSize_ * idx);
-                    break;
-                }
-                case C_Z: {
-                    out.z_ = t.z_ + (surfaceSize_ * idx);
-                    break;
-                }
-                case C_R: {
-                    out.r_ = t.r_ + (surfaceSize_ * idx);
-                    break;
-                }
-                case C_C: {
-                    out.c_ = t.c_ + (surfaceSize_ * idx);
-                    break;
-                }
-                default:
-                    LOG_0("JoinedSurface : invalid axis");
-                    break;
-            }
+    if (t.surface_ >= index_.size()) return out;
+    int idx = index_[t.surface_];
+    if (idx < 0) return out;
 
-            out.surface_ = surfaceId_;
-            return out;
-        }
-        idx++;
-    }
+    out.*axis_ = t.*axis_ + (surfaceSize_ * idx);
+    out.surface_ = surfaceId_;
     return out;
 }
 
 } // namespace
-
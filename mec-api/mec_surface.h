@@ -9,10 +9,18 @@
 //
 // mapping between surfaces
 //
+// surfaces are named in the configuration, SurfaceManager assigns each name a SurfaceID (small integer)
+// when loaded, then builds a routing table indexed by SurfaceID, giving the surface which consumes
+// touches from that surface.
+// - a split consumes touches on its own id (or 'source' if specified), and outputs onto its 'surfaces'
+// - a join consumes touches from each of its 'surfaces', and outputs on its own id
+// so routing a touch is an array lookup per surface it passes through
 
 
 #include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace mec {
 
@@ -21,13 +29,29 @@ class Surface;
 
 class SurfaceManager {
 public:
+    static const unsigned MAX_ROUTE_DEPTH = 16;
+
     SurfaceManager();
     virtual ~SurfaceManager();
     bool init(const Preferences &prefs);
 
     std::shared_ptr<Surface> getSurface(SurfaceID id);
+    std::shared_ptr<Surface> getSurface(const std::string &name);
+
+    // name <-> id, surfaceId() registers unknown names
+    SurfaceID surfaceId(const std::string &name);
+    const std::string &surfaceName(SurfaceID id) const;
+
+    // pass touch through routing table until it reaches a surface with no consumer
+    Touch route(const Touch &t) const;
+
 private:
-    std::map<SurfaceID, std::shared_ptr<Surface>> surfaces_;
+    bool compile();
+
+    std::map<std::string, SurfaceID> ids_;  // only used at configuration time
+    std::vector<std::string> names_;
+    std::vector<std::shared_ptr<Surface>> surfaces_; // by SurfaceID
+    std::vector<const Surface *> routes_;    // by SurfaceID, consumer of touches on that surface
 };
 
 
@@ -37,10 +61,15 @@ public:
     virtual ~Surface();
 
     SurfaceID getId();
-    virtual bool load(const Preferences &prefs);
+    virtual bool load(const Preferences &prefs, SurfaceManager &mgr);
     virtual Touch map(const Touch &) const;
 
+    // surfaces this surface consumes touches from
+    virtual std::vector<SurfaceID> sources() const;
+
 protected:
+    static float Touch::*axis(const std::string &axis);
+
     SurfaceID surfaceId_;
 };
 
@@ -50,18 +79,14 @@ public:
     SplitSurface(SurfaceID surfaceId);
     virtual ~SplitSurface();
 
-    virtual bool load(const Preferences &prefs) override;
+    virtual bool load(const Preferences &prefs, SurfaceManager &mgr) override;
     virtual Touch map(const Touch &) const override;
+    virtual std::vector<SurfaceID> sources() const override;
 
 private:
-    enum {
-        C_X,
-        C_Y,
-        C_Z,
-        C_R,
-        C_C
-    } axis_;
+    float Touch::*axis_;
     std::vector<SurfaceID> surfaces_;
+    SurfaceID source_;
     float splitPoint_;
 };
 
@@ -73,21 +98,17 @@ public:
     JoinedSurface(SurfaceID surfaceId);
     virtual ~JoinedSurface();
 
-    virtual bool load(const Preferences &prefs) override;
+    virtual bool load(const Preferences &prefs, SurfaceManager &mgr) override;
     virtual Touch map(const Touch &) const override;
+    virtual std::vector<SurfaceID> sources() const override;
 
 private:
-    enum {
-        C_X,
-        C_Y,
-        C_Z,
-        C_R,
-        C_C
-    } axis_;
+    float Touch::*axis_;
     std::vector<SurfaceID> surfaces_;
+    std::vector<int> index_;    // by source SurfaceID, position in surfaces_, -1 if not a member
     float surfaceSize_;
 };
 
 }
 
-#endif //MEC_SURFACE_H
\ No newline at end of file
+#endif //MEC_SURFACE_H
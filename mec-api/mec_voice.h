@@ -2,8 +2,8 @@
 #define MEC_VOICES_H_
 
 #include <math.h>
+#include <string>
 #include <vector>
-#include <list>
 
 #include "mec_log.h"
 
@@ -14,13 +14,26 @@ public:
     const float V_SCALE_AMT = 4.0f;
     const float V_CURVE_AMT = 1.0f;
 
-    Voices(unsigned voiceCount = 15, unsigned velocityCount = 5)
-            : maxVoices_(voiceCount), velocityCount_(velocityCount) {
+    // default size of touch id -> voice table, ids outside this are still supported, but need a search
+    static const unsigned DEFAULT_MAX_TOUCH_ID = 256;
+
+    // which voice stealVoice() selects, when all voices are in use
+    enum StealPolicy {
+        STEAL_OLDEST,
+        STEAL_QUIETEST,
+        STEAL_HIGHEST,
+        STEAL_LOWEST
+    };
+
+    Voices(unsigned voiceCount = 15, unsigned velocityCount = 5, unsigned maxTouchId = DEFAULT_MAX_TOUCH_ID)
+            : maxVoices_(voiceCount), velocityCount_(velocityCount), stealPolicy_(STEAL_OLDEST) {
         voices_.resize(maxVoices_);
-        for (int i = 0; i < maxVoices_; i++) {
-            voices_[i].i_ = i;
+        touchIdx_.resize(maxTouchId, nullptr);
+        for (unsigned i = 0; i < maxVoices_; i++) {
+            voices_[i].i_ = static_cast<int>(i);
             voices_[i].state_ = Voice::INACTIVE;
             voices_[i].id_ = -1;
+            voices_[i].prev_ = voices_[i].next_ = nullptr;
             freeVoices_.push_back(&voices_[i]);
         }
 
@@ -51,23 +64,41 @@ public:
             float scale_, curve_; // comes from config
             float raw_;
         } vel_;
+
+        // intrusive links, for free/used list
+        Voice *prev_;
+        Voice *next_;
     };
 
+    static StealPolicy stealPolicy(const std::string &name) {
+        if (name == "quietest") return STEAL_QUIETEST;
+        if (name == "highest") return STEAL_HIGHEST;
+        if (name == "lowest") return STEAL_LOWEST;
+        return STEAL_OLDEST;
+    }
+
+    void setStealPolicy(StealPolicy p) { stealPolicy_ = p; }
+
+    StealPolicy getStealPolicy() const { return stealPolicy_; }
+
     Voice *voiceId(unsigned id) {
-        for (int i = 0; i < maxVoices_; i++) {
-            if (voices_[i].id_ == id)
-                return &voices_[i];
+        if (id < touchIdx_.size()) return touchIdx_[id];
+
+        for (Voice *voice = usedVoices_.head_; voice != nullptr; voice = voice->next_) {
+            if (voice->id_ == static_cast<int>(id))
+                return voice;
         }
         return NULL;
     }
 
+    // an id already active keeps its voice
     Voice *startVoice(unsigned id) {
-        Voice *voice;
-        if (freeVoices_.size() > 0) {
-            voice = freeVoices_.front();
-            freeVoices_.pop_front();
-        } else {
-            // all voices used, use oldestActiveVoice
+        Voice *voice = voiceId(id);
+        if (voice) return voice;
+
+        voice = freeVoices_.pop_front();
+        if (!voice) {
+            // all voices used, use stealVoice/oldestActiveVoice
             // if you wish to steal it
             return NULL;
         }
@@ -91,6 +122,7 @@ public:
 
 
         usedVoices_.push_back(voice);
+        if (id < touchIdx_.size()) touchIdx_[id] = voice;
         return voice;
     }
 
@@ -130,8 +162,9 @@ public:
     }
 
     void stopVoice(Voice *voice) {
-        if (!voice) return;
+        if (!voice || voice->state_ == Voice::INACTIVE) return;
         usedVoices_.remove(voice);
+        if (voice->id_ >= 0 && (unsigned) voice->id_ < touchIdx_.size()) touchIdx_[voice->id_] = nullptr;
         voice->id_ = -1;
         voice->note_ = 0;
         voice->x_ = 0;
@@ -143,16 +176,78 @@ public:
     }
 
     Voice *oldestActiveVoice() {
-        return usedVoices_.front();
+        return usedVoices_.head_;
     }
 
+    // voice to steal according to steal policy, caller is responsible for stopping it
+    // oldest is O(1), other policies check each used voice (so bounded by voice count)
+    Voice *stealVoice() {
+        Voice *steal = usedVoices_.head_;
+        if (stealPolicy_ == STEAL_OLDEST || steal == nullptr) return steal;
+
+        for (Voice *voice = steal->next_; voice != nullptr; voice = voice->next_) {
+            switch (stealPolicy_) {
+                case STEAL_QUIETEST:
+                    if (voice->z_ < steal->z_) steal = voice;
+                    break;
+                case STEAL_HIGHEST:
+                    if (voice->note_ > steal->note_) steal = voice;
+                    break;
+                case STEAL_LOWEST:
+                    if (voice->note_ < steal->note_) steal = voice;
+                    break;
+                default:
+                    break;
+            }
+        }
+        return steal;
+    }
+
+    unsigned activeCount() const { return usedVoices_.size_; }
+
+    unsigned freeCount() const { return freeVoices_.size_; }
 
 private:
+    // intrusive doubly linked list, head is oldest
+    struct VoiceList {
+        VoiceList() : head_(nullptr), tail_(nullptr), size_(0) { ; }
+
+        void push_back(Voice *v) {
+            v->next_ = nullptr;
+            v->prev_ = tail_;
+            if (tail_) tail_->next_ = v;
+            else head_ = v;
+            tail_ = v;
+            size_++;
+        }
+
+        Voice *pop_front() {
+            Voice *v = head_;
+            if (v) remove(v);
+            return v;
+        }
+
+        void remove(Voice *v) {
+            if (v->prev_) v->prev_->next_ = v->next_;
+            else head_ = v->next_;
+            if (v->next_) v->next_->prev_ = v->prev_;
+            else tail_ = v->prev_;
+            v->prev_ = v->next_ = nullptr;
+            size_--;
+        }
+
+        Voice *head_;
+        Voice *tail_;
+        unsigned size_;
+    };
+
     std::vector<Voice> voices_;
-    std::list<Voice *> freeVoices_;
-    std::list<Voice *> usedVoices_;
+    std::vector<Voice *> touchIdx_;
+    VoiceList freeVoices_;
+    VoiceList usedVoices_;
     unsigned maxVoices_;
     unsigned velocityCount_;
+    StealPolicy stealPolicy_;
 };
 }
 
@@ -5,7 +5,7 @@
 
 namespace mec {
 
-Midi_Processor::Midi_Processor(float pbr) : pitchbendRange_ (pbr) {
+Midi_Processor::Midi_Processor(float pbr) : pitchbendRange_ (pbr), inFrame_(false) {
     ;
 }
 
@@ -17,8 +17,60 @@ void Midi_Processor::setPitchbendRange(float v) {
     pitchbendRange_ = v;
 }
 
+void Midi_Processor::process(const MidiBuffer& buf) {
+    buf.forEach([this](const unsigned char *data, unsigned size) {
+        MidiMsg msg;
+        for (unsigned i = 0; i < size; i++) msg.data[i] = static_cast<char>(data[i]);
+        msg.size = size;
+        process(msg);
+    });
+}
+
+void Midi_Processor::send(unsigned char status, unsigned char d1, unsigned char d2) {
+    if (inFrame_) {
+        // full buffer is flushed early, rather than dropping
+        if (!buffer_.fits(status)) {
+            process(buffer_);
+            buffer_.clear();
+        }
+        buffer_.add(status, d1, d2);
+        return;
+    }
+    MidiMsg msg(static_cast<char>(status), static_cast<char>(d1), static_cast<char>(d2));
+    process(msg);
+}
+
+void Midi_Processor::send(unsigned char status, unsigned char d1) {
+    if (inFrame_) {
+        if (!buffer_.fits(status)) {
+            process(buffer_);
+            buffer_.clear();
+        }
+        buffer_.add(status, d1);
+        return;
+    }
+    MidiMsg msg(static_cast<char>(status), static_cast<char>(d1));
+    process(msg);
+}
+
 /////////////////////////
 // ICallback interface
+void Midi_Processor::touchFrame(const MsgSpan &msgs) {
+    inFrame_ = true;
+    ICallback::touchFrame(msgs);
+    // devices without frame markers, the span is the frame
+    flushVoices();
+    inFrame_ = false;
+    if (!buffer_.empty()) {
+        process(buffer_);
+        buffer_.clear();
+    }
+}
+
+void Midi_Processor::frameEnd(unsigned) {
+    flushVoices();
+}
+
 void Midi_Processor::touchOn(int id, float note, float , float , float z) {
     unsigned ch = static_cast<unsigned int>(id);
     unsigned mz = unipolar7bit(z);
@@ -53,37 +105,32 @@ void Midi_Processor::mec_control(int , void* ) {
 
 bool Midi_Processor::noteOn(unsigned ch, unsigned note, unsigned vel) {
     // LOG_1( "midi note on ch " << ch << " note " << note  << " vel " << vel );
-    MidiMsg msg(static_cast<char>(0x90 + ch), static_cast<char>(note), static_cast<char>(vel));
-    process(msg);
+    send(static_cast<unsigned char>(0x90 + ch), static_cast<unsigned char>(note), static_cast<unsigned char>(vel));
     return true;
 }
 
 
 bool Midi_Processor::noteOff(unsigned ch, unsigned note, unsigned vel) {
     // LOG_1( "midi  note off ch " << ch << " note " << note  << " vel " << vel )
-    MidiMsg msg(static_cast<char>(0x80 + ch), static_cast<char>(note), static_cast<char>(vel));
-    process(msg);
+    send(static_cast<unsigned char>(0x80 + ch), static_cast<unsigned char>(note), static_cast<unsigned char>(vel));
     return true;
 }
 
 bool Midi_Processor::cc(unsigned ch, unsigned cc, unsigned v) {
     // LOG_1( "midi note off ch " << ch << " note " << note  << " vel " << vel )
-    MidiMsg msg(static_cast<char>(0xB0 + ch), static_cast<char>(cc), static_cast<char>(v));
-    process(msg);
+    send(static_cast<unsigned char>(0xB0 + ch), static_cast<unsigned char>(cc), static_cast<unsigned char>(v));
     return true;
 }
 
 bool Midi_Processor::pressure(unsigned ch, unsigned v) {
     // LOG_1( "midi pressure ch " << ch << " v  " << v)
-    MidiMsg msg(static_cast<char>(0xD0 + ch),static_cast<char>(v));
-    process(msg);
+    send(static_cast<unsigned char>(0xD0 + ch), static_cast<unsigned char>(v));
     return true;
 }
 
 bool Midi_Processor::pitchbend(unsigned ch, unsigned v) {
     // LOG_1( "midi pitchbend ch " << ch << " v  " << v)
-    MidiMsg msg(static_cast<char>(0xE0 + ch), static_cast<char>(v & 0x7f), static_cast<char>((v & 0x3F80) >> 7));
-    process(msg);
+    send(static_cast<unsigned char>(0xE0 + ch), static_cast<unsigned char>(v & 0x7f), static_cast<unsigned char>((v & 0x3F80) >> 7));
     return true;
 }
 
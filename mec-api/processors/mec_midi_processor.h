@@ -5,6 +5,7 @@
 // define the process method to determine what to do with the midi message
 
 #include "../mec_api.h"
+#include "../mec_midi_buffer.h"
 
 #include <list>
 
@@ -27,17 +28,34 @@ public:
 
 
     virtual void  process(MidiMsg& msg) = 0;
+    // all messages generated by a touchFrame, by default passed on individually to process(MidiMsg&)
+    // override to write them in one go
+    virtual void  process(const MidiBuffer& buf);
     void setPitchbendRange(float pbr);
 
     // ICallback handling
+    virtual void touchFrame(const MsgSpan &msgs);
+    virtual void frameEnd(unsigned frameId);
     virtual void touchOn(int touchId, float note, float x, float y, float z);
     virtual void touchContinue(int touchId, float note, float x, float y, float z);
     virtual void touchOff(int touchId, float note, float x, float y, float z);
     virtual void control(int ctrlId, float v);
     virtual void mec_control(int cmd, void* other); //ignores
 
+    // messages discarded whilst batching a touchFrame, not those sent early because the batch was full
+    unsigned long dropped() const { return buffer_.dropped(); }
+
 protected:
 
+    // called at the end of each sensor frame (FRAME_END), and of each touchFrame,
+    // for processors which coalesce updates per voice, to send them
+    virtual void flushVoices() { ; }
+    bool inFrame() const { return inFrame_; }
+
+    // queued whilst handling a touchFrame, otherwise processed immediately
+    void send(unsigned char status, unsigned char d1, unsigned char d2);
+    void send(unsigned char status, unsigned char d1);
+
     // low level midi, open unchecked
     bool noteOn(unsigned ch, unsigned note, unsigned vel);
     bool noteOff(unsigned ch, unsigned note, unsigned vel);
@@ -51,6 +69,10 @@ protected:
 
     float global_[127];
     float pitchbendRange_;
+
+private:
+    MidiBuffer buffer_;
+    bool inFrame_;
 };
 
 }
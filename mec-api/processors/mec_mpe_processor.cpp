@@ -7,7 +7,7 @@ namespace mec {
 
 #define TIMBRE_CC 74
 
-MPE_Processor::MPE_Processor(float pbr) : Midi_Processor(pbr) {
+MPE_Processor::MPE_Processor(float pbr) : Midi_Processor(pbr), pendingVoices_(0) {
     ;
 }
 
@@ -20,6 +20,7 @@ MPE_Processor::~MPE_Processor() {
 void MPE_Processor::touchOn(int id, float note, float x, float y, float z) {
 
     VoiceData& voice = voices_[id];
+    pendingVoices_ &= ~(1u << id);
 
     unsigned ch = id + 1; // MPE starts on 2
     voice.startNote_ = (note + 0.4999999) ; //int
@@ -53,7 +54,6 @@ void MPE_Processor::touchOn(int id, float note, float x, float y, float z) {
 void MPE_Processor::touchContinue(int id, float note, float x, float y, float z) {
 
     VoiceData& voice = voices_[id];
-    unsigned ch = id + 1; // MPE starts on 2
     // unsigned mx = bipolar14bit(x);
     int my = bipolar7bit(y);
     unsigned mz = unipolar7bit(z);
@@ -70,13 +70,27 @@ void MPE_Processor::touchContinue(int id, float note, float x, float y, float z)
 
     voice.note_ = note;
 
+    if (inFrame()) {
+        // latest wins, sent by flushVoices
+        voice.pendingPitchbend_ = pb;
+        voice.pendingTimbre_ = my;
+        voice.pendingPressure_ = mz;
+        pendingVoices_ |= (1u << id);
+        return;
+    }
+    sendContinue(id, pb, my, mz);
+}
+
+void MPE_Processor::sendContinue(unsigned id, int pb, int timbre, unsigned mz) {
+    VoiceData& voice = voices_[id];
+    unsigned ch = id + 1; // MPE starts on 2
     if (voice.pitchbend_ != pb) {
         voice.pitchbend_ = pb;
         pitchbend(ch, pb) ;
     }
-    if (voice.timbre_ != my) {
-        voice.timbre_ = my;
-        cc(ch, TIMBRE_CC, my);
+    if (voice.timbre_ != timbre) {
+        voice.timbre_ = timbre;
+        cc(ch, TIMBRE_CC, timbre);
     }
     if (voice.pressure_ != mz) {
         voice.pressure_ = mz;
@@ -84,8 +98,24 @@ void MPE_Processor::touchContinue(int id, float note, float x, float y, float z)
     }
 }
 
+void MPE_Processor::flushVoice(unsigned id) {
+    uint32_t bit = 1u << id;
+    if (!(pendingVoices_ & bit)) return;
+    pendingVoices_ &= ~bit;
+    VoiceData& voice = voices_[id];
+    sendContinue(id, voice.pendingPitchbend_, voice.pendingTimbre_, voice.pendingPressure_);
+}
+
+void MPE_Processor::flushVoices() {
+    for (unsigned id = 0; pendingVoices_ != 0 && id < MAX_VOICES; id++) {
+        flushVoice(id);
+    }
+}
+
 void MPE_Processor::touchOff(int id, float note, float x, float y, float z) {
 
+    // last position before the off
+    flushVoice(id);
     VoiceData& voice = voices_[id];
 
     unsigned ch = id + 1; // MPE starts on 2
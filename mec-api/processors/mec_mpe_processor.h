@@ -23,7 +23,12 @@ public:
     virtual void control(int ctrlId, float v);
     virtual void mec_control(int cmd, void* other); //ignores
 
+protected:
+    // within a frame, continues are coalesced, so each voice sends at most one update per frame
+    virtual void flushVoices();
+
 private:
+    static const unsigned MAX_VOICES = 16;
 
     struct VoiceData {
         unsigned    startNote_;
@@ -31,9 +36,18 @@ private:
         int         pitchbend_; //1
         int         timbre_;    //2
         unsigned    pressure_;  //3
+
+        // latest continue in this frame, not yet sent
+        int         pendingPitchbend_;
+        int         pendingTimbre_;
+        unsigned    pendingPressure_;
     };
 
-    VoiceData voices_[16];
+    void sendContinue(unsigned id, int pb, int timbre, unsigned mz);
+    void flushVoice(unsigned id);
+
+    VoiceData voices_[MAX_VOICES];
+    uint32_t pendingVoices_; // bit per voice
 };
 
 }
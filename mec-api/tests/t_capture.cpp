@@ -0,0 +1,399 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cJSON.h>
+#include <mec_capture.h>
+#include <mec_log.h>
+#include <mec_midi_buffer.h>
+#include <mec_voice.h>
+#include <processors/mec_mpe_processor.h>
+
+// checks the capture format, recorder and replay device
+// benchmark: the synthetic captures replayed through MecApi at maximum speed, into
+// a null callback (api and queue only), an MPE processor, and voice allocation followed by MPE
+// replay is deterministic, so results are comparable between runs and machines
+
+typedef std::chrono::steady_clock Clock;
+
+static const unsigned BENCH_SECONDS = 20;
+
+bool sameMsg(const mec::MecMsg &a, const mec::MecMsg &b) {
+    if (a.type_ != b.type_) return false;
+    switch (a.type_) {
+        case mec::MecMsg::TOUCH_ON:
+        case mec::MecMsg::TOUCH_CONTINUE:
+        case mec::MecMsg::TOUCH_OFF:
+            return a.data_.touch_.touchId_ == b.data_.touch_.touchId_
+                   && a.data_.touch_.note_ == b.data_.touch_.note_
+                   && a.data_.touch_.x_ == b.data_.touch_.x_
+                   && a.data_.touch_.y_ == b.data_.touch_.y_
+                   && a.data_.touch_.z_ == b.data_.touch_.z_;
+        case mec::MecMsg::CONTROL:
+            return a.data_.control_.controlId_ == b.data_.control_.controlId_
+                   && a.data_.control_.value_ == b.data_.control_.value_;
+        case mec::MecMsg::MEC_CONTROL:
+            return a.data_.mec_control_.cmd_ == b.data_.mec_control_.cmd_;
+        case mec::MecMsg::FRAME_START:
+        case mec::MecMsg::FRAME_END:
+            return a.data_.frame_.frameId_ == b.data_.frame_.frameId_;
+    }
+    return false;
+}
+
+bool sameCapture(const mec::Capture &a, const mec::Capture &b) {
+    if (a.frameCount() != b.frameCount() || a.msgCount() != b.msgCount()) return false;
+    for (unsigned i = 0; i < a.frameCount(); i++) {
+        if (a.frameTime(i) != b.frameTime(i)) return false;
+        mec::MsgSpan fa = a.frame(i), fb = b.frame(i);
+        if (fa.size() != fb.size()) return false;
+        for (unsigned j = 0; j < fa.size(); j++) {
+            if (!sameMsg(fa[j], fb[j])) return false;
+        }
+    }
+    return true;
+}
+
+// touches are balanced, every on has an off (or is still held at the end), per touch id
+void checkBalanced(const mec::Capture &c) {
+    bool on[16] = {false};
+    for (unsigned i = 0; i < c.frameCount(); i++) {
+        for (const mec::MecMsg &m : c.frame(i)) {
+            int id = m.data_.touch_.touchId_;
+            assert(id >= 0 && id < 16);
+            switch (m.type_) {
+                case mec::MecMsg::TOUCH_ON: assert(!on[id]); on[id] = true; break;
+                case mec::MecMsg::TOUCH_CONTINUE: assert(on[id]); break;
+                case mec::MecMsg::TOUCH_OFF: assert(on[id]); on[id] = false; break;
+                default: break;
+            }
+        }
+    }
+}
+
+void checkFormat() {
+    const char *names[] = {"chords", "glissandi", "stress"};
+    for (const char *name : names) {
+        mec::Capture c;
+        assert(mec::Capture::synthetic(c, name, 3));
+        // frames with nothing down are not kept
+        assert(c.frameCount() > 0 && c.frameCount() <= 3000);
+        assert(c.duration() < 3000000);
+        assert(c.msgCount() > 0);
+        checkBalanced(c);
+
+        std::stringstream ss;
+        assert(c.write(ss));
+        std::string data = ss.str();
+        std::stringstream in(data);
+        mec::Capture r;
+        assert(r.read(in));
+        assert(sameCapture(c, r));
+
+        // truncated
+        std::stringstream shortIn(data.substr(0, data.size() - 3));
+        assert(!r.read(shortIn));
+        assert(r.frameCount() == 0);
+
+        LOG_0(name << " frames " << c.frameCount() << " msgs " << c.msgCount()
+                   << " file " << data.size() << " bytes"
+                   << " (" << data.size() / c.frameCount() << " bytes/frame)");
+    }
+    mec::Capture c;
+    assert(!mec::Capture::synthetic(c, "unknown", 1));
+
+    // stress, all 16 fingers down in every frame except on retrigger
+    mec::Capture::stress(c, 1);
+    assert(c.frameCount() == 1000);
+    assert(c.maxFrameSize() == 16);
+
+    // bad magic, and unsupported version
+    std::stringstream ss;
+    c.write(ss);
+    std::string data = ss.str();
+    data[0] = 'X';
+    std::stringstream badMagic(data);
+    assert(!c.read(badMagic));
+    data = ss.str();
+    data[4] = 9;
+    std::stringstream badVersion(data);
+    assert(!c.read(badVersion));
+
+    // frame markers are dropped, the touches between them are kept as one frame
+    {
+        mec::MecMsg msgs[4];
+        msgs[0].type_ = mec::MecMsg::FRAME_START;
+        msgs[0].data_.frame_.frameId_ = 7;
+        msgs[1].type_ = mec::MecMsg::TOUCH_ON;
+        msgs[1].data_.touch_ = {1, 60.0f, 0.5f, 0.5f, 0.8f};
+        msgs[2].type_ = mec::MecMsg::TOUCH_ON;
+        msgs[2].data_.touch_ = {2, 64.0f, 0.25f, 0.5f, 0.6f};
+        msgs[3].type_ = mec::MecMsg::FRAME_END;
+        msgs[3].data_.frame_.frameId_ = 7;
+        mec::Capture m;
+        m.addFrame(0, mec::MsgSpan(msgs, 4));
+        m.addFrame(1000, mec::MsgSpan(msgs + 3, 1));
+        assert(m.frameCount() == 1 && m.msgCount() == 2);
+        assert(sameMsg(m.frame(0)[0], msgs[1]) && sameMsg(m.frame(0)[1], msgs[2]));
+        std::stringstream ms;
+        assert(m.write(ms));
+        mec::Capture mr;
+        assert(mr.read(ms));
+        assert(sameCapture(m, mr));
+    }
+
+    // files
+    mec::Capture::chords(c, 1);
+    const char *file = "t_capture.mecc";
+    assert(c.save(file));
+    assert(mec::Capture::isCapture(file));
+    mec::Capture loaded;
+    assert(loaded.load(file));
+    assert(sameCapture(c, loaded));
+    remove(file);
+    assert(!mec::Capture::isCapture(file));
+    assert(!loaded.load(file));
+}
+
+void checkRecorder() {
+    mec::CaptureRecorder rec;
+    rec.touchOn(1, 60.0f, 0.0f, 0.5f, 0.7f);
+
+    mec::MecMsg msgs[3];
+    msgs[0].type_ = mec::MecMsg::TOUCH_CONTINUE;
+    msgs[0].data_.touch_.touchId_ = 1;
+    msgs[0].data_.touch_.note_ = 60.5f;
+    msgs[0].data_.touch_.x_ = msgs[0].data_.touch_.y_ = msgs[0].data_.touch_.z_ = 0.5f;
+    msgs[1].type_ = mec::MecMsg::MEC_CONTROL;
+    msgs[1].data_.mec_control_.cmd_ = mec::MecMsg::PING;
+    msgs[2].type_ = mec::MecMsg::CONTROL;
+    msgs[2].data_.control_.controlId_ = 7;
+    msgs[2].data_.control_.value_ = 0.25f;
+    rec.touchFrame(mec::MsgSpan(msgs, 3));
+    rec.mec_control(mec::ICallback::SHUTDOWN, nullptr);
+    rec.touchOff(1, 60.5f, 0.0f, 0.5f, 0.0f);
+
+    mec::Capture &c = rec.capture();
+    assert(c.frameCount() == 3);
+    assert(c.msgCount() == 4);
+    assert(c.frameTime(0) == 0);
+    assert(c.frame(0)[0].type_ == mec::MecMsg::TOUCH_ON);
+    assert(c.frame(1).size() == 2);
+    assert(sameMsg(c.frame(1)[0], msgs[0]));
+    assert(sameMsg(c.frame(1)[1], msgs[2]));
+    assert(c.frame(2)[0].type_ == mec::MecMsg::TOUCH_OFF);
+    assert(c.frameTime(2) >= c.frameTime(1));
+
+    rec.reset();
+    assert(rec.capture().frameCount() == 0);
+}
+
+// counts what MecApi delivers, and stops on shutdown
+class CountCallback : public mec::Callback {
+public:
+    CountCallback() : msgs_(0), frames_(0), shutdown_(false) { ; }
+
+    void touchFrame(const mec::MsgSpan &msgs) override {
+        frames_++;
+        for (const mec::MecMsg &m : msgs) {
+            if (m.type_ == mec::MecMsg::MEC_CONTROL) {
+                if (m.data_.mec_control_.cmd_ == mec::MecMsg::SHUTDOWN) shutdown_ = true;
+            } else {
+                msgs_++;
+            }
+        }
+    }
+
+    unsigned long msgs_;
+    unsigned long frames_;
+    bool shutdown_;
+};
+
+// MPE into a null output, keeping the bytes, so replays can be compared
+class NullMpe : public mec::MPE_Processor {
+public:
+    NullMpe() : shutdown_(false) { ; }
+
+    void process(mec::MPE_Processor::MidiMsg &m) override {
+        bytes_.insert(bytes_.end(), m.data, m.data + m.size);
+    }
+
+    void process(const mec::MidiBuffer &buf) override {
+        bytes_.insert(bytes_.end(), buf.data(), buf.data() + buf.size());
+    }
+
+    void mec_control(int cmd, void *) override {
+        if (cmd == mec::ICallback::SHUTDOWN) shutdown_ = true;
+    }
+
+    std::vector<unsigned char> bytes_;
+    bool shutdown_;
+};
+
+// touch ids to voices, as devices do, then on to MPE
+// the stress capture has more fingers than voices, so some touches are not voiced
+class VoiceMpe : public mec::Callback {
+public:
+    VoiceMpe() : unvoiced_(0) { ; }
+
+    void touchOn(int touchId, float note, float x, float y, float z) override {
+        mec::Voices::Voice *voice = voices_.startVoice(touchId);
+        if (!voice) {
+            unvoiced_++;
+            return;
+        }
+        mpe_.touchOn(voice->i_, note, x, y, z);
+    }
+
+    void touchContinue(int touchId, float note, float x, float y, float z) override {
+        mec::Voices::Voice *voice = voices_.voiceId(touchId);
+        if (voice) mpe_.touchContinue(voice->i_, note, x, y, z);
+    }
+
+    void touchOff(int touchId, float note, float x, float y, float z) override {
+        mec::Voices::Voice *voice = voices_.voiceId(touchId);
+        if (!voice) return;
+        mpe_.touchOff(voice->i_, note, x, y, z);
+        voices_.stopVoice(voice);
+    }
+
+    void mec_control(int cmd, void *other) override {
+        mpe_.mec_control(cmd, other);
+    }
+
+    mec::Voices voices_;
+    NullMpe mpe_;
+    unsigned long unvoiced_;
+};
+
+std::string replayPrefs(const std::string &source, unsigned seconds, bool realtime) {
+    std::string prefs = "{ \"mec\" : { \"replay\" : { ";
+    if (source.find(".mecc") != std::string::npos) {
+        prefs += "\"file\" : \"" + source + "\"";
+    } else {
+        prefs += "\"synthetic\" : \"" + source + "\", \"seconds\" : " + std::to_string(seconds);
+    }
+    prefs += std::string(", \"realtime\" : ") + (realtime ? "true" : "false") + ", \"shutdown\" : true } } }";
+    return prefs;
+}
+
+// replays through MecApi until the device requests shutdown, returns elapsed seconds
+double replay(const std::string &source, unsigned seconds, bool realtime, mec::ICallback &cb, const bool &shutdown) {
+    cJSON *json = cJSON_Parse(replayPrefs(source, seconds, realtime).c_str());
+    assert(json != nullptr);
+    double secs;
+    {
+        mec::MecApi api(json);
+        api.subscribe(&cb);
+        api.init();
+        auto start = Clock::now();
+        while (!shutdown) {
+            api.process();
+            api.waitForWork(100);
+        }
+        secs = std::chrono::duration<double>(Clock::now() - start).count();
+        api.unsubscribe(&cb);
+    }
+    cJSON_Delete(json);
+    return secs;
+}
+
+void checkReplay() {
+    mec::Capture c;
+    mec::Capture::glissandi(c, 2);
+
+    // everything arrives, in order, as recorded
+    mec::CaptureRecorder rec;
+    CountCallback count;
+    const char *file = "t_capture_replay.mecc";
+    assert(c.save(file));
+    {
+        cJSON *json = cJSON_Parse(replayPrefs(file, 0, false).c_str());
+        mec::MecApi api(json);
+        api.subscribe(&count);
+        api.subscribe(&rec);
+        api.init();
+        while (!count.shutdown_) {
+            api.process();
+            api.waitForWork(100);
+        }
+        api.unsubscribe(&rec);
+        api.unsubscribe(&count);
+        cJSON_Delete(json);
+    }
+    remove(file);
+    assert(count.msgs_ == c.msgCount());
+    assert(rec.capture().msgCount() == c.msgCount());
+    // frames are replayed one per process, so batching is preserved (less any empty frames)
+    assert(rec.capture().frameCount() <= c.frameCount());
+    std::vector<mec::MecMsg> played;
+    for (unsigned i = 0; i < rec.capture().frameCount(); i++) {
+        for (const mec::MecMsg &m : rec.capture().frame(i)) played.push_back(m);
+    }
+    unsigned long n = 0;
+    for (unsigned i = 0; i < c.frameCount(); i++) {
+        for (const mec::MecMsg &m : c.frame(i)) assert(sameMsg(m, played[n++]));
+    }
+
+    // deterministic, two replays produce identical midi
+    NullMpe a, b;
+    replay("chords", 2, false, a, a.shutdown_);
+    replay("chords", 2, false, b, b.shutdown_);
+    assert(!a.bytes_.empty());
+    assert(a.bytes_ == b.bytes_);
+
+    // realtime, takes as long as the capture
+    CountCallback rt;
+    double secs = replay("chords", 1, true, rt, rt.shutdown_);
+    mec::Capture::chords(c, 1);
+    assert(rt.msgs_ == c.msgCount());
+    assert(secs >= c.duration() / 1000000.0);
+    LOG_0("realtime replay, capture " << c.duration() / 1000 << "ms"
+                                      << " took " << secs * 1000.0 << "ms"
+                                      << " in " << rt.frames_ << " process calls");
+}
+
+void benchmark(const char *name) {
+    mec::Capture c;
+    mec::Capture::synthetic(c, name, BENCH_SECONDS);
+
+    CountCallback null;
+    double nullSecs = replay(name, BENCH_SECONDS, false, null, null.shutdown_);
+    assert(null.msgs_ == c.msgCount());
+
+    // touch ids straight to MPE channels, (the 16th stress touch is outside the 15 member channels)
+    NullMpe mpe;
+    double mpeSecs = replay(name, BENCH_SECONDS, false, mpe, mpe.shutdown_);
+
+    VoiceMpe voice;
+    double voiceSecs = replay(name, BENCH_SECONDS, false, voice, voice.mpe_.shutdown_);
+
+    double frames = c.frameCount();
+    LOG_0(name << " frames " << c.frameCount() << " msgs " << c.msgCount()
+               << " | null " << nullSecs * 1000000.0 / frames << "us/frame"
+               << " (" << (unsigned long) (c.msgCount() / nullSecs) << " msg/s)"
+               << " | mpe " << mpeSecs * 1000000.0 / frames << "us/frame"
+               << " " << mpe.bytes_.size() << " bytes"
+               << " | voices+mpe " << voiceSecs * 1000000.0 / frames << "us/frame"
+               << " unvoiced " << voice.unvoiced_);
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    checkFormat();
+    checkRecorder();
+    checkReplay();
+
+    benchmark("chords");
+    benchmark("glissandi");
+    benchmark("stress");
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -0,0 +1,335 @@
+#include <mec_api.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cJSON.h>
+
+#include <mec_device.h>
+#include <mec_device_factory.h>
+#include <mec_log.h>
+#include <mec_prefs.h>
+
+// checks of DeviceRegistry and the MecApi device lifecycle: named instances of a type,
+// attach/detach, and rescan after a (fake) device is unplugged and plugged back in
+// also times how long a replugged device takes to be restarted by the periodic rescan
+
+static const unsigned RESCAN_INTERVAL = 20;
+
+// plugged state of the fake hardware, by instance name, as a usb bus would report
+static std::mutex plugMutex;
+static std::map<std::string, bool> plugged;
+
+static void plug(const std::string &name, bool p) {
+    std::lock_guard<std::mutex> lock(plugMutex);
+    plugged[name] = p;
+}
+
+static bool isPlugged(const std::string &name) {
+    std::lock_guard<std::mutex> lock(plugMutex);
+    return plugged[name];
+}
+
+// a polled device, sending a touch with its id on each process, while plugged
+class FakeDevice : public mec::Device {
+public:
+    FakeDevice(const std::string &name, mec::ICallback &cb) : name_(name), callback_(cb), id_(0), active_(false) { ; }
+
+    bool init(void *prefs) override {
+        mec::Preferences p(prefs);
+        id_ = p.getInt("id", 0);
+        active_ = isPlugged(name_);
+        return active_;
+    }
+
+    bool process() override {
+        if (!isPlugged(name_)) {
+            active_ = false;
+            return false;
+        }
+        callback_.touchContinue(id_, 60.0f, 0.5f, 0.5f, 0.5f);
+        return true;
+    }
+
+    void deinit() override { active_ = false; }
+    bool isActive() override { return active_; }
+
+    std::string name_;
+    mec::ICallback &callback_;
+    int id_;
+    std::atomic<bool> active_;
+};
+
+class FakeFactory : public mec::DeviceFactory {
+public:
+    std::shared_ptr<mec::Device> create(const std::string &name, mec::ICallback &cb) override {
+        std::lock_guard<std::mutex> lock(mtx_);
+        created_.push_back(name);
+        return std::make_shared<FakeDevice>(name, cb);
+    }
+
+    void destroy(const std::string &name, std::shared_ptr<mec::Device>) override {
+        std::lock_guard<std::mutex> lock(mtx_);
+        destroyed_.push_back(name);
+    }
+
+    std::mutex mtx_;
+    std::vector<std::string> created_;
+    std::vector<std::string> destroyed_;
+};
+
+// records which device ids are sending
+class OutputCallback : public mec::Callback {
+public:
+    void touchContinue(int touchId, float note, float x, float y, float z) override {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ids_.insert(touchId);
+    }
+
+    std::set<int> ids() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return ids_;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ids_.clear();
+    }
+
+    std::mutex mtx_;
+    std::set<int> ids_;
+};
+
+static std::shared_ptr<FakeFactory> factory = std::make_shared<FakeFactory>();
+
+static bool hasDevice(mec::MecApi &api, const std::string &name) {
+    std::vector<std::string> d = api.devices();
+    return std::find(d.begin(), d.end(), name) != d.end();
+}
+
+// process until the given ids are all (and only) sending, or timeout
+static bool waitForIds(mec::MecApi &api, OutputCallback &out, const std::set<int> &ids, unsigned timeoutMs) {
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (std::chrono::steady_clock::now() < end) {
+        out.clear();
+        for (int i = 0; i < 4; i++) {
+            api.process();
+            api.waitForWork(5);
+        }
+        if (out.ids() == ids) return true;
+    }
+    return false;
+}
+
+void checkRegistry() {
+    mec::DeviceRegistry::registerFactory("fake", factory);
+    assert(mec::DeviceRegistry::isRegistered("fake"));
+    assert(mec::DeviceRegistry::factory("fake") == factory);
+    assert(mec::DeviceRegistry::factory("nothere") == nullptr);
+    assert(!mec::DeviceRegistry::unregisterFactory("nothere"));
+
+    mec::DeviceRegistry::registerFactory("fake2", factory);
+    std::vector<std::string> types = mec::DeviceRegistry::types();
+    assert(std::find(types.begin(), types.end(), "fake2") != types.end());
+    bool removed = mec::DeviceRegistry::unregisterFactory("fake2");
+    assert(removed);
+    assert(!mec::DeviceRegistry::isRegistered("fake2"));
+
+    // a type registered by the application, before MecApi registers the built in types, is kept
+    mec::DeviceRegistry::registerFactory("replay", factory);
+    cJSON *json = cJSON_Parse("{ \"mec\" : { \"replay\" : { \"id\" : 9 } } }");
+    plug("replay", true);
+    {
+        mec::MecApi api(json);
+        assert(mec::DeviceRegistry::factory("replay") == factory);
+        api.init();
+        assert(hasDevice(api, "replay"));
+        assert(factory->created_.back() == "replay");
+    }
+    assert(factory->destroyed_.back() == "replay");
+    cJSON_Delete(json);
+    plug("replay", false);
+    mec::DeviceRegistry::unregisterFactory("replay");
+}
+
+void checkInstances(bool threaded) {
+    std::string prefs = std::string("{ \"mec\" : { \"poll interval\" : 2, \"device threads\" : ") + (threaded ? "true" : "false") +
+                        ", \"fake a\" : { \"type\" : \"fake\", \"id\" : 1 }"
+                        ", \"fake b\" : { \"type\" : \"fake\", \"id\" : 2 }"
+                        ", \"_fake c\" : { \"type\" : \"fake\", \"id\" : 3 }"
+                        ", \"unknown\" : { \"type\" : \"nothere\" }"
+                        ", \"fake\" : { \"id\" : 4 } } }";
+    cJSON *json = cJSON_Parse(prefs.c_str());
+    assert(json != nullptr);
+    plug("fake a", true);
+    plug("fake b", true);
+    plug("_fake c", true);
+    plug("fake", false);
+
+    OutputCallback out;
+    {
+        mec::MecApi api(json);
+        api.subscribe(&out);
+        api.init();
+
+        // named instances of one type, a disabled one, an unknown type and one not plugged in
+        assert(api.devices().size() == 2);
+        assert(hasDevice(api, "fake a") && hasDevice(api, "fake b"));
+        assert(waitForIds(api, out, {1, 2}, 1000));
+
+        // detach stops a device, and it stays stopped on rescan
+        assert(api.detachDevice("fake a"));
+        assert(!api.detachDevice("fake a"));
+        assert(!hasDevice(api, "fake a"));
+        assert(waitForIds(api, out, {2}, 1000));
+        assert(api.rescanDevices() == 0);
+        assert(!hasDevice(api, "fake a"));
+
+        // until attached again
+        assert(api.attachDevice("fake a"));
+        assert(api.attachDevice("fake a"));
+        assert(api.devices().size() == 2);
+        assert(waitForIds(api, out, {1, 2}, 1000));
+        assert(!api.attachDevice("nothere"));
+        assert(!api.attachDevice("unknown"));
+
+        // unplugged, the device goes inactive and is removed on rescan
+        plug("fake b", false);
+        assert(waitForIds(api, out, {1}, 1000));
+        assert(api.rescanDevices() == 0);
+        assert(!hasDevice(api, "fake b"));
+
+        // plugged back in (and one plugged for the first time), rescan restarts them
+        plug("fake b", true);
+        plug("fake", true);
+        assert(api.rescanDevices() == 2);
+        assert(api.devices().size() == 3);
+        assert(waitForIds(api, out, {1, 2, 4}, 1000));
+        assert(api.rescanDevices() == 0);
+
+        api.unsubscribe(&out);
+    }
+    cJSON_Delete(json);
+
+    // every created device was destroyed
+    std::multiset<std::string> created(factory->created_.begin(), factory->created_.end());
+    std::multiset<std::string> destroyed(factory->destroyed_.begin(), factory->destroyed_.end());
+    assert(created == destroyed);
+}
+
+// built in types start in a fixed order, not key order, then other types in key order
+// keys are matched to types ignoring case, so "Kontrol" is still a kontrol device
+void checkStartOrder() {
+    mec::DeviceRegistry::registerFactory("kontrol", factory);
+    mec::DeviceRegistry::registerFactory("midi", factory);
+    const char *prefs = "{ \"mec\" : { \"device threads\" : false, "
+                        "\"fake z\" : { \"type\" : \"fake\", \"id\" : 5 }, "
+                        "\"Kontrol\" : { \"id\" : 7 }, "
+                        "\"midi\" : { \"id\" : 2 } } }";
+    cJSON *json = cJSON_Parse(prefs);
+    plug("fake z", true);
+    plug("Kontrol", true);
+    plug("midi", true);
+    OutputCallback out;
+    {
+        mec::MecApi api(json);
+        api.subscribe(&out);
+        api.init();
+        std::vector<std::string> order = {"midi", "Kontrol", "fake z"};
+        assert(api.devices() == order);
+        assert(waitForIds(api, out, {2, 7, 5}, 1000));
+        api.unsubscribe(&out);
+    }
+    cJSON_Delete(json);
+    plug("fake z", false);
+    plug("Kontrol", false);
+    plug("midi", false);
+    mec::DeviceRegistry::unregisterFactory("kontrol");
+    mec::DeviceRegistry::unregisterFactory("midi");
+}
+
+// a second instance of a built in type
+void checkReplayInstances() {
+    const char *prefs = "{ \"mec\" : { "
+                        "\"replay\" : { \"synthetic\" : \"chords\", \"seconds\" : 1, \"realtime\" : false }, "
+                        "\"replay 2\" : { \"type\" : \"replay\", \"synthetic\" : \"chords\", \"seconds\" : 1, \"realtime\" : false } } }";
+    cJSON *json = cJSON_Parse(prefs);
+    {
+        mec::MecApi api(json);
+        api.init();
+        assert(api.devices().size() == 2);
+        assert(hasDevice(api, "replay") && hasDevice(api, "replay 2"));
+        assert(api.detachDevice("replay 2"));
+        assert(api.devices().size() == 1);
+    }
+    cJSON_Delete(json);
+}
+
+// time from replug, to the device sending again, with the periodic rescan
+void benchmarkReplug() {
+    std::string prefs = "{ \"mec\" : { \"poll interval\" : 1, \"rescan interval\" : " + std::to_string(RESCAN_INTERVAL) +
+                        ", \"fake a\" : { \"type\" : \"fake\", \"id\" : 1 } } }";
+    cJSON *json = cJSON_Parse(prefs.c_str());
+    plug("fake a", true);
+
+    static const int CYCLES = 20;
+    double total = 0, worst = 0;
+    OutputCallback out;
+    {
+        mec::MecApi api(json);
+        api.subscribe(&out);
+        api.init();
+        assert(waitForIds(api, out, {1}, 1000));
+        for (int i = 0; i < CYCLES; i++) {
+            plug("fake a", false);
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(2000);
+            while (hasDevice(api, "fake a") && std::chrono::steady_clock::now() < end) {
+                api.process();
+                api.waitForWork(1);
+            }
+            assert(!hasDevice(api, "fake a"));
+
+            out.clear();
+            plug("fake a", true);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            end = start + std::chrono::milliseconds(2000);
+            while (out.ids().empty() && std::chrono::steady_clock::now() < end) {
+                api.process();
+                api.waitForWork(1);
+            }
+            assert(!out.ids().empty());
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            total += ms;
+            worst = std::max(worst, ms);
+        }
+        api.unsubscribe(&out);
+    }
+    cJSON_Delete(json);
+
+    LOG_0("replug to first touch, rescan interval " << RESCAN_INTERVAL << "ms, " << CYCLES << " cycles : mean "
+                                                     << total / CYCLES << "ms, max " << worst << "ms");
+    assert(worst < RESCAN_INTERVAL * 4);
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    checkRegistry();
+    checkInstances(false);
+    checkInstances(true);
+    checkStartOrder();
+    checkReplayInstances();
+
+    benchmarkReplug();
+
+    LOG_0("test completed");
+    return 0;
+}
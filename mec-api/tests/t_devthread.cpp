@@ -0,0 +1,280 @@
+#include <mec_api.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cJSON.h>
+
+#include <mec_device_thread.h>
+#include <mec_latency.h>
+#include <mec_log.h>
+#include <mec_notifier.h>
+#include <devices/mec_replay.h>
+
+// functional checks of DeviceThread, MergeCallback and the MecApi "device threads" mode,
+// and a benchmark of touch latency jitter, with and without a slow sibling device
+// benchmark: a realtime replay (1kHz, as a Soundplane would send) alongside a device whose
+// process() takes SLOW_PROCESS_MS (e.g. push2 display rendering), latency is from the replay
+// queuing a frame, to the output callback (see Latency)
+//  serial   : both processed on one thread, as MecApi::process does by default
+//  threaded : each on a DeviceThread, delivered through the merged output stage
+
+static const unsigned POLL_INTERVAL = 5;
+static const unsigned SLOW_PROCESS_MS = 4;
+static const unsigned BENCH_SECONDS = 2;
+
+// a device which has to be polled, and is slow to process
+class SlowDevice : public mec::Device {
+public:
+    SlowDevice(unsigned ms) : ms_(ms), processed_(0) { ; }
+
+    bool init(void *) override { return true; }
+    bool process() override {
+        if (ms_ > 0) std::this_thread::sleep_for(std::chrono::milliseconds(ms_));
+        processed_++;
+        return true;
+    }
+    void deinit() override { ; }
+    bool isActive() override { return true; }
+
+    unsigned ms_;
+    std::atomic<unsigned long> processed_;
+};
+
+// counts messages, and checks they are all delivered on one thread
+class OutputCallback : public mec::Callback {
+public:
+    OutputCallback() : msgs_(0), frames_(0), shutdown_(false) { ; }
+
+    void touchFrame(const mec::MsgSpan &msgs) override {
+        if (frames_ == 0) thread_ = std::this_thread::get_id();
+        assert(thread_ == std::this_thread::get_id());
+        frames_++;
+        for (const mec::MecMsg &m : msgs) {
+            if (m.type_ == mec::MecMsg::MEC_CONTROL) {
+                if (m.data_.mec_control_.cmd_ == mec::MecMsg::SHUTDOWN) shutdown_ = true;
+                continue;
+            }
+            msgs_++;
+        }
+    }
+
+    unsigned long msgs_;
+    unsigned long frames_;
+    std::atomic<bool> shutdown_;
+    std::thread::id thread_;
+};
+
+void checkMergeCallback() {
+    mec::Latency::enable(true);
+    mec::MergeCallback merge(16);
+
+    merge.touchOn(1, 60.0f, 0.1f, 0.2f, 0.3f);
+    merge.touchContinue(1, 61.0f, 0.1f, 0.2f, 0.4f);
+    merge.touchOff(1, 61.0f, 0.1f, 0.2f, 0.0f);
+    merge.control(3, 0.5f);
+    merge.mec_control(mec::ICallback::SHUTDOWN, nullptr);
+
+    mec::MecMsg frame[2];
+    frame[0].type_ = mec::MecMsg::TOUCH_CONTINUE;
+    frame[0].data_.touch_.touchId_ = 2;
+    frame[0].t_ = 1234;
+    frame[1] = frame[0];
+    frame[1].data_.touch_.touchId_ = 3;
+    merge.touchFrame(mec::MsgSpan(frame, 2));
+
+    mec::MecMsg msgs[16];
+    unsigned n = merge.queue().drain(msgs, 16);
+    assert(n == 7);
+    assert(msgs[0].type_ == mec::MecMsg::TOUCH_ON && msgs[0].data_.touch_.note_ == 60.0f);
+    assert(msgs[1].type_ == mec::MecMsg::TOUCH_CONTINUE && msgs[1].data_.touch_.z_ == 0.4f);
+    assert(msgs[2].type_ == mec::MecMsg::TOUCH_OFF);
+    assert(msgs[3].type_ == mec::MecMsg::CONTROL && msgs[3].data_.control_.controlId_ == 3);
+    assert(msgs[4].type_ == mec::MecMsg::MEC_CONTROL && msgs[4].data_.mec_control_.cmd_ == mec::MecMsg::SHUTDOWN);
+    // direct calls are stamped, frames keep their device stamps
+    assert(msgs[0].t_ != 0);
+    assert(msgs[5].t_ == 1234 && msgs[5].data_.touch_.touchId_ == 2);
+    assert(msgs[6].t_ == 1234 && msgs[6].data_.touch_.touchId_ == 3);
+
+    mec::Latency::enable(false);
+    mec::Latency::reset();
+}
+
+void checkDeviceThread() {
+    // polled, processed every poll interval
+    std::shared_ptr<SlowDevice> polled = std::make_shared<SlowDevice>(0);
+    {
+        mec::DeviceThread t("polled", polled, POLL_INTERVAL);
+        assert(!t.isRunning());
+        assert(t.start(0, 0));
+        assert(t.isRunning());
+        assert(!t.start());
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        t.stop();
+        assert(!t.isRunning());
+        unsigned long n = polled->processed_;
+        assert(n >= 100 / POLL_INTERVAL / 2 && n <= 100 / POLL_INTERVAL + 2);
+        assert(t.processCount() == n);
+        t.stop();
+    }
+
+    // realtime priority needs privileges, if refused, the thread still runs
+    {
+        mec::DeviceThread t("realtime", polled, POLL_INTERVAL);
+        unsigned long before = polled->processed_;
+        t.start(50, -1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        t.stop();
+        assert(polled->processed_ > before);
+    }
+
+    // with a notifier, the device is processed when it signals, here a max speed replay
+    cJSON *json = cJSON_Parse("{ \"synthetic\" : \"chords\", \"seconds\" : 1, \"realtime\" : false }");
+    mec::MergeCallback merge(4096);
+    std::shared_ptr<mec::ReplayDevice> replay = std::make_shared<mec::ReplayDevice>(merge);
+    assert(replay->init(json));
+    {
+        mec::DeviceThread t("replay", replay, 1000);
+        t.start();
+        for (int i = 0; i < 500 && !replay->finished(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        t.stop();
+    }
+    assert(replay->finished());
+    assert(merge.queue().dropped() == 0);
+    OutputCallback out;
+    merge.queue().process(out);
+    assert(out.msgs_ == replay->capture().msgCount());
+    replay->deinit();
+    cJSON_Delete(json);
+}
+
+// a max speed replay is not paced by the consumer when threaded, so the merge queue holds the whole capture
+std::string apiPrefs(bool threaded) {
+    return std::string("{ \"mec\" : { \"merge queue size\" : 8192, \"device threads\" : ") + (threaded ? "true" : "false") +
+           ", \"replay\" : { \"synthetic\" : \"glissandi\", \"seconds\" : 2, \"realtime\" : false, \"shutdown\" : true,"
+           " \"thread priority\" : 0, \"thread cpu\" : -1 } } }";
+}
+
+unsigned long runApi(bool threaded) {
+    cJSON *json = cJSON_Parse(apiPrefs(threaded).c_str());
+    assert(json != nullptr);
+    OutputCallback out;
+    {
+        mec::MecApi api(json);
+        api.subscribe(&out);
+        api.init();
+        while (!out.shutdown_) {
+            api.process();
+            api.waitForWork(100);
+        }
+        api.unsubscribe(&out);
+    }
+    cJSON_Delete(json);
+    // outputs are only called on the thread calling process()
+    assert(out.thread_ == std::this_thread::get_id());
+    return out.msgs_;
+}
+
+void checkMecApi() {
+    unsigned long serial = runApi(false);
+    unsigned long threaded = runApi(true);
+    LOG_0("MecApi serial " << serial << " msgs, device threads " << threaded << " msgs");
+    assert(serial > 0);
+    assert(threaded == serial);
+}
+
+struct Jitter {
+    unsigned long msgs_;
+    uint64_t p50_, p99_, max_;
+};
+
+Jitter runBenchmark(bool threaded, unsigned slowMs) {
+    std::string prefs = "{ \"synthetic\" : \"chords\", \"seconds\" : " + std::to_string(BENCH_SECONDS) +
+                        ", \"realtime\" : true, \"shutdown\" : true }";
+    cJSON *json = cJSON_Parse(prefs.c_str());
+    mec::Latency::enable(true);
+    mec::Latency::reset();
+
+    OutputCallback out;
+    mec::MergeCallback merge;
+    mec::Notifier notifier;
+    std::shared_ptr<mec::ReplayDevice> replay = std::make_shared<mec::ReplayDevice>(threaded ? (mec::ICallback &) merge : out);
+    std::shared_ptr<SlowDevice> slow = std::make_shared<SlowDevice>(slowMs);
+    replay->init(json);
+
+    if (threaded) {
+        // as MecApi_Impl, in device threads mode
+        mec::DeviceThread replayThread("replay", replay, POLL_INTERVAL);
+        mec::DeviceThread slowThread("slow", slow, POLL_INTERVAL);
+        merge.queue().setNotifier(&notifier);
+        replayThread.start();
+        slowThread.start();
+        while (!out.shutdown_) {
+            merge.queue().process(out);
+            notifier.wait(std::chrono::milliseconds(100));
+        }
+        replayThread.stop();
+        slowThread.stop();
+        merge.queue().setNotifier(nullptr);
+    } else {
+        // as MecApi_Impl::process / waitForWork
+        replay->setNotifier(&notifier);
+        while (!out.shutdown_) {
+            replay->process();
+            slow->process();
+            notifier.wait(std::chrono::milliseconds(POLL_INTERVAL));
+        }
+        replay->setNotifier(nullptr);
+    }
+    replay->deinit();
+    cJSON_Delete(json);
+
+    const mec::LatencyHistogram &h = mec::Latency::histogram(mec::Latency::TOTAL);
+    Jitter j = {out.msgs_, h.percentile(50.0), h.percentile(99.0), h.max()};
+    mec::Latency::enable(false);
+    mec::Latency::reset();
+    return j;
+}
+
+void logJitter(const char *name, const Jitter &j) {
+    LOG_0(name << " msgs " << j.msgs_
+               << " latency us p50 " << j.p50_ / 1000.0
+               << " p99 " << j.p99_ / 1000.0
+               << " max " << j.max_ / 1000.0
+               << " jitter (p99-p50) " << (j.p99_ - j.p50_) / 1000.0);
+}
+
+void benchmark() {
+    Jitter serialAlone = runBenchmark(false, 0);
+    Jitter serialSlow = runBenchmark(false, SLOW_PROCESS_MS);
+    Jitter threadedAlone = runBenchmark(true, 0);
+    Jitter threadedSlow = runBenchmark(true, SLOW_PROCESS_MS);
+
+    LOG_0("touch latency, " << BENCH_SECONDS << "s 1kHz replay, slow sibling " << SLOW_PROCESS_MS << "ms per process");
+    logJitter("serial   , no sibling  ", serialAlone);
+    logJitter("serial   , slow sibling", serialSlow);
+    logJitter("threaded , no sibling  ", threadedAlone);
+    logJitter("threaded , slow sibling", threadedSlow);
+
+    // with its own thread, the touch device no longer waits on the slow device
+    assert(threadedSlow.p99_ < serialSlow.p99_);
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    checkMergeCallback();
+    checkDeviceThread();
+    checkMecApi();
+
+    benchmark();
+
+    LOG_0("test completed");
+    return 0;
+}
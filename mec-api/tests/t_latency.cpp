@@ -0,0 +1,256 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cJSON.h>
+
+#include <mec_latency.h>
+#include <mec_log.h>
+#include <mec_msg_queue.h>
+
+// functional checks of the latency histograms and stage recording, and a benchmark of
+// the overhead of stamping/recording, when disabled and enabled
+// benchmark: frames of 16 touches, stamped and queued as a device handler would, then
+// delivered with MsgQueue::process to a null callback
+//  baseline : no stamping at all, i.e. as before latency stats
+//  disabled : stamped with latency stats disabled (the default)
+//  enabled  : stamped and recorded
+
+typedef std::chrono::steady_clock Clock;
+
+static const unsigned FRAME_TOUCHES = 16;
+static const unsigned BENCH_FRAMES = 200000;
+
+void checkHistogram() {
+    typedef mec::LatencyHistogram H;
+
+    // buckets are contiguous, and values are within 1/SUB_BUCKETS of their bucket bound
+    unsigned last = 0;
+    for (uint64_t v = 0; v < H::MAX_VALUE; v = v < 1000 ? v + 1 : v + v / 97) {
+        unsigned b = H::bucket(v);
+        assert(b < H::BUCKETS);
+        assert(b == last || b == last + 1);
+        last = b;
+        uint64_t high = H::bucketHigh(b);
+        assert(high >= v);
+        assert(high - v <= v / H::SUB_BUCKETS);
+    }
+    assert(H::bucket(H::MAX_VALUE) == H::BUCKETS - 1);
+
+    H h;
+    assert(h.count() == 0);
+    assert(h.percentile(50.0) == 0);
+    assert(h.mean() == 0);
+
+    // 1..10000us, uniform
+    for (uint64_t i = 1; i <= 10000; i++) h.record(i * 1000);
+    assert(h.count() == 10000);
+    assert(h.max() == 10000000);
+    assert(h.mean() == 5000500);
+    double tolerance = 1.0 / H::SUB_BUCKETS;
+    assert(std::fabs(h.percentile(50.0) / 5000000.0 - 1.0) <= tolerance);
+    assert(std::fabs(h.percentile(99.0) / 9900000.0 - 1.0) <= tolerance);
+    assert(h.percentile(100.0) == h.max());
+    assert(h.percentile(0.0) <= 1000 + 1000 / H::SUB_BUCKETS);
+
+    // out of range is clamped, not lost
+    h.record(~0ULL);
+    assert(h.count() == 10001);
+    assert(h.max() == H::MAX_VALUE);
+
+    h.reset();
+    assert(h.count() == 0);
+    assert(h.max() == 0);
+    assert(h.percentile(99.0) == 0);
+
+    // lock-free recording from several threads
+    static const unsigned THREADS = 4, PER_THREAD = 250000;
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < THREADS; t++) {
+        threads.push_back(std::thread([&h, t]() {
+            for (unsigned i = 0; i < PER_THREAD; i++) h.record((t + 1) * 1000 + (i & 0xff));
+        }));
+    }
+    for (auto &t : threads) t.join();
+    assert(h.count() == THREADS * PER_THREAD);
+    assert(h.max() == THREADS * 1000 + 0xff);
+}
+
+class NullCallback : public mec::Callback {
+public:
+    NullCallback() : msgs_(0) { ; }
+    void touchFrame(const mec::MsgSpan &msgs) override { msgs_ += msgs.size(); }
+    unsigned long msgs_;
+};
+
+class SlowCallback : public NullCallback {
+public:
+    void touchFrame(const mec::MsgSpan &msgs) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        NullCallback::touchFrame(msgs);
+    }
+};
+
+void queueFrame(mec::MsgQueue &queue, bool stamp) {
+    mec::MecMsg msg;
+    if (stamp) mec::Latency::stamp(msg);
+    msg.type_ = mec::MecMsg::TOUCH_CONTINUE;
+    for (unsigned i = 0; i < FRAME_TOUCHES; i++) {
+        msg.data_.touch_.touchId_ = i;
+        msg.data_.touch_.note_ = 60.0f + i;
+        msg.data_.touch_.x_ = msg.data_.touch_.y_ = msg.data_.touch_.z_ = 0.5f;
+        queue.addToQueue(msg);
+    }
+}
+
+void checkStages() {
+    mec::MsgQueue queue(64);
+
+    // disabled, nothing is stamped or recorded
+    mec::Latency::enable(false);
+    mec::Latency::reset();
+    mec::MecMsg msg;
+    mec::Latency::stamp(msg);
+    assert(msg.t_ == 0);
+    assert(mec::Latency::stamp() == 0);
+    mec::Latency::recordDirect(mec::Latency::stamp());
+
+    NullCallback null;
+    queueFrame(queue, true);
+    queue.process(null);
+    assert(null.msgs_ == FRAME_TOUCHES);
+    for (unsigned s = 0; s < mec::Latency::NUM_STAGES; s++) {
+        assert(mec::Latency::histogram(static_cast<mec::Latency::Stage>(s)).count() == 0);
+    }
+
+    // enabled, queue and total per message, dispatch per frame
+    mec::Latency::enable(true);
+    SlowCallback slow;
+    queueFrame(queue, true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    queue.process(slow);
+    const mec::LatencyHistogram &q = mec::Latency::histogram(mec::Latency::QUEUE);
+    const mec::LatencyHistogram &d = mec::Latency::histogram(mec::Latency::DISPATCH);
+    const mec::LatencyHistogram &t = mec::Latency::histogram(mec::Latency::TOTAL);
+    assert(q.count() == FRAME_TOUCHES);
+    assert(d.count() == 1);
+    assert(t.count() == FRAME_TOUCHES);
+    assert(q.percentile(0.0) >= 1000000);
+    assert(d.max() >= 2000000);
+    assert(t.percentile(0.0) >= q.max() + d.max() - d.max() / mec::LatencyHistogram::SUB_BUCKETS);
+
+    // unstamped messages (e.g. queued before enabling) are ignored
+    queueFrame(queue, false);
+    queue.process(null);
+    assert(q.count() == FRAME_TOUCHES);
+    assert(d.count() == 2);
+
+    // direct callback devices record dispatch and total
+    mec::Latency::recordDirect(mec::Latency::stamp());
+    assert(d.count() == 3);
+    assert(t.count() == FRAME_TOUCHES + 1);
+
+    std::string report = mec::Latency::report();
+    LOG_0(report);
+    assert(report.find("queue [n 16") != std::string::npos);
+    assert(report.find("dispatch [n 3") != std::string::npos);
+
+    mec::Latency::reset();
+    assert(t.count() == 0);
+    mec::Latency::enable(false);
+}
+
+// end to end through MecApi, enabled by prefs
+class ShutdownCallback : public NullCallback {
+public:
+    ShutdownCallback() : shutdown_(false) { ; }
+    void touchFrame(const mec::MsgSpan &msgs) override {
+        for (const mec::MecMsg &m : msgs) {
+            if (m.type_ == mec::MecMsg::MEC_CONTROL && m.data_.mec_control_.cmd_ == mec::MecMsg::SHUTDOWN) {
+                shutdown_ = true;
+                return;
+            }
+        }
+        NullCallback::touchFrame(msgs);
+    }
+    bool shutdown_;
+};
+
+void checkMecApi() {
+    const char *prefs =
+            "{ \"mec\" : { \"latency stats\" : true, \"latency log interval\" : 100,"
+            " \"replay\" : { \"synthetic\" : \"chords\", \"seconds\" : 1, \"realtime\" : true, \"shutdown\" : true } } }";
+    cJSON *json = cJSON_Parse(prefs);
+    assert(json != nullptr);
+    ShutdownCallback cb;
+    {
+        mec::MecApi api(json);
+        api.subscribe(&cb);
+        api.init();
+        assert(mec::Latency::enabled());
+        while (!cb.shutdown_) {
+            api.process();
+            api.waitForWork(100);
+        }
+        api.unsubscribe(&cb);
+    }
+    cJSON_Delete(json);
+
+    // the log resets the histograms each interval, so only the last interval remains
+    const mec::LatencyHistogram &t = mec::Latency::histogram(mec::Latency::TOTAL);
+    assert(cb.msgs_ > 0);
+    assert(t.count() > 0 && t.count() <= cb.msgs_);
+    LOG_0("replay " << cb.msgs_ << " msgs, last interval " << mec::Latency::report());
+
+    mec::Latency::enable(false);
+    mec::Latency::reset();
+}
+
+double benchmarkRun(bool stamp, bool enabled) {
+    mec::Latency::enable(enabled);
+    mec::Latency::reset();
+    mec::MsgQueue queue(64);
+    NullCallback null;
+    auto start = Clock::now();
+    for (unsigned f = 0; f < BENCH_FRAMES; f++) {
+        queueFrame(queue, stamp);
+        queue.process(null);
+    }
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    assert(null.msgs_ == (unsigned long) BENCH_FRAMES * FRAME_TOUCHES);
+    mec::Latency::enable(false);
+    return secs * 1e9 / ((double) BENCH_FRAMES * FRAME_TOUCHES);
+}
+
+void benchmark() {
+    // best of a few runs, to reduce scheduling noise
+    double base = 1e9, disabled = 1e9, enabled = 1e9;
+    for (int i = 0; i < 5; i++) {
+        base = std::min(base, benchmarkRun(false, false));
+        disabled = std::min(disabled, benchmarkRun(true, false));
+        enabled = std::min(enabled, benchmarkRun(true, true));
+    }
+    LOG_0("latency overhead, " << FRAME_TOUCHES << " touches per frame, queue+process ns/msg:"
+                               << " baseline " << base
+                               << " | disabled " << disabled << " (+" << disabled - base << ")"
+                               << " | enabled " << enabled << " (+" << enabled - base << ")");
+    mec::Latency::reset();
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    checkHistogram();
+    checkStages();
+    checkMecApi();
+
+    benchmark();
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -0,0 +1,316 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <mec_midi_buffer.h>
+#include <mec_log.h>
+#include <processors/mec_mpe_processor.h>
+
+// checks MidiBuffer, and MPE_Processor batching per touchFrame, and coalescing per voice per frame
+// benchmark: a 15 voice MPE stream into a null output, as mec-app used to send it
+// (a vector per message), and as a buffer per frame, counting heap allocations
+
+static unsigned long allocations = 0;
+
+void *operator new(std::size_t size) {
+    allocations++;
+    void *p = malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+// null backend, stands in for RtMidiOut::sendMessage
+static unsigned long nullBytes = 0;
+static unsigned long nullCalls = 0;
+
+void nullSend(const unsigned char *data, size_t size) {
+    nullBytes += size;
+    nullCalls++;
+}
+
+// as MecMpeProcessor previously wrote each message
+class VectorMpe : public mec::MPE_Processor {
+public:
+    void process(mec::MPE_Processor::MidiMsg &m) override {
+        std::vector<unsigned char> msg;
+        for (unsigned i = 0; i < m.size; i++) {
+            msg.push_back((unsigned char) m.data[i]);
+        }
+        nullSend(&msg.at(0), msg.size());
+    }
+};
+
+class BufferMpe : public mec::MPE_Processor {
+public:
+    BufferMpe() : buffers_(0) { ; }
+
+    void process(mec::MPE_Processor::MidiMsg &m) override {
+        nullSend((unsigned char *) m.data, m.size);
+        bytes_.insert(bytes_.end(), m.data, m.data + m.size);
+    }
+
+    void process(const mec::MidiBuffer &buf) override {
+        buffers_++;
+        buf.forEach([](const unsigned char *data, unsigned size) { nullSend(data, size); });
+    }
+
+    unsigned buffers_;
+    std::vector<char> bytes_;
+};
+
+// collects everything, whether passed individually or batched
+class CollectMpe : public mec::MPE_Processor {
+public:
+    CollectMpe() : buffers_(0) { ; }
+
+    void process(mec::MPE_Processor::MidiMsg &m) override {
+        for (unsigned i = 0; i < m.size; i++) bytes_.push_back((unsigned char) m.data[i]);
+    }
+
+    void process(const mec::MidiBuffer &buf) override {
+        buffers_++;
+        bytes_.insert(bytes_.end(), buf.data(), buf.data() + buf.size());
+    }
+
+    unsigned buffers_;
+    std::vector<unsigned char> bytes_;
+};
+
+// MPE, 15 member channels
+static const unsigned VOICES = 15;
+static const unsigned FRAMES = 100000;
+
+void fillFrame(mec::MecMsg *msgs, unsigned f) {
+    for (unsigned t = 0; t < VOICES; t++) {
+        mec::MecMsg &msg = msgs[t];
+        msg.type_ = f == 0 ? mec::MecMsg::TOUCH_ON : mec::MecMsg::TOUCH_CONTINUE;
+        msg.data_.touch_.touchId_ = t;
+        // everything moves, so pitchbend, timbre and pressure are all sent
+        msg.data_.touch_.note_ = 48.0f + t + ((f + t) % 64) / 128.0f;
+        msg.data_.touch_.x_ = 0.0f;
+        msg.data_.touch_.y_ = ((f + t) % 100) / 50.0f - 1.0f;
+        msg.data_.touch_.z_ = ((f * 3 + t) % 127) / 127.0f;
+    }
+}
+
+static mec::MecMsg touchMsg(mec::MecMsg::type type, int id, float note, float y, float z) {
+    mec::MecMsg msg;
+    msg.type_ = type;
+    msg.data_.touch_.touchId_ = id;
+    msg.data_.touch_.note_ = note;
+    msg.data_.touch_.x_ = 0.0f;
+    msg.data_.touch_.y_ = y;
+    msg.data_.touch_.z_ = z;
+    return msg;
+}
+
+static mec::MecMsg frameMsg(mec::MecMsg::type type, unsigned frameId) {
+    mec::MecMsg msg;
+    msg.type_ = type;
+    msg.data_.frame_.frameId_ = frameId;
+    return msg;
+}
+
+// continues are coalesced per voice, per frame (FRAME_END), or per touchFrame without markers
+void checkCoalesce() {
+    CollectMpe expected, coalesced;
+    expected.touchOn(0, 60.0f, 0.0f, 0.0f, 0.5f);
+    expected.touchOn(1, 64.0f, 0.0f, 0.0f, 0.5f);
+    coalesced.touchOn(0, 60.0f, 0.0f, 0.0f, 0.5f);
+    coalesced.touchOn(1, 64.0f, 0.0f, 0.0f, 0.5f);
+
+    // only the last continue of a voice in a frame is sent, an off sends its voice's pending continue first
+    expected.touchContinue(1, 64.5f, 0.0f, 0.2f, 0.6f);
+    expected.touchContinue(0, 60.5f, 0.0f, 0.3f, 0.7f);
+    expected.touchContinue(0, 61.0f, 0.0f, 0.4f, 0.8f);
+    expected.touchOff(1, 64.5f, 0.0f, 0.0f, 0.0f);
+
+    mec::MecMsg msgs[] = {
+            frameMsg(mec::MecMsg::FRAME_START, 1),
+            touchMsg(mec::MecMsg::TOUCH_CONTINUE, 0, 60.2f, 0.1f, 0.6f),
+            touchMsg(mec::MecMsg::TOUCH_CONTINUE, 1, 64.5f, 0.2f, 0.6f),
+            touchMsg(mec::MecMsg::TOUCH_CONTINUE, 0, 60.5f, 0.3f, 0.7f),
+            frameMsg(mec::MecMsg::FRAME_END, 1),
+            frameMsg(mec::MecMsg::FRAME_START, 2),
+            touchMsg(mec::MecMsg::TOUCH_CONTINUE, 0, 61.0f, 0.4f, 0.8f),
+            touchMsg(mec::MecMsg::TOUCH_OFF, 1, 64.5f, 0.0f, 0.0f),
+            frameMsg(mec::MecMsg::FRAME_END, 2),
+    };
+    unsigned n = sizeof(msgs) / sizeof(msgs[0]);
+    coalesced.touchFrame(mec::MsgSpan(msgs, n));
+    // voice 1 continue is sent before voice 0, as voices are flushed at the frame end, but the bytes per channel match
+    assert(expected.bytes_.size() == coalesced.bytes_.size());
+
+    std::vector<unsigned char> e, c;
+    for (unsigned ch = 0x01; ch <= 0x02; ch++) {
+        e.clear();
+        c.clear();
+        for (unsigned i = 0; i < expected.bytes_.size(); i += mec::MidiBuffer::msgLength(expected.bytes_[i])) {
+            if ((expected.bytes_[i] & 0x0f) != ch) continue;
+            e.insert(e.end(), expected.bytes_.begin() + i, expected.bytes_.begin() + i + mec::MidiBuffer::msgLength(expected.bytes_[i]));
+        }
+        for (unsigned i = 0; i < coalesced.bytes_.size(); i += mec::MidiBuffer::msgLength(coalesced.bytes_[i])) {
+            if ((coalesced.bytes_[i] & 0x0f) != ch) continue;
+            c.insert(c.end(), coalesced.bytes_.begin() + i, coalesced.bytes_.begin() + i + mec::MidiBuffer::msgLength(coalesced.bytes_[i]));
+        }
+        assert(!e.empty());
+        assert(e == c);
+    }
+
+    // 4 frames drained together without markers (e.g. a busy consumer), one update per voice
+    CollectMpe perFrame, perSpan;
+    mec::MecMsg frame[VOICES];
+    std::vector<mec::MecMsg> span;
+    fillFrame(frame, 0);
+    perFrame.touchFrame(mec::MsgSpan(frame, VOICES));
+    perSpan.touchFrame(mec::MsgSpan(frame, VOICES));
+    size_t base = perFrame.bytes_.size();
+    for (unsigned f = 1; f <= 400; f++) {
+        fillFrame(frame, f);
+        perFrame.touchFrame(mec::MsgSpan(frame, VOICES));
+        span.insert(span.end(), frame, frame + VOICES);
+        if (f % 4 == 0) {
+            perSpan.touchFrame(mec::MsgSpan(span.data(), (unsigned) span.size()));
+            span.clear();
+        }
+    }
+    // the last frame of each span is what was sent
+    assert(perSpan.bytes_.size() < perFrame.bytes_.size());
+    LOG_0("coalesced 4 frames per span, bytes " << perSpan.bytes_.size() - base << " vs " << perFrame.bytes_.size() - base << " per frame");
+}
+
+// a frame larger than the buffer is sent in several batches, nothing is lost, or counted as dropped
+void checkOverflow() {
+    CollectMpe single, batched;
+    std::vector<mec::MecMsg> span;
+    for (unsigned i = 0; i < 200; i++) {
+        int id = (int) (i % VOICES);
+        float note = 48.0f + (i % 24);
+        span.push_back(touchMsg(mec::MecMsg::TOUCH_ON, id, note, 0.5f, 0.5f));
+        span.push_back(touchMsg(mec::MecMsg::TOUCH_OFF, id, note, 0.0f, 0.0f));
+        single.touchOn(id, note, 0.0f, 0.5f, 0.5f);
+        single.touchOff(id, note, 0.0f, 0.0f, 0.0f);
+    }
+    batched.touchFrame(mec::MsgSpan(span.data(), (unsigned) span.size()));
+    assert(batched.buffers_ > 1);
+    assert(batched.dropped() == 0);
+    assert(batched.bytes_ == single.bytes_);
+}
+
+void checks() {
+    // lengths from status
+    assert(mec::MidiBuffer::msgLength(0x90) == 3);
+    assert(mec::MidiBuffer::msgLength(0xC5) == 2);
+    assert(mec::MidiBuffer::msgLength(0xD0) == 2);
+    assert(mec::MidiBuffer::msgLength(0xE3) == 3);
+    assert(mec::MidiBuffer::msgLength(0xF8) == 1);
+    assert(mec::MidiBuffer::msgLength(0xF0) == 0);
+    assert(mec::MidiBuffer::msgLength(0x40) == 0);
+
+    mec::MidiBuffer buf;
+    assert(buf.add(0x91, 60, 100));
+    assert(buf.add(0x91, 62, 100));
+    assert(buf.add(0xF8));              // realtime, transparent to running status
+    assert(buf.add(0x91, 64, 100));
+    assert(buf.add(0xD1, 20));
+    assert(buf.add(0xD1, 21));
+    assert(buf.add(0xF3, 1));           // system common, cancels running status
+    assert(buf.add(0xD1, 22));
+    assert(!buf.add(0xF0));             // sysex, not supported
+    assert(buf.dropped() == 1);
+    assert(buf.count() == 8);
+    assert(buf.size() == 3 + 3 + 1 + 3 + 2 + 2 + 2 + 2);
+
+    unsigned n = 0;
+    buf.forEach([&n](const unsigned char *data, unsigned size) {
+        assert(size == mec::MidiBuffer::msgLength(data[0]));
+        n++;
+    });
+    assert(n == 8);
+
+    unsigned char out[64];
+    const unsigned char expected[] = {0x91, 60, 100, 62, 100, 0xF8, 64, 100, 0xD1, 20, 21, 0xF3, 1, 0xD1, 22};
+    assert(buf.encode(out, sizeof(out)) == sizeof(expected));
+    assert(memcmp(out, expected, sizeof(expected)) == 0);
+    assert(buf.encode(out, 4) == 0);
+
+    // full
+    buf.clear();
+    assert(buf.empty());
+    while (buf.add(0xB0, 1, 2));
+    assert(buf.size() == mec::MidiBuffer::CAPACITY - (mec::MidiBuffer::CAPACITY % 3));
+
+    // a frame produces the same bytes as individual callbacks, in one process call
+    CollectMpe individual, batched;
+    mec::MecMsg msgs[VOICES];
+    for (unsigned f = 0; f < 10; f++) {
+        fillFrame(msgs, f);
+        for (unsigned t = 0; t < VOICES; t++) {
+            const mec::MecMsg &m = msgs[t];
+            if (m.type_ == mec::MecMsg::TOUCH_ON) {
+                individual.touchOn(m.data_.touch_.touchId_, m.data_.touch_.note_, m.data_.touch_.x_, m.data_.touch_.y_, m.data_.touch_.z_);
+            } else {
+                individual.touchContinue(m.data_.touch_.touchId_, m.data_.touch_.note_, m.data_.touch_.x_, m.data_.touch_.y_, m.data_.touch_.z_);
+            }
+        }
+        batched.touchFrame(mec::MsgSpan(msgs, VOICES));
+    }
+    assert(individual.buffers_ == 0);
+    assert(batched.buffers_ == 10);
+    assert(individual.bytes_ == batched.bytes_);
+}
+
+template<typename P>
+void benchmark(const char *name, P &proc) {
+    mec::MecMsg msgs[VOICES];
+    fillFrame(msgs, 0);
+    proc.touchFrame(mec::MsgSpan(msgs, VOICES));
+
+    nullBytes = nullCalls = 0;
+    double secs = 0.0;
+    unsigned long allocs = 0;
+    for (unsigned f = 1; f < FRAMES; f++) {
+        fillFrame(msgs, f);
+        unsigned long a = allocations;
+        auto start = std::chrono::steady_clock::now();
+        proc.touchFrame(mec::MsgSpan(msgs, VOICES));
+        secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        allocs += allocations - a;
+    }
+
+    LOG_0(name
+                  << " frames " << FRAMES - 1
+                  << " msgs " << nullCalls
+                  << " bytes " << nullBytes
+                  << " time " << secs << "s"
+                  << " " << (secs * 1000000000.0 / nullCalls) << "ns/msg"
+                  << " allocations " << allocs);
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    checks();
+    checkCoalesce();
+    checkOverflow();
+
+    VectorMpe vectorMpe;
+    benchmark("vector per message", vectorMpe);
+
+    BufferMpe bufferMpe;
+    unsigned long a = allocations;
+    benchmark("buffer per frame", bufferMpe);
+    assert(allocations == a);
+    assert(bufferMpe.buffers_ == FRAMES);
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -0,0 +1,287 @@
+#include <mec_api.h>
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <mec_msg_queue.h>
+#include <mec_log.h>
+
+// functional checks, and a throughput micro-benchmark for MsgQueue
+// benchmark: N producer threads write as fast as they can, a single consumer drains,
+// producers spin (rather than drop) when full, so all messages should arrive in per-producer order
+
+static const unsigned BENCH_MSGS_PER_PRODUCER = 1000000;
+
+void producerProc(mec::MsgQueue *queue, int producer, unsigned count, unsigned long *retries) {
+    mec::MecMsg msg;
+    msg.type_ = mec::MecMsg::TOUCH_CONTINUE;
+    msg.data_.touch_.touchId_ = producer;
+    msg.data_.touch_.x_ = msg.data_.touch_.y_ = msg.data_.touch_.z_ = 0.0f;
+    unsigned long r = 0;
+    for (unsigned i = 0; i < count; i++) {
+        msg.data_.touch_.note_ = (float) i;
+        while (queue->isFull() || !queue->addToQueue(msg)) {
+            r++;
+            std::this_thread::yield();
+        }
+    }
+    *retries = r;
+}
+
+void benchmark(unsigned size, int producers) {
+    mec::MsgQueue queue(size);
+    std::vector<std::thread> threads;
+    std::vector<unsigned long> retries(producers, 0);
+    std::vector<unsigned> next(producers, 0);
+    unsigned long total = (unsigned long) producers * BENCH_MSGS_PER_PRODUCER;
+    unsigned long received = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < producers; p++) {
+        threads.push_back(std::thread(producerProc, &queue, p, BENCH_MSGS_PER_PRODUCER, &retries[p]));
+    }
+
+    mec::MecMsg msg;
+    while (received < total) {
+        if (queue.nextMsg(msg)) {
+            int p = msg.data_.touch_.touchId_;
+            assert(p >= 0 && p < producers);
+            assert(msg.data_.touch_.note_ == (float) next[p]);
+            next[p]++;
+            received++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    for (auto &t : threads) t.join();
+
+    unsigned long r = 0;
+    for (auto n : retries) r += n;
+
+    double secs = std::chrono::duration<double>(end - start).count();
+    LOG_0("size " << queue.capacity()
+                  << " producers " << producers
+                  << " msgs " << received
+                  << " time " << secs << "s"
+                  << " throughput " << (unsigned long) (received / secs) << " msg/s"
+                  << " full waits " << r
+                  << " high water " << queue.highWaterMark());
+
+    assert(queue.isEmpty());
+    assert(queue.dropped() <= r);
+}
+
+// dispatch benchmark, 16 touches per frame, fanned out to several callbacks
+static const unsigned FRAME_TOUCHES = 16;
+static const unsigned FRAMES = 100000;
+static const unsigned CALLBACKS = 4;
+
+class PerTouchCallback : public mec::Callback {
+public:
+    PerTouchCallback() : sum_(0.0f), count_(0) { ; }
+
+    void touchContinue(int, float note, float x, float y, float z) override {
+        sum_ += note + x + y + z;
+        count_++;
+    }
+
+    float sum_;
+    unsigned count_;
+};
+
+class FrameCallback : public PerTouchCallback {
+public:
+    void touchFrame(const mec::MsgSpan &msgs) override {
+        for (const mec::MecMsg &m : msgs) {
+            sum_ += m.data_.touch_.note_ + m.data_.touch_.x_ + m.data_.touch_.y_ + m.data_.touch_.z_;
+        }
+    }
+};
+
+class MarkerCallback : public PerTouchCallback {
+public:
+    MarkerCallback() : starts_(0), ends_(0), lastFrame_(0) { ; }
+
+    void frameStart(unsigned frameId) override {
+        assert(count_ == 0 || ends_ == starts_);
+        starts_++;
+        lastFrame_ = frameId;
+    }
+
+    void frameEnd(unsigned frameId) override {
+        assert(frameId == lastFrame_);
+        ends_++;
+    }
+
+    unsigned starts_, ends_, lastFrame_;
+};
+
+void fillFrame(mec::MsgQueue &queue) {
+    mec::MecMsg msg;
+    msg.type_ = mec::MecMsg::TOUCH_CONTINUE;
+    for (unsigned t = 0; t < FRAME_TOUCHES; t++) {
+        msg.data_.touch_.touchId_ = t;
+        msg.data_.touch_.note_ = msg.data_.touch_.x_ = msg.data_.touch_.y_ = msg.data_.touch_.z_ = 0.5f;
+        queue.addToQueue(msg);
+    }
+}
+
+void dispatchBenchmark() {
+    mec::MsgQueue queue(64);
+    std::vector<mec::ICallback *> callbacks;
+
+    // previous behaviour, one message at a time, each fanned out to every callback
+    PerTouchCallback perTouch[CALLBACKS];
+    for (unsigned i = 0; i < CALLBACKS; i++) callbacks.push_back(&perTouch[i]);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned f = 0; f < FRAMES; f++) {
+        fillFrame(queue);
+        mec::MecMsg msg;
+        while (queue.nextMsg(msg)) {
+            for (mec::ICallback *cb : callbacks) {
+                cb->touchContinue(msg.data_.touch_.touchId_, msg.data_.touch_.note_,
+                                  msg.data_.touch_.x_, msg.data_.touch_.y_, msg.data_.touch_.z_);
+            }
+        }
+    }
+    double perTouchSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // batched, one touchFrame per callback per frame
+    FrameCallback frame[CALLBACKS];
+    callbacks.clear();
+    for (unsigned i = 0; i < CALLBACKS; i++) callbacks.push_back(&frame[i]);
+    mec::MecMsg batch[64];
+    start = std::chrono::steady_clock::now();
+    for (unsigned f = 0; f < FRAMES; f++) {
+        fillFrame(queue);
+        unsigned n = queue.drain(batch, 64);
+        mec::MsgSpan span(batch, n);
+        for (mec::ICallback *cb : callbacks) {
+            cb->touchFrame(span);
+        }
+    }
+    double frameSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (unsigned i = 0; i < CALLBACKS; i++) assert(perTouch[i].sum_ == frame[i].sum_);
+
+    LOG_0("dispatch " << FRAME_TOUCHES << " touches x " << CALLBACKS << " callbacks"
+                      << " per touch " << (perTouchSecs * 1000000.0 / FRAMES) << "us/frame"
+                      << " (" << FRAME_TOUCHES * CALLBACKS << " calls)"
+                      << " batched " << (frameSecs * 1000000.0 / FRAMES) << "us/frame"
+                      << " (" << CALLBACKS << " calls)");
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    // capacity rounded to power of 2
+    mec::MsgQueue queue(30);
+    assert(queue.capacity() == 32);
+    assert(queue.isEmpty());
+    assert(queue.available() == 32);
+
+    mec::MecMsg msg;
+    msg.type_ = mec::MecMsg::TOUCH_ON;
+    for (int i = 0; i < 32; i++) {
+        msg.data_.touch_.touchId_ = i;
+        assert(queue.addToQueue(msg));
+    }
+    assert(queue.isFull());
+    assert(queue.pending() == 32);
+    assert(queue.highWaterMark() == 32);
+
+    // overflow is dropped, not overwritten
+    assert(!queue.addToQueue(msg));
+    assert(!queue.addToQueue(msg));
+    assert(queue.dropped() == 2);
+
+    for (int i = 0; i < 32; i++) {
+        assert(queue.nextMsg(msg));
+        assert(msg.data_.touch_.touchId_ == i);
+    }
+    assert(!queue.nextMsg(msg));
+    assert(queue.isEmpty());
+
+    // wrap around
+    for (int i = 0; i < 100; i++) {
+        msg.data_.touch_.touchId_ = i;
+        assert(queue.addToQueue(msg));
+        assert(queue.nextMsg(msg));
+        assert(msg.data_.touch_.touchId_ == i);
+    }
+    assert(queue.highWaterMark() == 32);
+    queue.resetStats();
+    assert(queue.highWaterMark() == 0);
+    assert(queue.dropped() == 0);
+
+    queue.resize(256);
+    assert(queue.capacity() == 256);
+    assert(queue.isEmpty());
+
+    // batch drain, and default touchFrame adapter
+    for (int i = 0; i < 20; i++) {
+        msg.type_ = mec::MecMsg::TOUCH_CONTINUE;
+        msg.data_.touch_.touchId_ = i;
+        assert(queue.addToQueue(msg));
+    }
+    mec::MecMsg batch[16];
+    assert(queue.drain(batch, 16) == 16);
+    assert(batch[15].data_.touch_.touchId_ == 15);
+    assert(queue.pending() == 4);
+    PerTouchCallback counter;
+    assert(queue.process(counter));
+    assert(counter.count_ == 4);
+    assert(queue.isEmpty());
+    assert(queue.drain(batch, 16) == 0);
+
+    // frames are queued whole, or not at all
+    mec::MecMsg frame[40];
+    for (int i = 0; i < 40; i++) {
+        frame[i].type_ = mec::MecMsg::TOUCH_CONTINUE;
+        frame[i].data_.touch_.touchId_ = i;
+    }
+    assert(queue.addFrameToQueue(frame, 0));
+    for (int f = 0; f < 20; f++) {
+        assert(queue.addFrameToQueue(frame, 40)); // wraps the queue
+        assert(queue.drain(batch, 16) == 16);
+        assert(batch[0].data_.touch_.touchId_ == 0);
+        PerTouchCallback frameCounter;
+        assert(queue.process(frameCounter));
+        assert(frameCounter.count_ == 24);
+    }
+    for (int f = 0; f < 6; f++) assert(queue.addFrameToQueue(frame, 40));
+    assert(queue.pending() == 240);
+    assert(!queue.addFrameToQueue(frame, 40));
+    assert(queue.pending() == 240);
+    assert(queue.dropped() == 40);
+    assert(!queue.addFrameToQueue(frame, 257));
+    while (queue.drain(batch, 16) > 0);
+    queue.resetStats();
+
+    // frame markers are passed to frameStart/frameEnd by the default touchFrame
+    frame[0].type_ = mec::MecMsg::FRAME_START;
+    frame[0].data_.frame_.frameId_ = 7;
+    frame[9].type_ = mec::MecMsg::FRAME_END;
+    frame[9].data_.frame_.frameId_ = 7;
+    assert(queue.addFrameToQueue(frame, 10));
+    MarkerCallback markers;
+    assert(queue.process(markers));
+    assert(markers.starts_ == 1 && markers.ends_ == 1 && markers.lastFrame_ == 7);
+    assert(markers.count_ == 8);
+
+    // throughput under contention
+    benchmark(64, 1);
+    benchmark(1024, 1);
+    benchmark(64, 2);
+    benchmark(1024, 4);
+
+    dispatchBenchmark();
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include <mec_api.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cJSON.h>
+
+#include <osc/OscOutboundPacketStream.h>
+#include <ip/UdpSocket.h>
+
+#include <devices/mec_osct3d.h>
+#include <mec_log.h>
+
+// loopback check of the t3d osc input: a sender thread plays 16 touches at 1kHz, as bundles
+// of /t3d/frm followed by /t3d/tchN, some touches end with z = 0, others just stop being sent
+// (as if the sender crashed, or the packet with the off was lost), these must be turned off
+// by the touch timeout, i.e. every touch on must be followed by a touch off
+// also reports the cpu time of OscT3D::process per frame
+
+static const unsigned PORT = 9123;
+static const unsigned TOUCHES = 16;
+static const unsigned TIMEOUT = 50; // ms
+static const unsigned FRAMES = 1000;
+static const unsigned PACKET_SIZE = 1536;
+
+// counts ons and offs by voice, a voice must not be turned on twice without an off
+class CountingCallback : public mec::Callback {
+public:
+    CountingCallback() : ons_(0), offs_(0), continues_(0), errors_(0), active_(TOUCHES, false) { ; }
+
+    void touchOn(int touchId, float note, float x, float y, float z) override {
+        assert(touchId >= 0 && touchId < (int) TOUCHES);
+        if (active_[touchId]) errors_++;
+        active_[touchId] = true;
+        ons_++;
+    }
+
+    void touchContinue(int touchId, float note, float x, float y, float z) override {
+        assert(touchId >= 0 && touchId < (int) TOUCHES);
+        if (!active_[touchId]) errors_++;
+        continues_++;
+    }
+
+    void touchOff(int touchId, float note, float x, float y, float z) override {
+        assert(touchId >= 0 && touchId < (int) TOUCHES);
+        if (!active_[touchId]) errors_++;
+        active_[touchId] = false;
+        offs_++;
+    }
+
+    unsigned stuck() {
+        unsigned n = 0;
+        for (bool a : active_) if (a) n++;
+        return n;
+    }
+
+    unsigned long ons_;
+    unsigned long offs_;
+    unsigned long continues_;
+    unsigned long errors_;
+    std::vector<bool> active_;
+};
+
+// touch t is held for 100 frames then released for 30, phase shifted by touch
+// odd touches are abandoned instead of released, then are silent for 150 frames (> timeout)
+static bool touchDown(unsigned t, unsigned frame, bool &abandoned) {
+    unsigned cycle = 130 + ((t & 1) ? 120 : 0);
+    unsigned f = (frame + t * 7) % cycle;
+    abandoned = (t & 1) != 0;
+    return f < 100;
+}
+
+static void sender(std::atomic<bool> &done, std::atomic<unsigned long> &sentOffs) {
+    UdpTransmitSocket socket(IpEndpointName("127.0.0.1", PORT));
+    char buffer[PACKET_SIZE];
+    std::vector<bool> down(TOUCHES, false);
+    char addr[32];
+
+    for (unsigned frame = 0; frame < FRAMES; frame++) {
+        osc::OutboundPacketStream ops(buffer, PACKET_SIZE);
+        ops << osc::BeginBundleImmediate;
+        ops << osc::BeginMessage("/t3d/frm") << (osc::int32) frame << (osc::int32) 0 << osc::EndMessage;
+        for (unsigned t = 0; t < TOUCHES; t++) {
+            bool abandoned;
+            bool d = touchDown(t, frame, abandoned);
+            if (!d && !down[t]) continue;
+            down[t] = d;
+            if (!d && abandoned) continue; // no off sent
+
+            snprintf(addr, sizeof(addr), "/t3d/tch%u", t + 1);
+            float z = d ? 0.5f : 0.0f;
+            if (!d) sentOffs++;
+            ops << osc::BeginMessage(addr) << (float) t / TOUCHES << 0.5f << z << 48.0f + t << osc::EndMessage;
+        }
+        ops << osc::EndBundle;
+        socket.Send(ops.Data(), ops.Size());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    done = true;
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    std::string prefs = "{ \"port\" : " + std::to_string(PORT) +
+                        ", \"voices\" : 16, \"queue size\" : 2048, \"touch timeout\" : " + std::to_string(TIMEOUT) + " }";
+    cJSON *json = cJSON_Parse(prefs.c_str());
+    assert(json != nullptr);
+
+    CountingCallback cb;
+    {
+        mec::OscT3D device(cb);
+        bool ok = device.init(json);
+        assert(ok);
+        assert(device.isActive());
+
+        std::atomic<bool> done(false);
+        std::atomic<unsigned long> sentOffs(0);
+        std::thread sendThread(sender, std::ref(done), std::ref(sentOffs));
+
+        std::clock_t cpu = 0;
+        while (!done) {
+            std::clock_t c = std::clock();
+            device.process();
+            cpu += std::clock() - c;
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        sendThread.join();
+
+        // let the abandoned touches time out
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT * 4);
+        while (std::chrono::steady_clock::now() < end) {
+            device.process();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        device.process();
+
+        unsigned long frames = device.framesReceived();
+        LOG_0("frames " << frames << " touches " << device.touchesReceived()
+                        << " ons " << cb.ons_ << " continues " << cb.continues_ << " offs " << cb.offs_
+                        << " (sent " << sentOffs << ") timed out " << device.touchesTimedOut());
+        if (frames > 0) {
+            LOG_0("process cpu per frame : " << (double(cpu) * 1000000.0 / CLOCKS_PER_SEC) / frames << "us");
+        }
+
+        // loopback udp may drop packets under load, but most frames should arrive
+        assert(frames > FRAMES / 2);
+        assert(cb.ons_ > 0);
+        assert(cb.errors_ == 0);
+        assert(cb.stuck() == 0);
+        assert(cb.ons_ == cb.offs_);
+        assert(device.touchesTimedOut() > 0);
+
+        device.deinit();
+        assert(!device.isActive());
+    }
+    cJSON_Delete(json);
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -2,6 +2,8 @@
 #include <iostream>
 
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <mec_scaler.h>
 #include <mec_log.h>
 
@@ -12,6 +14,70 @@ void dumpScale(const mec::ScaleArray& a) {
     std::cout << std::endl;
 }
 
+// batch must agree with map(), over a range of rows/columns including negative columns
+void checkBatch(const mec::Scaler &scaler) {
+    static const unsigned N = 203; // not a multiple of 4, to check remainder
+    float r[N], c[N], note[N];
+    for (unsigned i = 0; i < N; i++) {
+        r[i] = (float) (i % 5);
+        c[i] = -20.0f + (float) i * 0.37f;
+    }
+    scaler.mapBatch(r, c, note, N);
+    mec::Touch t;
+    for (unsigned i = 0; i < N; i++) {
+        t.r_ = r[i];
+        t.c_ = c[i];
+        float expected = scaler.map(t).note_;
+        assert(std::fabs(note[i] - expected) < 0.0001f);
+    }
+}
+
+// scalar vs batch throughput, a frame of 16 touches
+static const unsigned FRAME_TOUCHES = 16;
+static const unsigned FRAMES = 1000000;
+
+void benchmark(mec::Scaler &scaler) {
+    mec::Touch touches[FRAME_TOUCHES];
+    mec::MusicalTouch out[FRAME_TOUCHES];
+    float r[FRAME_TOUCHES], c[FRAME_TOUCHES], note[FRAME_TOUCHES];
+    for (unsigned i = 0; i < FRAME_TOUCHES; i++) {
+        touches[i].r_ = r[i] = (float) (i % 4);
+        touches[i].c_ = c[i] = (float) i * 1.3f;
+    }
+
+    float sum = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned f = 0; f < FRAMES; f++) {
+        for (unsigned i = 0; i < FRAME_TOUCHES; i++) {
+            touches[i].c_ += 0.0001f;
+            sum += scaler.map(touches[i]).note_;
+        }
+    }
+    double scalarSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned f = 0; f < FRAMES; f++) {
+        for (unsigned i = 0; i < FRAME_TOUCHES; i++) c[i] += 0.0001f;
+        scaler.mapBatch(r, c, note, FRAME_TOUCHES);
+        sum += note[0];
+    }
+    double batchSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned f = 0; f < FRAMES; f++) {
+        touches[0].c_ += 0.0001f;
+        scaler.mapBatch(touches, out, FRAME_TOUCHES);
+        sum += out[0].note_;
+    }
+    double touchSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    LOG_0((scaler.getPitchMode() == mec::Scaler::P_QUANTIZED ? "quantized" : "continuous")
+                  << " " << FRAME_TOUCHES << " touches x " << FRAMES << " frames"
+                  << " scalar " << (scalarSecs * 1000000000.0 / FRAMES) << "ns/frame"
+                  << " batch " << (batchSecs * 1000000000.0 / FRAMES) << "ns/frame"
+                  << " batch (touch) " << (touchSecs * 1000000000.0 / FRAMES) << "ns/frame"
+                  << " (checksum " << sum << ")");
+}
 
 int main (int argc, char** argv) {
     LOG_0("test started");
@@ -83,6 +149,37 @@ int main (int argc, char** argv) {
     // 12 + 2.5 + 4.0 (row o) + 1.0 (col o)
     assert(mt.note_ == 19.5f);
 
+    // quantized, snap to nearest degree
+    scaler.setPitchMode(mec::Scaler::P_QUANTIZED);
+    t.c_ = 8.4f;
+    mt = scaler.map(t);
+    assert(mt.note_ == 19.0f);
+    t.c_ = 8.6f;
+    mt = scaler.map(t);
+    assert(mt.note_ == 20.0f);
+
+    // batch agrees with map
+    checkBatch(scaler);
+    scaler.setPitchMode(mec::Scaler::P_CONTINUOUS);
+    checkBatch(scaler);
+    scaler.setScale(odd);
+    checkBatch(scaler);
+    mec::MusicalTouch mts[3];
+    mec::Touch ts[3];
+    for (int i = 0; i < 3; i++) {
+        ts[i].id_ = i;
+        ts[i].r_ = 1;
+        ts[i].c_ = 8.5f + i;
+    }
+    scaler.mapBatch(ts, mts, 3);
+    assert(mts[2].id_ == 2);
+    assert(mts[0].note_ == scaler.map(ts[0]).note_);
+
+    scaler.setScale("major");
+    benchmark(scaler);
+    scaler.setPitchMode(mec::Scaler::P_QUANTIZED);
+    benchmark(scaler);
+
 
     LOG_0("test completed");
     return 0;
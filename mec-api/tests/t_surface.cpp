@@ -1,12 +1,48 @@
 #include <mec_api.h>
 
 #include <cassert>
+#include <chrono>
 #include <iostream>
 
 #include <mec_surface.h>
 #include <mec_prefs.h>
 #include <mec_log.h>
 
+// throughput benchmark, 16 touches per frame routed through a 3 level tree
+// t (split x) -> t0 (split x) -> tj (join t00,t01)
+static const unsigned FRAME_TOUCHES = 16;
+static const unsigned FRAMES = 100000;
+
+void benchmark(mec::SurfaceManager &mgr) {
+    mec::SurfaceID src = mgr.surfaceId("t");
+    mec::SurfaceID joined = mgr.surfaceId("tj");
+    mec::SurfaceID t1 = mgr.surfaceId("t1");
+
+    mec::Touch touches[FRAME_TOUCHES];
+    for (unsigned i = 0; i < FRAME_TOUCHES; i++) {
+        touches[i] = mec::Touch(i, src, 0.0f, 0.5f, 0.5f, 0.0f, 0.0f);
+    }
+
+    float sum = 0.0f;
+    unsigned routed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned f = 0; f < FRAMES; f++) {
+        for (unsigned i = 0; i < FRAME_TOUCHES; i++) {
+            touches[i].x_ = (float) ((f + i) % 100) / 100.0f;
+            mec::Touch out = mgr.route(touches[i]);
+            assert(out.surface_ == joined || out.surface_ == t1);
+            sum += out.x_;
+            routed++;
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    LOG_0("route " << FRAME_TOUCHES << " touches x " << FRAMES << " frames"
+                   << " time " << secs << "s"
+                   << " per touch " << (secs * 1000000000.0 / routed) << "ns"
+                   << " (checksum " << sum << ")");
+}
+
 int main (int argc, char** argv) {
     LOG_0("test started");
 
@@ -26,18 +62,24 @@ int main (int argc, char** argv) {
     mec::Touch t;
     mec::Touch out;
 
+    // names resolve to stable ids
+    assert(mgr.surfaceId("1") == mgr.surfaceId("1"));
+    assert(mgr.surfaceId("10") != mgr.surfaceId("11"));
+    assert(mgr.surfaceName(mgr.surfaceId("10")) == "10");
+
     // simple split
     std::shared_ptr<mec::Surface> split1 = mgr.getSurface("1");
     assert(split1 != nullptr);
-    t.surface_ = "a1";
+    assert(split1 == mgr.getSurface(mgr.surfaceId("1")));
+    t.surface_ = mgr.surfaceId("a1");
     t.x_ = 0.1f;
     out = split1->map(t);
     assert(out.x_ == t.x_);
-    assert(out.surface_ == "10");
+    assert(out.surface_ == mgr.surfaceId("10"));
     t.x_ = 0.8f;
     out = split1->map(t);
     assert(out.x_ == 0.3f);
-    assert(out.surface_ == "11");
+    assert(out.surface_ == mgr.surfaceId("11"));
 
 
 
@@ -45,15 +87,30 @@ int main (int argc, char** argv) {
     std::shared_ptr<mec::Surface> join1 = mgr.getSurface("2");
     assert(join1 != nullptr);
     t.x_ = 0.1f;
-    t.surface_ = "20";
+    t.surface_ = mgr.surfaceId("20");
     out = join1->map(t);
     assert(out.x_ == t.x_);
-    assert(out.surface_ == "2");
-    t.surface_ = "21";
+    assert(out.surface_ == mgr.surfaceId("2"));
+    t.surface_ = mgr.surfaceId("21");
     out = join1->map(t);
     assert(out.x_ == 1.1f);
-    assert(out.surface_ == "2");
+    assert(out.surface_ == mgr.surfaceId("2"));
+
+    // routing table, split -> split -> join
+    t.surface_ = mgr.surfaceId("t");
+    t.x_ = 0.3f;
+    out = mgr.route(t);
+    assert(out.surface_ == mgr.surfaceId("tj"));
+    assert(out.x_ == 0.3f);
+    t.x_ = 0.8f;
+    out = mgr.route(t);
+    assert(out.surface_ == mgr.surfaceId("t1"));
+    t.surface_ = mgr.surfaceId("a1"); // not consumed, passes thru
+    out = mgr.route(t);
+    assert(out.surface_ == t.surface_);
+
+    benchmark(mgr);
 
     LOG_0("test completed");
     return 0;
-}
\ No newline at end of file
+}
@@ -1,12 +1,39 @@
 #include <mec_api.h>
 
 #include <cassert>
+#include <chrono>
 #include <iostream>
 
 #include <mec_voice.h>
 #include <mec_prefs.h>
 #include <mec_log.h>
 
+// 1M start/stop cycles, with all voices in use (so each start also steals)
+void benchmark(unsigned voiceCount) {
+    static const unsigned CYCLES = 1000000;
+    mec::Voices voices(voiceCount, 2);
+
+    for (unsigned i = 0; i < voiceCount; i++) voices.startVoice(i);
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = voiceCount; i < CYCLES + voiceCount; i++) {
+        unsigned id = i % 200;
+        mec::Voices::Voice *v = voices.voiceId(id);
+        if (v) voices.stopVoice(v);
+        v = voices.startVoice(id);
+        if (!v) {
+            voices.stopVoice(voices.stealVoice());
+            v = voices.startVoice(id);
+        }
+        assert(v != nullptr);
+        v->z_ = 0.5f;
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    LOG_0("voices " << voiceCount << " cycles " << CYCLES
+                    << " time " << secs << "s"
+                    << " per cycle " << (secs * 1000000000.0 / CYCLES) << "ns");
+}
+
 int main (int argc, char** argv) {
     LOG_0("test started");
 
@@ -29,6 +56,58 @@ int main (int argc, char** argv) {
     voices.startVoice(4);
     assert(voices.oldestActiveVoice()->id_ == 2);
 
+    // touch id lookup
+    assert(voices.voiceId(2) != nullptr);
+    assert(voices.voiceId(2)->id_ == 2);
+    assert(voices.voiceId(1) == nullptr);
+    assert(voices.voiceId(1000) == nullptr);
+
+    // steal policies
+    voices.voiceId(2)->note_ = 60.0f;
+    voices.voiceId(2)->z_ = 0.1f;
+    voices.voiceId(3)->note_ = 72.0f;
+    voices.voiceId(3)->z_ = 0.5f;
+    voices.voiceId(4)->note_ = 48.0f;
+    voices.voiceId(4)->z_ = 0.9f;
+    assert(voices.stealVoice()->id_ == 2);
+    voices.setStealPolicy(mec::Voices::stealPolicy("highest"));
+    assert(voices.stealVoice()->id_ == 3);
+    voices.setStealPolicy(mec::Voices::stealPolicy("lowest"));
+    assert(voices.stealVoice()->id_ == 4);
+    voices.setStealPolicy(mec::Voices::stealPolicy("quietest"));
+    assert(voices.stealVoice()->id_ == 2);
+
+    // stopping from the middle of the used list, ids beyond the lookup table
+    voices.stopVoice(voices.voiceId(3));
+    assert(voices.activeCount() == 2);
+    assert(voices.freeCount() == 1);
+    v = voices.startVoice(1000);
+    assert(v != nullptr);
+    assert(voices.voiceId(1000) == v);
+    voices.stopVoice(v);
+    voices.stopVoice(v); // double stop is ignored
+    assert(voices.voiceId(1000) == nullptr);
+    assert(voices.freeCount() == 1);
+
+    // starting an active id again returns its voice, rather than taking another
+    v = voices.startVoice(5);
+    assert(v != nullptr);
+    assert(voices.startVoice(5) == v);
+    assert(voices.freeCount() == 0);
+    voices.stopVoice(voices.voiceId(4));
+    v = voices.startVoice(2000);
+    assert(v != nullptr);
+    assert(voices.startVoice(2000) == v);
+    assert(voices.activeCount() == 3);
+    assert(voices.freeCount() == 0);
+    voices.stopVoice(voices.voiceId(2000));
+    voices.stopVoice(voices.voiceId(5));
+    assert(voices.voiceId(5) == nullptr);
+    assert(voices.freeCount() == 2);
+
+    benchmark(16);
+    benchmark(128);
+
     LOG_0("test completed");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include <mec_api.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <mec_msg_queue.h>
+#include <mec_notifier.h>
+#include <mec_log.h>
+
+// latency benchmark, from device thread enqueue to ICallback, comparing
+// polling (process then wait 5ms, as mec-app used to) with event driven wakeup (Notifier)
+
+typedef std::chrono::steady_clock Clock;
+
+static const unsigned BENCH_MSGS = 500;
+static const unsigned POLL_MS = 5;
+static const unsigned HOUSEKEEPING_MS = 100;
+
+class LatencyCallback : public mec::Callback {
+public:
+    LatencyCallback(const std::vector<Clock::time_point> &sent) : sent_(sent), received_(0) {
+        latency_.reserve(sent.size());
+    }
+
+    void touchContinue(int touchId, float, float, float, float) override {
+        auto now = Clock::now();
+        latency_.push_back(std::chrono::duration<double, std::micro>(now - sent_[touchId]).count());
+        received_++;
+    }
+
+    void report(const char *mode) {
+        std::sort(latency_.begin(), latency_.end());
+        double sum = 0.0;
+        for (double l : latency_) sum += l;
+        LOG_0(mode
+                      << " msgs " << latency_.size()
+                      << " mean " << (sum / latency_.size()) << "us"
+                      << " p50 " << latency_[latency_.size() / 2] << "us"
+                      << " p99 " << latency_[(latency_.size() * 99) / 100] << "us"
+                      << " max " << latency_.back() << "us");
+    }
+
+    const std::vector<Clock::time_point> &sent_;
+    std::vector<double> latency_;
+    std::atomic<unsigned> received_;
+};
+
+// simulates a device thread, sending a touch every ~1ms (1kHz sensor)
+void deviceProc(mec::MsgQueue *queue, std::vector<Clock::time_point> *sent) {
+    mec::MecMsg msg;
+    msg.type_ = mec::MecMsg::TOUCH_CONTINUE;
+    msg.data_.touch_.note_ = msg.data_.touch_.x_ = msg.data_.touch_.y_ = msg.data_.touch_.z_ = 0.0f;
+    for (unsigned i = 0; i < BENCH_MSGS; i++) {
+        // vary phase relative to the poll period
+        std::this_thread::sleep_for(std::chrono::microseconds(1000 + (i * 137) % 500));
+        msg.data_.touch_.touchId_ = i;
+        (*sent)[i] = Clock::now();
+        queue->addToQueue(msg);
+    }
+}
+
+void benchmark(bool eventDriven) {
+    mec::MsgQueue queue(256);
+    mec::Notifier notifier;
+    std::vector<Clock::time_point> sent(BENCH_MSGS);
+    LatencyCallback cb(sent);
+
+    std::mutex waitMtx;
+    std::condition_variable waitCond;
+
+    if (eventDriven) queue.setNotifier(&notifier);
+
+    std::thread device(deviceProc, &queue, &sent);
+    if (eventDriven) {
+        while (cb.received_ < BENCH_MSGS) {
+            queue.process(cb);
+            notifier.wait(std::chrono::milliseconds(HOUSEKEEPING_MS));
+        }
+    } else {
+        std::unique_lock<std::mutex> lock(waitMtx);
+        while (cb.received_ < BENCH_MSGS) {
+            queue.process(cb);
+            waitCond.wait_for(lock, std::chrono::milliseconds(POLL_MS));
+        }
+    }
+    device.join();
+
+    cb.report(eventDriven ? "event driven" : "polling (5ms)");
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    // notifier, signal is latched until next wait
+    mec::Notifier notifier;
+    assert(!notifier.wait(std::chrono::milliseconds(1)));
+    notifier.notify();
+    notifier.notify();
+    assert(notifier.wait(std::chrono::milliseconds(1)));
+    assert(!notifier.wait(std::chrono::milliseconds(1)));
+
+    // queue signals notifier on add
+    mec::MsgQueue queue;
+    queue.setNotifier(&notifier);
+    mec::MecMsg msg;
+    msg.type_ = mec::MecMsg::TOUCH_ON;
+    queue.addToQueue(msg);
+    assert(notifier.wait(std::chrono::milliseconds(1)));
+    queue.setNotifier(nullptr);
+    queue.addToQueue(msg);
+    assert(!notifier.wait(std::chrono::milliseconds(1)));
+
+    benchmark(false);
+    benchmark(true);
+
+    LOG_0("test completed");
+    return 0;
+}
@@ -17,24 +17,26 @@ inline void pthread_exit(void *value_ptr)
 
 #endif
 #include <string.h>
-
-#include <osc/OscOutboundPacketStream.h>
-#include <ip/UdpSocket.h>
+#include <atomic>
 
 #include "mec_app.h"
 #include "midi_output.h"
+#include "osc_output.h"
 
 #include <mec_api.h>
+#include <mec_capture.h>
+#include <mec_latency.h>
 #include <mec_prefs.h>
 #include <processors/mec_mpe_processor.h>
 
-#define OUTPUT_BUFFER_SIZE 1024
-
 //hacks for now
 //#define VELOCITY 1.0f
 //#define PB_RANGE 2.0f
 //#define MPE_PB_RANGE 48.0f
 
+// the running api, so a shutdown request can wake its event loop
+static std::atomic<mec::MecApi *> runningApi(nullptr);
+
 class MecCmdCallback : public mec::ICallback {
 public:
     virtual void mec_control(int cmd, void *other) {
@@ -43,6 +45,8 @@ public:
                 LOG_0("mec requesting shutdown");
                 keepRunning = 0;
                 waitCond.notify_all();
+                mec::MecApi *api = runningApi.load();
+                if (api) api->wakeup();
                 break;
             }
             default: {
@@ -110,12 +114,12 @@ private:
 };
 
 
-// this is basically T3D, but doesnt have the framemessages (/t3d/frm)
+// T3D, each frame of touches is sent as one bundle, with a /t3d/frm header
 class MecOSCCallback : public MecCmdCallback {
 public:
     MecOSCCallback(mec::Preferences &p)
             : prefs_(p),
-              transmitSocket_(IpEndpointName(p.getString("host", "127.0.0.1").c_str(), p.getInt("port", 9001))),
+              output_(p.getString("host", "127.0.0.1"), static_cast<unsigned>(p.getInt("port", 9001))),
               valid_(true) {
         if (valid_) {
             LOG_0("mecapi_proc enabling for osc");
@@ -124,46 +128,34 @@ public:
 
     bool isValid() { return valid_; }
 
+    void touchFrame(const mec::MsgSpan &msgs) override {
+        output_.sendFrame(msgs);
+        for (const mec::MecMsg &msg : msgs) {
+            if (msg.type_ == mec::MecMsg::MEC_CONTROL && msg.data_.mec_control_.cmd_ == mec::MecMsg::SHUTDOWN) {
+                mec_control(mec::ICallback::SHUTDOWN, nullptr);
+            }
+        }
+    }
+
     void touchOn(int touchId, float note, float x, float y, float z) {
-        std::string topic = "/t3d/tch" + std::to_string(touchId);
-        sendMsg(topic, touchId, note, x, y, z);
+        output_.touch(touchId, note, x, y, z);
     }
 
     void touchContinue(int touchId, float note, float x, float y, float z) {
-        std::string topic = "/t3d/tch" + std::to_string(touchId);
-        sendMsg(topic, touchId, note, x, y, z);
+        output_.touch(touchId, note, x, y, z);
     }
 
     void touchOff(int touchId, float note, float x, float y, float z) {
-        std::string topic = "/t3d/tch" + std::to_string(touchId);
-        sendMsg(topic, touchId, note, x, y, 0);
-
+        output_.touch(touchId, note, x, y, 0);
     }
 
     void control(int ctrlId, float v) {
-        osc::OutboundPacketStream op(buffer_, OUTPUT_BUFFER_SIZE);
-        op << osc::BeginBundleImmediate
-           << osc::BeginMessage("/t3d/control")
-           << ctrlId << v
-           << osc::EndMessage
-           << osc::EndBundle;
-        transmitSocket_.Send(op.Data(), op.Size());
-    }
-
-    void sendMsg(std::string topic, int touchId, float note, float x, float y, float z) {
-        osc::OutboundPacketStream op(buffer_, OUTPUT_BUFFER_SIZE);
-        op << osc::BeginBundleImmediate
-           << osc::BeginMessage(topic.c_str())
-           << x << y << z << note
-           << osc::EndMessage
-           << osc::EndBundle;
-        transmitSocket_.Send(op.Data(), op.Size());
+        output_.control(ctrlId, v);
     }
 
 private:
     mec::Preferences prefs_;
-    UdpTransmitSocket transmitSocket_;
-    char buffer_[OUTPUT_BUFFER_SIZE];
+    OscOutput output_;
     bool valid_;
 };
 
@@ -185,12 +177,13 @@ public:
 
     void process(mec::Midi_Processor::MidiMsg &m) {
         if (output_.isOpen()) {
-            std::vector<unsigned char> msg;
+            output_.sendMsg((unsigned char *) m.data, m.size);
+        }
+    }
 
-            for (int i = 0; i < m.size; i++) {
-                msg.push_back((unsigned char) m.data[i]);
-            }
-            output_.sendMsg(msg);
+    void process(const mec::MidiBuffer &buf) {
+        if (output_.isOpen()) {
+            output_.sendMsgs(buf);
         }
     }
 
@@ -222,12 +215,13 @@ public:
 
     void process(mec::MPE_Processor::MidiMsg &m) {
         if (output_.isOpen()) {
-            std::vector<unsigned char> msg;
+            output_.sendMsg((unsigned char *) m.data, m.size);
+        }
+    }
 
-            for (int i = 0; i < m.size; i++) {
-                msg.push_back((unsigned char) m.data[i]);
-            }
-            output_.sendMsg(msg);
+    void process(const mec::MidiBuffer &buf) {
+        if (output_.isOpen()) {
+            output_.sendMsgs(buf);
         }
     }
 
@@ -293,9 +287,28 @@ void *mecapi_proc(void *arg) {
         }
     }
 
+    // record everything played, saved once the api has shut down
+    std::unique_ptr<mec::CaptureRecorder> recorder;
+    std::string recordFile;
+    if (outprefs.exists("record")) {
+        mec::Preferences cbprefs(outprefs.getSubTree("record"));
+        recordFile = cbprefs.getString("file", "mec-capture.mecc");
+        recorder.reset(new mec::CaptureRecorder());
+        mecApi->subscribe(recorder.get());
+        LOG_0("mecapi_proc recording to " << recordFile);
+    }
+
     mecApi->init();
+    runningApi = mecApi.get();
 
-    {
+    if (app_prefs.getBool("event driven", true)) {
+        // wake as soon as a device has data, timeout is just for housekeeping (e.g. checking keepRunning)
+        unsigned housekeeping = static_cast<unsigned>(app_prefs.getInt("housekeeping interval", 100));
+        while (keepRunning) {
+            mecApi->process();
+            mecApi->waitForWork(housekeeping);
+        }
+    } else {
         std::unique_lock<std::mutex> lock(waitMtx);
         while (keepRunning) {
             mecApi->process();
@@ -305,7 +318,19 @@ void *mecapi_proc(void *arg) {
 
     // delete the api, so that it can clean up
     LOG_0("mecapi_proc stopping");
+    runningApi = nullptr;
     mecApi.reset();
+    if (mec::Latency::enabled() && mec::Latency::histogram(mec::Latency::TOTAL).count() > 0) {
+        LOG_0("mecapi_proc " << mec::Latency::report());
+    }
+    if (recorder) {
+        mec::Capture &capture = recorder->capture();
+        if (recorder->save(recordFile)) {
+            LOG_0("mecapi_proc recorded " << capture.frameCount() << " frames, " << capture.msgCount() << " msgs to " << recordFile);
+        } else {
+            LOG_0("mecapi_proc unable to save recording " << recordFile);
+        }
+    }
     sleep(1);
     LOG_0("mecapi_proc stopped");
 
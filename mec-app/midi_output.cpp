@@ -56,11 +56,26 @@ bool MidiOutput::create(const std::string &portname, bool virt) {
     return false;
 }
 
-bool MidiOutput::sendMsg(std::vector<unsigned char> &msg) {
+bool MidiOutput::sendMsg(const unsigned char *data, unsigned size) {
     if (!isOpen()) return false;
 
     try {
-        output_->sendMessage(&msg);
+        output_->sendMessage(data, size);
+    } catch (RtMidiError &error) {
+        LOG_0("Midi output write error:" << error.what());
+        return false;
+    }
+    return true;
+}
+
+bool MidiOutput::sendMsgs(const mec::MidiBuffer &buf) {
+    if (!isOpen()) return false;
+
+    // rtmidi apis take one complete message per call, so no running status here
+    try {
+        buf.forEach([this](const unsigned char *data, unsigned size) {
+            output_->sendMessage(data, size);
+        });
     } catch (RtMidiError &error) {
         LOG_0("Midi output write error:" << error.what());
         return false;
@@ -4,6 +4,8 @@
 #include <memory>
 #include <RtMidi.h>
 
+#include <mec_midi_buffer.h>
+
 
 class MidiOutput {
 public:
@@ -14,7 +16,8 @@ public:
 
     bool isOpen() { return (output_ && (virtualOpen_ || output_->isPortOpen())); }
 
-    bool sendMsg(std::vector<unsigned char> &msg);
+    bool sendMsg(const unsigned char *data, unsigned size);
+    bool sendMsgs(const mec::MidiBuffer &buf); // each message in turn, stops on error
 private:
     std::unique_ptr<RtMidiOut> output_;
     bool virtualOpen_;
@@ -0,0 +1,124 @@
+#include "osc_output.h"
+
+#include <chrono>
+#include <cstdio>
+
+OscOutput::OscOutput(const std::string &host, unsigned port)
+        : socket_(IpEndpointName(host.c_str(), port)),
+          stream_(buffer_, MAX_PACKET_SIZE),
+          frameId_(0),
+          frameTime_(0),
+          inFrame_(false),
+          msgs_(0),
+          packets_(0),
+          bytes_(0),
+          touches_(0) {
+    for (unsigned i = 0; i < TOUCH_ADDRESSES; i++) {
+        snprintf(addresses_[i], ADDRESS_SIZE, "/t3d/tch%u", i);
+    }
+}
+
+const char *OscOutput::touchAddress(int touchId) {
+    if (touchId >= 0 && touchId < (int) TOUCH_ADDRESSES) return addresses_[touchId];
+    snprintf(address_, ADDRESS_SIZE, "/t3d/tch%d", touchId);
+    return address_;
+}
+
+void OscOutput::beginFrame() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    frameTime_ = (osc::int32) std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+    inFrame_ = true;
+    beginBundle();
+}
+
+void OscOutput::beginBundle() {
+    stream_.Clear();
+    stream_ << osc::BeginBundleImmediate
+            << osc::BeginMessage("/t3d/frm")
+            << (osc::int32) frameId_ << frameTime_
+            << osc::EndMessage;
+    msgs_ = 0;
+}
+
+void OscOutput::sendBundle() {
+    stream_ << osc::EndBundle;
+    socket_.Send(stream_.Data(), stream_.Size());
+    packets_++;
+    bytes_ += stream_.Size();
+}
+
+// a frame too large for one packet continues in another bundle, with the same frame header
+void OscOutput::reserve() {
+    if (stream_.Capacity() - stream_.Size() < MAX_MSG_SIZE) {
+        sendBundle();
+        beginBundle();
+    }
+}
+
+void OscOutput::endFrame() {
+    if (!inFrame_) return;
+    if (msgs_ == 0) {
+        // nothing to send, e.g. a span of only markers or mec controls
+        inFrame_ = false;
+        return;
+    }
+    sendBundle();
+    frameId_++;
+    inFrame_ = false;
+}
+
+void OscOutput::touch(int touchId, float note, float x, float y, float z) {
+    bool single = !inFrame_;
+    if (single) beginFrame();
+    reserve();
+    stream_ << osc::BeginMessage(touchAddress(touchId))
+            << x << y << z << note
+            << osc::EndMessage;
+    msgs_++;
+    touches_++;
+    if (single) endFrame();
+}
+
+void OscOutput::control(int ctrlId, float v) {
+    bool single = !inFrame_;
+    if (single) beginFrame();
+    reserve();
+    stream_ << osc::BeginMessage("/t3d/control")
+            << ctrlId << v
+            << osc::EndMessage;
+    msgs_++;
+    if (single) endFrame();
+}
+
+void OscOutput::sendFrame(const mec::MsgSpan &msgs) {
+    for (const mec::MecMsg &msg : msgs) {
+        if (msg.type_ == mec::MecMsg::FRAME_START) {
+            endFrame();
+            beginFrame();
+            continue;
+        }
+        if (msg.type_ == mec::MecMsg::FRAME_END) {
+            endFrame();
+            continue;
+        }
+        if (msg.type_ == mec::MecMsg::MEC_CONTROL) continue;
+        if (!inFrame_) beginFrame();
+        switch (msg.type_) {
+            case mec::MecMsg::TOUCH_ON:
+            case mec::MecMsg::TOUCH_CONTINUE:
+                touch(msg.data_.touch_.touchId_, msg.data_.touch_.note_,
+                      msg.data_.touch_.x_, msg.data_.touch_.y_, msg.data_.touch_.z_);
+                break;
+            case mec::MecMsg::TOUCH_OFF:
+                touch(msg.data_.touch_.touchId_, msg.data_.touch_.note_,
+                      msg.data_.touch_.x_, msg.data_.touch_.y_, 0.0f);
+                break;
+            case mec::MecMsg::CONTROL:
+                control(msg.data_.control_.controlId_, msg.data_.control_.value_);
+                break;
+            default:
+                break;
+        }
+    }
+    endFrame();
+}
@@ -0,0 +1,63 @@
+#ifndef MEC_OSC_OUTPUT_H
+#define MEC_OSC_OUTPUT_H
+
+#include <cstdint>
+#include <string>
+
+#include <osc/OscOutboundPacketStream.h>
+#include <ip/UdpSocket.h>
+
+#include <mec_msg_queue.h>
+
+// T3D over OSC, a bundle per frame, a /t3d/frm header, then a /t3d/tchN message per touch
+// addresses are preformatted, and packets are built in a reusable buffer,
+// so a frame is sent without allocation, in one send (unless it exceeds MAX_PACKET_SIZE)
+class OscOutput {
+public:
+    // ethernet mtu, less ip and udp headers
+    static const unsigned MAX_PACKET_SIZE = 1472;
+    static const unsigned TOUCH_ADDRESSES = 128;
+
+    OscOutput(const std::string &host, unsigned port);
+
+    // touches and controls between beginFrame and endFrame are sent as one bundle
+    void beginFrame();
+    void touch(int touchId, float note, float x, float y, float z);
+    void control(int ctrlId, float v);
+    void endFrame();
+
+    // touch off is sent with z = 0, other messages are ignored
+    // with frame markers, each sensor frame is a bundle, otherwise the whole span is one bundle
+    void sendFrame(const mec::MsgSpan &msgs);
+
+    unsigned long packets() const { return packets_; }
+    unsigned long bytes() const { return bytes_; }
+    unsigned long touches() const { return touches_; }
+    void resetStats() { packets_ = bytes_ = touches_ = 0; }
+
+private:
+    // largest message we write, /t3d/tch with a 10 digit id, 4 floats
+    static const unsigned MAX_MSG_SIZE = 64;
+    static const unsigned ADDRESS_SIZE = 24;
+
+    const char *touchAddress(int touchId);
+    void beginBundle();
+    void sendBundle();
+    void reserve();
+
+    UdpTransmitSocket socket_;
+    char buffer_[MAX_PACKET_SIZE];
+    osc::OutboundPacketStream stream_;
+    char addresses_[TOUCH_ADDRESSES][ADDRESS_SIZE];
+    char address_[ADDRESS_SIZE];
+    uint32_t frameId_;
+    osc::int32 frameTime_;
+    bool inFrame_;
+    unsigned msgs_;
+
+    unsigned long packets_;
+    unsigned long bytes_;
+    unsigned long touches_;
+};
+
+#endif //MEC_OSC_OUTPUT_H
@@ -0,0 +1,204 @@
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <osc/OscReceivedElements.h>
+#include <osc/OscPacketListener.h>
+#include <osc/OscOutboundPacketStream.h>
+#include <ip/UdpSocket.h>
+
+#include <mec_msg_queue.h>
+#include <mec_log.h>
+
+#include "osc_output.h"
+
+// loopback benchmark for T3D output, 16 touches per frame
+// previously, each touch was sent as its own bundle, with its address built in a std::string,
+// now a frame is a single bundle, /t3d/frm followed by the touches
+
+static const unsigned PORT = 9123;
+static const unsigned FRAME_TOUCHES = 16;
+static const unsigned FRAMES = 20000;
+
+class Counter : public osc::OscPacketListener {
+public:
+    Counter() : packets_(0), frames_(0), touches_(0), lastFrame_(-1), ordered_(true) { ; }
+
+    void reset() {
+        packets_ = frames_ = touches_ = 0;
+        lastFrame_ = -1;
+        ordered_ = true;
+    }
+
+    std::atomic<unsigned long> packets_;
+    std::atomic<unsigned long> frames_;
+    std::atomic<unsigned long> touches_;
+    long lastFrame_;
+    bool ordered_;
+
+protected:
+    void ProcessPacket(const char *data, int size, const IpEndpointName &remoteEndpoint) override {
+        packets_++;
+        osc::OscPacketListener::ProcessPacket(data, size, remoteEndpoint);
+    }
+
+    void ProcessMessage(const osc::ReceivedMessage &m, const IpEndpointName &) override {
+        const char *addr = m.AddressPattern();
+        if (strncmp(addr, "/t3d/tch", 8) == 0) {
+            touches_++;
+        } else if (strcmp(addr, "/t3d/frm") == 0) {
+            osc::ReceivedMessageArgumentStream args = m.ArgumentStream();
+            osc::int32 frameId, time;
+            args >> frameId >> time >> osc::EndMessage;
+            if (frameId < lastFrame_) ordered_ = false;
+            lastFrame_ = frameId;
+            frames_++;
+        }
+    }
+};
+
+void fillFrame(mec::MecMsg *msgs, unsigned f) {
+    for (unsigned t = 0; t < FRAME_TOUCHES; t++) {
+        mec::MecMsg &msg = msgs[t];
+        msg.type_ = f == 0 ? mec::MecMsg::TOUCH_ON : mec::MecMsg::TOUCH_CONTINUE;
+        msg.data_.touch_.touchId_ = t;
+        msg.data_.touch_.note_ = 60.0f + t;
+        msg.data_.touch_.x_ = (float) (f % 100) / 100.0f;
+        msg.data_.touch_.y_ = 0.5f;
+        msg.data_.touch_.z_ = 0.25f;
+    }
+}
+
+// as MecOSCCallback sent touches previously
+class PerTouchOutput {
+public:
+    PerTouchOutput(const std::string &host, unsigned port)
+            : socket_(IpEndpointName(host.c_str(), port)), packets_(0), bytes_(0) { ; }
+
+    void sendMsg(std::string topic, float note, float x, float y, float z) {
+        osc::OutboundPacketStream op(buffer_, 1024);
+        op << osc::BeginBundleImmediate
+           << osc::BeginMessage(topic.c_str())
+           << x << y << z << note
+           << osc::EndMessage
+           << osc::EndBundle;
+        socket_.Send(op.Data(), op.Size());
+        packets_++;
+        bytes_ += op.Size();
+    }
+
+    void sendFrame(const mec::MsgSpan &msgs) {
+        for (const mec::MecMsg &msg : msgs) {
+            std::string topic = "/t3d/tch" + std::to_string(msg.data_.touch_.touchId_);
+            sendMsg(topic, msg.data_.touch_.note_, msg.data_.touch_.x_, msg.data_.touch_.y_, msg.data_.touch_.z_);
+        }
+    }
+
+    UdpTransmitSocket socket_;
+    char buffer_[1024];
+    unsigned long packets_;
+    unsigned long bytes_;
+};
+
+void settle(Counter &counter, unsigned long expected) {
+    // wait for the receiver to catch up, or give up once it stops making progress (i.e. dropped)
+    unsigned long last = ~0UL;
+    while (counter.touches_ < expected && counter.touches_ != last) {
+        last = counter.touches_;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+void report(const char *name, double secs, unsigned long packets, unsigned long bytes, Counter &counter) {
+    unsigned long touches = (unsigned long) FRAMES * FRAME_TOUCHES;
+    LOG_0(name
+                  << " frames " << FRAMES
+                  << " packets " << packets
+                  << " time " << secs << "s"
+                  << " packets/s " << (unsigned long) (packets / secs)
+                  << " frames/s " << (unsigned long) (FRAMES / secs)
+                  << " bytes/touch " << (double) bytes / touches
+                  << " received touches " << counter.touches_ << "/" << touches);
+}
+
+void checks(Counter &counter) {
+    OscOutput output("127.0.0.1", PORT);
+    mec::MecMsg msgs[FRAME_TOUCHES + 1];
+    fillFrame(msgs, 0);
+    msgs[3].type_ = mec::MecMsg::TOUCH_OFF;
+    msgs[FRAME_TOUCHES].type_ = mec::MecMsg::MEC_CONTROL;    // ignored
+    msgs[FRAME_TOUCHES].data_.mec_control_.cmd_ = mec::MecMsg::PING;
+
+    output.sendFrame(mec::MsgSpan(msgs, FRAME_TOUCHES + 1));
+    assert(output.packets() == 1);
+    assert(output.touches() == FRAME_TOUCHES);
+
+    // touches outside frames are sent individually, large ids are formatted on the fly
+    output.touch(1000, 60.0f, 0.5f, 0.5f, 0.5f);
+    output.control(1, 0.5f);
+    assert(output.packets() == 3);
+
+    // a frame too large for one packet is split, each part with a frame header
+    output.resetStats();
+    output.beginFrame();
+    for (unsigned t = 0; t < 100; t++) output.touch(t, 60.0f, 0.5f, 0.5f, 0.5f);
+    output.endFrame();
+    assert(output.packets() > 1);
+    assert(output.bytes() <= output.packets() * OscOutput::MAX_PACKET_SIZE);
+
+    settle(counter, FRAME_TOUCHES + 1 + 100);
+    assert(counter.touches_ == FRAME_TOUCHES + 1 + 100);
+    assert(counter.frames_ == 3 + output.packets());
+    assert(counter.ordered_);
+    counter.reset();
+}
+
+int main(int argc, char **argv) {
+    LOG_0("test started");
+
+    Counter counter;
+    UdpListeningReceiveSocket receiver(IpEndpointName("127.0.0.1", PORT), &counter);
+    std::thread listener([&receiver]() { receiver.Run(); });
+
+    checks(counter);
+
+    mec::MecMsg msgs[FRAME_TOUCHES];
+    unsigned long touches = (unsigned long) FRAMES * FRAME_TOUCHES;
+
+    {
+        PerTouchOutput output("127.0.0.1", PORT);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned f = 0; f < FRAMES; f++) {
+            fillFrame(msgs, f);
+            output.sendFrame(mec::MsgSpan(msgs, FRAME_TOUCHES));
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        settle(counter, touches);
+        report("per touch bundles", secs, output.packets_, output.bytes_, counter);
+        counter.reset();
+    }
+
+    {
+        OscOutput output("127.0.0.1", PORT);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned f = 0; f < FRAMES; f++) {
+            fillFrame(msgs, f);
+            output.sendFrame(mec::MsgSpan(msgs, FRAME_TOUCHES));
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        settle(counter, touches);
+        report("frame bundles", secs, output.packets(), output.bytes(), counter);
+        assert(output.packets() == FRAMES);
+        assert(counter.ordered_);
+        counter.reset();
+    }
+
+    receiver.AsynchronousBreak();
+    listener.join();
+
+    LOG_0("test completed");
+    return 0;
+}
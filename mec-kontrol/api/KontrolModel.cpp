@@ -1,8 +1,13 @@
 #include "KontrolModel.h"
 #include <mec_prefs.h>
 
+#include <stdexcept>
+
 namespace Kontrol {
 
+static const std::vector<std::shared_ptr<Module>> noModules;
+static const std::vector<std::shared_ptr<Page>> noPages;
+static const std::vector<std::shared_ptr<Parameter>> noParams;
 
 std::shared_ptr<KontrolModel> KontrolModel::model() {
     static std::shared_ptr<KontrolModel> model_;
@@ -24,7 +29,7 @@ void KontrolModel::publishMetaData() const {
 }
 
 void KontrolModel::publishMetaData(const std::shared_ptr<Rack> &rack) const {
-    std::vector<std::shared_ptr<Module>> modules = getModules(rack);
+    const std::vector<std::shared_ptr<Module>> &modules = getModules(rack);
     publishRack(CS_LOCAL, *rack);
     for (auto resType:rack->getResourceTypes()) {
         for (auto res : rack->getResources(resType)) {
@@ -94,29 +99,25 @@ std::vector<std::shared_ptr<Rack>> KontrolModel::getRacks() const {
     return ret;
 }
 
-std::vector<std::shared_ptr<Module>> KontrolModel::getModules(const std::shared_ptr<Rack> &rack) const {
-    std::vector<std::shared_ptr<Module>> ret;
-    if (rack != nullptr) ret = rack->getModules();
-    return ret;
+const std::vector<std::shared_ptr<Module>> &KontrolModel::getModules(const std::shared_ptr<Rack> &rack) const {
+    if (rack != nullptr) return rack->getModules();
+    return noModules;
 }
 
-std::vector<std::shared_ptr<Page>> KontrolModel::getPages(const std::shared_ptr<Module> &module) const {
-    std::vector<std::shared_ptr<Page>> ret;
-    if (module != nullptr) ret = module->getPages();
-    return ret;
+const std::vector<std::shared_ptr<Page>> &KontrolModel::getPages(const std::shared_ptr<Module> &module) const {
+    if (module != nullptr) return module->getPages();
+    return noPages;
 }
 
-std::vector<std::shared_ptr<Parameter>> KontrolModel::getParams(const std::shared_ptr<Module> &module) const {
-    std::vector<std::shared_ptr<Parameter>> ret;
-    if (module != nullptr) ret = module->getParams();
-    return ret;
+const std::vector<std::shared_ptr<Parameter>> &KontrolModel::getParams(const std::shared_ptr<Module> &module) const {
+    if (module != nullptr) return module->getParams();
+    return noParams;
 }
 
-std::vector<std::shared_ptr<Parameter>> KontrolModel::getParams(const std::shared_ptr<Module> &module,
-                                                                const std::shared_ptr<Page> &page) const {
-    std::vector<std::shared_ptr<Parameter>> ret;
-    if (module != nullptr && page != nullptr) ret = module->getParams(page);
-    return ret;
+const std::vector<std::shared_ptr<Parameter>> &KontrolModel::getParams(const std::shared_ptr<Module> &module,
+                                                                       const std::shared_ptr<Page> &page) const {
+    if (module != nullptr && page != nullptr) return module->getParams(page);
+    return noParams;
 }
 
 
@@ -216,6 +217,7 @@ std::shared_ptr<Parameter> KontrolModel::createParam(
 
     auto param = module->createParam(args);
     if (param != nullptr) {
+        rack->modulesChanged();
         publishParam(src, *rack, *module, *param);
     }
     return param;
@@ -67,11 +67,12 @@ public:
     std::shared_ptr<Parameter> getParam(const std::shared_ptr<Module> &, const EntityId &paramId) const;
 
     std::vector<std::shared_ptr<Rack>> getRacks() const;
-    std::vector<std::shared_ptr<Module>> getModules(const std::shared_ptr<Rack> &) const;
-    std::vector<std::shared_ptr<Page>> getPages(const std::shared_ptr<Module> &) const;
-    std::vector<std::shared_ptr<Parameter>> getParams(const std::shared_ptr<Module> &) const;
-    std::vector<std::shared_ptr<Parameter>> getParams(const std::shared_ptr<Module> &,
-                                                      const std::shared_ptr<Page> &) const;
+    // references into the rack/module, valid until it is next changed
+    const std::vector<std::shared_ptr<Module>> &getModules(const std::shared_ptr<Rack> &) const;
+    const std::vector<std::shared_ptr<Page>> &getPages(const std::shared_ptr<Module> &) const;
+    const std::vector<std::shared_ptr<Parameter>> &getParams(const std::shared_ptr<Module> &) const;
+    const std::vector<std::shared_ptr<Parameter>> &getParams(const std::shared_ptr<Module> &,
+                                                             const std::shared_ptr<Page> &) const;
 
     std::shared_ptr<Rack> createRack(
             ChangeSource src,
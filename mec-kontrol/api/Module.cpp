@@ -25,26 +25,45 @@ std::string Module::getParamId(const EntityId& pageId, unsigned paramNum) {
 #endif
 
 
+static const std::vector<std::shared_ptr<Parameter>> noParams;
+static const std::vector<EntityId> noParamIds;
+
 // Module
 std::shared_ptr<Parameter> Module::createParam(const std::vector<ParamValue> &args) {
     auto p = Parameter::create(args);
     if (p->valid()) {
-        parameters_[p->id()] = p;
+        // redefining a parameter keeps its handle
+        auto i = paramIndex_.find(p->id());
+        if (i != paramIndex_.end()) {
+            params_[i->second] = p;
+        } else {
+            paramIndex_[p->id()] = static_cast<ParamHandle>(params_.size());
+            params_.push_back(p);
+        }
+        pageParamsValid_ = false;
         return p;
     }
     return nullptr;
 }
 
 bool Module::changeParam(const EntityId &paramId, const ParamValue &value, bool force) {
-    auto p = parameters_[paramId];
-    if (p != nullptr) {
-        if (p->change(value, force)) {
+    return changeParam(getParamHandle(paramId), value, force);
+}
+
+bool Module::changeParam(ParamHandle h, const ParamValue &value, bool force) {
+    if (h < params_.size() && params_[h] != nullptr) {
+        if (params_[h]->change(value, force)) {
             return true;
         }
     }
     return false;
 }
 
+ParamHandle Module::getParamHandle(const EntityId &paramId) const {
+    auto i = paramIndex_.find(paramId);
+    return i != paramIndex_.end() ? i->second : INVALID_PARAM;
+}
+
 inline std::shared_ptr<KontrolModel> Module::model() {
     return KontrolModel::model();
 }
@@ -55,51 +74,55 @@ std::shared_ptr<Page> Module::createPage(
         const std::vector<EntityId> paramIds
 ) {
     // std::cout << "Module::addPage " << id << std::endl;
-    auto page = pages_[pageId];
-    if (page == nullptr) {
+    auto p = std::make_shared<Page>(pageId, displayName, paramIds);
+    auto page = pages_.find(pageId);
+    if (page == pages_.end()) {
         pageIds_.push_back(pageId);
+        pageList_.push_back(p);
+    } else {
+        for (unsigned i = 0; i < pageIds_.size(); i++) {
+            if (pageIds_[i] == pageId) pageList_[i] = p;
+        }
     }
 
-    auto p = std::make_shared<Page>(pageId, displayName, paramIds);
     pages_[pageId] = p;
+    pageParamsValid_ = false;
     return p;
 }
 
 // access functions
 std::shared_ptr<Page> Module::getPage(const EntityId &pageId) {
-    return pages_[pageId];
+    auto i = pages_.find(pageId);
+    return i != pages_.end() ? i->second : nullptr;
 }
 
 std::shared_ptr<Parameter> Module::getParam(const EntityId &paramId) {
-    return parameters_[paramId];
+    return getParam(getParamHandle(paramId));
 }
 
-std::vector<std::shared_ptr<Page>> Module::getPages() {
-    std::vector<std::shared_ptr<Page>> ret;
-    for (auto p : pageIds_) {
-        auto page = pages_[p];
-        if (page != nullptr) ret.push_back(page);
-    }
-    return ret;
+const std::vector<std::shared_ptr<Page>> &Module::getPages() {
+    return pageList_;
 }
 
-std::vector<std::shared_ptr<Parameter>> Module::getParams() {
-    std::vector<std::shared_ptr<Parameter>> ret;
-    for (auto p : parameters_) {
-        if (p.second != nullptr) ret.push_back(p.second);
-    }
-    return ret;
+const std::vector<std::shared_ptr<Parameter>> &Module::getParams() {
+    return params_;
 }
 
-std::vector<std::shared_ptr<Parameter>> Module::getParams(const std::shared_ptr<Page> &page) {
-    std::vector<std::shared_ptr<Parameter>> ret;
-    if (page != nullptr) {
-        for (auto pid : page->paramIds()) {
-            auto param = parameters_[pid];
-            if (param != nullptr) ret.push_back(param);
+const std::vector<std::shared_ptr<Parameter>> &Module::getParams(const std::shared_ptr<Page> &page) {
+    if (page == nullptr) return noParams;
+    if (!pageParamsValid_) {
+        pageParams_.clear();
+        for (auto pg : pageList_) {
+            std::vector<std::shared_ptr<Parameter>> &params = pageParams_[pg->id()];
+            for (auto pid : pg->paramIds()) {
+                auto param = getParam(pid);
+                if (param != nullptr) params.push_back(param);
+            }
         }
+        pageParamsValid_ = true;
     }
-    return ret;
+    auto i = pageParams_.find(page->id());
+    return i != pageParams_.end() ? i->second : noParams;
 }
 
 
@@ -108,9 +131,13 @@ bool Module::loadModuleDefinitions(const mec::Preferences &module) {
 
     type_ = module.getString("name");
     displayName_ = module.getString("display");
-    parameters_.clear();
+    params_.clear();
+    paramIndex_.clear();
     pages_.clear();
     pageIds_.clear();
+    pageList_.clear();
+    pageParams_.clear();
+    pageParamsValid_ = false;
     midi_mapping_.clear();
 
     if (module.exists("parameters")) {
@@ -178,7 +205,7 @@ void Module::dumpParameters() {
     LOG_1("Parameter Dump : " << displayName_ << " : " << type_);
     LOG_1("----------------------");
     for (std::string pageId : pageIds_) {
-        auto page = pages_[pageId];
+        auto page = getPage(pageId);
         if (page == nullptr) {
             LOG_1("Page not found: " << pageId);
             continue;
@@ -186,7 +213,7 @@ void Module::dumpParameters() {
         LOG_1(page->id());
         LOG_1(page->displayName());
         for (std::string paramId : page->paramIds()) {
-            auto param = parameters_[paramId];
+            auto param = getParam(paramId);
             if (param == nullptr) {
                 LOG_1("Parameter not found:" << paramId);
                 continue;
@@ -217,7 +244,7 @@ void Module::dumpCurrentValues() {
     LOG_1("Current Values Dump");
     LOG_1("-------------------");
     for (std::string pageId : pageIds_) {
-        auto page = pages_[pageId];
+        auto page = getPage(pageId);
         if (page == nullptr) {
             LOG_1("Page not found: " << pageId);
             continue;
@@ -225,7 +252,7 @@ void Module::dumpCurrentValues() {
         LOG_1(page->id());
         LOG_1(page->displayName());
         for (auto paramId : page->paramIds()) {
-            auto param = parameters_[paramId];
+            auto param = getParam(paramId);
             if (param == nullptr) {
                 LOG_1("Parameter not found:" << paramId);
                 continue;
@@ -248,8 +275,9 @@ void Module::dumpCurrentValues() {
 }
 
 
-std::vector<EntityId> Module::getParamsForCC(unsigned cc) {
-    return midi_mapping_[cc];
+const std::vector<EntityId> &Module::getParamsForCC(unsigned cc) const {
+    auto i = midi_mapping_.find(cc);
+    return i != midi_mapping_.end() ? i->second : noParamIds;
 }
 
 void Module::addMidiCCMapping(unsigned ccnum, const EntityId &paramId) {
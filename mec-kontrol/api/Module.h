@@ -25,7 +25,7 @@ public:
     Module(const std::string &id,
            const std::string &displayName,
            const std::string &type)
-            : Entity(id, displayName), type_(type) {
+            : Entity(id, displayName), type_(type), pageParamsValid_(false) {
         ;
     }
 
@@ -43,9 +43,15 @@ public:
 
     std::shared_ptr<Page> getPage(const EntityId &pageId);
     std::shared_ptr<Parameter> getParam(const EntityId &paramId);
-    std::vector<std::shared_ptr<Page>> getPages();
-    std::vector<std::shared_ptr<Parameter>> getParams();
-    std::vector<std::shared_ptr<Parameter>> getParams(const std::shared_ptr<Page> &);
+    const std::vector<std::shared_ptr<Page>> &getPages();
+    const std::vector<std::shared_ptr<Parameter>> &getParams();
+    const std::vector<std::shared_ptr<Parameter>> &getParams(const std::shared_ptr<Page> &);
+
+    // parameters by handle, i.e. position in the parameter table (creation order)
+    ParamHandle getParamHandle(const EntityId &paramId) const;
+    std::shared_ptr<Parameter> getParam(ParamHandle h) const { return h < params_.size() ? params_[h] : nullptr; }
+    bool changeParam(ParamHandle h, const ParamValue &value, bool force);
+    unsigned getParamCount() const { return static_cast<unsigned>(params_.size()); }
 
     // unsigned    getPageCount() { return pageIds_.size();}
     // std::string getPageId(unsigned pageNum) { return pageNum < pageIds_.size() ? pageIds_[pageNum] : "";}
@@ -60,12 +66,12 @@ public:
     void dumpCurrentValues();
 
 
-    std::vector<EntityId> getParamsForCC(unsigned cc);
+    const std::vector<EntityId> &getParamsForCC(unsigned cc) const;
 
     void addMidiCCMapping(unsigned ccnum, const EntityId &paramId);
     void removeMidiCCMapping(unsigned ccnum, const EntityId &paramId);
 
-    MidiMap getMidiMapping() { return midi_mapping_; }
+    const MidiMap &getMidiMapping() const { return midi_mapping_; }
 
     void setMidiMapping(const MidiMap &map) { midi_mapping_ = map; }
 
@@ -73,10 +79,16 @@ private:
     std::string type_;
 
     std::vector<std::string> pageIds_; // ordered list of page id, for presentation
-    std::unordered_map<std::string, std::shared_ptr<Parameter> > parameters_; // key = paramId
+    std::vector<std::shared_ptr<Page>> pageList_; // as pageIds_
+    std::vector<std::shared_ptr<Parameter>> params_; // parameter table, index = handle
+    std::unordered_map<std::string, ParamHandle> paramIndex_; // key = paramId
     std::unordered_map<std::string, std::shared_ptr<Page> > pages_; // key = pageId
     MidiMap midi_mapping_; // key CC id, value = paramId
 
+    // parameters of each page, resolved when first asked for after a page or parameter is added
+    std::unordered_map<std::string, std::vector<std::shared_ptr<Parameter>>> pageParams_; // key = pageId
+    bool pageParamsValid_;
+
 };
 
 
@@ -3,19 +3,57 @@
 #include <osc/OscOutboundPacketStream.h>
 #include <mec_log.h>
 
+#include <cstring>
+
 namespace Kontrol {
 
 
 //const std::string OSCBroadcaster::ADDRESS = "127.0.0.1";
 
-#define POLL_TIMEOUT_MS 1000
+// the producer notifies without the lock, so a wake up can be missed, this bounds the delay
+#define WRITE_POLL_MS 10
+
+static const unsigned BUNDLE_HEADER_SIZE = 16; // "#bundle\0" + time tag
+
+// key for a parameter, fnv-1a over its ids
+static uint64_t paramKey(const Rack &rack, const Module &module, const Parameter &p) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const std::string *id : {&rack.id(), &module.id(), &p.id()}) {
+        for (unsigned char c : *id) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        h ^= 0xff; // separator, so ids "ab"+"c" != "a"+"bc"
+        h *= 1099511628211ULL;
+    }
+    return h != 0 ? h : 1;
+}
+
+static void writeInt32(char *p, uint32_t v) {
+    p[0] = (char) (v >> 24);
+    p[1] = (char) (v >> 16);
+    p[2] = (char) (v >> 8);
+    p[3] = (char) v;
+}
 
 OSCBroadcaster::OSCBroadcaster(Kontrol::ChangeSource src, unsigned keepAlive, bool master) :
         master_(master),
         port_(0),
         changeSource_(src),
-        keepAliveTime_(keepAlive) {
-    PaUtil_InitializeRingBuffer(&messageQueue_, sizeof(OscMsg), OscMsg::MAX_N_OSC_MSGS, msgData_);
+        keepAliveTime_(keepAlive),
+        running_(false),
+        wake_(false),
+        queued_(0),
+        read_(0),
+        maxPacketSize_(MAX_PACKET_SIZE) {
+    PaUtil_InitializeRingBuffer(&messageQueue_, sizeof(OscMsg), OscMsg::QUEUE_SIZE, msgData_);
+    resetSlots();
+    resetCounters();
+
+    // bundle header, time tag immediate
+    memcpy(packet_, "#bundle\0", 8);
+    writeInt32(packet_ + 8, 0);
+    writeInt32(packet_ + 12, 1);
 }
 
 OSCBroadcaster::~OSCBroadcaster() {
@@ -40,32 +78,158 @@ bool OSCBroadcaster::connect(const std::string &host, unsigned port) {
         socket_.reset();
         return false;
     }
+    resetSlots();
+    resetCounters();
     running_ = true;
     writer_thread_ = std::thread(osc_broadcaster_write_thread_func, this);
     return true;
 }
 
 void OSCBroadcaster::stop() {
-    running_ = false;
+    {
+        std::lock_guard<std::mutex> lock(write_lock_);
+        running_ = false;
+    }
+    write_cond_.notify_one();
     if (socket_) {
         writer_thread_.join();
         PaUtil_FlushRingBuffer(&messageQueue_);
+        resetSlots();
     }
     port_ = 0;
     socket_.reset();
 }
 
+void OSCBroadcaster::resetCounters() {
+    messagesSent_ = 0;
+    packetsSent_ = 0;
+    messagesCollapsed_ = 0;
+    messagesDropped_ = 0;
+}
+
+
+// only whilst the writer is not running
+void OSCBroadcaster::resetSlots() {
+    for (unsigned i = 0; i < KeySlot::N_SLOTS; i++) {
+        slots_[i].key_ = 0;
+        slots_[i].seq_ = 0;
+        slots_[i].after_ = 0;
+        slots_[i].size_ = 0;
+        slots_[i].sentSeq_ = 0;
+    }
+    queued_ = 0;
+    read_ = 0;
+}
+
+// producer only, so a free slot can be claimed without contention, nullptr if the table is full
+OSCBroadcaster::KeySlot *OSCBroadcaster::keySlot(uint64_t key) {
+    for (unsigned i = 0; i < KeySlot::N_SLOTS; i++) {
+        KeySlot &slot = slots_[(key + i) & (KeySlot::N_SLOTS - 1)];
+        uint64_t k = slot.key_.load(std::memory_order_relaxed);
+        if (k == key) return &slot;
+        if (k == 0) {
+            slot.key_.store(key, std::memory_order_release);
+            return &slot;
+        }
+    }
+    return nullptr;
+}
 
 void OSCBroadcaster::writePoll() {
     std::unique_lock<std::mutex> lock(write_lock_);
     while (running_) {
+        write_cond_.wait_for(lock, std::chrono::milliseconds(WRITE_POLL_MS), [this] {
+            return !running_ || wake_.load(std::memory_order_acquire);
+        });
+        wake_.store(false, std::memory_order_relaxed);
+
+        // senders never take the lock, so do not hold it while sending
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+    // anything queued whilst stopping
+    lock.unlock();
+    flush();
+}
+
+void OSCBroadcaster::pack(const char *data, unsigned size, unsigned &pos, unsigned &msgs) {
+    if (msgs > 0 && pos + 4 + size > maxPacketSize_) {
+        sendPacket(pos);
+        messagesSent_ += msgs;
+        pos = BUNDLE_HEADER_SIZE;
+        msgs = 0;
+    }
+    writeInt32(packet_ + pos, (uint32_t) size);
+    memcpy(packet_ + pos + 4, data, (size_t) size);
+    pos += 4 + size;
+    msgs++;
+}
+
+// send everything pending, as few packets as possible
+// queued messages in order, then the latest values, once what was queued before them has been sent
+void OSCBroadcaster::flush() {
+    bool more = true;
+    while (more) {
+        unsigned pos = BUNDLE_HEADER_SIZE;
+        unsigned msgs = 0;
         while (PaUtil_GetRingBufferReadAvailable(&messageQueue_)) {
-            OscMsg msg;
-            PaUtil_ReadRingBuffer(&messageQueue_, &msg, 1);
-            socket_->Send(msg.buffer_, msg.size_);
+            unsigned n = (unsigned) PaUtil_ReadRingBuffer(&messageQueue_, batch_, OscMsg::MAX_N_OSC_MSGS);
+            for (unsigned i = 0; i < n; i++) {
+                pack(batch_[i].buffer_, (unsigned) batch_[i].size_, pos, msgs);
+            }
+            read_ += n;
+        }
+        if (msgs > 0) {
+            sendPacket(pos);
+            messagesSent_ += msgs;
         }
-        write_cond_.wait_for(lock, std::chrono::milliseconds(POLL_TIMEOUT_MS));
+        more = flushSlots();
+    }
+}
+
+// returns true if a value is waiting on messages queued before it
+bool OSCBroadcaster::flushSlots() {
+    bool waiting = false;
+    unsigned pos = BUNDLE_HEADER_SIZE;
+    unsigned msgs = 0;
+    char buffer[OscMsg::MAX_OSC_MESSAGE_SIZE];
+    for (unsigned i = 0; i < KeySlot::N_SLOTS; i++) {
+        KeySlot &slot = slots_[i];
+        if (slot.key_.load(std::memory_order_acquire) == 0) continue;
+
+        unsigned seq, size;
+        unsigned long after;
+        do {
+            seq = slot.seq_.load(std::memory_order_acquire);
+            if (seq == slot.sentSeq_ || (seq & 1)) break; // sent, or being written (the producer wakes us after)
+            after = slot.after_;
+            size = (unsigned) slot.size_;
+            if (size > sizeof(buffer)) size = 0;
+            memcpy(buffer, slot.buffer_, size);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while (slot.seq_.load(std::memory_order_relaxed) != seq);
+        if (seq == slot.sentSeq_ || (seq & 1)) continue;
+
+        if (after > read_) {
+            // queued after messages still in the queue (e.g. its param), send those first
+            waiting = true;
+            continue;
+        }
+        pack(buffer, size, pos, msgs);
+        messagesCollapsed_ += (seq - slot.sentSeq_) / 2 - 1;
+        slot.sentSeq_ = seq;
+    }
+    if (msgs > 0) {
+        sendPacket(pos);
+        messagesSent_ += msgs;
     }
+    return waiting;
+}
+
+void OSCBroadcaster::sendPacket(unsigned size) {
+    socket_->Send(packet_, size);
+    packetsSent_++;
 }
 
 bool OSCBroadcaster::isActive() {
@@ -82,18 +246,38 @@ bool OSCBroadcaster::isActive() {
 }
 
 
-void OSCBroadcaster::send(const char *data, unsigned size) {
-    OscMsg msg;
-//    {
-//        static unsigned maxsize = 0;
-//        if(size>maxsize) {
-//            maxsize = size;
-//            LOG_0("OSCBroadcaster MAXSIZE " << maxsize);
-//        }
-//    }
-    msg.size_ = (size > OscMsg::MAX_OSC_MESSAGE_SIZE ? OscMsg::MAX_OSC_MESSAGE_SIZE : size);
-    memcpy(msg.buffer_, data, (size_t) msg.size_);
-    PaUtil_WriteRingBuffer(&messageQueue_, (void *) &msg, 1);
+void OSCBroadcaster::send(const char *data, unsigned size, uint64_t key) {
+    // a truncated message would be malformed, and spoil the bundle it is packed in
+    if (size > OscMsg::MAX_OSC_MESSAGE_SIZE) {
+        messagesDropped_++;
+        return;
+    }
+
+    KeySlot *slot = key != 0 ? keySlot(key) : nullptr;
+    if (slot != nullptr) {
+        // latest value, overwrites any the writer has not yet sent
+        unsigned seq = slot->seq_.load(std::memory_order_relaxed);
+        slot->seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot->after_ = queued_.load(std::memory_order_relaxed);
+        slot->size_ = (int) size;
+        memcpy(slot->buffer_, data, (size_t) size);
+        slot->seq_.store(seq + 2, std::memory_order_release);
+    } else {
+        OscMsg msg;
+        msg.size_ = size;
+        memcpy(msg.buffer_, data, (size_t) msg.size_);
+
+        // called from the audio thread, so never wait for space, a full queue drops the message
+        if (PaUtil_WriteRingBuffer(&messageQueue_, (void *) &msg, 1) == 0) {
+            messagesDropped_++;
+        } else {
+            queued_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // no lock, a missed wake up is caught by the writer's poll
+    wake_.store(true, std::memory_order_release);
     write_cond_.notify_one();
 }
 
@@ -102,12 +286,10 @@ void OSCBroadcaster::sendPing(unsigned port) {
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/ping")
+    ops << osc::BeginMessage("/Kontrol/ping")
         << (int32_t) port
         << (int32_t) keepAliveTime_
-        << osc::EndMessage
-        << osc::EndBundle;
+        << osc::EndMessage;
 
     send(ops.Data(), ops.Size());
 }
@@ -164,15 +346,13 @@ void OSCBroadcaster::assignMidiCC(ChangeSource src, const Rack &rack, const Modu
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/assignMidiCC")
+    ops << osc::BeginMessage("/Kontrol/assignMidiCC")
         << rack.id().c_str()
         << module.id().c_str()
         << p.id().c_str()
         << (int32_t) midiCC;
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 }
 
 void OSCBroadcaster::unassignMidiCC(ChangeSource src, const Rack &rack, const Module &module, const Parameter &p,
@@ -182,15 +362,13 @@ void OSCBroadcaster::unassignMidiCC(ChangeSource src, const Rack &rack, const Mo
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/assignMidiCC")
+    ops << osc::BeginMessage("/Kontrol/assignMidiCC")
         << rack.id().c_str()
         << module.id().c_str()
         << p.id().c_str()
         << (int32_t) midiCC;
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 }
 
 
@@ -200,13 +378,11 @@ void OSCBroadcaster::updatePreset(ChangeSource src, const Rack &rack, std::strin
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/updatePreset")
+    ops << osc::BeginMessage("/Kontrol/updatePreset")
         << rack.id().c_str()
         << preset.c_str();
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 
     send(ops.Data(), ops.Size());
 }
@@ -216,13 +392,11 @@ void OSCBroadcaster::applyPreset(ChangeSource src, const Rack &rack, std::string
     if (!isActive()) return;
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/applyPreset")
+    ops << osc::BeginMessage("/Kontrol/applyPreset")
         << rack.id().c_str()
         << preset.c_str();
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 
     send(ops.Data(), ops.Size());
 }
@@ -232,12 +406,10 @@ void OSCBroadcaster::saveSettings(ChangeSource src, const Rack &rack) {
     if (!isActive()) return;
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/saveSettings")
+    ops << osc::BeginMessage("/Kontrol/saveSettings")
         << rack.id().c_str();
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 
     send(ops.Data(), ops.Size());
 }
@@ -249,14 +421,12 @@ void OSCBroadcaster::loadModule(ChangeSource src, const Rack &rack, const Entity
     if (!isActive()) return;
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/loadModule")
+    ops << osc::BeginMessage("/Kontrol/loadModule")
         << rack.id().c_str()
         << moduleId.c_str()
         << modType.c_str();
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 
     send(ops.Data(), ops.Size());
 }
@@ -268,14 +438,12 @@ void OSCBroadcaster::rack(ChangeSource src, const Rack &p) {
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/rack")
+    ops << osc::BeginMessage("/Kontrol/rack")
         << p.id().c_str()
         << p.host().c_str()
         << (int32_t) p.port();
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 
     send(ops.Data(), ops.Size());
 }
@@ -289,15 +457,13 @@ void OSCBroadcaster::module(ChangeSource src, const Rack &rack, const Module &m)
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/module")
+    ops << osc::BeginMessage("/Kontrol/module")
         << rack.id().c_str()
         << m.id().c_str()
         << m.displayName().c_str()
         << m.type().c_str();
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 
     send(ops.Data(), ops.Size());
 }
@@ -309,8 +475,7 @@ void OSCBroadcaster::page(ChangeSource src, const Rack &rack, const Module &modu
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/page")
+    ops << osc::BeginMessage("/Kontrol/page")
         << rack.id().c_str()
         << module.id().c_str()
         << p.id().c_str()
@@ -320,8 +485,7 @@ void OSCBroadcaster::page(ChangeSource src, const Rack &rack, const Module &modu
         ops << paramId.c_str();
     }
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 
     send(ops.Data(), ops.Size());
 }
@@ -332,8 +496,7 @@ void OSCBroadcaster::param(ChangeSource src, const Rack &rack, const Module &mod
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/param")
+    ops << osc::BeginMessage("/Kontrol/param")
         << rack.id().c_str()
         << module.id().c_str();
 
@@ -351,8 +514,7 @@ void OSCBroadcaster::param(ChangeSource src, const Rack &rack, const Module &mod
         }
     }
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 
     send(ops.Data(), ops.Size());
 }
@@ -363,8 +525,7 @@ void OSCBroadcaster::changed(ChangeSource src, const Rack &rack, const Module &m
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/changed")
+    ops << osc::BeginMessage("/Kontrol/changed")
         << rack.id().c_str()
         << module.id().c_str()
         << p.id().c_str();
@@ -379,10 +540,9 @@ void OSCBroadcaster::changed(ChangeSource src, const Rack &rack, const Module &m
 
     }
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 
-    send(ops.Data(), ops.Size());
+    send(ops.Data(), ops.Size(), paramKey(rack, module, p));
 }
 
 void OSCBroadcaster::resource(ChangeSource src, const Rack &rack, const std::string &type, const std::string &res) {
@@ -391,15 +551,13 @@ void OSCBroadcaster::resource(ChangeSource src, const Rack &rack, const std::str
 
     osc::OutboundPacketStream ops(buffer_, OUTPUT_BUFFER_SIZE);
 
-    ops << osc::BeginBundleImmediate
-        << osc::BeginMessage("/Kontrol/resource")
+    ops << osc::BeginMessage("/Kontrol/resource")
         << rack.id().c_str()
         << type.c_str()
         << res.c_str();
 
 
-    ops << osc::EndMessage
-        << osc::EndBundle;
+    ops << osc::EndMessage;
 
     send(ops.Data(), ops.Size());
 }
@@ -6,7 +6,9 @@
 #include <memory>
 #include <ip/UdpSocket.h>
 #include <pa_ringbuffer.h>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -14,9 +16,15 @@
 namespace Kontrol {
 
 
+// messages are queued by the callbacks, and sent by the writer thread
+// the writer packs everything pending into bundles of up to maxPacketSize bytes
+// changes to a parameter are not queued, but written to a latest value slot for the parameter,
+// so only the latest value is sent, and it is never lost to a full queue
+// callbacks (the producer) are from one thread at a time, e.g. the audio thread, and never wait
 class OSCBroadcaster : public KontrolCallback {
 public:
     static const unsigned int OUTPUT_BUFFER_SIZE = 1024;
+    static const unsigned int MAX_PACKET_SIZE = 1472; // udp payload in an ethernet mtu
 
     OSCBroadcaster(Kontrol::ChangeSource src, unsigned keepAlive, bool master);
     ~OSCBroadcaster();
@@ -51,19 +59,52 @@ public:
 
     unsigned port() { return port_; }
 
+    // 0, sends each message in its own packet
+    void maxPacketSize(unsigned size) { maxPacketSize_ = size < MAX_PACKET_SIZE ? size : MAX_PACKET_SIZE; }
+    unsigned maxPacketSize() { return maxPacketSize_; }
+
+    // counters, since connect (or resetCounters)
+    unsigned long messagesSent() { return messagesSent_; }
+    unsigned long packetsSent() { return packetsSent_; }
+    unsigned long messagesCollapsed() { return messagesCollapsed_; } // superseded by a later value, before sending
+    unsigned long messagesDropped() { return messagesDropped_; }     // queue full, or message too large
+    // sent, collapsed and dropped account for every message, once the writer is idle (e.g. after stop)
+    void resetCounters();
+
 
 protected:
-    void send(const char *data, unsigned size);
+    // key identifies a parameter, for which only the latest pending message is sent, 0 = always sent
+    void send(const char *data, unsigned size, uint64_t key = 0);
     bool broadcastChange(ChangeSource src);
 
 private:
     struct OscMsg {
-        static const int MAX_N_OSC_MSGS = 128;
+        static const int MAX_N_OSC_MSGS = 128;      // per batch written
+        static const int QUEUE_SIZE = 1024;         // power of 2, holds the meta data burst of a ping
         static const int MAX_OSC_MESSAGE_SIZE = 256;
         int size_;
         char buffer_[MAX_OSC_MESSAGE_SIZE];
     };
 
+    // latest value of a parameter, a seqlock: seq_ is odd whilst the producer writes,
+    // and advances by 2 per value, so the writer can tell how many values it did not send
+    struct KeySlot {
+        static const unsigned N_SLOTS = 512;        // power of 2, parameters beyond this are queued as other messages
+        std::atomic<uint64_t> key_;                 // 0 = free, only set by the producer
+        std::atomic<unsigned> seq_;
+        unsigned long after_;                       // messages queued before this value, which must be sent first
+        int size_;
+        char buffer_[OscMsg::MAX_OSC_MESSAGE_SIZE];
+        unsigned sentSeq_;                          // writer thread only
+    };
+
+    KeySlot *keySlot(uint64_t key);
+    void resetSlots();
+    void flush();
+    bool flushSlots();
+    void pack(const char *data, unsigned size, unsigned &pos, unsigned &msgs);
+    void sendPacket(unsigned size);
+
     std::string host_;
     unsigned int port_;
     std::shared_ptr<UdpTransmitSocket> socket_;
@@ -72,14 +113,29 @@ private:
     unsigned keepAliveTime_;
 
     PaUtilRingBuffer messageQueue_;
-    char msgData_[sizeof(OscMsg) * OscMsg::MAX_N_OSC_MSGS];
+    char msgData_[sizeof(OscMsg) * OscMsg::QUEUE_SIZE];
     bool master_;
 
-    bool running_;
+    std::atomic<bool> running_;
+    std::atomic<bool> wake_;            // set by the producer, the writer also wakes every WRITE_POLL_MS
+    std::atomic<unsigned long> queued_; // messages written to messageQueue_
     std::mutex write_lock_;
     std::condition_variable write_cond_;
     std::thread writer_thread_;
     ChangeSource changeSource_;
+
+    KeySlot slots_[KeySlot::N_SLOTS];
+
+    // writer thread only
+    OscMsg batch_[OscMsg::MAX_N_OSC_MSGS];
+    unsigned long read_;                // messages read from messageQueue_
+    char packet_[MAX_PACKET_SIZE];
+
+    std::atomic<unsigned> maxPacketSize_;
+    std::atomic<unsigned long> messagesSent_;
+    std::atomic<unsigned long> packetsSent_;
+    std::atomic<unsigned long> messagesCollapsed_;
+    std::atomic<unsigned long> messagesDropped_;
 };
 
 } //namespace
@@ -5,166 +5,272 @@
 
 #include <mec_log.h>
 
+#include <algorithm>
+#include <cstring>
+
 
 namespace Kontrol {
 
 class KontrolPacketListener : public PacketListener {
 public:
-    KontrolPacketListener(PaUtilRingBuffer *queue) : queue_(queue) {
+    KontrolPacketListener(OSCReceiver &recv) : receiver_(recv) {
     }
 
     virtual void ProcessPacket(const char *data, int size,
                                const IpEndpointName &remoteEndpoint) {
-        OSCReceiver::OscMsg msg;
-        msg.origin_ = remoteEndpoint;
-
-//        {
-//            static unsigned maxsize = 0;
-//            if(size>maxsize) {
-//                maxsize = size;
-//                LOG_0("KontrolPacketListener MAXSIZE " << maxsize);
-//            }
-//        }
-
-        msg.size_ = (size > OSCReceiver::OscMsg::MAX_OSC_MESSAGE_SIZE ? OSCReceiver::OscMsg::MAX_OSC_MESSAGE_SIZE
-                                                                      : size);
-        memcpy(msg.buffer_, data, (size_t) msg.size_);
-        PaUtil_WriteRingBuffer(queue_, (void *) &msg, 1);
+        receiver_.queuePacket(data, size, remoteEndpoint);
+    }
+
+private:
+    OSCReceiver &receiver_;
+};
+
+
+// the kontrol address set, resolved with a perfect hash (no collisions in the table),
+// so dispatch is a hash and a single strcmp
+enum KontrolAddress {
+    KA_CHANGED,
+    KA_PARAM,
+    KA_PAGE,
+    KA_MODULE,
+    KA_RACK,
+    KA_PING,
+    KA_RESOURCE,
+    KA_ASSIGN_MIDI_CC,
+    KA_UNASSIGN_MIDI_CC,
+    KA_UPDATE_PRESET,
+    KA_APPLY_PRESET,
+    KA_SAVE_SETTINGS,
+    KA_LOAD_MODULE,
+    KA_NUM_ADDRESSES,
+    KA_UNKNOWN = KA_NUM_ADDRESSES
+};
+
+static const char *kontrolAddresses[KA_NUM_ADDRESSES] = {
+        "/Kontrol/changed",
+        "/Kontrol/param",
+        "/Kontrol/page",
+        "/Kontrol/module",
+        "/Kontrol/rack",
+        "/Kontrol/ping",
+        "/Kontrol/resource",
+        "/Kontrol/assignMidiCC",
+        "/Kontrol/unassignMidiCC",
+        "/Kontrol/updatePreset",
+        "/Kontrol/applyPreset",
+        "/Kontrol/saveSettings",
+        "/Kontrol/loadModule"
+};
+
+class AddressTable {
+public:
+    AddressTable() {
+        // smallest table without collisions
+        for (size_ = KA_NUM_ADDRESSES; size_ < MAX_TABLE_SIZE; size_++) {
+            std::fill(table_, table_ + size_, (unsigned char) KA_UNKNOWN);
+            bool collision = false;
+            for (unsigned a = 0; a < KA_NUM_ADDRESSES && !collision; a++) {
+                unsigned char &slot = table_[hash(kontrolAddresses[a]) % size_];
+                collision = slot != KA_UNKNOWN;
+                slot = (unsigned char) a;
+            }
+            if (!collision) return;
+        }
+        size_ = 0; // not found, lookup falls back to comparing each address
+    }
+
+    KontrolAddress lookup(const char *address) const {
+        if (size_ == 0) {
+            for (unsigned a = 0; a < KA_NUM_ADDRESSES; a++) {
+                if (std::strcmp(address, kontrolAddresses[a]) == 0) return (KontrolAddress) a;
+            }
+            return KA_UNKNOWN;
+        }
+        unsigned a = table_[hash(address) % size_];
+        if (a != KA_UNKNOWN && std::strcmp(address, kontrolAddresses[a]) == 0) return (KontrolAddress) a;
+        return KA_UNKNOWN;
     }
 
 private:
-    PaUtilRingBuffer *queue_;
+    static const unsigned MAX_TABLE_SIZE = 256;
+
+    // fnv-1a
+    static uint32_t hash(const char *s) {
+        uint32_t h = 2166136261U;
+        while (*s) {
+            h ^= (unsigned char) *s++;
+            h *= 16777619U;
+        }
+        return h;
+    }
+
+    unsigned size_;
+    unsigned char table_[MAX_TABLE_SIZE];
 };
 
+static const AddressTable &addressTable() {
+    static AddressTable table;
+    return table;
+}
+
 
 class KontrolOSCListener : public osc::OscPacketListener {
 public:
-    KontrolOSCListener(OSCReceiver &recv) : receiver_(recv) { ; }
+    KontrolOSCListener(OSCReceiver &recv) : receiver_(recv), changedSrc_(ChangeSource::REMOTE) { ; }
 
 
     virtual void ProcessMessage(const osc::ReceivedMessage &m,
                                 const IpEndpointName &remoteEndpoint) {
         try {
-            char host[IpEndpointName::ADDRESS_STRING_LENGTH];
-            remoteEndpoint.AddressAsString(host);
-            ChangeSource changedSrc = ChangeSource::createRemoteSource(host, remoteEndpoint.port);
+            const ChangeSource &changedSrc = changeSource(remoteEndpoint);
             // std::err << "received osc message: " << m.AddressPattern() << std::endl;
-            if (std::strcmp(m.AddressPattern(), "/Kontrol/changed") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                const char *paramId = (arg++)->AsString();
-                if (arg != m.ArgumentsEnd()) {
-                    if (arg->IsString()) {
-                        receiver_.changeParam(changedSrc, rackId, moduleId, paramId,
-                                              ParamValue(std::string(arg->AsString())));
-
-                    } else if (arg->IsFloat()) {
+            switch (addressTable().lookup(m.AddressPattern())) {
+                case KA_CHANGED: {
+                    // most frequent, ids are reused strings, to avoid allocating for each message
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    rackId_.assign((arg++)->AsString());
+                    moduleId_.assign((arg++)->AsString());
+                    paramId_.assign((arg++)->AsString());
+                    if (arg != m.ArgumentsEnd()) {
+                        if (arg->IsString()) {
+                            receiver_.changeParam(changedSrc, rackId_, moduleId_, paramId_,
+                                                  ParamValue(std::string(arg->AsString())));
+
+                        } else if (arg->IsFloat()) {
 //                        std::cerr << "changed " << paramId << " : " << arg->AsFloat() << std::endl;
-                        receiver_.changeParam(changedSrc, rackId, moduleId, paramId, ParamValue(arg->AsFloat()));
+                            receiver_.changeParam(changedSrc, rackId_, moduleId_, paramId_, ParamValue(arg->AsFloat()));
+                        }
                     }
+                    break;
                 }
-
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/param") == 0) {
-                std::vector<ParamValue> params;
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                while (arg != m.ArgumentsEnd()) {
-                    if (arg->IsString()) {
-                        params.push_back(ParamValue(std::string(arg->AsString())));
-
-                    } else if (arg->IsFloat()) {
-                        params.push_back(ParamValue(arg->AsFloat()));
+                case KA_PARAM: {
+                    std::vector<ParamValue> params;
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const char *rackId = (arg++)->AsString();
+                    const char *moduleId = (arg++)->AsString();
+                    while (arg != m.ArgumentsEnd()) {
+                        if (arg->IsString()) {
+                            params.push_back(ParamValue(std::string(arg->AsString())));
+
+                        } else if (arg->IsFloat()) {
+                            params.push_back(ParamValue(arg->AsFloat()));
+                        }
+                        arg++;
                     }
-                    arg++;
-                }
-
-                receiver_.createParam(changedSrc, rackId, moduleId, params);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/page") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                // std::cerr << "received page p1"<< std::endl;
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                const char *pageId = (arg++)->AsString();
-
-                const char *displayName = (arg++)->AsString();
 
-                std::vector<EntityId> paramIds;
-                while (arg != m.ArgumentsEnd()) {
-                    paramIds.push_back((arg++)->AsString());
+                    receiver_.createParam(changedSrc, rackId, moduleId, params);
+                    break;
                 }
+                case KA_PAGE: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    // std::cerr << "received page p1"<< std::endl;
+                    const char *rackId = (arg++)->AsString();
+                    const char *moduleId = (arg++)->AsString();
+                    const char *pageId = (arg++)->AsString();
+
+                    const char *displayName = (arg++)->AsString();
+
+                    std::vector<EntityId> paramIds;
+                    while (arg != m.ArgumentsEnd()) {
+                        paramIds.push_back((arg++)->AsString());
+                    }
 
-                // std::cout << "received page " << id << std::endl;
-                receiver_.createPage(changedSrc, rackId, moduleId, pageId, displayName, paramIds);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/module") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                const char *displayName = (arg++)->AsString();
-                const char *type = (arg++)->AsString();
+                    // std::cout << "received page " << id << std::endl;
+                    receiver_.createPage(changedSrc, rackId, moduleId, pageId, displayName, paramIds);
+                    break;
+                }
+                case KA_MODULE: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const char *rackId = (arg++)->AsString();
+                    const char *moduleId = (arg++)->AsString();
+                    const char *displayName = (arg++)->AsString();
+                    const char *type = (arg++)->AsString();
 
 //                 std::cout << "received module " << moduleId << std::endl;
-                receiver_.createModule(changedSrc, rackId, moduleId, displayName, type);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/rack") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *host = (arg++)->AsString();
-                unsigned port = (unsigned) (arg++)->AsInt32();
-
-                // std::cout << "received rack " << rackId << std::endl;
-                receiver_.createRack(changedSrc, rackId, host, port);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/ping") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                unsigned port = (unsigned) (arg++)->AsInt32();
-                unsigned keepAlive = 0;
-                if (arg != m.ArgumentsEnd()) {
-                    keepAlive = (unsigned) (arg++)->AsInt32();
+                    receiver_.createModule(changedSrc, rackId, moduleId, displayName, type);
+                    break;
+                }
+                case KA_RACK: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const char *rackId = (arg++)->AsString();
+                    const char *host = (arg++)->AsString();
+                    unsigned port = (unsigned) (arg++)->AsInt32();
+
+                    // std::cout << "received rack " << rackId << std::endl;
+                    receiver_.createRack(changedSrc, rackId, host, port);
+                    break;
+                }
+                case KA_PING: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    unsigned port = (unsigned) (arg++)->AsInt32();
+                    unsigned keepAlive = 0;
+                    if (arg != m.ArgumentsEnd()) {
+                        keepAlive = (unsigned) (arg++)->AsInt32();
+                    }
+                    char host[IpEndpointName::ADDRESS_STRING_LENGTH];
+                    remoteEndpoint.AddressAsString(host);
+                    receiver_.ping(changedSrc, std::string(host), port, keepAlive);
+                    break;
                 }
-                receiver_.ping(changedSrc, std::string(host), port, keepAlive);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/resource") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                case KA_RESOURCE: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
 //                 std::cout << "received resource p1"<< std::endl;
-                const char *rackId = (arg++)->AsString();
-                const char *resType = (arg++)->AsString();
-                const char *resValue = (arg++)->AsString();
+                    const char *rackId = (arg++)->AsString();
+                    const char *resType = (arg++)->AsString();
+                    const char *resValue = (arg++)->AsString();
 
 //                 std::cout << "received resource " << rackId <<  " : " << resType << " : " << resValue << std::endl;
-                receiver_.createResource(changedSrc, rackId, resType, resValue);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/assignMidiCC") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                const char *paramId = (arg++)->AsString();
-                unsigned midiCC = (unsigned) (arg++)->AsInt32();
-                receiver_.assignMidiCC(changedSrc, rackId, moduleId, paramId, midiCC);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/unassignMidiCC") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *moduleId = (arg++)->AsString();
-                const char *paramId = (arg++)->AsString();
-                unsigned midiCC = (unsigned) (arg++)->AsInt32();
-                receiver_.unassignMidiCC(changedSrc, rackId, moduleId, paramId, midiCC);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/updatePreset") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *preset = (arg++)->AsString();
-                receiver_.updatePreset(changedSrc, rackId, preset);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/applyPreset") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *preset = (arg++)->AsString();
-                receiver_.applyPreset(changedSrc, rackId, preset);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/saveSettings") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                receiver_.saveSettings(changedSrc, rackId);
-            } else if (std::strcmp(m.AddressPattern(), "/Kontrol/loadModule") == 0) {
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                const char *rackId = (arg++)->AsString();
-                const char *modId = (arg++)->AsString();
-                const char *modType = (arg++)->AsString();
-                receiver_.loadModule(changedSrc, rackId, modId, modType);
+                    receiver_.createResource(changedSrc, rackId, resType, resValue);
+                    break;
+                }
+                case KA_ASSIGN_MIDI_CC: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const char *rackId = (arg++)->AsString();
+                    const char *moduleId = (arg++)->AsString();
+                    const char *paramId = (arg++)->AsString();
+                    unsigned midiCC = (unsigned) (arg++)->AsInt32();
+                    receiver_.assignMidiCC(changedSrc, rackId, moduleId, paramId, midiCC);
+                    break;
+                }
+                case KA_UNASSIGN_MIDI_CC: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const char *rackId = (arg++)->AsString();
+                    const char *moduleId = (arg++)->AsString();
+                    const char *paramId = (arg++)->AsString();
+                    unsigned midiCC = (unsigned) (arg++)->AsInt32();
+                    receiver_.unassignMidiCC(changedSrc, rackId, moduleId, paramId, midiCC);
+                    break;
+                }
+                case KA_UPDATE_PRESET: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const char *rackId = (arg++)->AsString();
+                    const char *preset = (arg++)->AsString();
+                    receiver_.updatePreset(changedSrc, rackId, preset);
+                    break;
+                }
+                case KA_APPLY_PRESET: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const char *rackId = (arg++)->AsString();
+                    const char *preset = (arg++)->AsString();
+                    receiver_.applyPreset(changedSrc, rackId, preset);
+                    break;
+                }
+                case KA_SAVE_SETTINGS: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const char *rackId = (arg++)->AsString();
+                    receiver_.saveSettings(changedSrc, rackId);
+                    break;
+                }
+                case KA_LOAD_MODULE: {
+                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                    const char *rackId = (arg++)->AsString();
+                    const char *modId = (arg++)->AsString();
+                    const char *modType = (arg++)->AsString();
+                    receiver_.loadModule(changedSrc, rackId, modId, modType);
+                    break;
+                }
+                default:
+                    break;
             }
         } catch (osc::Exception &e) {
             // std::err << "error while parsing message: "
@@ -173,13 +279,31 @@ public:
     }
 
 private:
+    // the source is rebuilt only when the sender changes
+    const ChangeSource &changeSource(const IpEndpointName &remoteEndpoint) {
+        if (!(remoteEndpoint == lastEndpoint_) || !hasSrc_) {
+            char host[IpEndpointName::ADDRESS_STRING_LENGTH];
+            remoteEndpoint.AddressAsString(host);
+            changedSrc_ = ChangeSource::createRemoteSource(host, remoteEndpoint.port);
+            lastEndpoint_ = remoteEndpoint;
+            hasSrc_ = true;
+        }
+        return changedSrc_;
+    }
+
     OSCReceiver &receiver_;
+    IpEndpointName lastEndpoint_;
+    bool hasSrc_ = false;
+    ChangeSource changedSrc_;
+    EntityId rackId_;
+    EntityId moduleId_;
+    EntityId paramId_;
 };
 
 OSCReceiver::OSCReceiver(const std::shared_ptr<KontrolModel> &param)
-        : model_(param), port_(0) {
-    PaUtil_InitializeRingBuffer(&messageQueue_, sizeof(OscMsg), OscMsg::MAX_N_OSC_MSGS, msgData_);
-    packetListener_ = std::make_shared<KontrolPacketListener>(&messageQueue_);
+        : model_(param), port_(0), packetsDropped_(0) {
+    PaUtil_InitializeRingBuffer(&messageQueue_, 1, QUEUE_SIZE, msgData_);
+    packetListener_ = std::make_shared<KontrolPacketListener>(*this);
     oscListener_ = std::make_shared<KontrolOSCListener>(*this);
 }
 
@@ -218,11 +342,58 @@ void OSCReceiver::stop() {
     socket_.reset();
 }
 
+bool OSCReceiver::queuePacket(const char *data, int size, const IpEndpointName &origin) {
+    if (size <= 0) return false;
+    long slot = (long) ((sizeof(SlotHeader) + (unsigned) size + SLOT_ALIGN - 1) & ~(SLOT_ALIGN - 1));
+    if (slot > (long) QUEUE_SIZE / 2) {
+        packetsDropped_++;
+        return false;
+    }
+
+    // if the slot would wrap, pad to the end of the queue, and start the slot at the beginning
+    void *p1, *p2;
+    long s1, s2;
+    long avail = PaUtil_GetRingBufferWriteRegions(&messageQueue_, slot, &p1, &s1, &p2, &s2);
+    long pad = 0;
+    char *dest = static_cast<char *>(p1);
+    if (avail == slot && s2 > 0) {
+        pad = s1;
+        avail = PaUtil_GetRingBufferWriteRegions(&messageQueue_, pad + slot, &p1, &s1, &p2, &s2);
+        dest = static_cast<char *>(p2);
+    }
+    if (avail < pad + slot) {
+        packetsDropped_++;
+        return false;
+    }
+
+    if (pad > 0) {
+        SlotHeader *padding = static_cast<SlotHeader *>(p1);
+        padding->size_ = 0;
+        padding->slot_ = (uint32_t) pad;
+    }
+    SlotHeader *header = reinterpret_cast<SlotHeader *>(dest);
+    header->size_ = (uint32_t) size;
+    header->slot_ = (uint32_t) slot;
+    header->address_ = (uint32_t) origin.address;
+    header->port_ = (uint32_t) origin.port;
+    memcpy(dest + sizeof(SlotHeader), data, (size_t) size);
+    PaUtil_AdvanceRingBufferWriteIndex(&messageQueue_, pad + slot);
+    return true;
+}
+
 void OSCReceiver::poll() {
     while (PaUtil_GetRingBufferReadAvailable(&messageQueue_)) {
-        OscMsg msg;
-        PaUtil_ReadRingBuffer(&messageQueue_, &msg, 1);
-        oscListener_->ProcessPacket(msg.buffer_, msg.size_, msg.origin_);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        void *p1, *p2;
+        long s1, s2;
+        PaUtil_GetRingBufferReadRegions(&messageQueue_, sizeof(SlotHeader), &p1, &s1, &p2, &s2);
+        const SlotHeader *header = static_cast<const SlotHeader *>(p1);
+        unsigned slot = header->slot_;
+        if (header->size_ > 0) {
+            IpEndpointName origin((unsigned long) header->address_, (int) header->port_);
+            oscListener_->ProcessPacket(static_cast<const char *>(p1) + sizeof(SlotHeader), (int) header->size_, origin);
+        }
+        PaUtil_AdvanceRingBufferReadIndex(&messageQueue_, slot);
     }
 }
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "KontrolModel.h"
+#include <atomic>
+#include <cstdint>
 #include <thread>
 #include <memory>
 
@@ -22,6 +24,11 @@ public:
     bool listen(unsigned port = 9000);
     void poll();
 
+    // queue a packet for poll(), as received by the socket thread (also used to inject packets, e.g. in tests)
+    // returns false if the queue is full
+    bool queuePacket(const char *data, int size, const IpEndpointName &origin);
+    unsigned long packetsDropped() { return packetsDropped_; }
+
     void stop();
 
     void createRack(
@@ -99,12 +106,16 @@ public:
 private:
     friend class KontrolPacketListener;
 
-    struct OscMsg {
-        static const int MAX_N_OSC_MSGS = 128;
-        static const int MAX_OSC_MESSAGE_SIZE = 256;
-        IpEndpointName origin_;
-        int size_;
-        char buffer_[MAX_OSC_MESSAGE_SIZE];
+    // packets are queued in variable length slots, a header then the packet, padded to SLOT_ALIGN
+    // a slot never wraps the end of the queue, so poll() parses packets in place
+    // a header with no packet pads to the end of the queue
+    static const unsigned QUEUE_SIZE = 1 << 17; // bytes, power of 2
+    static const unsigned SLOT_ALIGN = 16;
+    struct SlotHeader {
+        uint32_t size_; // packet size, 0 = padding
+        uint32_t slot_; // slot size, including header
+        uint32_t address_;
+        uint32_t port_;
     };
 
     std::shared_ptr<KontrolModel> model_;
@@ -114,7 +125,8 @@ private:
     std::shared_ptr<PacketListener> packetListener_;
     std::shared_ptr<KontrolOSCListener> oscListener_;
     PaUtilRingBuffer messageQueue_;
-    char msgData_[sizeof(OscMsg) * OscMsg::MAX_N_OSC_MSGS];
+    alignas(SLOT_ALIGN) char msgData_[QUEUE_SIZE];
+    std::atomic<unsigned long> packetsDropped_;
 };
 
 } //namespace
\ No newline at end of file
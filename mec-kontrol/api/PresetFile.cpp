@@ -0,0 +1,264 @@
+#include "PresetFile.h"
+#include "Rack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <mec_log.h>
+
+namespace Kontrol {
+
+PresetFile::PresetFile() : data_(nullptr), size_(0), mapped_(false) {
+}
+
+PresetFile::~PresetFile() {
+    close();
+}
+
+bool PresetFile::isPresetFile(const std::string &filename) {
+    std::ifstream in(filename, std::ios::binary);
+    uint32_t magic = 0;
+    if (!in.read(reinterpret_cast<char *>(&magic), sizeof(magic))) return false;
+    return magic == MAGIC;
+}
+
+bool PresetFile::open(const std::string &filename) {
+    close();
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(Header)) {
+        void *p = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            data_ = static_cast<const char *>(p);
+            size_ = (size_t) st.st_size;
+            mapped_ = true;
+        }
+    }
+    ::close(fd);
+#else
+    std::ifstream in(filename, std::ios::binary);
+    if (in) {
+        buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (buffer_.size() >= sizeof(Header)) {
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+        }
+    }
+#endif
+    if (data_ == nullptr) return false;
+    if (!validate()) {
+        LOG_0("PresetFile::open invalid preset file " << filename);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void PresetFile::close() {
+#ifndef _WIN32
+    if (mapped_ && data_ != nullptr) munmap(const_cast<char *>(data_), size_);
+#endif
+    buffer_.clear();
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+}
+
+// everything referred to must lie within the file, so records can then be read unchecked
+bool PresetFile::validate() const {
+    const Header *h = header();
+    if (h->magic_ != MAGIC || h->version_ != VERSION || h->fileSize_ != size_) return false;
+    if (h->stringsOffset_ > size_ || h->stringsSize_ == 0 || h->stringsOffset_ + h->stringsSize_ != size_) return false;
+    if (data_[size_ - 1] != 0) return false;
+
+    auto inRange = [h](uint32_t offset, uint32_t count, size_t recSize) {
+        return offset % 4 == 0 && offset >= sizeof(Header) && offset <= h->stringsOffset_
+               && (uint64_t) count * recSize <= (uint64_t) (h->stringsOffset_ - offset);
+    };
+    auto validStr = [h](uint32_t s) { return s == NO_STRING || s < h->stringsSize_; };
+
+    if (!inRange(h->presetsOffset_, h->presetCount_, sizeof(PresetRecord))) return false;
+    for (unsigned i = 0; i < h->presetCount_; i++) {
+        const PresetRecord &p = preset(i);
+        if (!validStr(p.id_) || !inRange(p.modulesOffset_, p.moduleCount_, sizeof(ModuleRecord))) return false;
+        const ModuleRecord *m = modules(p);
+        for (unsigned j = 0; j < p.moduleCount_; j++) {
+            if (!validStr(m[j].id_) || !validStr(m[j].type_)) return false;
+            if (!inRange(m[j].valuesOffset_, m[j].valueCount_, sizeof(ValueRecord))) return false;
+            if (!inRange(m[j].midiOffset_, m[j].midiCount_, sizeof(MidiRecord))) return false;
+            const ValueRecord *v = values(m[j]);
+            for (unsigned k = 0; k < m[j].valueCount_; k++) {
+                if (!validStr(v[k].paramId_) || !validStr(v[k].strValue_)) return false;
+            }
+            const MidiRecord *mm = midi(m[j]);
+            for (unsigned k = 0; k < m[j].midiCount_; k++) {
+                if (!validStr(mm[k].paramId_)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+int PresetFile::findPreset(const std::string &presetId) const {
+    for (unsigned i = 0; i < presetCount(); i++) {
+        if (presetId == str(preset(i).id_)) return i;
+    }
+    return -1;
+}
+
+ParamValue PresetFile::value(const ValueRecord &v) const {
+    if (v.type_ == ParamValue::T_String) return ParamValue(str(v.strValue_));
+    return ParamValue(v.floatValue_);
+}
+
+void PresetFile::read(Presets &presets) const {
+    presets.clear();
+    for (unsigned i = 0; i < presetCount(); i++) {
+        const PresetRecord &p = preset(i);
+        auto &rackPreset = presets[str(p.id_)];
+        const ModuleRecord *m = modules(p);
+        for (unsigned j = 0; j < p.moduleCount_; j++) {
+            std::vector<ModulePresetValue> presetValues;
+            const ValueRecord *v = values(m[j]);
+            for (unsigned k = 0; k < m[j].valueCount_; k++) {
+                presetValues.push_back(ModulePresetValue(str(v[k].paramId_), value(v[k])));
+            }
+            MidiMap midimap;
+            const MidiRecord *mm = midi(m[j]);
+            for (unsigned k = 0; k < m[j].midiCount_; k++) {
+                midimap[mm[k].cc_].push_back(str(mm[k].paramId_));
+            }
+            rackPreset[str(m[j].id_)] = ModulePreset(str(m[j].type_), presetValues, midimap);
+        }
+    }
+}
+
+
+namespace {
+
+class StringTable {
+public:
+    uint32_t add(const std::string &s) {
+        auto i = index_.find(s);
+        if (i != index_.end()) return i->second;
+        uint32_t offset = (uint32_t) data_.size();
+        data_.insert(data_.end(), s.begin(), s.end());
+        data_.push_back(0);
+        index_[s] = offset;
+        return offset;
+    }
+
+    std::vector<char> data_;
+
+private:
+    std::unordered_map<std::string, uint32_t> index_;
+};
+
+template<typename T>
+void put(std::vector<char> &out, uint32_t offset, const T &rec) {
+    memcpy(out.data() + offset, &rec, sizeof(T));
+}
+
+}
+
+bool PresetFile::write(const std::string &filename, const Presets &presets) {
+    // sorted, so the same presets always give the same file
+    std::vector<std::string> presetIds;
+    for (const auto &p : presets) presetIds.push_back(p.first);
+    std::sort(presetIds.begin(), presetIds.end());
+
+    uint32_t nModules = 0, nValues = 0, nMidi = 0;
+    for (const auto &p : presets) {
+        for (const auto &m : p.second) {
+            nModules++;
+            nValues += (uint32_t) m.second.values().size();
+            for (const auto &mm : m.second.midiMap()) nMidi += (uint32_t) mm.second.size();
+        }
+    }
+
+    uint32_t presetsOffset = sizeof(Header);
+    uint32_t modulesOffset = presetsOffset + (uint32_t) (presetIds.size() * sizeof(PresetRecord));
+    uint32_t valuesOffset = modulesOffset + nModules * (uint32_t) sizeof(ModuleRecord);
+    uint32_t midiOffset = valuesOffset + nValues * (uint32_t) sizeof(ValueRecord);
+    uint32_t stringsOffset = midiOffset + nMidi * (uint32_t) sizeof(MidiRecord);
+
+    std::vector<char> out(stringsOffset, 0);
+    StringTable strings;
+    strings.add(""); // never empty, and the empty string is at 0
+
+    uint32_t presetPos = presetsOffset, modulePos = modulesOffset, valuePos = valuesOffset, midiPos = midiOffset;
+    for (const auto &presetId : presetIds) {
+        const auto &rackPreset = presets.at(presetId);
+        std::vector<EntityId> moduleIds;
+        for (const auto &m : rackPreset) moduleIds.push_back(m.first);
+        std::sort(moduleIds.begin(), moduleIds.end());
+
+        PresetRecord pr = {strings.add(presetId), (uint32_t) moduleIds.size(), modulePos};
+        put(out, presetPos, pr);
+        presetPos += sizeof(PresetRecord);
+
+        for (const auto &moduleId : moduleIds) {
+            const ModulePreset &modulePreset = rackPreset.at(moduleId);
+            ModuleRecord mr = {strings.add(moduleId), strings.add(modulePreset.moduleType()),
+                               0, valuePos, 0, midiPos};
+            for (auto v : modulePreset.values()) {
+                ParamValue pv = v.value();
+                ValueRecord vr = {strings.add(v.paramId()), (uint32_t) pv.type(), pv.floatValue(),
+                                  pv.type() == ParamValue::T_String ? strings.add(pv.stringValue()) : NO_STRING};
+                put(out, valuePos, vr);
+                valuePos += sizeof(ValueRecord);
+                mr.valueCount_++;
+            }
+            std::vector<unsigned> ccs;
+            for (const auto &mm : modulePreset.midiMap()) ccs.push_back(mm.first);
+            std::sort(ccs.begin(), ccs.end());
+            for (auto cc : ccs) {
+                for (const auto &paramId : modulePreset.midiMap().at(cc)) {
+                    MidiRecord mmr = {cc, strings.add(paramId)};
+                    put(out, midiPos, mmr);
+                    midiPos += sizeof(MidiRecord);
+                    mr.midiCount_++;
+                }
+            }
+            put(out, modulePos, mr);
+            modulePos += sizeof(ModuleRecord);
+        }
+    }
+
+    out.insert(out.end(), strings.data_.begin(), strings.data_.end());
+    Header h = {MAGIC, VERSION, (uint32_t) out.size(), (uint32_t) presetIds.size(), presetsOffset,
+                stringsOffset, (uint32_t) strings.data_.size()};
+    put(out, 0, h);
+
+    // written aside then renamed, so a mapped copy of the previous file is unaffected
+    std::string tmpfile = filename + ".tmp";
+    {
+        std::ofstream outfile(tmpfile, std::ios::binary | std::ios::trunc);
+        if (!outfile.write(out.data(), out.size())) {
+            LOG_0("PresetFile::write failed to write " << tmpfile);
+            return false;
+        }
+    }
+#ifdef _WIN32
+    std::remove(filename.c_str());
+#endif
+    if (std::rename(tmpfile.c_str(), filename.c_str()) != 0) {
+        LOG_0("PresetFile::write failed to rename " << tmpfile);
+        return false;
+    }
+    return true;
+}
+
+} //namespace
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Entity.h"
+#include "ParamValue.h"
+
+namespace Kontrol {
+
+class ModulePreset;
+
+// binary preset file, read in place (mmapped where available), so presets are available without parsing
+// layout, all fields 32 bit host order, offsets from the start of the file:
+//   Header, PresetRecord[presetCount], ModuleRecord[], ValueRecord[], MidiRecord[], string table
+// strings are stored once, null terminated, and referred to by offset into the string table
+// version is bumped on any incompatible change, older versions are rejected (re-import from json)
+class PresetFile {
+public:
+    static const uint32_t MAGIC = 0x4b505245; // KPRE
+    static const uint32_t VERSION = 1;
+    static const uint32_t NO_STRING = 0xffffffff;
+
+    struct Header {
+        uint32_t magic_;
+        uint32_t version_;
+        uint32_t fileSize_;
+        uint32_t presetCount_;
+        uint32_t presetsOffset_;
+        uint32_t stringsOffset_;
+        uint32_t stringsSize_;
+    };
+
+    struct PresetRecord {
+        uint32_t id_;
+        uint32_t moduleCount_;
+        uint32_t modulesOffset_;
+    };
+
+    struct ModuleRecord {
+        uint32_t id_;
+        uint32_t type_;
+        uint32_t valueCount_;
+        uint32_t valuesOffset_;
+        uint32_t midiCount_;
+        uint32_t midiOffset_;
+    };
+
+    struct ValueRecord {
+        uint32_t paramId_;
+        uint32_t type_;     // ParamValue::Type
+        float floatValue_;
+        uint32_t strValue_;
+    };
+
+    struct MidiRecord {
+        uint32_t cc_;
+        uint32_t paramId_;
+    };
+
+    // key = presetId, value = (key = moduleId)
+    typedef std::unordered_map<std::string, std::unordered_map<EntityId, ModulePreset>> Presets;
+
+    PresetFile();
+    ~PresetFile();
+
+    static bool isPresetFile(const std::string &filename);
+    static bool write(const std::string &filename, const Presets &presets);
+
+    bool open(const std::string &filename);
+    void close();
+    bool isOpen() const { return data_ != nullptr; }
+
+    unsigned presetCount() const { return header()->presetCount_; }
+    const PresetRecord &preset(unsigned i) const { return at<PresetRecord>(header()->presetsOffset_)[i]; }
+    int findPreset(const std::string &presetId) const; // -1 if not found
+
+    const ModuleRecord *modules(const PresetRecord &p) const { return at<ModuleRecord>(p.modulesOffset_); }
+    const ValueRecord *values(const ModuleRecord &m) const { return at<ValueRecord>(m.valuesOffset_); }
+    const MidiRecord *midi(const ModuleRecord &m) const { return at<MidiRecord>(m.midiOffset_); }
+    const char *str(uint32_t s) const { return s == NO_STRING ? "" : data_ + header()->stringsOffset_ + s; }
+    ParamValue value(const ValueRecord &v) const;
+
+    // the whole file, as loaded from json
+    void read(Presets &presets) const;
+
+private:
+    const Header *header() const { return reinterpret_cast<const Header *>(data_); }
+
+    template<typename T>
+    const T *at(uint32_t offset) const { return reinterpret_cast<const T *>(data_ + offset); }
+
+    bool validate() const;
+
+    const char *data_;
+    size_t size_;
+    bool mapped_;
+    std::vector<char> buffer_; // if not mapped
+};
+
+} //namespace
@@ -26,19 +26,21 @@ inline std::shared_ptr<KontrolModel> Rack::model() {
 void Rack::addModule(const std::shared_ptr<Module> &module) {
     if (module != nullptr) {
         modules_[module->id()] = module;
+        moduleList_.clear();
+        for (auto p : modules_) {
+            if (p.second != nullptr) moduleList_.push_back(p.second);
+        }
+        modulesChanged();
     }
 }
 
-std::vector<std::shared_ptr<Module>> Rack::getModules() {
-    std::vector<std::shared_ptr<Module>> ret;
-    for (auto p : modules_) {
-        if (p.second != nullptr) ret.push_back(p.second);
-    }
-    return ret;
+const std::vector<std::shared_ptr<Module>> &Rack::getModules() {
+    return moduleList_;
 }
 
 std::shared_ptr<Module> Rack::getModule(const EntityId &moduleId) {
-    return modules_[moduleId];
+    auto i = modules_.find(moduleId);
+    return i != modules_.end() ? i->second : nullptr;
 }
 
 
@@ -46,7 +48,9 @@ bool Rack::loadModuleDefinitions(const EntityId &moduleId, const mec::Preference
     bool ret = false;
     auto module = getModule(moduleId);
     if (module != nullptr) {
-        if (module->loadModuleDefinitions(prefs)) {
+        bool loaded = module->loadModuleDefinitions(prefs);
+        modulesChanged();
+        if (loaded) {
             publishMetaData(module);
             ret = true;
         }
@@ -56,24 +60,53 @@ bool Rack::loadModuleDefinitions(const EntityId &moduleId, const mec::Preference
 
 
 bool Rack::loadSettings(const std::string &filename) {
-    settings_ = std::make_shared<mec::Preferences>(filename);
     settingsFile_ = filename;
+    if (PresetFile::isPresetFile(filename)) {
+        return loadBinarySettings(filename);
+    }
+    settingsBinary_ = false;
+    settings_ = std::make_shared<mec::Preferences>(filename);
     return loadSettings(*settings_);
 }
 
+bool Rack::loadBinarySettings(const std::string &filename) {
+    auto file = std::make_shared<PresetFile>();
+    if (!file->open(filename)) return false;
+    // also kept as for json, to update and save presets
+    file->read(presets_);
+    presetFile_ = file;
+    resolved_.clear();
+    settings_.reset();
+    settingsBinary_ = true;
+    return true;
+}
+
 
 bool Rack::saveSettings() {
     // save to original module settings file
     // note: we do not save back to an preferences file, as this would not be complete
     if (!settingsFile_.empty()) {
-        saveSettings(settingsFile_);
+        return settingsBinary_ ? saveBinarySettings(settingsFile_) : saveSettings(settingsFile_);
     }
     return false;
 }
 
+bool Rack::saveBinarySettings(const std::string &filename) {
+    if (!PresetFile::write(filename, presets_)) return false;
+    if (settingsBinary_ && filename == settingsFile_) {
+        // presets match the file again
+        auto file = std::make_shared<PresetFile>();
+        resolved_.clear();
+        presetFile_ = file->open(filename) ? file : nullptr;
+    }
+    return true;
+}
+
 bool Rack::loadSettings(const mec::Preferences &prefs) {
     bool ret = false;
     presets_.clear();
+    presetFile_.reset();
+    resolved_.clear();
     mec::Preferences presetspref(prefs.getSubTree("presets"));
     if (presetspref.valid()) {
         for (std::string presetId :presetspref.getKeys()) {
@@ -152,6 +185,10 @@ bool Rack::updatePreset(std::string presetId) {
     presets_[presetId] = rackPreset;
     currentPreset_ = presetId;
 
+    // presets no longer match the file, until saved
+    presetFile_.reset();
+    resolved_.clear();
+
     dumpSettings();
 
     return ret;
@@ -159,6 +196,14 @@ bool Rack::updatePreset(std::string presetId) {
 
 bool Rack::applyPreset(std::string presetId) {
     bool ret = false;
+    if (presetFile_ != nullptr) {
+        int idx = presetFile_->findPreset(presetId);
+        if (idx < 0) return false;
+        ret = applyBinaryPreset(presetFile_->preset(idx));
+        currentPreset_ = presetId;
+        return ret;
+    }
+
     if (presets_.count(presetId) == 0) return false;
     RackPreset rackPreset = presets_[presetId];
 
@@ -181,22 +226,85 @@ bool Rack::applyPreset(std::string presetId) {
     return ret;
 }
 
+void Rack::buildMidiMap() {
+    midiTargets_.clear();
+    for (unsigned cc = 0; cc < MAX_MIDI_CC; cc++) {
+        midiIndex_[cc] = static_cast<unsigned>(midiTargets_.size());
+        for (auto module : moduleList_) {
+            for (auto paramId : module->getParamsForCC(cc)) {
+                ParamHandle h = module->getParamHandle(paramId);
+                if (h != INVALID_PARAM) midiTargets_.push_back(MidiTarget{module, h});
+            }
+        }
+    }
+    midiIndex_[MAX_MIDI_CC] = static_cast<unsigned>(midiTargets_.size());
+    midiDirty_ = false;
+}
+
+bool Rack::applyBinaryPreset(const PresetFile::PresetRecord &preset) {
+    bool ret = false;
+    const PresetFile &file = *presetFile_;
+    const PresetFile::ModuleRecord *records = file.modules(preset);
+    for (unsigned i = 0; i < preset.moduleCount_; i++) {
+        const PresetFile::ModuleRecord &record = records[i];
+        EntityId moduleId = file.str(record.id_);
+        auto module = getModule(moduleId);
+        if (module == nullptr) continue;
+        if (module->type() != file.str(record.type_)) {
+            model()->loadModule(CS_PRESET, id(), moduleId, file.str(record.type_));
+            module = getModule(moduleId);
+            if (module == nullptr) continue;
+        }
+
+        ResolvedPreset &resolved = resolved_[&record];
+        const PresetFile::ValueRecord *values = file.values(record);
+        if (resolved.handles_.size() != record.valueCount_ || resolved.generation_ != generation_) {
+            resolved.handles_.clear();
+            for (unsigned j = 0; j < record.valueCount_; j++) {
+                resolved.handles_.push_back(module->getParamHandle(file.str(values[j].paramId_)));
+            }
+            resolved.midiMap_.clear();
+            const PresetFile::MidiRecord *midi = file.midi(record);
+            for (unsigned j = 0; j < record.midiCount_; j++) {
+                resolved.midiMap_[midi[j].cc_].push_back(file.str(midi[j].paramId_));
+            }
+            resolved.generation_ = generation_;
+        }
+
+        // restore parameter values
+        for (unsigned j = 0; j < record.valueCount_; j++) {
+            ParamHandle h = resolved.handles_[j];
+            if (h == INVALID_PARAM || values[j].type_ != ParamValue::T_Float) continue;
+            //TODO: preset, support non numeric types
+            if (module->changeParam(h, ParamValue(values[j].floatValue_), true)) {
+                model()->publishChanged(CS_PRESET, *this, *module, *module->getParams()[h]);
+            }
+            ret = true;
+        }
+
+        if (module->getMidiMapping() != resolved.midiMap_) {
+            module->setMidiMapping(resolved.midiMap_);
+            midiMappingChanged();
+        }
+    }
+    return ret;
+}
+
 bool Rack::changeMidiCC(unsigned midiCC, unsigned midiValue) {
+    if (midiCC >= MAX_MIDI_CC) return false;
+    if (midiDirty_) buildMidiMap();
+
     bool ret = false;
-    for (auto m : modules_) {
-        auto module = m.second;
-        if (module != nullptr) {
-            std::vector<EntityId> mmvec = module->getParamsForCC(midiCC);
-            for (auto paramId : mmvec) {
-                auto param = module->getParam(paramId);
-                if (param != nullptr) {
-                    ParamValue pv = param->calcMidi(midiValue);
-                    if (pv != param->current()) {
-                        model()->changeParam(CS_MIDI, id(), module->id(), param->id(), pv);
-                        ret = true;
-                    }
-                }
+    for (unsigned i = midiIndex_[midiCC]; i < midiIndex_[midiCC + 1]; i++) {
+        const MidiTarget &target = midiTargets_[i];
+        const std::shared_ptr<Parameter> &param = target.module_->getParams()[target.param_];
+        ParamValue pv = param->calcMidi(midiValue);
+        if (pv != param->current()) {
+            // as KontrolModel::changeParam, without looking up rack, module and parameter by id
+            if (target.module_->changeParam(target.param_, pv, false)) {
+                model()->publishChanged(CS_MIDI, *this, *target.module_, *param);
             }
+            ret = true;
         }
     }
     return ret;
@@ -205,18 +313,18 @@ bool Rack::changeMidiCC(unsigned midiCC, unsigned midiValue) {
 void Rack::addMidiCCMapping(unsigned ccnum, const EntityId &moduleId, const EntityId &paramId) {
     auto module = getModule(moduleId);
     if (module != nullptr) module->addMidiCCMapping(ccnum, paramId);
+    midiMappingChanged();
 }
 
 void Rack::removeMidiCCMapping(unsigned ccnum, const EntityId &moduleId, const EntityId &paramId) {
     auto module = getModule(moduleId);
     if (module != nullptr) module->removeMidiCCMapping(ccnum, paramId);
+    midiMappingChanged();
 }
 
 void Rack::publishCurrentValues(const std::shared_ptr<Module> &module) const {
     if (module != nullptr) {
-        std::vector<std::shared_ptr<Parameter>> params = module->getParams();
-        std::vector<std::shared_ptr<Page>> pages = module->getPages();
-        for (auto p : params) {
+        for (auto p : module->getParams()) {
             model()->publishChanged(CS_LOCAL, *this, *module, *p);
         }
     }
@@ -233,12 +341,10 @@ void Rack::publishCurrentValues() const {
 void Rack::publishMetaData(const std::shared_ptr<Module> &module) const {
     if (module != nullptr) {
         model()->publishModule(CS_LOCAL, *this, *module);
-        std::vector<std::shared_ptr<Parameter>> params = module->getParams();
-        std::vector<std::shared_ptr<Page>> pages = module->getPages();
-        for (auto p : params) {
+        for (auto p : module->getParams()) {
             model()->publishParam(CS_LOCAL, *this, *module, *p);
         }
-        for (auto p : pages) {
+        for (auto p : module->getPages()) {
             if (p != nullptr) {
                 model()->publishPage(CS_LOCAL, *this, *module, *p);
             }
@@ -389,13 +495,14 @@ bool Rack::applyModulePreset(std::shared_ptr<Module> module, const ModulePreset
     // restore parameter values
     for (auto p : modulePreset.values()) {
         if (p.value().type() == ParamValue::T_Float) {
-            model()->changeParam(CS_PRESET, model()->localRack()->id(), module->id(), p.paramId(), p.value());
+            model()->changeParam(CS_PRESET, id(), module->id(), p.paramId(), p.value());
             ret |= true;
         } //iffloat
         //TODO: preset, support non numeric types
     }
 
     module->setMidiMapping(modulePreset.midiMap());
+    midiMappingChanged();
 
     return ret;
 }
@@ -3,6 +3,7 @@
 #include "Entity.h"
 #include "ParamValue.h"
 #include "Parameter.h"
+#include "PresetFile.h"
 
 #include <map>
 #include <unordered_map>
@@ -19,6 +20,10 @@ class Module;
 
 typedef std::unordered_map<unsigned, std::vector<EntityId>> MidiMap;
 
+// index into a module's parameter table, stable until its definitions are reloaded
+typedef unsigned ParamHandle;
+static const ParamHandle INVALID_PARAM = static_cast<ParamHandle>(-1);
+
 class ModulePresetValue {
 public:
     ModulePresetValue(const EntityId &paramId, const ParamValue &v) :
@@ -81,7 +86,8 @@ public:
     Rack(const std::string &host,
          unsigned port,
          const std::string &displayName)
-            : Entity(createId(host, port), displayName), host_(host), port_(port) {
+            : Entity(createId(host, port), displayName), host_(host), port_(port),
+              midiDirty_(true), settingsBinary_(false), generation_(0) {
         ;
     }
 
@@ -89,18 +95,20 @@ public:
         return (host + ":" + std::to_string(port));
     }
 
-    std::vector<std::shared_ptr<Module>> getModules();
+    const std::vector<std::shared_ptr<Module>> &getModules();
     std::shared_ptr<Module> getModule(const EntityId &moduleId);
     void addModule(const std::shared_ptr<Module> &module);
 
 
     bool loadModuleDefinitions(const EntityId &moduleId, const mec::Preferences &prefs);
 
+    // json, or a binary preset file (see PresetFile), which is then saved back as binary
     bool loadSettings(const std::string &filename);
     bool loadSettings(const mec::Preferences &prefs);
 
     bool saveSettings();
-    bool saveSettings(const std::string &filename);
+    bool saveSettings(const std::string &filename); // json
+    bool saveBinarySettings(const std::string &filename);
 
     bool applyPreset(std::string presetId);
     bool updatePreset(std::string presetId);
@@ -112,6 +120,14 @@ public:
     bool changeMidiCC(unsigned midiCC, unsigned midiValue);
     void addMidiCCMapping(unsigned ccnum, const EntityId &moduleId, const EntityId &paramId);
     void removeMidiCCMapping(unsigned ccnum, const EntityId &moduleId, const EntityId &paramId);
+    // cc routing and preset parameter handles are precomputed,
+    // call if a module's parameters (modulesChanged) or mappings are changed directly
+    void modulesChanged() {
+        generation_++;
+        midiDirty_ = true;
+    }
+
+    void midiMappingChanged() { midiDirty_ = true; }
 
     static std::shared_ptr<KontrolModel> model();
 
@@ -136,18 +152,44 @@ public:
 
 private:
     typedef std::unordered_map<EntityId, ModulePreset> RackPreset;
+    bool loadBinarySettings(const std::string &filename);
+    bool applyBinaryPreset(const PresetFile::PresetRecord &preset);
     bool loadModulePreset(RackPreset &rackPreset, const EntityId &moduleId, const mec::Preferences &prefs);
     bool saveModulePreset(ModulePreset &, cJSON *root);
     bool updateModulePreset(std::shared_ptr<Module> module, ModulePreset &modulePreset);
     bool applyModulePreset(std::shared_ptr<Module> module, const ModulePreset &modulePreset);
+    void buildMidiMap();
 
     std::string host_;
     unsigned port_;
     std::map<EntityId, std::shared_ptr<Module>> modules_;
+    std::vector<std::shared_ptr<Module>> moduleList_; // as modules_, without gaps
+
+    // cc -> parameters, targets for cc n are midiTargets_[midiIndex_[n]] to midiTargets_[midiIndex_[n+1]]
+    static const unsigned MAX_MIDI_CC = 128;
+    struct MidiTarget {
+        std::shared_ptr<Module> module_;
+        ParamHandle param_;
+    };
+    std::vector<MidiTarget> midiTargets_;
+    unsigned midiIndex_[MAX_MIDI_CC + 1];
+    bool midiDirty_;
     std::unordered_map<std::string, std::set<std::string>> resources_;
 
     std::string settingsFile_;
     std::shared_ptr<mec::Preferences> settings_;
+    bool settingsBinary_;
+
+    // presets as loaded from a binary file, whilst unchanged, applied from the file
+    // parameter handles are resolved on first apply, and again once modules change
+    std::shared_ptr<PresetFile> presetFile_;
+    struct ResolvedPreset {
+        unsigned long generation_;
+        std::vector<ParamHandle> handles_;
+        MidiMap midiMap_;
+    };
+    std::unordered_map<const PresetFile::ModuleRecord *, ResolvedPreset> resolved_;
+    unsigned long generation_;
 
     std::string currentPreset_;
     // presets = key = presetid, value = map<moduleId, preset>
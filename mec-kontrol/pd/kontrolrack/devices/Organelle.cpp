@@ -225,7 +225,7 @@ void OParamMode::display() {
     auto module = parent_.model()->getModule(rack, parent_.currentModule());
     auto page = parent_.model()->getPage(module, pageId_);
 //    auto pages = parent_.model()->getPages(module);
-    auto params = parent_.model()->getParams(module, page);
+    const auto &params = parent_.model()->getParams(module, page);
 
 
     unsigned int j = 0;
@@ -264,7 +264,7 @@ void OParamMode::changePot(unsigned pot, float rawvalue) {
         auto module = parent_.model()->getModule(rack, parent_.currentModule());
         auto page = parent_.model()->getPage(module, pageId_);
 //        auto pages = parent_.model()->getPages(module);
-        auto params = parent_.model()->getParams(module, page);
+        const auto &params = parent_.model()->getParams(module, page);
 
         if (!(pot < params.size())) return;
 
@@ -337,7 +337,7 @@ void OParamMode::setCurrentPage(unsigned pageIdx, bool UI) {
         auto rack = parent_.model()->getRack(parent_.currentRack());
         auto module = parent_.model()->getModule(rack, parent_.currentModule());
         auto page = parent_.model()->getPage(module, pageId_);
-        auto pages = parent_.model()->getPages(module);
+        const auto &pages = parent_.model()->getPages(module);
 //        auto params = parent_.model()->getParams(module,page);
 
         if (pageIdx_ != pageIdx) {
@@ -382,7 +382,7 @@ void OParamMode::changeEncoder(unsigned enc, float value) {
         auto rack = parent_.model()->getRack(parent_.currentRack());
         auto module = parent_.model()->getModule(rack, parent_.currentModule());
 //        auto page = parent_.model()->getPage(module,pageId_);
-        auto pages = parent_.model()->getPages(module);
+        const auto &pages = parent_.model()->getPages(module);
 //        auto params = parent_.model()->getParams(module,page);
 
         // clockwise
@@ -426,7 +426,7 @@ void OParamMode::activateShortcut(unsigned key) {
     if (key > 0) {
         unsigned moduleIdx = key - 1;
         auto rack = parent_.model()->getRack(parent_.currentRack());
-        auto modules = parent_.model()->getModules(rack);
+        const auto &modules = parent_.model()->getModules(rack);
         if (moduleIdx < modules.size()) {
             auto module = modules[moduleIdx];
             auto moduleId = module->id();
@@ -459,7 +459,7 @@ void OParamMode::changed(Kontrol::ChangeSource src, const Kontrol::Rack &rack, c
     auto pmodule = parent_.model()->getModule(prack, parent_.currentModule());
     auto page = parent_.model()->getPage(pmodule, pageId_);
 //    auto pages = parent_.model()->getPages(pmodule);
-    auto params = parent_.model()->getParams(pmodule, page);
+    const auto &params = parent_.model()->getParams(pmodule, page);
 
 
     unsigned sz = params.size();
@@ -816,7 +816,7 @@ void OModuleSelectMenu::clicked(unsigned idx) {
     if (idx < getSize()) {
         unsigned moduleIdx = idx;
         auto rack = parent_.model()->getRack(parent_.currentRack());
-        auto modules = parent_.model()->getModules(rack);
+        const auto &modules = parent_.model()->getModules(rack);
         if (moduleIdx < modules.size()) {
             auto module = modules[moduleIdx];
             auto moduleId = module->id();
@@ -1,9 +1,24 @@
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <new>
+#include <thread>
 
 #include <mec_prefs.h>
 #include <mec_log.h>
 #include <KontrolModel.h>
+#include <OSCBroadcaster.h>
+#include <OSCReceiver.h>
+
+#include <ip/UdpSocket.h>
+#include <osc/OscOutboundPacketStream.h>
+#include <osc/OscPacketListener.h>
+#include <osc/OscReceivedElements.h>
 
 class LoggerCallback : public Kontrol::KontrolCallback {
 public:
@@ -39,6 +54,532 @@ public:
     }
 };
 
+// cc benchmark, a rack of 20 modules, each with 25 parameters
+// every module maps 4 ccs of its own, and cc 1 (mod wheel) is mapped in every module
+static const unsigned BENCH_MODULES = 20;
+static const unsigned BENCH_PARAMS = 25;
+static const unsigned BENCH_CCS = 10000;
+
+static unsigned long allocations = 0;
+
+void *operator new(std::size_t size) {
+    allocations++;
+    void *p = malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+class CountingCallback : public Kontrol::KontrolCallback {
+public:
+    CountingCallback() : changed_(0) { ; }
+
+    void rack(Kontrol::ChangeSource, const Kontrol::Rack &) override { ; }
+
+    void module(Kontrol::ChangeSource, const Kontrol::Rack &, const Kontrol::Module &) override { ; }
+
+    void page(Kontrol::ChangeSource, const Kontrol::Rack &, const Kontrol::Module &, const Kontrol::Page &) override { ; }
+
+    void param(Kontrol::ChangeSource, const Kontrol::Rack &, const Kontrol::Module &, const Kontrol::Parameter &) override { ; }
+
+    void changed(Kontrol::ChangeSource, const Kontrol::Rack &, const Kontrol::Module &,
+                 const Kontrol::Parameter &) override { changed_++; }
+
+    void resource(Kontrol::ChangeSource, const Kontrol::Rack &, const std::string &, const std::string &) override { ; }
+
+    unsigned long changed_;
+};
+
+std::shared_ptr<Kontrol::Rack> createBenchRack(std::shared_ptr<Kontrol::KontrolModel> model) {
+    std::string host = "bench";
+    unsigned port = 9100;
+    Kontrol::EntityId rackId = Kontrol::Rack::createId(host, port);
+    auto rack = model->createRack(Kontrol::CS_LOCAL, rackId, host, port);
+    for (unsigned m = 0; m < BENCH_MODULES; m++) {
+        Kontrol::EntityId moduleId = "module" + std::to_string(m);
+        model->createModule(Kontrol::CS_LOCAL, rackId, moduleId, "Module " + std::to_string(m), "bench");
+        for (unsigned p = 0; p < BENCH_PARAMS; p++) {
+            std::vector<Kontrol::ParamValue> args;
+            std::string paramId = "p" + std::to_string(p);
+            args.push_back(Kontrol::ParamValue("pct"));
+            args.push_back(Kontrol::ParamValue(paramId));
+            args.push_back(Kontrol::ParamValue(paramId));
+            args.push_back(Kontrol::ParamValue(0.0f));
+            args.push_back(Kontrol::ParamValue(100.0f));
+            args.push_back(Kontrol::ParamValue(50.0f));
+            model->createParam(Kontrol::CS_LOCAL, rackId, moduleId, args);
+        }
+        for (unsigned c = 0; c < 4; c++) {
+            rack->addMidiCCMapping(10 + m * 4 + c, moduleId, "p" + std::to_string(c));
+        }
+        rack->addMidiCCMapping(1, moduleId, "p10");
+    }
+    return rack;
+}
+
+// as Rack::changeMidiCC was, copying the mapping for each module, then changing by id
+bool changeMidiCCById(std::shared_ptr<Kontrol::KontrolModel> model, Kontrol::Rack &rack,
+                      unsigned midiCC, unsigned midiValue) {
+    bool ret = false;
+    for (auto module : rack.getModules()) {
+        std::vector<Kontrol::EntityId> mmvec = module->getParamsForCC(midiCC);
+        for (auto paramId : mmvec) {
+            auto param = module->getParam(paramId);
+            if (param != nullptr) {
+                Kontrol::ParamValue pv = param->calcMidi(midiValue);
+                if (pv != param->current()) {
+                    model->changeParam(Kontrol::CS_MIDI, rack.id(), module->id(), param->id(), pv);
+                    ret = true;
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+void ccChecks(std::shared_ptr<Kontrol::KontrolModel> model, Kontrol::Rack &rack) {
+    // mod wheel reaches every module
+    assert(rack.changeMidiCC(1, 127));
+    for (auto module : rack.getModules()) {
+        assert(module->getParam("p10")->current().floatValue() == 100.0f);
+        assert(module->getParamHandle("p10") == 10);
+    }
+    assert(!rack.changeMidiCC(1, 127)); // unchanged
+    assert(!rack.changeMidiCC(200, 1)); // not a cc
+
+    // mappings changes are picked up
+    assert(!rack.changeMidiCC(120, 0));
+    rack.addMidiCCMapping(120, "module3", "p20");
+    assert(rack.changeMidiCC(120, 0));
+    assert(rack.getModule("module3")->getParam("p20")->current().floatValue() == 0.0f);
+    rack.removeMidiCCMapping(120, "module3", "p20");
+    assert(!rack.changeMidiCC(120, 127));
+
+    // handles are stable when a parameter is redefined
+    std::vector<Kontrol::ParamValue> args = {Kontrol::ParamValue("pct"), Kontrol::ParamValue("p2"),
+                                             Kontrol::ParamValue("p2"), Kontrol::ParamValue(0.0f),
+                                             Kontrol::ParamValue(100.0f), Kontrol::ParamValue(50.0f)};
+    model->createParam(Kontrol::CS_LOCAL, rack.id(), "module0", args);
+    assert(rack.getModule("module0")->getParamHandle("p2") == 2);
+    assert(rack.getModule("module0")->getParamCount() == BENCH_PARAMS);
+    assert(rack.changeMidiCC(12, 127));
+    assert(rack.getModule("module0")->getParam("p2")->current().floatValue() == 100.0f);
+
+    // model getters return the module's own tables
+    auto module = rack.getModule("module0");
+    assert(&model->getParams(module) == &module->getParams());
+    assert(model->getParams(nullptr).empty());
+}
+
+template<typename F>
+void ccBenchmark(const char *name, std::shared_ptr<Kontrol::KontrolModel> model, CountingCallback &counter, F change) {
+    counter.changed_ = 0;
+    unsigned long a = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < BENCH_CCS; i++) {
+        // sweep knobs, cc 1 and the modules' own ccs
+        unsigned cc = (i % 9) == 0 ? 1 : 10 + (i % (BENCH_MODULES * 4));
+        change(cc, i % 128);
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    LOG_0(name
+                  << " ccs " << BENCH_CCS
+                  << " changes " << counter.changed_
+                  << " time " << secs * 1000.0 << "ms"
+                  << " " << (secs * 1000000000.0 / BENCH_CCS) << "ns/cc"
+                  << " allocations " << (allocations - a));
+}
+
+// preset switching, on the same 500 parameter rack, two presets setting every parameter
+static const unsigned BENCH_SWITCHES = 200;
+
+void writeBenchPresets(const std::string &filename) {
+    std::ofstream out(filename);
+    out << "{ \"presets\" : {";
+    const char *presets[] = {"a", "b"};
+    for (unsigned p = 0; p < 2; p++) {
+        out << (p ? "," : "") << "\"" << presets[p] << "\" : {";
+        for (unsigned m = 0; m < BENCH_MODULES; m++) {
+            out << (m ? "," : "") << "\"module" << m << "\" : { \"moduleType\" : \"bench\", \"params\" : {";
+            for (unsigned i = 0; i < BENCH_PARAMS; i++) {
+                out << (i ? "," : "") << "\"p" << i << "\" : " << (p * 50 + (m + i) % 50);
+            }
+            out << "}, \"midi-mapping\" : { \"cc\" : { \"1\" : [\"p10\"] } } }";
+        }
+        out << "}";
+    }
+    out << "} }" << std::endl;
+}
+
+void checkPresetValues(Kontrol::Rack &rack, unsigned p) {
+    for (unsigned m = 0; m < BENCH_MODULES; m++) {
+        auto module = rack.getModule("module" + std::to_string(m));
+        for (unsigned i = 0; i < BENCH_PARAMS; i++) {
+            float v = module->getParams()[i]->current().floatValue();
+            assert(v == (float) (p * 50 + (m + i) % 50));
+        }
+        assert(module->getParamsForCC(1).size() == 1);
+    }
+}
+
+void presetBenchmark(const char *name, Kontrol::Rack &rack, CountingCallback &counter) {
+    counter.changed_ = 0;
+    // first switch resolves handles (binary)
+    assert(rack.applyPreset("a"));
+    checkPresetValues(rack, 0);
+    double worst = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < BENCH_SWITCHES; i++) {
+        auto s = std::chrono::steady_clock::now();
+        rack.applyPreset(i % 2 ? "a" : "b");
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - s).count();
+        if (us > worst) worst = us;
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    checkPresetValues(rack, 0);
+    LOG_0(name
+                  << " switches " << BENCH_SWITCHES
+                  << " params " << BENCH_MODULES * BENCH_PARAMS
+                  << " changes " << counter.changed_
+                  << " " << (secs * 1000000.0 / BENCH_SWITCHES) << "us/switch"
+                  << " (max " << worst << "us)");
+}
+
+void presetChecks(std::shared_ptr<Kontrol::KontrolModel> model, Kontrol::Rack &rack, CountingCallback &counter) {
+    std::string jsonFile = "bench-presets.json";
+    std::string binFile = "bench-presets.kpre";
+    std::string exportFile = "bench-export.json";
+    writeBenchPresets(jsonFile);
+
+    assert(rack.loadSettings(jsonFile));
+    presetBenchmark("preset switch json", rack, counter);
+
+    // import, json -> binary
+    assert(rack.saveBinarySettings(binFile));
+    assert(Kontrol::PresetFile::isPresetFile(binFile));
+    assert(!Kontrol::PresetFile::isPresetFile(jsonFile));
+    assert(rack.loadSettings(binFile));
+    assert(rack.getPresetList().size() == 2);
+    presetBenchmark("preset switch binary", rack, counter);
+    assert(!rack.applyPreset("missing"));
+
+    // preset values are applied with current parameter handles
+    rack.addMidiCCMapping(2, "module0", "p11");
+    assert(rack.applyPreset("b"));
+    checkPresetValues(rack, 1);
+    assert(rack.getModule("module0")->getParamsForCC(2).empty());
+
+    // updated presets are used straight away, and saved back as binary
+    model->changeParam(Kontrol::CS_LOCAL, rack.id(), "module0", "p0", Kontrol::ParamValue(99.0f));
+    rack.updatePreset("b");
+    assert(rack.applyPreset("a"));
+    assert(rack.applyPreset("b"));
+    assert(rack.getModule("module0")->getParam("p0")->current().floatValue() == 99.0f);
+    assert(rack.saveSettings());
+    assert(Kontrol::PresetFile::isPresetFile(binFile));
+    assert(rack.applyPreset("a"));
+    assert(rack.applyPreset("b"));
+    assert(rack.getModule("module0")->getParam("p0")->current().floatValue() == 99.0f);
+
+    // export, binary -> json
+    assert(rack.saveSettings(exportFile));
+    assert(rack.loadSettings(exportFile));
+    assert(rack.applyPreset("a"));
+    checkPresetValues(rack, 0);
+
+    // corrupt files are rejected
+    Kontrol::PresetFile file;
+    assert(file.open(binFile));
+    file.close();
+    {
+        std::fstream f(binFile, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(8);
+        uint32_t size = 16;
+        f.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    }
+    assert(!file.open(binFile));
+
+    std::remove(jsonFile.c_str());
+    std::remove(binFile.c_str());
+    std::remove(exportFile.c_str());
+}
+
+// osc loopback, an OSCBroadcaster sending to a listener on this host, counting what arrives
+static const unsigned BENCH_OSC_PORT = 9201;
+static const unsigned BENCH_OSC_RUNS = 5;
+static const unsigned BENCH_OSC_CHANGES = 10000;
+
+class CountingOscListener : public osc::OscPacketListener {
+public:
+    CountingOscListener() : packets_(0), messages_(0), changed_(0), lastValue_(0.0f) { ; }
+
+    void ProcessPacket(const char *data, int size, const IpEndpointName &remoteEndpoint) override {
+        packets_++;
+        osc::OscPacketListener::ProcessPacket(data, size, remoteEndpoint);
+    }
+
+    void ProcessMessage(const osc::ReceivedMessage &m, const IpEndpointName &) override {
+        messages_++;
+        if (std::strcmp(m.AddressPattern(), "/Kontrol/changed") == 0) {
+            osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+            arg++;
+            arg++;
+            arg++;
+            if (arg->IsFloat()) lastValue_ = arg->AsFloat();
+            changed_++;
+        }
+    }
+
+    void reset() {
+        packets_ = 0;
+        messages_ = 0;
+        changed_ = 0;
+    }
+
+    std::atomic<unsigned long> packets_;
+    std::atomic<unsigned long> messages_;
+    std::atomic<unsigned long> changed_;
+    std::atomic<float> lastValue_;
+};
+
+// wait until count reaches n, or nothing arrives for a while (i.e. the rest was lost)
+bool waitForCount(std::atomic<unsigned long> &count, unsigned long n) {
+    unsigned long last = count;
+    auto progress = std::chrono::steady_clock::now();
+    while (count < n) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        if (count != last) {
+            last = count;
+            progress = std::chrono::steady_clock::now();
+        } else if (std::chrono::steady_clock::now() - progress > std::chrono::milliseconds(500)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// messages a master broadcaster publishes on ping, for all racks
+unsigned long metaDataMessages(std::shared_ptr<Kontrol::KontrolModel> model) {
+    unsigned long n = 0;
+    for (auto r : model->getRacks()) {
+        n++;
+        for (auto m : r->getModules()) {
+            n += 1 + 2 * m->getParams().size();
+            for (auto p : m->getPages()) {
+                if (p != nullptr) n++;
+            }
+        }
+    }
+    return n;
+}
+
+// full rack meta data publication, as on the first ping from a client
+void metaDataBenchmark(const char *name, std::shared_ptr<Kontrol::KontrolModel> model,
+                       CountingOscListener &listener, unsigned maxPacketSize) {
+    std::string host = "127.0.0.1";
+    unsigned long expected = metaDataMessages(model);
+    double total = 0.0, worst = 0.0;
+    unsigned long packets = 0, received = 0, dropped = 0;
+    for (unsigned run = 0; run < BENCH_OSC_RUNS; run++) {
+        Kontrol::OSCBroadcaster broadcaster(Kontrol::CS_LOCAL, 0, true);
+        assert(broadcaster.connect(host, BENCH_OSC_PORT));
+        broadcaster.maxPacketSize(maxPacketSize);
+        listener.reset();
+
+        auto start = std::chrono::steady_clock::now();
+        broadcaster.ping(Kontrol::ChangeSource::createRemoteSource(host, BENCH_OSC_PORT), host, BENCH_OSC_PORT, 0);
+        waitForCount(listener.messages_, expected);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        broadcaster.stop();
+        total += ms;
+        if (ms > worst) worst = ms;
+        packets += broadcaster.packetsSent();
+        received += listener.messages_;
+        dropped += broadcaster.messagesDropped();
+        // the meta data burst fits the queue
+        assert(broadcaster.messagesDropped() == 0);
+    }
+    LOG_0(name
+                  << " messages " << expected
+                  << " packets " << packets / BENCH_OSC_RUNS
+                  << " received " << received / BENCH_OSC_RUNS
+                  << " dropped " << dropped / BENCH_OSC_RUNS
+                  << " " << total / BENCH_OSC_RUNS << "ms/publish"
+                  << " (max " << worst << "ms)");
+}
+
+void oscChecks(std::shared_ptr<Kontrol::KontrolModel> model, Kontrol::Rack &rack) {
+    CountingOscListener listener;
+    UdpListeningReceiveSocket socket(IpEndpointName("127.0.0.1", BENCH_OSC_PORT), &listener);
+    std::thread receiver([&socket] { socket.Run(); });
+
+    // meta data arrives complete, bundled into mtu sized packets
+    {
+        Kontrol::OSCBroadcaster broadcaster(Kontrol::CS_LOCAL, 0, true);
+        assert(broadcaster.connect("127.0.0.1", BENCH_OSC_PORT));
+        unsigned long expected = metaDataMessages(model);
+        broadcaster.ping(Kontrol::ChangeSource::createRemoteSource("127.0.0.1", BENCH_OSC_PORT), "127.0.0.1", BENCH_OSC_PORT, 0);
+        bool complete = waitForCount(listener.messages_, expected);
+        assert(complete);
+        assert(listener.messages_ == expected);
+        broadcaster.stop();
+        assert(broadcaster.messagesSent() == expected);
+        assert(broadcaster.messagesDropped() == 0);
+        assert(broadcaster.packetsSent() < expected);
+        assert(listener.packets_ == broadcaster.packetsSent());
+    }
+
+    metaDataBenchmark("osc meta data, packet per message", model, listener, 0);
+    metaDataBenchmark("osc meta data, mtu bundles       ", model, listener, Kontrol::OSCBroadcaster::MAX_PACKET_SIZE);
+
+    // a sweep of one parameter, only the latest value of those pending is sent, the final value always arrives
+    {
+        // as a client's broadcaster, so local changes are sent
+        auto broadcaster = std::make_shared<Kontrol::OSCBroadcaster>(
+                Kontrol::ChangeSource::createRemoteSource("127.0.0.1", BENCH_OSC_PORT), 0, true);
+        assert(broadcaster->connect("127.0.0.1", BENCH_OSC_PORT));
+        model->addCallback("osc", broadcaster);
+        listener.reset();
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < BENCH_OSC_CHANGES; i++) {
+            model->changeParam(Kontrol::CS_LOCAL, rack.id(), "module0", "p0", Kontrol::ParamValue((float) (i % 100) + 0.5f));
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        float last = (float) ((BENCH_OSC_CHANGES - 1) % 100) + 0.5f;
+        // every change is either sent or superseded, and the last received is the last made
+        auto end = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (broadcaster->messagesSent() + broadcaster->messagesCollapsed() < BENCH_OSC_CHANGES &&
+               std::chrono::steady_clock::now() < end) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        bool complete = waitForCount(listener.changed_, broadcaster->messagesSent());
+        assert(complete);
+        assert(listener.lastValue_ == last);
+        model->removeCallback("osc");
+        broadcaster->stop();
+        assert(broadcaster->messagesDropped() == 0);
+        assert(broadcaster->messagesSent() + broadcaster->messagesCollapsed() == BENCH_OSC_CHANGES);
+        LOG_0("osc param sweep changes " << BENCH_OSC_CHANGES
+                                        << " sent " << broadcaster->messagesSent()
+                                        << " collapsed " << broadcaster->messagesCollapsed()
+                                        << " dropped " << broadcaster->messagesDropped()
+                                        << " packets " << broadcaster->packetsSent()
+                                        << " send time " << ms << "ms");
+    }
+
+    socket.AsynchronousBreak();
+    receiver.join();
+}
+
+// receive path, changes as a client sends them (bundled to the mtu), parsed and applied to the model
+static const unsigned BENCH_RECEIVE_CHANGES = 100000;
+
+struct ChangePacket {
+    char data_[Kontrol::OSCBroadcaster::MAX_PACKET_SIZE];
+    unsigned size_;
+    unsigned msgs_;
+};
+
+// packets covering every bench parameter, value v
+std::vector<ChangePacket> createChangePackets(const Kontrol::Rack &rack, float v) {
+    std::vector<ChangePacket> packets;
+    ChangePacket packet;
+    osc::OutboundPacketStream *ops = nullptr;
+    for (unsigned m = 0; m < BENCH_MODULES; m++) {
+        std::string moduleId = "module" + std::to_string(m);
+        for (unsigned i = 0; i < BENCH_PARAMS; i++) {
+            std::string paramId = "p" + std::to_string(i);
+            if (ops != nullptr && ops->Size() > Kontrol::OSCBroadcaster::MAX_PACKET_SIZE - 100) {
+                *ops << osc::EndBundle;
+                packet.size_ = (unsigned) ops->Size();
+                packets.push_back(packet);
+                delete ops;
+                ops = nullptr;
+            }
+            if (ops == nullptr) {
+                ops = new osc::OutboundPacketStream(packet.data_, sizeof(packet.data_));
+                *ops << osc::BeginBundleImmediate;
+                packet.msgs_ = 0;
+            }
+            *ops << osc::BeginMessage("/Kontrol/changed")
+                 << rack.id().c_str() << moduleId.c_str() << paramId.c_str() << v
+                 << osc::EndMessage;
+            packet.msgs_++;
+        }
+    }
+    *ops << osc::EndBundle;
+    packet.size_ = (unsigned) ops->Size();
+    packets.push_back(packet);
+    delete ops;
+    return packets;
+}
+
+void receiveChecks(std::shared_ptr<Kontrol::KontrolModel> model, Kontrol::Rack &rack, CountingCallback &counter) {
+    Kontrol::OSCReceiver receiver(model);
+    IpEndpointName origin("127.0.0.1", BENCH_OSC_PORT);
+
+    // unknown addresses are ignored
+    {
+        char buffer[256];
+        osc::OutboundPacketStream ops(buffer, sizeof(buffer));
+        ops << osc::BeginBundleImmediate
+            << osc::BeginMessage("/Kontrol/nothere") << 1.0f << osc::EndMessage
+            << osc::BeginMessage("/Kontrol/changed") << rack.id().c_str() << "module1" << "p1" << 20.0f << osc::EndMessage
+            << osc::EndBundle;
+        assert(receiver.queuePacket(ops.Data(), (int) ops.Size(), origin));
+        receiver.poll();
+        assert(rack.getModule("module1")->getParam("p1")->current().floatValue() == 20.0f);
+    }
+
+    // a full queue drops, rather than overwrites
+    std::vector<ChangePacket> packets[2] = {createChangePackets(rack, 10.0f), createChangePackets(rack, 90.0f)};
+    unsigned queued = 0;
+    while (receiver.queuePacket(packets[0][0].data_, (int) packets[0][0].size_, origin)) queued++;
+    assert(queued > 0 && receiver.packetsDropped() == 1);
+    receiver.poll();
+    assert(rack.getModule("module0")->getParam("p0")->current().floatValue() == 10.0f);
+
+    // odd sizes wrap the queue, without splitting a packet
+    for (unsigned i = 0; i < 1000; i++) {
+        const ChangePacket &p = packets[i % 2][i % packets[i % 2].size()];
+        assert(receiver.queuePacket(p.data_, (int) p.size_, origin));
+        if (i % 7 == 0) receiver.poll();
+    }
+    receiver.poll();
+    for (const ChangePacket &p : packets[1]) assert(receiver.queuePacket(p.data_, (int) p.size_, origin));
+    receiver.poll();
+
+    counter.changed_ = 0;
+    unsigned long a = allocations;
+    unsigned long msgs = 0;
+    unsigned n = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (msgs < BENCH_RECEIVE_CHANGES) {
+        const std::vector<ChangePacket> &set = packets[n % 2];
+        for (const ChangePacket &p : set) {
+            if (!receiver.queuePacket(p.data_, (int) p.size_, origin)) {
+                receiver.poll();
+                receiver.queuePacket(p.data_, (int) p.size_, origin);
+            }
+            msgs += p.msgs_;
+        }
+        n++;
+    }
+    receiver.poll();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    assert(counter.changed_ == msgs);
+    assert(rack.getModule("module0")->getParam("p0")->current().floatValue() == ((n - 1) % 2 ? 90.0f : 10.0f));
+
+    LOG_0("osc receive changes " << msgs
+                                 << " time " << secs * 1000.0 << "ms"
+                                 << " " << (unsigned long) (msgs / secs) << " changes/s"
+                                 << " allocations " << (allocations - a));
+}
+
 int main(int argc, char **argv) {
     LOG_0("test kontrol started");
     std::string file;
@@ -88,6 +629,24 @@ int main(int argc, char **argv) {
         // rack->saveSettings("./rack.json");
     }
 
+    model->removeCallback("logger");
+    auto counter = std::make_shared<CountingCallback>();
+    model->addCallback("counter", counter);
+
+    auto rack = createBenchRack(model);
+    ccChecks(model, *rack);
+
+    ccBenchmark("cc by id", model, *counter, [&](unsigned cc, unsigned v) {
+        changeMidiCCById(model, *rack, cc, v);
+    });
+    ccBenchmark("cc table", model, *counter, [&](unsigned cc, unsigned v) {
+        rack->changeMidiCC(cc, v);
+    });
+
+    presetChecks(model, *rack, *counter);
+    oscChecks(model, *rack);
+    receiveChecks(model, *rack, *counter);
+
     LOG_0("test completed");
     return 0;
 }
\ No newline at end of file